@@ -513,7 +513,8 @@ cos_status_t *cos_get_object_acl(const cos_request_options_t *options,
  * @param[out]  params        output params for list object response,
                               including truncated, next_marker, obje list
  * @param[out]  resp_headers  cos server response headers
- * @return  cos_status_t, code is 2xx success, other failure
+ * @return  cos_status_t, code is 2xx success, other failure, the lists and the markers
+ *          of params are undefined on failure and truncated is left unchanged
  */
 cos_status_t *cos_list_object(const cos_request_options_t *options, 
                               const cos_string_t *bucket, 
@@ -530,7 +531,8 @@ cos_status_t *cos_list_object(const cos_request_options_t *options,
  * @param[out]  params        output params for list object response,
                               including truncated, next_marker, obje list
  * @param[out]  resp_headers  cos server response headers
- * @return  cos_status_t, code is 2xx success, other failure
+ * @return  cos_status_t, code is 2xx success, other failure, the lists and the markers
+ *          of params are undefined on failure and truncated is left unchanged
  */
 cos_status_t *cos_do_list_object(const cos_request_options_t *options,
                               const cos_string_t *bucket,
@@ -538,6 +540,42 @@ cos_status_t *cos_do_list_object(const cos_request_options_t *options,
                               cos_list_object_params_t *params, 
                               cos_table_t **resp_headers);
 
+/*
+ * @brief  list cos objects, the objects are passed to the callback as the body is parsed
+ *         instead of being added to object_list, the page is never kept in memory
+ * @param[in]   options       the cos request options
+ * @param[in]   bucket        the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   params        input params for list object request,
+                              including prefix, marker, delimiter, max_ret
+ * @param[out]  params        output params for list object response,
+                              including truncated, next_marker, common prefix list
+ * @param[in]   callback      called with each object, the content is valid only in the call,
+ *                            the rest objects of the page are skipped if it does not return COSE_OK
+ * @param[in]   data          passed to callback
+ * @param[out]  resp_headers  cos server response headers
+ * @return  cos_status_t, code is 2xx success, other failure, the lists and the markers
+ *          of params are undefined on failure and truncated is left unchanged
+ */
+cos_status_t *cos_list_object_with_callback(const cos_request_options_t *options,
+                                            const cos_string_t *bucket,
+                                            cos_list_object_params_t *params,
+                                            cos_list_object_callback callback,
+                                            void *data,
+                                            cos_table_t **resp_headers);
+
+/*
+ * @brief  list all cos objects under a prefix by partitions of the key space listed at the same time,
+ *         the partitions are the common prefixes of the delimiter, or the ranges ended by split keys
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   params              the prefix, partitions, threads and callback, created by
+ *                                  cos_create_list_object_parallel_params, object_count and object_list are filled
+ * @return  cos_status_t, code is 2xx success, other the status of the first failed partition
+ */
+cos_status_t *cos_list_object_parallel(cos_request_options_t *options,
+                                       const cos_string_t *bucket,
+                                       cos_list_object_parallel_params_t *params);
+
 /*
  * @brief  put cos object from buffer
  * @param[in]   options             the cos request options
@@ -788,6 +826,36 @@ cos_status_t *cos_delete_objects_by_prefix(cos_request_options_t *options,
                                            const cos_string_t *bucket, 
                                            const cos_string_t *prefix);
 
+/*
+ * @brief  delete cos objects in quiet mode, and get the keys failed to delete
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   object_list         the cos object list name
+ * @param[out]  resp_headers        cos server response headers
+ * @param[out]  error_list          the cos_object_delete_error_t of the keys failed to delete
+ * @return  cos_status_t, code is 2xx success, other failure
+ */
+cos_status_t *cos_delete_objects_quiet(const cos_request_options_t *options,
+                                       const cos_string_t *bucket,
+                                       cos_list_t *object_list,
+                                       cos_table_t **resp_headers,
+                                       cos_list_t *error_list);
+
+/*
+ * @brief  delete cos objects by prefix, the next page is listed while the delete requests of
+ *         the former pages are in flight, the failed keys are retried after the listing ends
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   prefix              prefix of delete objects
+ * @param[in]   del_params          the concurrency, retries, dry run and progress callback, created by
+ *                                  cos_create_delete_by_prefix_params, the counts and failed keys are filled
+ * @return  cos_status_t, code is 2xx success, other failure, the failed keys are in del_params->failed_list
+ */
+cos_status_t *cos_delete_objects_by_prefix_mt(cos_request_options_t *options,
+                                              const cos_string_t *bucket,
+                                              const cos_string_t *prefix,
+                                              cos_delete_by_prefix_params_t *del_params);
+
 
 /*
  * @brief  append cos object from buffer
@@ -1074,6 +1142,29 @@ cos_status_t *cos_upload_part_from_buffer(const cos_request_options_t *options,
                                           cos_list_t *buffer, 
                                           cos_table_t **resp_headers);
 
+/*
+ * @brief  cos upload part from buffer which is read ahead and digested
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   object              the cos object name
+ * @param[in]   upload_id           the upload id to upload if has
+ * @param[in]   part_num            the upload part number
+ * @param[in]   buffer              the buffer containing upload part content
+ * @param[in]   content_md5         the base64 md5 of buffer, NULL if md5 is disabled
+ * @param[in]   crc64               the crc64 of buffer, used if crc is enabled
+ * @param[out]  resp_headers        cos server response headers
+ * @return  cos_status_t, code is 2xx success, other failure
+ */
+cos_status_t *cos_upload_part_from_read_ahead(const cos_request_options_t *options, 
+                                              const cos_string_t *bucket, 
+                                              const cos_string_t *object, 
+                                              const cos_string_t *upload_id, 
+                                              int part_num, 
+                                              cos_list_t *buffer, 
+                                              const char *content_md5,
+                                              uint64_t crc64,
+                                              cos_table_t **resp_headers);
+
 /*
  * @brief  cos upload part from buffer
  * @param[in]   options             the cos request options
@@ -1216,7 +1307,8 @@ cos_status_t *cos_do_complete_multipart_upload(const cos_request_options_t *opti
  * @param[out]  params              the output params,
                                     including next_part_number_marker, part_list, truncated
  * @param[out]  resp_headers        cos server response headers
- * @return  cos_status_t, code is 2xx success, other failure
+ * @return  cos_status_t, code is 2xx success, other failure, the lists and the markers
+ *          of params are undefined on failure and truncated is left unchanged
  */
 cos_status_t *cos_list_upload_part(const cos_request_options_t *options, 
                                    const cos_string_t *bucket, 
@@ -1232,7 +1324,8 @@ cos_status_t *cos_list_upload_part(const cos_request_options_t *options,
  * @param[in]   params              the input list multipart upload parameters
  * @param[out]  params              the output params including next_key_marker, next_upload_id_markert, upload_list etc
  * @param[out]  resp_headers        cos server response headers
- * @return  cos_status_t, code is 2xx success, other failure
+ * @return  cos_status_t, code is 2xx success, other failure, the lists and the markers
+ *          of params are undefined on failure and truncated is left unchanged
  */
 cos_status_t *cos_list_multipart_upload(const cos_request_options_t *options, 
                                         const cos_string_t *bucket, 
@@ -1254,6 +1347,21 @@ cos_status_t *cos_upload_part_copy(const cos_request_options_t *options,
                                    cos_table_t **resp_headers);
 
 
+/*
+ * @brief  index the parts uploaded to a multipart upload by part number
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   object              the cos object name
+ * @param[in]   upload_id           the upload id of the multipart upload
+ * @param[out]  index               the index the uploaded parts are put into
+ * @return  cos_status_t, code is 2xx success, other failure
+ */
+cos_status_t *cos_build_uploaded_part_index(cos_request_options_t *options,
+                                            const cos_string_t *bucket, 
+                                            const cos_string_t *object, 
+                                            const cos_string_t *upload_id, 
+                                            cos_part_index_t *index);
+
 /*
  * @brief  cos upload file using multipart upload
  * @param[in]   options             the cos request options
@@ -1273,6 +1381,29 @@ cos_status_t *cos_upload_file(cos_request_options_t *options,
                               int64_t part_size,
                               cos_table_t *headers);
 
+/*
+ * @brief  cos upload file using multipart upload with mulit-thread
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   object              the cos object name
+ * @param[in]   upload_id           the upload id to upload if has, the parts missing from it are uploaded only
+ * @param[in]   filename            the filename containing object content
+ * @param[in]   part_size           the part size for multipart upload
+ * @param[in]   thread_num          the number of parts uploaded at the same time
+ * @param[in]   headers             the headers for request
+ * @param[in]   progress_callback   the progress callback function
+ * @return  cos_status_t, code is 2xx success, other failure
+ */
+cos_status_t *cos_upload_file_mt(cos_request_options_t *options,
+                                 const cos_string_t *bucket, 
+                                 const cos_string_t *object, 
+                                 cos_string_t *upload_id,
+                                 cos_string_t *filename, 
+                                 int64_t part_size,
+                                 int32_t thread_num,
+                                 cos_table_t *headers,
+                                 cos_progress_callback progress_callback);
+
 /*
  * @brief  cos upload object using part copy
  * @param[in]   options             the cos request options
@@ -1291,6 +1422,36 @@ cos_status_t *cos_upload_object_by_part_copy
         int64_t part_size
 );
 
+/*
+ * @brief  cos copy object by part copy with mulit-thread and checkpoint, a copy broken off
+ *         is resumed by the upload recorded in the checkpoint if the source is unchanged
+ * @param[in]   options             the cos request options
+ * @param[in]   src_bucket          the cos source bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   src_object          the cos source object name
+ * @param[in]   src_endpoint        the cos source endpoint
+ * @param[in]   dest_bucket         the cos dest bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   dest_object         the cos dest object name
+ * @param[in]   part_size           the part size for multipart upload
+ * @param[in]   thread_num          the number of parts copied at the same time
+ * @param[in]   checkpoint_path     the checkpoint file, removed after the copy succeeds, the copy starts
+ *                                  over only if the upload of it is gone, other errors keep it to resume
+ * @param[in]   progress_callback   the progress callback function
+ * @return  cos_status_t, code is 2xx success, other failure
+ */
+cos_status_t *cos_upload_object_by_part_copy_mt_with_cp
+(
+        cos_request_options_t *options,
+        cos_string_t *src_bucket,
+        cos_string_t *src_object,
+        cos_string_t *src_endpoint,
+        cos_string_t *dest_bucket, 
+        cos_string_t *dest_object,
+        int64_t part_size,
+        int32_t thread_num,
+        cos_string_t *checkpoint_path,
+        cos_progress_callback progress_callback
+);
+
 /*
  * @brief  cos download part to file
  * @param[in]   options             the cos request options
@@ -1327,6 +1488,64 @@ cos_status_t *cos_do_download_part_to_file(const cos_request_options_t *options,
                                            cos_table_t *params,
                                            cos_table_t **resp_headers);
 
+/*
+ * @brief  cos download part to the range of a memory shared by parts
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   object              the cos object name
+ * @param[in]   download_file       the part range to download, filename is only for log
+ * @param[in]   buffer              the memory of the part range, in the memory shared by parts
+ * @param[out]  resp_headers        cos server response headers
+ * @return  cos_status_t, code is 2xx success, other failure
+ */
+cos_status_t *cos_download_part_to_buffer(const cos_request_options_t *options,
+                                          const cos_string_t *bucket, 
+                                          const cos_string_t *object,
+                                          cos_upload_file_t *download_file,
+                                          char *buffer,
+                                          cos_table_t **resp_headers);
+
+/*
+ * @brief  cos download part to the range of a file shared by parts, with positional write
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   object              the cos object name
+ * @param[in]   download_file       the part range to download, filename is only for log
+ * @param[in]   file                the file opened by cos_open_file_for_shared_write
+ * @param[out]  resp_headers        cos server response headers
+ * @return  cos_status_t, code is 2xx success, other failure
+ */
+cos_status_t *cos_download_part_to_shared_file(const cos_request_options_t *options,
+                                               const cos_string_t *bucket, 
+                                               const cos_string_t *object,
+                                               cos_upload_file_t *download_file,
+                                               apr_file_t *file,
+                                               cos_table_t **resp_headers);
+
+/*
+ * @brief  cos download part to the range of a file shared by parts, with positional write
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   object              the cos object name
+ * @param[in]   download_file       the part range to download, filename is only for log
+ * @param[in]   file                the file opened by cos_open_file_for_shared_write, 
+ *                                  NULL to open download_file for the part
+ * @param[in]   progress_callback   the progress callback function
+ * @param[in]   headers             the headers for request
+ * @param[in]   params              the params for request
+ * @param[out]  resp_headers        cos server response headers
+ * @return  cos_status_t, code is 2xx success, other failure
+ */
+cos_status_t *cos_do_download_part_to_shared_file(const cos_request_options_t *options,
+                                                  const cos_string_t *bucket, 
+                                                  const cos_string_t *object,
+                                                  cos_upload_file_t *download_file,
+                                                  apr_file_t *file,
+                                                  cos_progress_callback progress_callback,
+                                                  cos_table_t *headers, 
+                                                  cos_table_t *params,
+                                                  cos_table_t **resp_headers);
+
 /*
  * @brief  cos upload file with mulit-thread and resumable
  * @param[in]   options             the cos request options
@@ -1350,6 +1569,145 @@ cos_status_t *cos_resumable_upload_file(cos_request_options_t *options,
                                         cos_table_t **resp_headers,
                                         cos_list_t *resp_body);
 
+/*
+ * @brief  cos download file with mulit-thread and resumable
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   object              the cos object name
+ * @param[in]   filename            the filename to store the object content
+ * @param[in]   headers             the headers for request    
+ * @param[in]   params              the params for request
+ * @param[in]   clt_params          the control params of download, with checkpoint enabled 
+ *                                  only the parts not downloaded yet are downloaded again
+ * @param[in]   progress_callback   the progress callback function
+ * @return  cos_status_t, code is 0 success, other failure
+ */
+cos_status_t *cos_resumable_download_file(cos_request_options_t *options,
+                                          cos_string_t *bucket, 
+                                          cos_string_t *object, 
+                                          cos_string_t *filepath,                           
+                                          cos_table_t *headers,
+                                          cos_table_t *params,
+                                          cos_resumable_clt_params_t *clt_params, 
+                                          cos_progress_callback progress_callback);
+
+/*
+ * @brief  cos download object to one contiguous memory with mulit-thread, parts are
+ *         written at their offsets and the crc64 of parts is combined to verify the object
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   object              the cos object name
+ * @param[in]   part_size           the part size of range download
+ * @param[in]   thread_num          the number of parts downloaded at the same time
+ * @param[in,out]  buffer           NULL to allocate the memory from options->pool, 
+ *                                  otherwise the memory of caller, the object content on success
+ * @param[in,out]  buffer_len       the size of the memory of caller, the object size on success
+ * @param[in]   progress_callback   the progress callback function
+ * @return  cos_status_t, code is 0 success, other failure
+ */
+cos_status_t *cos_download_object_to_buffer_mt(cos_request_options_t *options,
+                                               cos_string_t *bucket, 
+                                               cos_string_t *object, 
+                                               int64_t part_size,
+                                               int32_t thread_num,
+                                               char **buffer,
+                                               int64_t *buffer_len,
+                                               cos_progress_callback progress_callback);
+
+/*
+ * @brief  cos download object to a sink with mulit-thread, ranges are downloaded ahead of
+ *         the sink and delivered strictly in order, a slow sink holds back the downloads
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   object              the cos object name
+ * @param[in]   part_size           the part size of range download
+ * @param[in]   thread_num          the number of parts downloaded at the same time,
+ *                                  at most thread_num + 2 parts are held in memory
+ * @param[in]   sink_callback       called with the object content in order in the calling thread
+ * @param[in]   sink_data           the data passed to sink_callback
+ * @param[in]   progress_callback   the progress callback function
+ * @return  cos_status_t, code is 0 success, other failure, the content delivered is
+ *          invalid if the code is COSE_CRC_INCONSISTENT_ERROR
+ */
+cos_status_t *cos_download_object_to_sink_mt(cos_request_options_t *options,
+                                             cos_string_t *bucket, 
+                                             cos_string_t *object, 
+                                             int64_t part_size,
+                                             int32_t thread_num,
+                                             cos_download_sink_callback sink_callback,
+                                             void *sink_data,
+                                             cos_progress_callback progress_callback);
+
+/*
+ * @brief  cos upload the files of a local directory tree to objects under prefix, the small files 
+ *         are uploaded as whole objects and the large ones by parts, on the same threads
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   local_dir           the local directory, a file dir/a/b is uploaded to prefix + "a/b",
+ *                                  a link to a file is uploaded as the file, links to directories are not followed
+ * @param[in]   prefix              the prefix of objects, with the trailing '/' if any
+ * @param[in]   headers             the headers for request of every file
+ * @param[in]   clt_params          the control params, thread_num is the threads shared by all files,
+ *                                  files larger than part_size and 8MB are uploaded by parts
+ * @param[out]  results             the cos_dir_transfer_result_t of every file
+ * @return  cos_status_t, code is 0 success, other the status of the first failed file
+ */
+cos_status_t *cos_upload_dir(cos_request_options_t *options,
+                             cos_string_t *bucket, 
+                             cos_string_t *local_dir, 
+                             cos_string_t *prefix,
+                             cos_table_t *headers,
+                             cos_resumable_clt_params_t *clt_params,
+                             cos_list_t *results);
+
+/*
+ * @brief  cos download the objects under prefix to a local directory tree, the small objects
+ *         are downloaded as whole objects and the large ones by parts, on the same threads
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   prefix              the prefix of objects, an object prefix + "a/b" is downloaded to dir/a/b,
+ *                                  an object whose key after prefix is absolute or has a ".." segment
+ *                                  is failed without being downloaded
+ * @param[in]   local_dir           the local directory, created if not exists
+ * @param[in]   clt_params          the control params, thread_num is the threads shared by all objects,
+ *                                  objects larger than part_size and 8MB are downloaded by parts
+ * @param[out]  results             the cos_dir_transfer_result_t of every object
+ * @return  cos_status_t, code is 0 success, other the status of the first failed object
+ */
+cos_status_t *cos_download_dir(cos_request_options_t *options,
+                               cos_string_t *bucket, 
+                               cos_string_t *prefix,
+                               cos_string_t *local_dir, 
+                               cos_resumable_clt_params_t *clt_params,
+                               cos_list_t *results);
+
+/*
+ * @brief  cos sync a local directory tree to the objects under prefix, a file is uploaded only if
+ *         its object is missing, of another size, or of another crc64, the crc64 of unchanged
+ *         files comes from the digest cache set by cos_set_digest_cache, and the files of the
+ *         same size are compared in parallel on the threads of the transfer
+ * @param[in]   options             the cos request options
+ * @param[in]   bucket              the cos bucket name, syntax: [bucket]-[appid], for example: mybucket-1253666666
+ * @param[in]   local_dir           the local directory
+ * @param[in]   prefix              the prefix of objects, a file dir/a/b is synced to prefix + "a/b"
+ * @param[in]   headers             the headers for every upload request
+ * @param[in]   clt_params          the control params, the same as cos_upload_dir
+ * @param[in]   delete_extraneous   COS_TRUE to delete the objects under prefix without local files,
+ *                                  only if every file to upload succeeds, the objects of broken links,
+ *                                  links to directories and other entries not regular files are kept
+ * @param[out]  results             the cos_dir_transfer_result_t of every file and deleted object,
+ *                                  action tells whether it is transferred, skipped or deleted
+ * @return  cos_status_t, code is 0 success, other the status of the first failed file
+ */
+cos_status_t *cos_sync_dir(cos_request_options_t *options,
+                           cos_string_t *bucket,
+                           cos_string_t *local_dir,
+                           cos_string_t *prefix,
+                           cos_table_t *headers,
+                           cos_resumable_clt_params_t *clt_params,
+                           int delete_extraneous,
+                           cos_list_t *results);
+
 #if 0
 /*
  * @brief  cos create live channel
@@ -6,7 +6,13 @@
 #include "cos_auth.h"
 #include "cos_utility.h"
 #include "cos_xml.h"
+#include "cos_xml_stream.h"
 #include "cos_api.h"
+#include "apr_atomic.h"
+#include "apr_queue.h"
+#include "apr_thread_pool.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_cond.h"
 
 cos_status_t *cos_get_service(const cos_request_options_t *options,
                                 cos_get_service_params_t *params,
@@ -156,11 +162,14 @@ cos_status_t *cos_list_object(const cos_request_options_t *options,
     return cos_do_list_object(options, bucket, NULL, params, resp_headers);
 }
 
-cos_status_t *cos_do_list_object(const cos_request_options_t *options,
-                              const cos_string_t *bucket,
-                              cos_table_t *headers,
-                              cos_list_object_params_t *params, 
-                              cos_table_t **resp_headers)
+// the body is parsed as it arrives, the objects go to object_list or the callback
+static cos_status_t *cos_do_list_object_to_parser(const cos_request_options_t *options,
+                                                  const cos_string_t *bucket,
+                                                  cos_table_t *headers,
+                                                  cos_list_object_params_t *params,
+                                                  cos_list_object_callback callback,
+                                                  void *data,
+                                                  cos_table_t **resp_headers)
 {
     int res;
     cos_status_t *s = NULL;
@@ -168,6 +177,7 @@ cos_status_t *cos_do_list_object(const cos_request_options_t *options,
     cos_http_response_t *resp = NULL;
     cos_table_t *query_params = NULL;
     cos_table_t *pHeaders = NULL;
+    cos_list_parser_t *parser = NULL;
 
     //init query_params
     query_params = cos_table_create_if_null(options, query_params, 5);
@@ -182,16 +192,19 @@ cos_status_t *cos_do_list_object(const cos_request_options_t *options,
 
     cos_init_bucket_request(options, bucket, HTTP_GET, &req, 
                             query_params, pHeaders, &resp);
+    parser = cos_list_objects_parser_create(options->pool, params, callback, data);
+    cos_init_read_response_body_to_list_parser(parser, resp);
 
     s = cos_process_request(options, req, resp);
     cos_fill_read_response_header(resp, resp_headers);
     if (!cos_status_is_ok(s)) {
+        if (s->code == COSE_WRITE_BODY_ERROR) {
+            cos_xml_error_status_set(s, COSE_XML_PARSE_ERROR);
+        }
         return s;
     }
 
-    res = cos_list_objects_parse_from_body(options->pool, &resp->body, 
-            &params->object_list, &params->common_prefix_list, 
-            &params->next_marker, &params->truncated);
+    res = cos_list_parser_finish(parser);
     if (res != COSE_OK) {
         cos_xml_error_status_set(s, res);
     }
@@ -199,6 +212,472 @@ cos_status_t *cos_do_list_object(const cos_request_options_t *options,
     return s;
 }
 
+cos_status_t *cos_do_list_object(const cos_request_options_t *options,
+                              const cos_string_t *bucket,
+                              cos_table_t *headers,
+                              cos_list_object_params_t *params, 
+                              cos_table_t **resp_headers)
+{
+    return cos_do_list_object_to_parser(options, bucket, headers, params, NULL, NULL, resp_headers);
+}
+
+cos_status_t *cos_list_object_with_callback(const cos_request_options_t *options,
+                                            const cos_string_t *bucket,
+                                            cos_list_object_params_t *params,
+                                            cos_list_object_callback callback,
+                                            void *data,
+                                            cos_table_t **resp_headers)
+{
+    return cos_do_list_object_to_parser(options, bucket, NULL, params, callback, data, resp_headers);
+}
+
+
+typedef struct {
+    cos_list_t node;
+    cos_string_t prefix;
+    char *marker;                    // the listing starts after it
+    char *last;                      // the last key of the partition, NULL if not bounded
+    cos_string_t delimiter;          // set to list only the keys directly under prefix
+    cos_list_t pages;                // the pages waiting for the former partitions, ordered only
+    int done;
+} cos_list_partition_t;
+
+typedef struct {
+    cos_list_t node;
+    cos_pool_t *pool;                // owned by the page, released once it is delivered
+    cos_list_partition_t *partition;
+    cos_list_t object_list;
+    int last_page;
+    int buffered;                    // taken from the page budget, the partition was not next
+    cos_status_t *s;
+} cos_list_page_t;
+
+typedef struct {
+    cos_pool_t *pool;
+    cos_list_object_parallel_params_t *params;
+    cos_list_t partitions;
+    cos_list_partition_t *next_partition; // the first partition not delivered entirely, ordered only
+    apr_thread_mutex_t *mutex;       // guards next_partition and buffered_pages, ordered only
+    apr_thread_cond_t *cond;         // signaled once a page is delivered or next_partition moves
+    int buffered_pages;              // the pages of the later partitions listed and not delivered
+    int max_buffered_pages;
+    volatile apr_uint32_t stop;
+    cos_status_t *s;                 // the status of the first failed listing
+    cos_status_t *ok_s;              // the status of the first succeeded listing
+} cos_list_parallel_t;
+
+typedef struct {
+    const cos_request_options_t *options;
+    const cos_string_t *bucket;
+    cos_list_partition_t *partition;
+    apr_queue_t *pages;
+    cos_list_parallel_t *lp;
+} cos_list_partition_task_t;
+
+static void cos_dup_string(cos_pool_t *p, cos_string_t *dst, const cos_string_t *src)
+{
+    if (NULL != src->data) {
+        dst->data = apr_pstrndup(p, src->data, src->len);
+        dst->len = src->len;
+    }
+}
+
+static cos_list_object_content_t *cos_dup_list_object_content(cos_pool_t *p, cos_list_object_content_t *src)
+{
+    cos_list_object_content_t *content = cos_create_list_object_content(p);
+
+    cos_dup_string(p, &content->key, &src->key);
+    cos_dup_string(p, &content->last_modified, &src->last_modified);
+    cos_dup_string(p, &content->etag, &src->etag);
+    cos_dup_string(p, &content->size, &src->size);
+    cos_dup_string(p, &content->owner_id, &src->owner_id);
+    cos_dup_string(p, &content->owner_display_name, &src->owner_display_name);
+    cos_dup_string(p, &content->storage_class, &src->storage_class);
+    return content;
+}
+
+static cos_list_partition_t *cos_add_list_partition(cos_list_parallel_t *lp, const char *prefix, 
+                                                    const char *marker, const char *last)
+{
+    cos_list_partition_t *partition;
+
+    partition = (cos_list_partition_t *)cos_pcalloc(lp->pool, sizeof(cos_list_partition_t));
+    cos_str_set(&partition->prefix, apr_pstrdup(lp->pool, NULL == prefix ? "" : prefix));
+    partition->marker = apr_pstrdup(lp->pool, NULL == marker ? "" : marker);
+    partition->last = NULL == last ? NULL : apr_pstrdup(lp->pool, last);
+    cos_list_init(&partition->pages);
+    cos_list_add_tail(&partition->node, &lp->partitions);
+    return partition;
+}
+
+static cos_list_page_t *cos_create_list_page(cos_pool_t *p, cos_list_partition_t *partition)
+{
+    cos_pool_t *pool;
+    cos_list_page_t *page;
+
+    cos_pool_create(&pool, p);
+    page = (cos_list_page_t *)cos_pcalloc(pool, sizeof(cos_list_page_t));
+    page->pool = pool;
+    page->partition = partition;
+    cos_list_init(&page->object_list);
+    return page;
+}
+
+/*
+ * the pages of the next partition are delivered as they come, a page of a later partition is
+ * buffered till the former ones are done, so its worker waits for a free page of the budget,
+ * the next partition never waits and the listing always goes on
+ * @return COS_TRUE if the page takes one of the budget
+ */
+static int cos_acquire_list_page(cos_list_parallel_t *lp, cos_list_partition_t *partition)
+{
+    int buffered = COS_FALSE;
+
+    apr_thread_mutex_lock(lp->mutex);
+    while (partition != lp->next_partition && lp->buffered_pages >= lp->max_buffered_pages &&
+           !apr_atomic_read32(&lp->stop)) {
+        apr_thread_cond_wait(lp->cond, lp->mutex);
+    }
+    if (partition != lp->next_partition) {
+        buffered = COS_TRUE;
+        lp->buffered_pages++;
+        if (lp->buffered_pages > lp->params->peak_buffered_pages) {
+            lp->params->peak_buffered_pages = lp->buffered_pages;
+        }
+    }
+    apr_thread_mutex_unlock(lp->mutex);
+    return buffered;
+}
+
+/*
+ * the partitions are the common prefixes under prefix, a run of the keys directly under prefix
+ * between two common prefixes is a partition bounded by them, only the run boundaries are
+ * kept, the keys are listed again by the workers
+ */
+static cos_status_t *cos_discover_list_partitions(cos_request_options_t *options,
+                                                  const cos_string_t *bucket,
+                                                  cos_list_parallel_t *lp)
+{
+    cos_pool_t *parent_pool = options->pool;
+    cos_pool_t *subpool = NULL;
+    cos_status_t *s = NULL;
+    cos_list_object_params_t *params;
+    cos_list_object_content_t *content;
+    cos_list_object_common_prefix_t *common_prefix;
+    cos_list_partition_t *keys_partition = NULL;
+    cos_list_partition_t *partition;
+    cos_table_t *resp_headers = NULL;
+    char *last_prefix = NULL;
+
+    params = cos_create_list_object_params(parent_pool);
+    params->prefix = lp->params->prefix;
+    params->delimiter = lp->params->delimiter;
+    while (params->truncated && !cos_is_canceled(options->ctl)) {
+        cos_pool_create(&subpool, parent_pool);
+        options->pool = subpool;
+        cos_list_init(&params->object_list);
+        cos_list_init(&params->common_prefix_list);
+        s = cos_list_object(options, bucket, params, &resp_headers);
+        options->pool = parent_pool;
+        if (!cos_status_is_ok(s)) {
+            s = cos_status_dup(parent_pool, s);
+            cos_pool_destroy(subpool);
+            return s;
+        }
+        if (NULL == lp->ok_s) {
+            lp->ok_s = cos_status_dup(parent_pool, s);
+        }
+
+        // a page holds keys and common prefixes both in key order, merge them
+        content = cos_list_get_first(&params->object_list, cos_list_object_content_t, node);
+        common_prefix = cos_list_get_first(&params->common_prefix_list, cos_list_object_common_prefix_t, node);
+        while (NULL != content || NULL != common_prefix) {
+            if (NULL != content && (NULL == common_prefix || strcmp(content->key.data, common_prefix->prefix.data) < 0)) {
+                if (NULL == keys_partition) {
+                    // the run starts after the keys of the last common prefix, rolled up by the delimiter
+                    keys_partition = cos_add_list_partition(lp, lp->params->prefix.data, last_prefix, NULL);
+                    cos_str_set(&keys_partition->delimiter, apr_pstrdup(lp->pool, lp->params->delimiter.data));
+                }
+                content = content->node.next == &params->object_list ? NULL :
+                    cos_list_entry(content->node.next, cos_list_object_content_t, node);
+            } else {
+                if (NULL != keys_partition) {
+                    // no key directly under prefix equals a common prefix
+                    keys_partition->last = apr_pstrdup(lp->pool, common_prefix->prefix.data);
+                    keys_partition = NULL;
+                }
+                partition = cos_add_list_partition(lp, common_prefix->prefix.data, NULL, NULL);
+                last_prefix = partition->prefix.data;
+                common_prefix = common_prefix->node.next == &params->common_prefix_list ? NULL :
+                    cos_list_entry(common_prefix->node.next, cos_list_object_common_prefix_t, node);
+            }
+        }
+
+        if (params->truncated && NULL != params->next_marker.data) {
+            cos_str_set(&params->marker, apr_pstrndup(parent_pool, params->next_marker.data, params->next_marker.len));
+        }
+        cos_pool_destroy(subpool);
+    }
+    if (cos_is_canceled(options->ctl)) {
+        s = cos_status_create(parent_pool);
+        cos_status_set(s, COSE_CANCELED_ERROR, COS_CANCELED_ERROR_CODE, NULL);
+        return s;
+    }
+
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC cos_list_partition(apr_thread_t *thd, void *data)
+{
+    cos_list_partition_task_t *task = (cos_list_partition_task_t *)data;
+    cos_list_partition_t *partition = task->partition;
+    cos_pool_t *nextmark_pool = NULL;
+    cos_request_options_t options;
+    cos_list_object_params_t *params;
+    cos_list_object_content_t *content;
+    cos_list_object_content_t *next;
+    cos_list_object_common_prefix_t *common_prefix;
+    cos_list_page_t *page;
+    cos_table_t *resp_headers = NULL;
+    char *marker = partition->marker;
+    int last_page = COS_FALSE;
+    int buffered = COS_FALSE;
+
+    while (!last_page) {
+        if (task->lp->params->ordered) {
+            buffered = cos_acquire_list_page(task->lp, partition);
+        }
+        page = cos_create_list_page(task->options->pool, partition);
+        page->buffered = buffered;
+        options = *task->options;
+        options.pool = page->pool;
+        options.ctl = cos_http_controller_create(page->pool, 0);
+        options.ctl->options = task->options->ctl->options;
+        options.ctl->cancel = task->options->ctl->cancel;
+
+        params = cos_create_list_object_params(page->pool);
+        if (task->lp->params->max_ret > 0) {
+            params->max_ret = task->lp->params->max_ret;
+        }
+        cos_str_set(&params->prefix, partition->prefix.data);
+        cos_str_set(&params->marker, marker);
+        if (NULL != partition->delimiter.data) {
+            cos_str_set(&params->delimiter, partition->delimiter.data);
+        }
+        page->s = cos_list_object(&options, task->bucket, params, &resp_headers);
+        if (!cos_status_is_ok(page->s)) {
+            last_page = COS_TRUE;
+        } else {
+            cos_list_for_each_entry_safe(cos_list_object_content_t, content, next, &params->object_list, node) {
+                cos_list_del(&content->node);
+                if (NULL != partition->last && strcmp(content->key.data, partition->last) > 0) {
+                    last_page = COS_TRUE;
+                    break;
+                }
+                cos_list_add_tail(&content->node, &page->object_list);
+            }
+            // the run of keys ends at the common prefix bounding it
+            if (NULL != partition->last && !cos_list_empty(&params->common_prefix_list)) {
+                common_prefix = cos_list_entry(params->common_prefix_list.prev, cos_list_object_common_prefix_t, node);
+                last_page = last_page || strcmp(common_prefix->prefix.data, partition->last) >= 0;
+            }
+            last_page = last_page || !params->truncated || NULL == params->next_marker.data ||
+                apr_atomic_read32(&task->lp->stop) || cos_is_canceled(task->options->ctl);
+        }
+
+        if (!last_page) {
+            if (NULL != nextmark_pool) {
+                cos_pool_destroy(nextmark_pool);
+            }
+            cos_pool_create(&nextmark_pool, NULL);
+            marker = apr_pstrndup(nextmark_pool, params->next_marker.data, params->next_marker.len);
+        }
+        page->last_page = last_page;
+        apr_queue_push(task->pages, page);
+    }
+    if (NULL != nextmark_pool) {
+        cos_pool_destroy(nextmark_pool);
+    }
+
+    return NULL;
+}
+
+static void cos_deliver_list_page(cos_list_parallel_t *lp, cos_list_page_t *page)
+{
+    cos_list_object_parallel_params_t *params = lp->params;
+    cos_list_object_content_t *content;
+
+    cos_list_for_each_entry(cos_list_object_content_t, content, &page->object_list, node) {
+        if (apr_atomic_read32(&lp->stop)) {
+            break;
+        }
+        params->object_count++;
+        if (NULL == params->callback) {
+            cos_list_add_tail(&cos_dup_list_object_content(lp->pool, content)->node, &params->object_list);
+        } else if (params->callback(params->callback_data, content) != COSE_OK) {
+            apr_atomic_set32(&lp->stop, COS_TRUE);
+        }
+    }
+    cos_pool_destroy(page->pool);
+}
+
+// deliver the buffered pages of the partitions in order, up to the first one not done
+static void cos_deliver_list_partitions(cos_list_parallel_t *lp)
+{
+    cos_list_page_t *page;
+    cos_list_page_t *next;
+    int delivered = 0;
+
+    while (&lp->next_partition->node != &lp->partitions) {
+        cos_list_for_each_entry_safe(cos_list_page_t, page, next, &lp->next_partition->pages, node) {
+            cos_list_del(&page->node);
+            delivered += page->buffered;
+            cos_deliver_list_page(lp, page);
+        }
+        if (!lp->next_partition->done) {
+            break;
+        }
+        apr_thread_mutex_lock(lp->mutex);
+        lp->next_partition = cos_list_entry(lp->next_partition->node.next, cos_list_partition_t, node);
+        apr_thread_mutex_unlock(lp->mutex);
+    }
+
+    // wake the workers waiting for the budget, also on stop
+    apr_thread_mutex_lock(lp->mutex);
+    lp->buffered_pages -= delivered;
+    apr_thread_cond_broadcast(lp->cond);
+    apr_thread_mutex_unlock(lp->mutex);
+}
+
+static void cos_finish_list_page(cos_list_parallel_t *lp, cos_list_page_t *page)
+{
+    cos_list_partition_t *partition = page->partition;
+
+    if (!cos_status_is_ok(page->s)) {
+        if (NULL == lp->s) {
+            lp->s = cos_status_dup(lp->pool, page->s);
+        }
+        apr_atomic_set32(&lp->stop, COS_TRUE);
+    } else if (NULL == lp->ok_s) {
+        lp->ok_s = cos_status_dup(lp->pool, page->s);
+    }
+    partition->done = page->last_page;
+
+    if (!lp->params->ordered) {
+        cos_deliver_list_page(lp, page);
+    } else {
+        cos_list_add_tail(&page->node, &partition->pages);
+        cos_deliver_list_partitions(lp);
+    }
+}
+
+cos_status_t *cos_list_object_parallel(cos_request_options_t *options,
+                                       const cos_string_t *bucket,
+                                       cos_list_object_parallel_params_t *params)
+{
+    cos_pool_t *parent_pool = options->pool;
+    cos_status_t *s = NULL;
+    cos_list_parallel_t lp;
+    cos_list_partition_t *partition;
+    cos_list_partition_task_t *task;
+    cos_object_key_t *split;
+    apr_thread_pool_t *thrp = NULL;
+    apr_queue_t *pages = NULL;
+    const char *marker = NULL;
+    void *page;
+    int thread_num = params->thread_num > 0 ? params->thread_num : COS_LIST_PARALLEL_THREAD_NUM;
+    int running = 0;
+    int rv;
+
+    memset(&lp, 0, sizeof(lp));
+    lp.pool = parent_pool;
+    lp.params = params;
+    cos_list_init(&lp.partitions);
+    params->object_count = 0;
+    params->peak_buffered_pages = 0;
+    cos_list_init(&params->object_list);
+
+    if (!cos_list_empty(&params->split_list)) {
+        cos_list_for_each_entry(cos_object_key_t, split, &params->split_list, node) {
+            cos_add_list_partition(&lp, params->prefix.data, marker, split->key.data);
+            marker = split->key.data;
+        }
+        cos_add_list_partition(&lp, params->prefix.data, marker, NULL);
+    } else {
+        s = cos_discover_list_partitions(options, bucket, &lp);
+        if (NULL != s) {
+            return s;
+        }
+    }
+
+    rv = apr_queue_create(&pages, thread_num * 2, parent_pool);
+    if (APR_SUCCESS != rv) {
+        s = cos_status_create(parent_pool);
+        cos_status_set(s, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL);
+        return s;
+    }
+    if (params->ordered) {
+        lp.max_buffered_pages = params->max_buffered_pages > 0 ? params->max_buffered_pages :
+            thread_num * COS_LIST_PARALLEL_BUFFER_PAGES;
+        if (apr_thread_mutex_create(&lp.mutex, APR_THREAD_MUTEX_DEFAULT, parent_pool) != APR_SUCCESS ||
+            apr_thread_cond_create(&lp.cond, parent_pool) != APR_SUCCESS) {
+            s = cos_status_create(parent_pool);
+            cos_status_set(s, COSE_INTERNAL_ERROR, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL);
+            return s;
+        }
+    }
+    rv = apr_thread_pool_create(&thrp, 0, thread_num, parent_pool);
+    if (APR_SUCCESS != rv) {
+        s = cos_status_create(parent_pool);
+        cos_status_set(s, rv, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL);
+        return s;
+    }
+
+    lp.next_partition = cos_list_entry(lp.partitions.next, cos_list_partition_t, node);
+    cos_list_for_each_entry(cos_list_partition_t, partition, &lp.partitions, node) {
+        task = (cos_list_partition_task_t *)cos_pcalloc(parent_pool, sizeof(cos_list_partition_task_t));
+        task->options = options;
+        task->bucket = bucket;
+        task->partition = partition;
+        task->pages = pages;
+        task->lp = &lp;
+        rv = apr_thread_pool_push(thrp, cos_list_partition, task, 0, NULL);
+        if (APR_SUCCESS != rv) {
+            if (NULL == lp.s) {
+                lp.s = cos_status_create(parent_pool);
+                cos_status_set(lp.s, rv, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL);
+            }
+            apr_atomic_set32(&lp.stop, COS_TRUE);
+            partition->done = COS_TRUE;
+            continue;
+        }
+        running++;
+    }
+    if (params->ordered) {
+        cos_deliver_list_partitions(&lp);
+    }
+
+    // the pages are taken on this thread, so is the callback called
+    while (running > 0) {
+        rv = apr_queue_pop(pages, &page);
+        if (rv == APR_EINTR) {
+            continue;
+        } else if (rv != APR_SUCCESS) {
+            break;
+        }
+        if (((cos_list_page_t *)page)->last_page) {
+            running--;
+        }
+        cos_finish_list_page(&lp, (cos_list_page_t *)page);
+    }
+    apr_thread_pool_destroy(thrp);
+
+    if (NULL != lp.s) {
+        return lp.s;
+    }
+    return NULL != lp.ok_s ? lp.ok_s : cos_status_create(parent_pool);
+}
+
 
 cos_status_t *cos_delete_objects(const cos_request_options_t *options,
                                  const cos_string_t *bucket, 
@@ -210,18 +689,14 @@ cos_status_t *cos_delete_objects(const cos_request_options_t *options,
     return cos_do_delete_objects(options, bucket, object_list, is_quiet, NULL, resp_headers, deleted_object_list);
 }
 
-cos_status_t *cos_do_delete_objects(const cos_request_options_t *options,
-                                 const cos_string_t *bucket, 
-                                 cos_list_t *object_list, 
-                                 int is_quiet,
-                                 cos_table_t *headers,
-                                 cos_table_t **resp_headers, 
-                                 cos_list_t *deleted_object_list)
+static void cos_init_delete_objects_request(const cos_request_options_t *options,
+                                            const cos_string_t *bucket, 
+                                            cos_list_t *object_list, 
+                                            int is_quiet,
+                                            cos_table_t *headers,
+                                            cos_http_request_t **req,
+                                            cos_http_response_t **resp)
 {
-    int res;
-    cos_status_t *s = NULL;
-    cos_http_request_t *req = NULL;
-    cos_http_response_t *resp = NULL;
     cos_table_t *pHeaders = NULL;
     cos_table_t *query_params = NULL;
     cos_list_t body;
@@ -240,8 +715,8 @@ cos_status_t *cos_do_delete_objects(const cos_request_options_t *options,
     pHeaders = cos_table_create_if_null(options, headers, 1);
     apr_table_set(pHeaders, COS_CONTENT_TYPE, COS_MULTIPART_CONTENT_TYPE);
 
-    cos_init_bucket_request(options, bucket, HTTP_POST, &req, 
-                            query_params, pHeaders, &resp);
+    cos_init_bucket_request(options, bucket, HTTP_POST, req, 
+                            query_params, pHeaders, resp);
 
     build_delete_objects_body(options->pool, object_list, is_quiet, &body);
 
@@ -254,7 +729,23 @@ cos_status_t *cos_do_delete_objects(const cos_request_options_t *options,
     b64_value[b64_len] = '\0';
     apr_table_addn(pHeaders, COS_CONTENT_MD5, b64_value);
 
-    cos_write_request_body_from_buffer(&body, req);
+    cos_write_request_body_from_buffer(&body, *req);
+}
+
+cos_status_t *cos_do_delete_objects(const cos_request_options_t *options,
+                                 const cos_string_t *bucket, 
+                                 cos_list_t *object_list, 
+                                 int is_quiet,
+                                 cos_table_t *headers,
+                                 cos_table_t **resp_headers, 
+                                 cos_list_t *deleted_object_list)
+{
+    int res;
+    cos_status_t *s = NULL;
+    cos_http_request_t *req = NULL;
+    cos_http_response_t *resp = NULL;
+
+    cos_init_delete_objects_request(options, bucket, object_list, is_quiet, headers, &req, &resp);
 
     s = cos_process_request(options, req, resp);
     cos_fill_read_response_header(resp, resp_headers);
@@ -276,6 +767,35 @@ cos_status_t *cos_do_delete_objects(const cos_request_options_t *options,
     return s;
 }
 
+cos_status_t *cos_delete_objects_quiet(const cos_request_options_t *options,
+                                       const cos_string_t *bucket, 
+                                       cos_list_t *object_list, 
+                                       cos_table_t **resp_headers, 
+                                       cos_list_t *error_list)
+{
+    int res;
+    cos_status_t *s = NULL;
+    cos_http_request_t *req = NULL;
+    cos_http_response_t *resp = NULL;
+
+    cos_init_delete_objects_request(options, bucket, object_list, COS_TRUE, NULL, &req, &resp);
+
+    s = cos_process_request(options, req, resp);
+    cos_fill_read_response_header(resp, resp_headers);
+
+    // the body of quiet mode lists the failed keys only, it may be empty
+    if (!cos_status_is_ok(s) || cos_list_empty(&resp->body)) {
+        return s;
+    }
+
+    res = cos_delete_objects_error_parse_from_body(options->pool, &resp->body, error_list);
+    if (res != COSE_OK) {
+        cos_xml_error_status_set(s, res);
+    }
+
+    return s;
+}
+
 
 cos_status_t *cos_delete_objects_by_prefix(cos_request_options_t *options,
                                            const cos_string_t *bucket, 
@@ -368,6 +888,287 @@ cos_status_t *cos_delete_objects_by_prefix(cos_request_options_t *options,
     return ret;
 }
 
+typedef struct {
+    cos_request_options_t options;   // options.pool is owned by the batch
+    const cos_string_t *bucket;
+    cos_list_t object_list;          // cos_object_key_t
+    int keys;
+    cos_list_t error_list;           // cos_object_delete_error_t
+    cos_status_t *s;
+    apr_queue_t *finished;
+} cos_delete_batch_t;
+
+typedef struct {
+    cos_request_options_t *options;
+    const cos_string_t *bucket;
+    cos_delete_by_prefix_params_t *params;
+    apr_thread_pool_t *thrp;
+    apr_queue_t *finished;
+    int thread_num;
+    int running;
+    cos_pool_t *retry_pool;
+    cos_list_t retry_list;           // cos_object_delete_error_t of the keys to retry
+    int64_t failed_keys;             // the keys in retry_list
+} cos_delete_pipeline_t;
+
+static cos_delete_batch_t *cos_create_delete_batch(cos_delete_pipeline_t *pl)
+{
+    cos_pool_t *pool;
+    cos_delete_batch_t *batch;
+
+    cos_pool_create(&pool, pl->options->pool);
+    batch = (cos_delete_batch_t *)cos_pcalloc(pool, sizeof(cos_delete_batch_t));
+    batch->options = *pl->options;
+    batch->options.pool = pool;
+    batch->options.ctl = cos_http_controller_create(pool, 0);
+    batch->options.ctl->options = pl->options->ctl->options;
+    batch->options.ctl->cancel = pl->options->ctl->cancel;
+    batch->bucket = pl->bucket;
+    batch->finished = pl->finished;
+    cos_list_init(&batch->object_list);
+    cos_list_init(&batch->error_list);
+    return batch;
+}
+
+static void cos_add_delete_batch_key(cos_delete_batch_t *batch, const cos_string_t *key)
+{
+    cos_object_key_t *object_key = cos_create_cos_object_key(batch->options.pool);
+
+    cos_str_set(&object_key->key, apr_pstrndup(batch->options.pool, key->data, key->len));
+    cos_list_add_tail(&object_key->node, &batch->object_list);
+    batch->keys++;
+}
+
+static void * APR_THREAD_FUNC cos_run_delete_batch(apr_thread_t *thd, void *data)
+{
+    cos_delete_batch_t *batch = (cos_delete_batch_t *)data;
+
+    batch->s = cos_delete_objects_quiet(&batch->options, batch->bucket, &batch->object_list, NULL, 
+                                        &batch->error_list);
+    apr_queue_push(batch->finished, batch);
+    return NULL;
+}
+
+static void cos_add_delete_retry_key(cos_delete_pipeline_t *pl, const cos_string_t *key, 
+                                     const char *code, const char *message)
+{
+    cos_object_delete_error_t *error;
+
+    error = (cos_object_delete_error_t *)cos_pcalloc(pl->retry_pool, sizeof(cos_object_delete_error_t));
+    cos_str_set(&error->key, apr_pstrndup(pl->retry_pool, key->data, key->len));
+    cos_str_set(&error->code, apr_pstrdup(pl->retry_pool, NULL == code ? "" : code));
+    cos_str_set(&error->message, apr_pstrdup(pl->retry_pool, NULL == message ? "" : message));
+    cos_list_add_tail(&error->node, &pl->retry_list);
+    pl->failed_keys++;
+}
+
+// runs on the calling thread, the failed keys are kept for the next round
+static void cos_finish_delete_batch(cos_delete_pipeline_t *pl, cos_delete_batch_t *batch)
+{
+    cos_object_key_t *object_key;
+    cos_object_delete_error_t *error;
+    int failed = 0;
+
+    if (!cos_status_is_ok(batch->s)) {
+        cos_list_for_each_entry(cos_object_key_t, object_key, &batch->object_list, node) {
+            cos_add_delete_retry_key(pl, &object_key->key, batch->s->error_code, batch->s->error_msg);
+        }
+        failed = batch->keys;
+    } else {
+        cos_list_for_each_entry(cos_object_delete_error_t, error, &batch->error_list, node) {
+            cos_add_delete_retry_key(pl, &error->key, error->code.data, error->message.data);
+            failed++;
+        }
+    }
+    pl->params->deleted_keys += batch->keys - failed;
+    cos_pool_destroy(batch->options.pool);
+
+    if (NULL != pl->params->progress_callback) {
+        pl->params->progress_callback(pl->params->listed_keys, pl->params->deleted_keys, pl->failed_keys,
+                                      pl->params->progress_data);
+    }
+}
+
+// wait until no more than max_running batches are in flight
+static void cos_wait_delete_batches(cos_delete_pipeline_t *pl, int max_running)
+{
+    void *batch;
+    int rv;
+
+    while (pl->running > max_running) {
+        rv = apr_queue_pop(pl->finished, &batch);
+        if (rv == APR_EINTR) {
+            continue;
+        } else if (rv != APR_SUCCESS) {
+            break;
+        }
+        cos_finish_delete_batch(pl, (cos_delete_batch_t *)batch);
+        pl->running--;
+    }
+}
+
+static void cos_submit_delete_batch(cos_delete_pipeline_t *pl, cos_delete_batch_t *batch)
+{
+    int rv;
+
+    if (batch->keys == 0) {
+        cos_pool_destroy(batch->options.pool);
+        return;
+    }
+    cos_wait_delete_batches(pl, pl->thread_num - 1);
+    rv = apr_thread_pool_push(pl->thrp, cos_run_delete_batch, batch, 0, NULL);
+    if (APR_SUCCESS != rv) {
+        batch->s = cos_status_create(batch->options.pool);
+        cos_status_set(batch->s, rv, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL);
+        cos_finish_delete_batch(pl, batch);
+        return;
+    }
+    pl->running++;
+}
+
+// delete the keys of the last round once more, the keys failed again are left in retry_list
+static void cos_retry_delete_keys(cos_delete_pipeline_t *pl)
+{
+    cos_pool_t *round_pool = pl->retry_pool;
+    cos_list_t round_list;
+    cos_object_delete_error_t *error;
+    cos_delete_batch_t *batch = NULL;
+
+    cos_list_movelist(&pl->retry_list, &round_list);
+    cos_pool_create(&pl->retry_pool, pl->options->pool);
+    pl->failed_keys = 0;
+
+    cos_list_for_each_entry(cos_object_delete_error_t, error, &round_list, node) {
+        if (NULL == batch) {
+            batch = cos_create_delete_batch(pl);
+        }
+        cos_add_delete_batch_key(batch, &error->key);
+        if (batch->keys == COS_DELETE_OBJECTS_MAX_NUM) {
+            cos_submit_delete_batch(pl, batch);
+            batch = NULL;
+        }
+    }
+    if (NULL != batch) {
+        cos_submit_delete_batch(pl, batch);
+    }
+    cos_wait_delete_batches(pl, 0);
+    cos_pool_destroy(round_pool);
+}
+
+cos_status_t *cos_delete_objects_by_prefix_mt(cos_request_options_t *options,
+                                              const cos_string_t *bucket, 
+                                              const cos_string_t *prefix,
+                                              cos_delete_by_prefix_params_t *del_params)
+{
+    cos_pool_t *parent_pool = options->pool;
+    cos_pool_t *subpool = NULL;
+    cos_status_t *s = NULL;
+    cos_status_t *ret = NULL;
+    cos_list_object_params_t *params = NULL;
+    cos_list_object_content_t *content = NULL;
+    cos_object_delete_error_t *error = NULL;
+    cos_object_delete_error_t *failed = NULL;
+    cos_delete_batch_t *batch = NULL;
+    cos_table_t *resp_headers = NULL;
+    cos_delete_pipeline_t pl;
+    int round;
+    int rv;
+
+    memset(&pl, 0, sizeof(pl));
+    pl.options = options;
+    pl.bucket = bucket;
+    pl.params = del_params;
+    pl.thread_num = del_params->thread_num > 0 ? del_params->thread_num : COS_DELETE_PREFIX_THREAD_NUM;
+    cos_list_init(&pl.retry_list);
+    del_params->listed_keys = 0;
+    del_params->deleted_keys = 0;
+    cos_list_init(&del_params->failed_list);
+
+    if (!del_params->dry_run) {
+        rv = apr_queue_create(&pl.finished, pl.thread_num, parent_pool);
+        if (APR_SUCCESS != rv) {
+            ret = cos_status_create(parent_pool);
+            cos_status_set(ret, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL);
+            return ret;
+        }
+        rv = apr_thread_pool_create(&pl.thrp, 0, pl.thread_num, parent_pool);
+        if (APR_SUCCESS != rv) {
+            ret = cos_status_create(parent_pool);
+            cos_status_set(ret, rv, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL);
+            return ret;
+        }
+        cos_pool_create(&pl.retry_pool, parent_pool);
+    }
+
+    params = cos_create_list_object_params(parent_pool);
+    params->max_ret = COS_DELETE_OBJECTS_MAX_NUM;
+    cos_str_set(&params->prefix, NULL == prefix->data ? "" : apr_pstrndup(parent_pool, prefix->data, prefix->len));
+
+    // the next page is listed while the batches of the former pages are being deleted
+    while (params->truncated && !cos_is_canceled(options->ctl)) {
+        cos_pool_create(&subpool, parent_pool);
+        options->pool = subpool;
+        cos_list_init(&params->object_list);
+        cos_list_init(&params->common_prefix_list);
+        s = cos_list_object(options, bucket, params, &resp_headers);
+        options->pool = parent_pool;
+        if (!cos_status_is_ok(s)) {
+            ret = cos_status_dup(parent_pool, s);
+            cos_pool_destroy(subpool);
+            break;
+        }
+
+        batch = del_params->dry_run ? NULL : cos_create_delete_batch(&pl);
+        cos_list_for_each_entry(cos_list_object_content_t, content, &params->object_list, node) {
+            del_params->listed_keys++;
+            if (NULL != batch) {
+                cos_add_delete_batch_key(batch, &content->key);
+            }
+        }
+        if (NULL != batch) {
+            cos_submit_delete_batch(&pl, batch);
+        } else if (NULL != del_params->progress_callback) {
+            del_params->progress_callback(del_params->listed_keys, 0, 0, del_params->progress_data);
+        }
+
+        if (params->truncated && NULL != params->next_marker.data) {
+            cos_str_set(&params->marker, apr_pstrndup(parent_pool, params->next_marker.data, params->next_marker.len));
+        }
+        ret = NULL == ret ? cos_status_dup(parent_pool, s) : ret;
+        cos_pool_destroy(subpool);
+    }
+    if (cos_is_canceled(options->ctl) && (NULL == ret || cos_status_is_ok(ret))) {
+        ret = cos_status_create(parent_pool);
+        cos_status_set(ret, COSE_CANCELED_ERROR, COS_CANCELED_ERROR_CODE, NULL);
+    }
+    if (del_params->dry_run) {
+        return ret;
+    }
+
+    cos_wait_delete_batches(&pl, 0);
+    for (round = 0; round < del_params->max_retries && !cos_list_empty(&pl.retry_list) &&
+         !cos_is_canceled(options->ctl); round++) {
+        cos_retry_delete_keys(&pl);
+    }
+    apr_thread_pool_destroy(pl.thrp);
+
+    cos_list_for_each_entry(cos_object_delete_error_t, error, &pl.retry_list, node) {
+        failed = (cos_object_delete_error_t *)cos_pcalloc(parent_pool, sizeof(cos_object_delete_error_t));
+        cos_str_set(&failed->key, apr_pstrdup(parent_pool, error->key.data));
+        cos_str_set(&failed->code, apr_pstrdup(parent_pool, error->code.data));
+        cos_str_set(&failed->message, apr_pstrdup(parent_pool, error->message.data));
+        cos_list_add_tail(&failed->node, &del_params->failed_list);
+    }
+    cos_pool_destroy(pl.retry_pool);
+
+    if (pl.failed_keys > 0 && cos_status_is_ok(ret)) {
+        cos_status_set(ret, COSE_SERVICE_ERROR, COS_DELETE_OBJECTS_ERROR_CODE,
+                       apr_psprintf(parent_pool, "failed keys: %" APR_INT64_T_FMT, pl.failed_keys));
+    }
+
+    return ret;
+}
+
 cos_status_t *cos_put_bucket_acl(const cos_request_options_t *options, 
                                  const cos_string_t *bucket, 
                                  cos_acl_e cos_acl,
@@ -1,6 +1,14 @@
 #include "cos_buf.h"
 #include "cos_log.h"
 #include <apr_file_io.h>
+#include <apr_portable.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 cos_buf_t *cos_create_buf(cos_pool_t *p, int size)
 {
@@ -162,6 +170,135 @@ int cos_open_file_for_range_write(cos_pool_t *p, const char *path, int64_t file_
     return COSE_OK;
 }
 
+int cos_file_preallocate(apr_file_t *file, int64_t size)
+{
+    int s;
+    char buf[256];
+#if defined(__linux__)
+    apr_os_file_t fd;
+
+    // reserve the blocks at once, parts written out of order do not fragment the file
+    if (size > 0 && apr_os_file_get(&fd, file) == APR_SUCCESS && posix_fallocate(fd, 0, (off_t)size) == 0) {
+        return COSE_OK;
+    }
+#endif
+    // not supported by the file system, extend the file only
+    if ((s = apr_file_trunc(file, (apr_off_t)size)) != APR_SUCCESS) {
+        cos_error_log("apr_file_trunc failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        return COSE_FILE_TRUNC_ERROR;
+    }
+
+    return COSE_OK;
+}
+
+int cos_file_sync(apr_file_t *file)
+{
+    apr_os_file_t fd;
+
+    if (apr_file_flush(file) != APR_SUCCESS || apr_os_file_get(&fd, file) != APR_SUCCESS) {
+        return COSE_FILE_FLUSH_ERROR;
+    }
+#ifdef WIN32
+    if (!FlushFileBuffers(fd)) {
+        cos_error_log("FlushFileBuffers failure, code:%d.", (int)GetLastError());
+        return COSE_FILE_FLUSH_ERROR;
+    }
+#else
+    if (fsync(fd) != 0) {
+        cos_error_log("fsync failure, code:%d.", errno);
+        return COSE_FILE_FLUSH_ERROR;
+    }
+#endif
+
+    return COSE_OK;
+}
+
+int cos_open_file_for_shared_write(cos_pool_t *p, const char *path, int64_t file_size, apr_file_t **file)
+{
+    int s;
+    int res;
+    char buf[256];
+
+    if ((s = apr_file_open(file, path, APR_CREATE | APR_WRITE | APR_TRUNCATE,
+                APR_UREAD | APR_UWRITE | APR_GREAD, p)) != APR_SUCCESS) {
+        cos_error_log("apr_file_open failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        *file = NULL;
+        return COSE_OPEN_FILE_ERROR;
+    }
+
+    res = cos_file_preallocate(*file, file_size);
+    if (res != COSE_OK) {
+        apr_file_close(*file);
+        *file = NULL;
+    }
+
+    return res;
+}
+
+int cos_open_file_for_shared_resume(cos_pool_t *p, const char *path, int64_t file_size, apr_file_t **file)
+{
+    int s;
+    char buf[256];
+    apr_finfo_t finfo;
+
+    if ((s = apr_file_open(file, path, APR_WRITE, APR_UREAD | APR_UWRITE | APR_GREAD, p)) != APR_SUCCESS) {
+        cos_error_log("apr_file_open failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        *file = NULL;
+        return COSE_OPEN_FILE_ERROR;
+    }
+
+    if ((s = apr_file_info_get(&finfo, APR_FINFO_SIZE, *file)) != APR_SUCCESS || finfo.size != file_size) {
+        cos_error_log("file %s can not be resumed, size:%" APR_INT64_T_FMT ", expected:%" APR_INT64_T_FMT ".",
+                      path, s == APR_SUCCESS ? (int64_t)finfo.size : (int64_t)-1, file_size);
+        apr_file_close(*file);
+        *file = NULL;
+        return COSE_FILE_INFO_ERROR;
+    }
+
+    return COSE_OK;
+}
+
+int cos_file_pwrite(apr_file_t *file, const char *buffer, int64_t len, int64_t offset)
+{
+    apr_os_file_t fd;
+#ifdef WIN32
+    OVERLAPPED ov;
+    DWORD written;
+#else
+    ssize_t written;
+#endif
+
+    if (apr_os_file_get(&fd, file) != APR_SUCCESS) {
+        return COSE_FILE_WRITE_ERROR;
+    }
+
+    // the position of the file is not used, so threads share the file safely
+    while (len > 0) {
+#ifdef WIN32
+        memset(&ov, 0, sizeof(ov));
+        ov.Offset = (DWORD)(offset & 0xFFFFFFFF);
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+        if (!WriteFile(fd, buffer, (DWORD)len, &written, &ov)) {
+            cos_error_log("WriteFile failure, code:%d.", (int)GetLastError());
+            return COSE_FILE_WRITE_ERROR;
+        }
+#else
+        written = pwrite(fd, buffer, (size_t)len, (off_t)offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            cos_error_log("pwrite failure, errno:%d.", errno);
+            return COSE_FILE_WRITE_ERROR;
+        }
+#endif
+        buffer += written;
+        len -= written;
+        offset += written;
+    }
+
+    return COSE_OK;
+}
 
 void cos_buf_append_string(cos_pool_t *p, cos_buf_t *b, const char *str, int len)
 {
@@ -56,6 +56,38 @@ int cos_open_file_for_write(cos_pool_t *p, const char *path, cos_file_buf_t *fb)
 
 int cos_open_file_for_range_write(cos_pool_t *p, const char *path, int64_t file_pos, int64_t file_last, cos_file_buf_t *fb);
 
+/**
+ * create or truncate the file and preallocate file_size, the file is
+ * written by cos_file_pwrite from many threads at the same time.
+ * @return COSE_OK success, other failure.
+ */
+int cos_open_file_for_shared_write(cos_pool_t *p, const char *path, int64_t file_size, apr_file_t **file);
+
+/**
+ * open an existing file written by cos_open_file_for_shared_write before,
+ * the content is kept and the size of it must be file_size.
+ * @return COSE_OK success, other failure.
+ */
+int cos_open_file_for_shared_resume(cos_pool_t *p, const char *path, int64_t file_size, apr_file_t **file);
+
+/**
+ * reserve size bytes for the file, fallocate if supported, otherwise extend it.
+ * @return COSE_OK success, other failure.
+ */
+int cos_file_preallocate(apr_file_t *file, int64_t size);
+
+/**
+ * flush the file and wait until its content reaches the disk.
+ * @return COSE_OK success, other failure.
+ */
+int cos_file_sync(apr_file_t *file);
+
+/**
+ * write len bytes at offset without moving the file position.
+ * @return COSE_OK success, other failure.
+ */
+int cos_file_pwrite(apr_file_t *file, const char *buffer, int64_t len, int64_t offset);
+
 
 COS_CPP_END
 
@@ -4,6 +4,7 @@
 #include "cos_string.h"
 #include "cos_list.h"
 #include "cos_transport.h"
+#include "cos_status.h"
 
 #ifdef __cplusplus
 #define COS_CPP_START extern "C" {
@@ -181,11 +182,49 @@ typedef struct {
     cos_string_t storage_class;
 } cos_list_object_content_t;
 
+typedef enum {
+    COS_DIR_TRANSFERRED,  // the file is uploaded or downloaded
+    COS_DIR_SKIPPED,      // the object is the same as the file, by sync only
+    COS_DIR_DELETED       // the object has no local file and is deleted, by sync only
+} cos_dir_transfer_action_e;
+
+typedef struct {
+    cos_list_t node;
+    cos_string_t local_path;
+    cos_string_t object;
+    int64_t size;
+    cos_dir_transfer_action_e action;
+    cos_status_t *s;     // the status of the file, code is 0 or 2xx success
+} cos_dir_transfer_result_t;
+
 typedef struct {
     cos_list_t node;
     cos_string_t prefix;
 } cos_list_object_common_prefix_t;
 
+/*
+ * @return COSE_OK to go on listing, other to stop
+ */
+typedef int (*cos_list_object_callback)(void *data, cos_list_object_content_t *content);
+
+typedef struct {
+    cos_string_t prefix;
+    cos_string_t delimiter;    // the partitions are the common prefixes of it under prefix, "/" by default
+    cos_list_t split_list;     // cos_object_key_t in ascending order, a partition ends with its split key,
+                               // used instead of the delimiter if not empty
+    int thread_num;            // the partitions listed at the same time
+    int ordered;               // COS_TRUE to get the objects in key order, the later partitions are buffered
+    int max_buffered_pages;    // ordered only, the pages of the later partitions buffered at most, the workers
+                               // wait until their partition is next or a page is delivered,
+                               // 0 for thread_num * COS_LIST_PARALLEL_BUFFER_PAGES
+    int max_ret;               // the keys of a listed page, 0 for COS_PER_RET_NUM
+    cos_list_object_callback callback; // called on the calling thread, NULL to collect the objects in object_list
+    void *callback_data;
+    int64_t object_count;      // out
+    int peak_buffered_pages;   // out, the most pages of the later partitions buffered at the same time
+    cos_list_t object_list;    // out, the cos_list_object_content_t allocated from options->pool
+} cos_list_object_parallel_params_t;
+
 typedef struct {
     cos_list_t node;
     cos_string_t key;
@@ -212,6 +251,18 @@ typedef struct {
     char *etag;
 } cos_upload_part_t;
 
+/*
+ * the parts of a multipart upload indexed by part number, built in one pass
+ * over the pages of ListParts
+ */
+typedef struct {
+    int max_part_num;       // the largest part number can be indexed
+    int count;              // the number of parts indexed
+    unsigned char *bitmap;  // bit n-1 is set if part n is indexed
+    char **etags;           // etag of part n at n-1
+    int64_t *sizes;         // size of part n at n-1
+} cos_part_index_t;
+
 typedef struct {
     cos_list_t node;
     cos_string_t bucket_name;
@@ -275,6 +326,8 @@ typedef struct {
     cos_string_t filename;  /**< file range read filename */
     int64_t file_pos;   /**< file range read start position */
     int64_t file_last;  /**< file range read last position */
+    uint64_t crc64;     /**< crc64 ecma of the range downloaded, valid if has_crc64 */
+    int has_crc64;      /**< COS_TRUE if crc64 is filled by the download of the range */
 } cos_upload_file_t;
 
 typedef struct {
@@ -336,6 +389,27 @@ typedef struct {
     cos_string_t key;
 } cos_object_key_t;
 
+typedef struct {
+    cos_list_t node;
+    cos_string_t key;
+    cos_string_t code;
+    cos_string_t message;
+} cos_object_delete_error_t;
+
+typedef void (*cos_delete_progress_callback)(int64_t listed_keys, int64_t deleted_keys, int64_t failed_keys,
+                                             void *data);
+
+typedef struct {
+    int thread_num;        // the delete requests in flight
+    int max_retries;       // the rounds the failed keys are retried
+    int dry_run;           // COS_TRUE to list and count the keys only, nothing is deleted
+    cos_delete_progress_callback progress_callback;
+    void *progress_data;
+    int64_t listed_keys;   // out
+    int64_t deleted_keys;  // out
+    cos_list_t failed_list; // out, the cos_object_delete_error_t of keys still failed after the retries
+} cos_delete_by_prefix_params_t;
+
 typedef struct {
     char *suffix;
     char *type;
@@ -346,6 +420,8 @@ typedef struct {
     int32_t  thread_num;  // default 1
     int      enable_checkpoint; // default disable, false
     cos_string_t checkpoint_path;  // dafault ./filepath.ucp or ./filepath.dcp
+    int      auto_tune;  // default disable, true: part_size is chosen if not set, and the parts in flight
+                         // are adjusted up to thread_num (default 16) by the observed throughput and errors
 } cos_resumable_clt_params_t;
 
 typedef struct {
@@ -0,0 +1,293 @@
+#include <inttypes.h>
+#include "cos_log.h"
+#include "cos_sys_util.h"
+#include "cos_string.h"
+#include "cos_crc64.h"
+#include "cos_digest_cache.h"
+
+static int cos_digest_cache_load(cos_digest_cache_t *cache)
+{
+    apr_status_t s;
+    apr_file_t *thefile;
+    apr_finfo_t finfo;
+    apr_size_t len;
+    char *content;
+    char *line;
+    char *next;
+    char buf[256];
+    cos_digest_cache_key_t key;
+    cos_digest_t digest;
+
+    s = apr_file_open(&thefile, cache->path, APR_READ, APR_UREAD | APR_GREAD, cache->pool);
+    if (s != APR_SUCCESS) {
+        return COSE_OPEN_FILE_ERROR;
+    }
+    s = apr_file_info_get(&finfo, APR_FINFO_NORM, thefile);
+    if (s != APR_SUCCESS) {
+        apr_file_close(thefile);
+        return COSE_FILE_INFO_ERROR;
+    }
+
+    content = (char *)cos_palloc(cache->pool, (apr_size_t)(finfo.size + 1));
+    s = apr_file_read_full(thefile, content, (apr_size_t)finfo.size, &len);
+    apr_file_close(thefile);
+    if (s != APR_SUCCESS) {
+        cos_error_log("apr_file_read_full failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        return COSE_FILE_READ_ERROR;
+    }
+    content[len] = '\0';
+
+    // one entry per line, broken lines are ignored
+    for (line = content; line != NULL && *line != '\0'; line = next) {
+        next = strchr(line, '\n');
+        if (next != NULL) {
+            *next++ = '\0';
+        }
+        memset(&key, 0, sizeof(key));
+        memset(&digest, 0, sizeof(digest));
+        if (sscanf(line, "%" SCNu64 " %" SCNu64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %24s %" SCNu64,
+                   &key.device, &key.inode, &key.size, &key.mtime, &key.range_pos, &key.range_last,
+                   digest.content_md5, &digest.crc64) != 8) {
+            continue;
+        }
+        cos_digest_cache_put(cache, &key, &digest);
+    }
+    cache->dirty = COS_FALSE;
+
+    return COSE_OK;
+}
+
+cos_digest_cache_t *cos_digest_cache_create(cos_pool_t *p, const char *path)
+{
+    cos_digest_cache_t *cache;
+    cos_pool_t *pool;
+
+    cos_pool_create(&pool, p);
+    cache = (cos_digest_cache_t *)cos_pcalloc(pool, sizeof(cos_digest_cache_t));
+    cache->pool = pool;
+    cache->entries = apr_hash_make(pool);
+    cache->order = apr_array_make(pool, 64, sizeof(cos_digest_cache_key_t *));
+    cache->oldest = 0;
+    apr_thread_mutex_create(&cache->mutex, APR_THREAD_MUTEX_DEFAULT, pool);
+    cache->path = path == NULL ? NULL : apr_pstrdup(pool, path);
+    cache->dirty = COS_FALSE;
+
+    if (cache->path != NULL) {
+        cos_digest_cache_load(cache);
+    }
+
+    return cache;
+}
+
+int cos_digest_cache_save(cos_digest_cache_t *cache)
+{
+    apr_status_t s;
+    apr_file_t *thefile;
+    cos_pool_t *subpool;
+    const cos_digest_cache_key_t *key;
+    const cos_digest_t *digest;
+    char *tmp_path;
+    char *line;
+    char buf[256];
+    int res = COSE_OK;
+    int i;
+
+    if (cache->path == NULL) {
+        return COSE_OK;
+    }
+
+    apr_thread_mutex_lock(cache->mutex);
+    if (!cache->dirty) {
+        apr_thread_mutex_unlock(cache->mutex);
+        return COSE_OK;
+    }
+
+    // write to a temporary file and rename, a crash never leaves a torn cache
+    cos_pool_create(&subpool, cache->pool);
+    tmp_path = apr_psprintf(subpool, "%s%s", cache->path, COS_TEMP_FILE_SUFFIX);
+    s = apr_file_open(&thefile, tmp_path, APR_CREATE | APR_WRITE | APR_TRUNCATE | APR_BUFFERED,
+                      APR_UREAD | APR_UWRITE | APR_GREAD, subpool);
+    if (s != APR_SUCCESS) {
+        cos_error_log("apr_file_open failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        res = COSE_OPEN_FILE_ERROR;
+        goto done;
+    }
+
+    // oldest first, the order of eviction is kept by the next load
+    for (i = 0; i < cache->order->nelts; i++) {
+        key = APR_ARRAY_IDX(cache->order, (cache->oldest + i) % cache->order->nelts, cos_digest_cache_key_t *);
+        digest = (const cos_digest_t *)apr_hash_get(cache->entries, key, sizeof(cos_digest_cache_key_t));
+        line = apr_psprintf(subpool, "%" APR_UINT64_T_FMT " %" APR_UINT64_T_FMT " %" APR_INT64_T_FMT
+                            " %" APR_INT64_T_FMT " %" APR_INT64_T_FMT " %" APR_INT64_T_FMT " %s %" APR_UINT64_T_FMT "\n",
+                            key->device, key->inode, key->size, key->mtime, key->range_pos, key->range_last,
+                            digest->content_md5, digest->crc64);
+        s = apr_file_write_full(thefile, line, strlen(line), NULL);
+        if (s != APR_SUCCESS) {
+            cos_error_log("apr_file_write failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+            apr_file_close(thefile);
+            apr_file_remove(tmp_path, subpool);
+            res = COSE_FILE_WRITE_ERROR;
+            goto done;
+        }
+    }
+    apr_file_close(thefile);
+
+    s = apr_file_rename(tmp_path, cache->path, subpool);
+    if (s != APR_SUCCESS) {
+        cos_error_log("apr_file_rename failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        apr_file_remove(tmp_path, subpool);
+        res = COSE_FILE_WRITE_ERROR;
+        goto done;
+    }
+    cache->dirty = COS_FALSE;
+
+done:
+    cos_pool_destroy(subpool);
+    apr_thread_mutex_unlock(cache->mutex);
+    return res;
+}
+
+void cos_digest_cache_destroy(cos_digest_cache_t *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    cos_digest_cache_save(cache);
+    apr_thread_mutex_destroy(cache->mutex);
+    cos_pool_destroy(cache->pool);
+}
+
+int cos_digest_cache_build_key(cos_pool_t *p, const char *filename, int64_t file_pos, int64_t file_last,
+                               cos_digest_cache_key_t *key)
+{
+    apr_finfo_t finfo;
+
+    if (APR_SUCCESS != apr_stat(&finfo, filename, APR_FINFO_IDENT | APR_FINFO_SIZE | APR_FINFO_MTIME, p)) {
+        return COSE_FILE_INFO_ERROR;
+    }
+
+    // zero the padding, the key is hashed as raw bytes
+    memset(key, 0, sizeof(cos_digest_cache_key_t));
+    key->device = (uint64_t)finfo.device;
+    key->inode = (uint64_t)finfo.inode;
+    key->size = finfo.size;
+    key->mtime = finfo.mtime;
+    key->range_pos = file_pos;
+    key->range_last = cos_min(file_last, finfo.size);
+    if (key->range_pos < 0 || key->range_pos > key->range_last) {
+        return COSE_INVALID_ARGUMENT;
+    }
+
+    return COSE_OK;
+}
+
+int cos_digest_cache_get(cos_digest_cache_t *cache, const cos_digest_cache_key_t *key, cos_digest_t *digest)
+{
+    cos_digest_t *found;
+
+    apr_thread_mutex_lock(cache->mutex);
+    found = (cos_digest_t *)apr_hash_get(cache->entries, key, sizeof(cos_digest_cache_key_t));
+    if (found != NULL) {
+        memcpy(digest, found, sizeof(cos_digest_t));
+    }
+    apr_thread_mutex_unlock(cache->mutex);
+
+    return found != NULL ? COS_TRUE : COS_FALSE;
+}
+
+void cos_digest_cache_put(cos_digest_cache_t *cache, const cos_digest_cache_key_t *key, const cos_digest_t *digest)
+{
+    cos_digest_cache_key_t *k;
+    cos_digest_t *v;
+
+    apr_thread_mutex_lock(cache->mutex);
+    v = (cos_digest_t *)apr_hash_get(cache->entries, key, sizeof(cos_digest_cache_key_t));
+    if (v == NULL) {
+        if (cache->order->nelts < COS_DIGEST_CACHE_MAX_ENTRIES) {
+            k = (cos_digest_cache_key_t *)apr_pmemdup(cache->pool, key, sizeof(cos_digest_cache_key_t));
+            v = (cos_digest_t *)cos_palloc(cache->pool, sizeof(cos_digest_t));
+            APR_ARRAY_PUSH(cache->order, cos_digest_cache_key_t *) = k;
+        } else {
+            // evict the oldest entry and reuse its memory, the pool never grows once full
+            k = APR_ARRAY_IDX(cache->order, cache->oldest, cos_digest_cache_key_t *);
+            v = (cos_digest_t *)apr_hash_get(cache->entries, k, sizeof(cos_digest_cache_key_t));
+            apr_hash_set(cache->entries, k, sizeof(cos_digest_cache_key_t), NULL);
+            memcpy(k, key, sizeof(cos_digest_cache_key_t));
+            cache->oldest = (cache->oldest + 1) % COS_DIGEST_CACHE_MAX_ENTRIES;
+        }
+        apr_hash_set(cache->entries, k, sizeof(cos_digest_cache_key_t), v);
+    }
+    memcpy(v, digest, sizeof(cos_digest_t));
+    cache->dirty = COS_TRUE;
+    apr_thread_mutex_unlock(cache->mutex);
+}
+
+static int cos_calc_file_range_digest(cos_pool_t *p, const char *filename,
+                                      int64_t file_pos, int64_t file_last, cos_digest_t *digest)
+{
+    unsigned char md5_data[APR_MD5_DIGESTSIZE];
+    apr_md5_ctx_t context;
+    apr_file_t *thefile;
+    apr_off_t offset;
+    apr_size_t nbytes;
+    int64_t bytes_left;
+    char buff[64 * 1024];
+    int b64_len;
+
+    if (apr_file_open(&thefile, filename, APR_READ, APR_UREAD | APR_GREAD, p) != APR_SUCCESS) {
+        return COSE_OPEN_FILE_ERROR;
+    }
+    offset = file_pos;
+    if (apr_file_seek(thefile, APR_SET, &offset) != APR_SUCCESS) {
+        apr_file_close(thefile);
+        return COSE_FILE_SEEK_ERROR;
+    }
+
+    apr_md5_init(&context);
+    digest->crc64 = 0;
+    bytes_left = file_last - file_pos;
+    while (bytes_left > 0) {
+        nbytes = (apr_size_t)cos_min((int64_t)sizeof(buff), bytes_left);
+        if (apr_file_read(thefile, buff, &nbytes) != APR_SUCCESS) {
+            apr_file_close(thefile);
+            return COSE_FILE_READ_ERROR;
+        }
+        apr_md5_update(&context, buff, nbytes);
+        digest->crc64 = cos_crc64(digest->crc64, buff, nbytes);
+        bytes_left -= nbytes;
+    }
+    apr_file_close(thefile);
+
+    apr_md5_final(md5_data, &context);
+    b64_len = cos_base64_encode(md5_data, APR_MD5_DIGESTSIZE, digest->content_md5);
+    digest->content_md5[b64_len] = '\0';
+
+    return COSE_OK;
+}
+
+int cos_get_file_range_digest(cos_pool_t *p, cos_digest_cache_t *cache, const char *filename,
+                              int64_t file_pos, int64_t file_last, cos_digest_t *digest)
+{
+    cos_digest_cache_key_t key;
+    int res;
+
+    res = cos_digest_cache_build_key(p, filename, file_pos, file_last, &key);
+    if (res != COSE_OK) {
+        return res;
+    }
+
+    if (cache != NULL && cos_digest_cache_get(cache, &key, digest)) {
+        return COSE_OK;
+    }
+
+    res = cos_calc_file_range_digest(p, filename, key.range_pos, key.range_last, digest);
+    if (res != COSE_OK) {
+        return res;
+    }
+
+    if (cache != NULL) {
+        cos_digest_cache_put(cache, &key, digest);
+    }
+
+    return COSE_OK;
+}
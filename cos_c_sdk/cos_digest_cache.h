@@ -0,0 +1,90 @@
+#ifndef LIBCOS_DIGEST_CACHE_H
+#define LIBCOS_DIGEST_CACHE_H
+
+#include "cos_sys_define.h"
+#include "cos_string.h"
+#include "cos_define.h"
+#include "apr_hash.h"
+#include "apr_tables.h"
+#include "apr_md5.h"
+#include "apr_thread_mutex.h"
+
+COS_CPP_START
+
+#define COS_CONTENT_MD5_B64_LEN 24
+
+/*
+ * the identity of a local file range, a cached digest is reused only if
+ * device, inode, size and last modified time of the file are all unchanged
+ */
+typedef struct {
+    uint64_t device;
+    uint64_t inode;
+    int64_t size;
+    int64_t mtime;       // last modified time, microsecond
+    int64_t range_pos;   // the start of range, include
+    int64_t range_last;  // the end of range, exclude
+} cos_digest_cache_key_t;
+
+typedef struct {
+    char content_md5[COS_CONTENT_MD5_B64_LEN + 1]; // base64 encoded md5, as the value of Content-MD5
+    uint64_t crc64;                                // crc64 ecma of the range
+} cos_digest_t;
+
+/*
+ * at most COS_DIGEST_CACHE_MAX_ENTRIES ranges are kept, the oldest put is evicted first,
+ * so the entries of the files changed or removed since are dropped in time
+ */
+typedef struct cos_digest_cache_s {
+    cos_pool_t *pool;
+    apr_hash_t *entries;          // cos_digest_cache_key_t -> cos_digest_t
+    apr_array_header_t *order;    // the keys of entries in the order put, a ring once it is full
+    int oldest;                   // the index of the oldest key in order once it is full
+    apr_thread_mutex_t *mutex;
+    char *path;                   // the file the cache is persisted to, NULL for memory only
+    int dirty;
+} cos_digest_cache_t;
+
+/*
+ * create a digest cache, entries are loaded from path if it is not NULL
+ * and the file exists, the cache is memory only if path is NULL
+ */
+cos_digest_cache_t *cos_digest_cache_create(cos_pool_t *p, const char *path);
+
+/*
+ * persist the cache to its path if it is changed
+ * @return COSE_OK success, other failure
+ */
+int cos_digest_cache_save(cos_digest_cache_t *cache);
+
+/*
+ * save the cache and release the memory of it
+ */
+void cos_digest_cache_destroy(cos_digest_cache_t *cache);
+
+/*
+ * build the cache key of range [file_pos, file_last) of the file
+ * @return COSE_OK success, other failure
+ */
+int cos_digest_cache_build_key(cos_pool_t *p, const char *filename, int64_t file_pos, int64_t file_last,
+                               cos_digest_cache_key_t *key);
+
+/*
+ * @return COS_TRUE found, COS_FALSE not found
+ */
+int cos_digest_cache_get(cos_digest_cache_t *cache, const cos_digest_cache_key_t *key, cos_digest_t *digest);
+
+void cos_digest_cache_put(cos_digest_cache_t *cache, const cos_digest_cache_key_t *key, const cos_digest_t *digest);
+
+/*
+ * get the md5 and crc64 of range [file_pos, file_last) of the file, the
+ * cache is consulted first and the file is read only if it misses
+ * @param[in] cache   NULL to always read the file
+ * @return COSE_OK success, other failure
+ */
+int cos_get_file_range_digest(cos_pool_t *p, cos_digest_cache_t *cache, const char *filename,
+                              int64_t file_pos, int64_t file_last, cos_digest_t *digest);
+
+COS_CPP_END
+
+#endif
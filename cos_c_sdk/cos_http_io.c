@@ -82,6 +82,8 @@ cos_http_request_options_t *cos_http_request_options_create(cos_pool_t *p)
     options->connect_timeout = COS_CONNECT_TIMEOUT;
     options->dns_cache_timeout = COS_DNS_CACHE_TIMOUT;
     options->max_memory_size = COS_MAX_MEMORY_SIZE;
+    options->read_ahead_size = 0;
+    options->download_temp_file = COS_FALSE;
     options->enable_crc = COS_TRUE;
     options->enable_md5 = COS_TRUE;
     options->proxy_auth = NULL;
@@ -276,6 +278,49 @@ int cos_write_http_body_file_part(cos_http_response_t *resp, const char *buffer,
     return nbytes;
 }
 
+int cos_write_http_body_shared_file(cos_http_response_t *resp, const char *buffer, int len)
+{
+    int res;
+    
+    if (resp->file_buf == NULL || resp->file_buf->file == NULL) {
+        cos_error_log("file_buf is NULL.");
+        return COSE_INVALID_ARGUMENT;
+    }
+    // never write beyond the range of the part, other parts share the file
+    if (resp->file_buf->file_pos + len > resp->file_buf->file_last) {
+        cos_error_log("body is longer than part range.");
+        return COSE_FILE_WRITE_ERROR;
+    }
+
+    res = cos_file_pwrite(resp->file_buf->file, buffer, len, resp->file_buf->file_pos);
+    if (res != COSE_OK) {
+        return res;
+    }
+    
+    resp->file_buf->file_pos += len;
+    resp->body_len += len;
+
+    return len;
+}
+
+int cos_write_http_body_range_buffer(cos_http_response_t *resp, const char *buffer, int len)
+{
+    if (resp->range_buf == NULL) {
+        cos_error_log("range_buf is NULL.");
+        return COSE_INVALID_ARGUMENT;
+    }
+    // never write beyond the range of the part, other parts share the memory
+    if (resp->range_buf->last + len > resp->range_buf->end) {
+        cos_error_log("body is longer than part range.");
+        return COSE_OVER_MEMORY;
+    }
+
+    memcpy(resp->range_buf->last, buffer, len);
+    resp->range_buf->last += len;
+    resp->body_len += len;
+
+    return len;
+}
 
 int cos_http_io_initialize(const char *user_agent_info, int flags)
 {
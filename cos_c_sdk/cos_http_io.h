@@ -38,6 +38,8 @@ int cos_write_http_body_memory(cos_http_response_t *resp, const char *buffer, in
 int cos_read_http_body_file(cos_http_request_t *req, char *buffer, int len);
 int cos_write_http_body_file(cos_http_response_t *resp, const char *buffer, int len);
 int cos_write_http_body_file_part(cos_http_response_t *resp, const char *buffer, int len);
+int cos_write_http_body_shared_file(cos_http_response_t *resp, const char *buffer, int len);
+int cos_write_http_body_range_buffer(cos_http_response_t *resp, const char *buffer, int len);
 
 
 typedef cos_http_transport_t *(*cos_http_transport_create_pt)(cos_pool_t *p);
@@ -0,0 +1,423 @@
+#include "cos_log.h"
+#include "cos_sys_util.h"
+#include "cos_status.h"
+#include "cos_utility.h"
+#include "cos_api.h"
+#include "cos_list_compact.h"
+
+static apr_status_t cos_list_object_compact_cleanup(void *data)
+{
+    cos_list_object_compact_t *compact = (cos_list_object_compact_t *)data;
+
+    free(compact->keys);
+    free(compact->key_offsets);
+    free(compact->sizes);
+    free(compact->mtimes);
+    free(compact->md5s);
+    free(compact->etag_parts);
+    free(compact->owner_ids);
+    free(compact->owner_names);
+    free(compact->storage_classes);
+    return APR_SUCCESS;
+}
+
+static int cos_list_object_compact_intern(cos_list_object_compact_t *compact, const cos_string_t *str)
+{
+    int *id;
+    char *s;
+
+    if (NULL == str->data || str->len == 0) {
+        return 0;
+    }
+    id = (int *)apr_hash_get(compact->string_index, str->data, str->len);
+    if (NULL != id) {
+        return *id;
+    }
+    s = apr_pstrndup(compact->pool, str->data, str->len);
+    id = (int *)cos_palloc(compact->pool, sizeof(int));
+    *id = compact->strings->nelts;
+    APR_ARRAY_PUSH(compact->strings, const char *) = s;
+    apr_hash_set(compact->string_index, s, str->len, id);
+
+    return *id;
+}
+
+cos_list_object_compact_t *cos_list_object_compact_create(cos_pool_t *p)
+{
+    cos_list_object_compact_t *compact;
+
+    compact = (cos_list_object_compact_t *)cos_pcalloc(p, sizeof(cos_list_object_compact_t));
+    compact->pool = p;
+    compact->string_index = apr_hash_make(p);
+    compact->strings = apr_array_make(p, 8, sizeof(const char *));
+    APR_ARRAY_PUSH(compact->strings, const char *) = "";
+    apr_pool_cleanup_register(p, compact, cos_list_object_compact_cleanup, apr_pool_cleanup_null);
+
+    return compact;
+}
+
+#define COS_LIST_COMPACT_GROW(column, capacity) do {                          \
+        void *grown = realloc(column, (capacity) * sizeof(*(column)));         \
+        if (NULL == grown) {                                                   \
+            return COSE_OUT_MEMORY;                                            \
+        }                                                                      \
+        column = grown;                                                        \
+    } while (0)
+
+// the columns are grown one by one, the capacity is changed after all of them
+static int cos_list_object_compact_grow(cos_list_object_compact_t *compact)
+{
+    int64_t capacity = compact->capacity > 0 ? compact->capacity * 2 : COS_LIST_COMPACT_INIT_NUM;
+
+    COS_LIST_COMPACT_GROW(compact->key_offsets, capacity);
+    COS_LIST_COMPACT_GROW(compact->sizes, capacity);
+    COS_LIST_COMPACT_GROW(compact->mtimes, capacity);
+    COS_LIST_COMPACT_GROW(compact->md5s, capacity * COS_LIST_COMPACT_MD5_LEN);
+    COS_LIST_COMPACT_GROW(compact->etag_parts, capacity);
+    COS_LIST_COMPACT_GROW(compact->owner_ids, capacity);
+    COS_LIST_COMPACT_GROW(compact->owner_names, capacity);
+    COS_LIST_COMPACT_GROW(compact->storage_classes, capacity);
+    compact->capacity = capacity;
+
+    return COSE_OK;
+}
+
+static int cos_list_object_compact_reserve_keys(cos_list_object_compact_t *compact, int64_t len)
+{
+    int64_t capacity = compact->keys_capacity > 0 ? compact->keys_capacity : COS_LIST_COMPACT_INIT_NUM * 64;
+    char *keys;
+
+    if (compact->keys_len + len <= compact->keys_capacity) {
+        return COSE_OK;
+    }
+    while (compact->keys_len + len > capacity) {
+        capacity *= 2;
+    }
+    keys = (char *)realloc(compact->keys, capacity);
+    if (NULL == keys) {
+        return COSE_OUT_MEMORY;
+    }
+    compact->keys = keys;
+    compact->keys_capacity = capacity;
+
+    return COSE_OK;
+}
+
+static int cos_hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// the etag is "<32 lower hex>" or "<32 lower hex>-<parts>", anything else is kept raw
+static int cos_parse_list_etag(const cos_string_t *etag, unsigned char md5[COS_LIST_COMPACT_MD5_LEN])
+{
+    const char *s = etag->data;
+    int len = etag->len;
+    int parts = 0;
+    int i;
+
+    if (NULL == s || len == 0) {
+        return COS_LIST_COMPACT_NO_ETAG;
+    }
+    if (len >= 2 && s[0] == '"' && s[len - 1] == '"') {
+        s++;
+        len -= 2;
+    }
+    if (len < COS_LIST_COMPACT_MD5_LEN * 2) {
+        return COS_LIST_COMPACT_ETAG_RAW;
+    }
+    for (i = 0; i < COS_LIST_COMPACT_MD5_LEN; i++) {
+        if (cos_hex_value(s[2 * i]) < 0 || cos_hex_value(s[2 * i + 1]) < 0) {
+            return COS_LIST_COMPACT_ETAG_RAW;
+        }
+        md5[i] = (unsigned char)(cos_hex_value(s[2 * i]) << 4 | cos_hex_value(s[2 * i + 1]));
+    }
+    if (len == COS_LIST_COMPACT_MD5_LEN * 2) {
+        return 0;
+    }
+    // the parts of multipart upload, without leading zeros so the etag is formatted back as is
+    if (s[COS_LIST_COMPACT_MD5_LEN * 2] != '-' || len == COS_LIST_COMPACT_MD5_LEN * 2 + 1 ||
+        s[COS_LIST_COMPACT_MD5_LEN * 2 + 1] == '0' || len > COS_LIST_COMPACT_MD5_LEN * 2 + 6) {
+        return COS_LIST_COMPACT_ETAG_RAW;
+    }
+    for (i = COS_LIST_COMPACT_MD5_LEN * 2 + 1; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return COS_LIST_COMPACT_ETAG_RAW;
+        }
+        parts = parts * 10 + (s[i] - '0');
+    }
+    return parts;
+}
+
+static int64_t cos_parse_list_size(const cos_string_t *size)
+{
+    char buf[32];
+    char *end;
+    int64_t value;
+
+    if (NULL == size->data || size->len == 0 || size->len >= (int)sizeof(buf)) {
+        return -1;
+    }
+    memcpy(buf, size->data, size->len);
+    buf[size->len] = '\0';
+    value = cos_strtoll(buf, &end, 10);
+    return *end == '\0' && value >= 0 ? value : -1;
+}
+
+// the last modified is 2023-01-02T03:04:05.000Z
+static int64_t cos_parse_list_mtime(const cos_string_t *last_modified)
+{
+    char buf[64];
+    apr_time_exp_t tm;
+    apr_time_t t;
+    int year, mon, mday, hour, min, sec;
+
+    if (NULL == last_modified->data || last_modified->len == 0 || last_modified->len >= (int)sizeof(buf)) {
+        return -1;
+    }
+    memcpy(buf, last_modified->data, last_modified->len);
+    buf[last_modified->len] = '\0';
+    if (sscanf(buf, "%4d-%2d-%2dT%2d:%2d:%2d", &year, &mon, &mday, &hour, &min, &sec) != 6) {
+        return -1;
+    }
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = year - 1900;
+    tm.tm_mon = mon - 1;
+    tm.tm_mday = mday;
+    tm.tm_hour = hour;
+    tm.tm_min = min;
+    tm.tm_sec = sec;
+    if (apr_time_exp_gmt_get(&t, &tm) != APR_SUCCESS) {
+        return -1;
+    }
+    return apr_time_sec(t);
+}
+
+int cos_list_object_compact_add(cos_list_object_compact_t *compact, const cos_list_object_content_t *content)
+{
+    int64_t i = compact->count;
+    int parts;
+    int64_t len;
+
+    if (compact->error != COSE_OK) {
+        return compact->error;
+    }
+    if (i == compact->capacity && cos_list_object_compact_grow(compact) != COSE_OK) {
+        cos_error_log("grow compact list failure, objects:%" APR_INT64_T_FMT ".", i);
+        compact->error = COSE_OUT_MEMORY;
+        return compact->error;
+    }
+
+    parts = cos_parse_list_etag(&content->etag, compact->md5s + i * COS_LIST_COMPACT_MD5_LEN);
+    len = content->key.len + 1;
+    if (parts == COS_LIST_COMPACT_ETAG_RAW) {
+        len += content->etag.len + 1;
+    }
+    if (cos_list_object_compact_reserve_keys(compact, len) != COSE_OK) {
+        cos_error_log("grow compact list keys failure, size:%" APR_INT64_T_FMT ".", compact->keys_len);
+        compact->error = COSE_OUT_MEMORY;
+        return compact->error;
+    }
+
+    compact->key_offsets[i] = compact->keys_len;
+    memcpy(compact->keys + compact->keys_len, content->key.data, content->key.len);
+    compact->keys_len += content->key.len;
+    compact->keys[compact->keys_len++] = '\0';
+    if (parts == COS_LIST_COMPACT_ETAG_RAW) {
+        memcpy(compact->keys + compact->keys_len, content->etag.data, content->etag.len);
+        compact->keys_len += content->etag.len;
+        compact->keys[compact->keys_len++] = '\0';
+    }
+    compact->etag_parts[i] = parts;
+    compact->sizes[i] = cos_parse_list_size(&content->size);
+    compact->mtimes[i] = cos_parse_list_mtime(&content->last_modified);
+    compact->owner_ids[i] = cos_list_object_compact_intern(compact, &content->owner_id);
+    compact->owner_names[i] = cos_list_object_compact_intern(compact, &content->owner_display_name);
+    compact->storage_classes[i] = cos_list_object_compact_intern(compact, &content->storage_class);
+    compact->count++;
+
+    return COSE_OK;
+}
+
+int cos_list_object_compact_callback(void *data, cos_list_object_content_t *content)
+{
+    return cos_list_object_compact_add((cos_list_object_compact_t *)data, content);
+}
+
+cos_status_t *cos_list_object_compact(const cos_request_options_t *options,
+                                      const cos_string_t *bucket,
+                                      cos_list_object_params_t *params,
+                                      cos_list_object_compact_t *compact)
+{
+    cos_pool_t *subpool = NULL;
+    cos_pool_t *nextmark_pool = NULL;
+    cos_pool_t *marker_pool = NULL;
+    cos_request_options_t page_options;
+    cos_list_object_params_t *page_params;
+    cos_list_object_common_prefix_t *common_prefix;
+    cos_list_object_common_prefix_t *dup_prefix;
+    cos_table_t *resp_headers = NULL;
+    cos_status_t *s = NULL;
+    cos_status_t *ret = NULL;
+    const char *marker = params->marker.data;
+    int truncated;
+
+    page_options = *options;
+    do {
+        cos_pool_create(&subpool, options->pool);
+        page_options.pool = subpool;
+        page_params = cos_create_list_object_params(subpool);
+        page_params->encoding_type = params->encoding_type;
+        page_params->prefix = params->prefix;
+        page_params->delimiter = params->delimiter;
+        if (params->max_ret > 0) {
+            page_params->max_ret = params->max_ret;
+        }
+        if (NULL != marker) {
+            cos_str_set(&page_params->marker, marker);
+        }
+
+        s = cos_list_object_with_callback(&page_options, bucket, page_params,
+                                          cos_list_object_compact_callback, compact, &resp_headers);
+        if (!cos_status_is_ok(s)) {
+            ret = cos_status_dup(options->pool, s);
+            cos_pool_destroy(subpool);
+            break;
+        }
+        if (compact->error != COSE_OK) {
+            ret = cos_status_create(options->pool);
+            cos_status_set(ret, compact->error, COS_CLIENT_ERROR_CODE, NULL);
+            cos_pool_destroy(subpool);
+            break;
+        }
+
+        cos_list_for_each_entry(cos_list_object_common_prefix_t, common_prefix, &page_params->common_prefix_list, node) {
+            dup_prefix = cos_create_list_object_common_prefix(options->pool);
+            cos_str_set(&dup_prefix->prefix, apr_pstrndup(options->pool, common_prefix->prefix.data,
+                                                          common_prefix->prefix.len));
+            cos_list_add_tail(&dup_prefix->node, &params->common_prefix_list);
+        }
+        params->truncated = page_params->truncated;
+        truncated = page_params->truncated && NULL != page_params->next_marker.data;
+        if (NULL != page_params->next_marker.data) {
+            cos_str_set(&params->next_marker, apr_pstrndup(options->pool, page_params->next_marker.data,
+                                                           page_params->next_marker.len));
+        }
+        if (truncated) {
+            cos_pool_create(&nextmark_pool, options->pool);
+            marker = apr_pstrndup(nextmark_pool, page_params->next_marker.data, page_params->next_marker.len);
+            if (NULL != marker_pool) {
+                cos_pool_destroy(marker_pool);
+            }
+            marker_pool = nextmark_pool;
+        } else {
+            ret = cos_status_dup(options->pool, s);
+        }
+        cos_pool_destroy(subpool);
+    } while (truncated);
+
+    if (NULL != marker_pool) {
+        cos_pool_destroy(marker_pool);
+    }
+    return ret;
+}
+
+void cos_list_object_compact_key(const cos_list_object_compact_t *compact, int64_t i, cos_string_t *key)
+{
+    cos_str_set(key, compact->keys + compact->key_offsets[i]);
+}
+
+int64_t cos_list_object_compact_size(const cos_list_object_compact_t *compact, int64_t i)
+{
+    return compact->sizes[i];
+}
+
+int64_t cos_list_object_compact_mtime(const cos_list_object_compact_t *compact, int64_t i)
+{
+    return compact->mtimes[i];
+}
+
+const unsigned char *cos_list_object_compact_md5(const cos_list_object_compact_t *compact, int64_t i)
+{
+    return compact->etag_parts[i] >= 0 ? compact->md5s + i * COS_LIST_COMPACT_MD5_LEN : NULL;
+}
+
+char *cos_list_object_compact_etag(const cos_list_object_compact_t *compact, int64_t i, cos_pool_t *p)
+{
+    static const char hex[] = "0123456789abcdef";
+    char md5[COS_LIST_COMPACT_MD5_LEN * 2 + 1];
+    const unsigned char *digest;
+    const char *key;
+    int j;
+
+    if (compact->etag_parts[i] == COS_LIST_COMPACT_NO_ETAG) {
+        return apr_pstrdup(p, "");
+    }
+    if (compact->etag_parts[i] == COS_LIST_COMPACT_ETAG_RAW) {
+        key = compact->keys + compact->key_offsets[i];
+        return apr_pstrdup(p, key + strlen(key) + 1);
+    }
+    digest = compact->md5s + i * COS_LIST_COMPACT_MD5_LEN;
+    for (j = 0; j < COS_LIST_COMPACT_MD5_LEN; j++) {
+        md5[2 * j] = hex[digest[j] >> 4];
+        md5[2 * j + 1] = hex[digest[j] & 0xF];
+    }
+    md5[COS_LIST_COMPACT_MD5_LEN * 2] = '\0';
+    if (compact->etag_parts[i] == 0) {
+        return apr_psprintf(p, "\"%s\"", md5);
+    }
+    return apr_psprintf(p, "\"%s-%d\"", md5, compact->etag_parts[i]);
+}
+
+const char *cos_list_object_compact_owner_id(const cos_list_object_compact_t *compact, int64_t i)
+{
+    return APR_ARRAY_IDX(compact->strings, compact->owner_ids[i], const char *);
+}
+
+const char *cos_list_object_compact_owner_name(const cos_list_object_compact_t *compact, int64_t i)
+{
+    return APR_ARRAY_IDX(compact->strings, compact->owner_names[i], const char *);
+}
+
+const char *cos_list_object_compact_storage_class(const cos_list_object_compact_t *compact, int64_t i)
+{
+    return APR_ARRAY_IDX(compact->strings, compact->storage_classes[i], const char *);
+}
+
+static void cos_list_compact_str_set(cos_string_t *str, const char *s)
+{
+    // unknown fields are left unset as the xml parsers do
+    if (*s != '\0') {
+        cos_str_set(str, s);
+    }
+}
+
+void cos_list_object_compact_to_list(const cos_list_object_compact_t *compact, cos_pool_t *p,
+                                     cos_list_t *object_list)
+{
+    cos_list_object_content_t *content;
+    apr_time_exp_t tm;
+    int64_t i;
+
+    for (i = 0; i < compact->count; i++) {
+        content = (cos_list_object_content_t *)cos_pcalloc(p, sizeof(cos_list_object_content_t));
+        cos_str_set(&content->key, apr_pstrdup(p, compact->keys + compact->key_offsets[i]));
+        cos_list_compact_str_set(&content->etag, cos_list_object_compact_etag(compact, i, p));
+        if (compact->sizes[i] >= 0) {
+            cos_str_set(&content->size, apr_psprintf(p, "%" APR_INT64_T_FMT, compact->sizes[i]));
+        }
+        if (compact->mtimes[i] >= 0 && apr_time_exp_gmt(&tm, apr_time_from_sec(compact->mtimes[i])) == APR_SUCCESS) {
+            cos_str_set(&content->last_modified, apr_psprintf(p, "%04d-%02d-%02dT%02d:%02d:%02d.000Z",
+                        tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec));
+        }
+        cos_list_compact_str_set(&content->owner_id, cos_list_object_compact_owner_id(compact, i));
+        cos_list_compact_str_set(&content->owner_display_name, cos_list_object_compact_owner_name(compact, i));
+        cos_list_compact_str_set(&content->storage_class, cos_list_object_compact_storage_class(compact, i));
+        cos_list_add_tail(&content->node, object_list);
+    }
+}
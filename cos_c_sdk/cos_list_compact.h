@@ -0,0 +1,101 @@
+#ifndef LIBCOS_LIST_COMPACT_H
+#define LIBCOS_LIST_COMPACT_H
+
+#include "cos_sys_define.h"
+#include "cos_define.h"
+#include "apr_hash.h"
+#include "apr_tables.h"
+
+COS_CPP_START
+
+#define COS_LIST_COMPACT_MD5_LEN 16
+
+/*
+ * the objects of list object kept column by column for listings of millions of keys,
+ * the keys are in one contiguous arena, size and last modified are numbers, the etag
+ * is binary and the owner and storage class are interned, the columns are freed with the pool
+ */
+typedef struct {
+    cos_pool_t *pool;
+    int64_t count;
+    int64_t capacity;          // the objects the columns can hold
+    char *keys;                // the keys ended with '\0', a key is followed by its etag if it is not an md5
+    int64_t keys_len;
+    int64_t keys_capacity;
+    int64_t *key_offsets;      // the key of object i starts at key_offsets[i]
+    int64_t *sizes;            // -1 unknown
+    int64_t *mtimes;           // last modified, seconds since epoch, -1 unknown
+    unsigned char *md5s;       // COS_LIST_COMPACT_MD5_LEN bytes of object i at i * COS_LIST_COMPACT_MD5_LEN
+    int *etag_parts;           // the parts of a multipart etag, 0 an md5 etag,
+                               // COS_LIST_COMPACT_ETAG_RAW the etag follows the key, COS_LIST_COMPACT_NO_ETAG
+    int *owner_ids;            // the interned strings, 0 is the empty string
+    int *owner_names;
+    int *storage_classes;
+    apr_hash_t *string_index;  // interned string -> id
+    apr_array_header_t *strings;
+    int error;                 // COSE_OUT_MEMORY once a column fails to grow
+} cos_list_object_compact_t;
+
+#define COS_LIST_COMPACT_ETAG_RAW -1
+#define COS_LIST_COMPACT_NO_ETAG -2
+
+cos_list_object_compact_t *cos_list_object_compact_create(cos_pool_t *p);
+
+/*
+ * add an object, the strings of content are copied
+ * @return COSE_OK or COSE_OUT_MEMORY
+ */
+int cos_list_object_compact_add(cos_list_object_compact_t *compact, const cos_list_object_content_t *content);
+
+/*
+ * cos_list_object_callback adding the objects to the cos_list_object_compact_t in data,
+ * for cos_list_object_with_callback, cos_list_object_parallel or any other listing
+ */
+int cos_list_object_compact_callback(void *data, cos_list_object_content_t *content);
+
+/*
+ * list all objects from params->marker into compact page by page
+ * @param[in]   params    prefix, marker, delimiter, encoding_type and max_ret of the listing,
+ *                        the common prefixes are added to common_prefix_list, next_marker
+ *                        and truncated are of the last page
+ * @return  cos_status_t, code is 2xx success, other failure
+ */
+cos_status_t *cos_list_object_compact(const cos_request_options_t *options,
+                                      const cos_string_t *bucket,
+                                      cos_list_object_params_t *params,
+                                      cos_list_object_compact_t *compact);
+
+// the key is in the arena of compact, valid until the next object is added
+void cos_list_object_compact_key(const cos_list_object_compact_t *compact, int64_t i, cos_string_t *key);
+
+int64_t cos_list_object_compact_size(const cos_list_object_compact_t *compact, int64_t i);
+
+int64_t cos_list_object_compact_mtime(const cos_list_object_compact_t *compact, int64_t i);
+
+/*
+ * @return the md5 of an md5 or multipart etag, NULL otherwise
+ */
+const unsigned char *cos_list_object_compact_md5(const cos_list_object_compact_t *compact, int64_t i);
+
+/*
+ * @return the etag as listed, quoted, "" if the object has no etag
+ */
+char *cos_list_object_compact_etag(const cos_list_object_compact_t *compact, int64_t i, cos_pool_t *p);
+
+// the interned strings are valid as long as compact, "" if unknown
+const char *cos_list_object_compact_owner_id(const cos_list_object_compact_t *compact, int64_t i);
+
+const char *cos_list_object_compact_owner_name(const cos_list_object_compact_t *compact, int64_t i);
+
+const char *cos_list_object_compact_storage_class(const cos_list_object_compact_t *compact, int64_t i);
+
+/*
+ * add the objects to object_list as cos_list_object_content_t allocated from p,
+ * last modified is formatted to seconds
+ */
+void cos_list_object_compact_to_list(const cos_list_object_compact_t *compact, cos_pool_t *p,
+                                     cos_list_t *object_list);
+
+COS_CPP_END
+
+#endif
@@ -0,0 +1,182 @@
+#include "cos_log.h"
+#include "cos_sys_util.h"
+#include "cos_status.h"
+#include "cos_auth.h"
+#include "cos_utility.h"
+#include "cos_api.h"
+#include "cos_list_iterator.h"
+
+static void cos_fetch_list_page(cos_list_iterator_t *it, cos_list_iterator_page_t *page, const char *marker)
+{
+    cos_request_options_t options;
+    cos_table_t *resp_headers = NULL;
+
+    apr_pool_clear(page->pool);
+    options = it->options;
+    options.pool = page->pool;
+    options.ctl = cos_http_controller_create(page->pool, 0);
+    options.ctl->options = it->options.ctl->options;
+
+    page->params = cos_create_list_object_params(page->pool);
+    page->params->encoding_type = it->params.encoding_type;
+    page->params->prefix = it->params.prefix;
+    page->params->delimiter = it->params.delimiter;
+    page->params->max_ret = it->params.max_ret;
+    cos_str_set(&page->params->marker, apr_pstrdup(page->pool, marker));
+
+    page->s = cos_list_object(&options, &it->bucket, page->params, &resp_headers);
+    page->last_page = !cos_status_is_ok(page->s) || !page->params->truncated ||
+        NULL == page->params->next_marker.data;
+}
+
+static void * APR_THREAD_FUNC cos_list_iterator_fetch(apr_thread_t *thd, void *data)
+{
+    cos_list_iterator_t *it = (cos_list_iterator_t *)data;
+    cos_list_iterator_page_t *page;
+    cos_pool_t *nextmark_pool = NULL;
+    cos_pool_t *marker_pool = NULL;
+    const char *marker = it->params.marker.data;
+    void *free_page;
+
+    do {
+        if (apr_queue_pop(it->free_pages, &free_page) != APR_SUCCESS) {
+            break;
+        }
+        page = (cos_list_iterator_page_t *)free_page;
+        cos_fetch_list_page(it, page, marker);
+
+        // the page may be consumed and fetched again before the marker is used
+        if (!page->last_page) {
+            cos_pool_create(&nextmark_pool, NULL);
+            marker = apr_pstrndup(nextmark_pool, page->params->next_marker.data, page->params->next_marker.len);
+            if (NULL != marker_pool) {
+                cos_pool_destroy(marker_pool);
+            }
+            marker_pool = nextmark_pool;
+        }
+        if (apr_queue_push(it->ready_pages, page) != APR_SUCCESS) {
+            break;
+        }
+    } while (!page->last_page);
+
+    if (NULL != marker_pool) {
+        cos_pool_destroy(marker_pool);
+    }
+    return NULL;
+}
+
+cos_list_iterator_t *cos_list_iterator_create(const cos_request_options_t *options,
+                                              const cos_string_t *bucket,
+                                              const cos_list_object_params_t *params)
+{
+    cos_pool_t *pool;
+    cos_list_iterator_t *it;
+    cos_list_object_params_t *default_params;
+    int i;
+
+    cos_pool_create(&pool, options->pool);
+    it = (cos_list_iterator_t *)cos_pcalloc(pool, sizeof(cos_list_iterator_t));
+    it->pool = pool;
+
+    it->options.pool = pool;
+    it->options.config = options->config;
+    it->options.ctl = cos_http_controller_create(pool, 0);
+    it->options.ctl->options = options->ctl->options;
+    cos_str_set(&it->bucket, apr_pstrndup(pool, bucket->data, bucket->len));
+
+    default_params = cos_create_list_object_params(pool);
+    if (NULL == params) {
+        params = default_params;
+    }
+    cos_str_set(&it->params.encoding_type, NULL == params->encoding_type.data ? "" :
+                apr_pstrndup(pool, params->encoding_type.data, params->encoding_type.len));
+    cos_str_set(&it->params.prefix, NULL == params->prefix.data ? "" :
+                apr_pstrndup(pool, params->prefix.data, params->prefix.len));
+    cos_str_set(&it->params.delimiter, NULL == params->delimiter.data ? "" :
+                apr_pstrndup(pool, params->delimiter.data, params->delimiter.len));
+    cos_str_set(&it->params.marker, NULL == params->marker.data ? "" :
+                apr_pstrndup(pool, params->marker.data, params->marker.len));
+    it->params.max_ret = params->max_ret > 0 ? params->max_ret : default_params->max_ret;
+
+    if (apr_queue_create(&it->free_pages, COS_LIST_ITERATOR_PAGES, pool) != APR_SUCCESS ||
+        apr_queue_create(&it->ready_pages, COS_LIST_ITERATOR_PAGES, pool) != APR_SUCCESS) {
+        cos_error_log("create queue of list iterator failure.");
+        cos_pool_destroy(pool);
+        return NULL;
+    }
+    for (i = 0; i < COS_LIST_ITERATOR_PAGES; i++) {
+        cos_pool_create(&it->pages[i].pool, pool);
+        apr_queue_push(it->free_pages, &it->pages[i]);
+    }
+
+    if (apr_thread_create(&it->thread, NULL, cos_list_iterator_fetch, it, pool) != APR_SUCCESS) {
+        cos_error_log("create thread of list iterator failure.");
+        cos_pool_destroy(pool);
+        return NULL;
+    }
+
+    return it;
+}
+
+int cos_list_iterator_next(cos_list_iterator_t *it, cos_list_object_content_t **content)
+{
+    void *ready_page;
+
+    for (;;) {
+        if (NULL != it->page && it->next != &it->page->params->object_list) {
+            *content = cos_list_entry(it->next, cos_list_object_content_t, node);
+            it->next = it->next->next;
+            return COS_TRUE;
+        }
+        if (it->end) {
+            *content = NULL;
+            return COS_FALSE;
+        }
+
+        // the consumed page is fetched again while the next one is consumed
+        if (NULL != it->page) {
+            apr_queue_push(it->free_pages, it->page);
+            it->page = NULL;
+        }
+        if (apr_queue_pop(it->ready_pages, &ready_page) != APR_SUCCESS) {
+            it->end = COS_TRUE;
+            continue;
+        }
+        it->page = (cos_list_iterator_page_t *)ready_page;
+        it->next = it->page->params->object_list.next;
+        it->end = it->page->last_page;
+        if (!cos_status_is_ok(it->page->s)) {
+            it->s = cos_status_dup(it->pool, it->page->s);
+            it->next = &it->page->params->object_list;
+        } else {
+            it->code = it->page->s->code;
+        }
+    }
+}
+
+cos_status_t *cos_list_iterator_status(cos_list_iterator_t *it)
+{
+    cos_status_t *s;
+
+    // a failed page ends the listing and keeps its status, otherwise follow the pages consumed
+    if (NULL != it->s) {
+        return it->s;
+    }
+    s = cos_status_create(it->pool);
+    s->code = it->code;
+    return s;
+}
+
+void cos_list_iterator_destroy(cos_list_iterator_t *it)
+{
+    apr_status_t retval;
+
+    if (NULL == it) {
+        return;
+    }
+    // wake the thread up if it waits for a free page, a fetched page never waits
+    apr_queue_term(it->free_pages);
+    apr_thread_join(&retval, it->thread);
+    apr_queue_term(it->ready_pages);
+    cos_pool_destroy(it->pool);
+}
@@ -0,0 +1,69 @@
+#ifndef LIBCOS_LIST_ITERATOR_H
+#define LIBCOS_LIST_ITERATOR_H
+
+#include "cos_sys_define.h"
+#include "cos_define.h"
+#include "apr_queue.h"
+#include "apr_thread_proc.h"
+
+COS_CPP_START
+
+typedef struct {
+    cos_pool_t *pool;                 // cleared when the page is fetched again
+    cos_list_object_params_t *params;
+    cos_status_t *s;
+    int last_page;
+} cos_list_iterator_page_t;
+
+/*
+ * iterate the objects of list object one by one, a thread fetches page N+1
+ * while page N is consumed, the pages are recycled so only
+ * COS_LIST_ITERATOR_PAGES pages are in memory
+ */
+typedef struct cos_list_iterator_s {
+    cos_pool_t *pool;
+    cos_request_options_t options;    // the options of the fetching thread
+    cos_string_t bucket;
+    cos_list_object_params_t params;  // the prefix, delimiter, max_ret and the start marker
+    cos_list_iterator_page_t pages[COS_LIST_ITERATOR_PAGES];
+    apr_queue_t *free_pages;          // consumed, to be fetched again
+    apr_queue_t *ready_pages;         // fetched, to be consumed
+    apr_thread_t *thread;
+    cos_list_iterator_page_t *page;   // the page being consumed
+    cos_list_t *next;                 // the node of the next object in page
+    cos_status_t *s;                  // the status of the failed page
+    int code;                         // the http code of the last page succeeded
+    int end;
+} cos_list_iterator_t;
+
+/*
+ * create an iterator and start fetching the first page
+ * @param[in]   params    prefix, marker, delimiter, encoding_type and max_ret of the listing,
+ *                        NULL to list the whole bucket
+ * @return the iterator, NULL if the thread fails to start
+ */
+cos_list_iterator_t *cos_list_iterator_create(const cos_request_options_t *options,
+                                              const cos_string_t *bucket,
+                                              const cos_list_object_params_t *params);
+
+/*
+ * get the next object, it is valid until the next call of next
+ * @return COS_TRUE an object is got, COS_FALSE the listing ends or fails,
+ *         cos_list_iterator_status tells which
+ */
+int cos_list_iterator_next(cos_list_iterator_t *it, cos_list_object_content_t **content);
+
+/*
+ * @return the status of the last page consumed, code is 2xx success, 0 before the first page,
+ *         other failure
+ */
+cos_status_t *cos_list_iterator_status(cos_list_iterator_t *it);
+
+/*
+ * stop the fetching thread and release the iterator
+ */
+void cos_list_iterator_destroy(cos_list_iterator_t *it);
+
+COS_CPP_END
+
+#endif
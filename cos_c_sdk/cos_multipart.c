@@ -6,6 +6,7 @@
 #include "cos_auth.h"
 #include "cos_utility.h"
 #include "cos_xml.h"
+#include "cos_xml_stream.h"
 #include "cos_api.h"
 
 cos_status_t *cos_init_multipart_upload(const cos_request_options_t *options, 
@@ -88,6 +89,7 @@ cos_status_t *cos_list_upload_part(const cos_request_options_t *options,
     cos_http_response_t *resp = NULL;
     cos_table_t *query_params = NULL;
     cos_table_t *headers = NULL;
+    cos_list_parser_t *parser = NULL;
 
     //init query_params
     query_params = cos_table_create_if_null(options, query_params, 4);
@@ -101,16 +103,19 @@ cos_status_t *cos_list_upload_part(const cos_request_options_t *options,
 
     cos_init_object_request(options, bucket, object, HTTP_GET, 
                             &req, query_params, headers, NULL, 0, &resp);
+    parser = cos_list_parts_parser_create(options->pool, params);
+    cos_init_read_response_body_to_list_parser(parser, resp);
 
     s = cos_process_request(options, req, resp);
     cos_fill_read_response_header(resp, resp_headers);
     if (!cos_status_is_ok(s)) {
+        if (s->code == COSE_WRITE_BODY_ERROR) {
+            cos_xml_error_status_set(s, COSE_XML_PARSE_ERROR);
+        }
         return s;
     }
 
-    res = cos_list_parts_parse_from_body(options->pool, &resp->body,
-            &params->part_list, &params->next_part_number_marker,
-            &params->truncated);
+    res = cos_list_parser_finish(parser);
     if (res != COSE_OK) {
         cos_xml_error_status_set(s, res);
     }
@@ -129,6 +134,7 @@ cos_status_t *cos_list_multipart_upload(const cos_request_options_t *options,
     cos_http_response_t *resp = NULL;
     cos_table_t *query_params = NULL;
     cos_table_t *headers = NULL;
+    cos_list_parser_t *parser = NULL;
 
     //init query_params
     query_params = cos_table_create_if_null(options, query_params, 7);
@@ -145,16 +151,19 @@ cos_status_t *cos_list_multipart_upload(const cos_request_options_t *options,
 
     cos_init_bucket_request(options, bucket, HTTP_GET, &req, 
                             query_params, headers, &resp);
+    parser = cos_list_multipart_uploads_parser_create(options->pool, params);
+    cos_init_read_response_body_to_list_parser(parser, resp);
 
     s = cos_process_request(options, req, resp);
     cos_fill_read_response_header(resp, resp_headers);
     if (!cos_status_is_ok(s)) {
+        if (s->code == COSE_WRITE_BODY_ERROR) {
+            cos_xml_error_status_set(s, COSE_XML_PARSE_ERROR);
+        }
         return s;
     }
 
-    res = cos_list_multipart_uploads_parse_from_body(options->pool, &resp->body, 
-            &params->upload_list, &params->next_key_marker, 
-            &params->next_upload_id_marker, &params->truncated);
+    res = cos_list_parser_finish(parser);
     if (res != COSE_OK) {
         cos_xml_error_status_set(s, res);
     }
@@ -225,6 +234,48 @@ cos_status_t *cos_upload_part_from_buffer(const cos_request_options_t *options,
                                           buffer, NULL, NULL, NULL, resp_headers, NULL);
 }
 
+cos_status_t *cos_upload_part_from_read_ahead(const cos_request_options_t *options, 
+                                              const cos_string_t *bucket, 
+                                              const cos_string_t *object, 
+                                              const cos_string_t *upload_id, 
+                                              int part_num, 
+                                              cos_list_t *buffer, 
+                                              const char *content_md5,
+                                              uint64_t crc64,
+                                              cos_table_t **resp_headers)
+{
+    cos_status_t *s = NULL;
+    cos_http_request_t *req = NULL;
+    cos_http_response_t *resp = NULL;
+    cos_table_t *query_params = NULL;
+    cos_table_t *headers = NULL;
+
+    //init query_params
+    query_params = cos_table_create_if_null(options, NULL, 2);
+    apr_table_add(query_params, COS_UPLOAD_ID, upload_id->data);
+    cos_table_add_int(query_params, COS_PARTNUMBER, part_num);
+
+    //init headers, the digests are calculated when the buffer is read
+    headers = cos_table_create_if_null(options, NULL, 1);
+    if (NULL != content_md5) {
+        apr_table_set(headers, COS_CONTENT_MD5, content_md5);
+    }
+
+    cos_init_object_request(options, bucket, object, HTTP_PUT, &req, query_params, 
+                            headers, NULL, 0, &resp);
+
+    cos_write_request_body_from_read_ahead(buffer, options, crc64, req);
+
+    s = cos_process_request(options, req, resp);
+    cos_fill_read_response_header(resp, resp_headers);
+
+    if (is_enable_crc(options) && has_crc_in_response(resp)) {
+        cos_check_crc_consistent(req->crc64, resp->headers, s);
+    }
+
+    return s;
+}
+
 cos_status_t *cos_do_upload_part_from_buffer(const cos_request_options_t *options, 
                                              const cos_string_t *bucket, 
                                              const cos_string_t *object, 
@@ -296,6 +347,9 @@ cos_status_t *cos_do_upload_part_from_file(const cos_request_options_t *options,
     cos_http_request_t *req = NULL;
     cos_http_response_t *resp = NULL; 
     cos_table_t *query_params = NULL;
+    cos_list_t read_ahead_body;
+    uint64_t read_ahead_crc64 = 0;
+    int read_ahead = COS_FALSE;
     int res = COSE_OK;
 
     s = cos_status_create(options->pool);
@@ -308,15 +362,30 @@ cos_status_t *cos_do_upload_part_from_file(const cos_request_options_t *options,
     //init headers
     headers = cos_table_create_if_null(options, headers, 0);
 
-    cos_add_content_md5_from_file_range(options, upload_file, headers);
+    if (cos_is_read_ahead_upload_file(options, upload_file)) {
+        // read the part once for md5, crc64 and sending
+        cos_list_init(&read_ahead_body);
+        res = cos_read_ahead_upload_file(options, upload_file, headers, &read_ahead_body, &read_ahead_crc64);
+        if (res != COSE_OK) {
+            cos_file_error_status_set(s, res);
+            return s;
+        }
+        read_ahead = COS_TRUE;
+    } else {
+        cos_add_content_md5_from_file_range(options, upload_file, headers);
+    }
 
     cos_init_object_request(options, bucket, object, HTTP_PUT, &req, 
                             query_params, headers, progress_callback, 0, &resp);
 
-    res = cos_write_request_body_from_upload_file(options->pool, upload_file, req);
-    if (res != COSE_OK) {
-        cos_file_error_status_set(s, res);
-        return s;
+    if (read_ahead) {
+        cos_write_request_body_from_read_ahead(&read_ahead_body, options, read_ahead_crc64, req);
+    } else {
+        res = cos_write_request_body_from_upload_file(options->pool, upload_file, req);
+        if (res != COSE_OK) {
+            cos_file_error_status_set(s, res);
+            return s;
+        }
     }
 
     s = cos_process_request(options, req, resp);
@@ -378,78 +447,73 @@ cos_status_t *cos_upload_part_copy(const cos_request_options_t *options,
     return s;
 }
 
-cos_status_t *cos_get_sorted_uploaded_part(cos_request_options_t *options,
-                                           const cos_string_t *bucket, 
-                                           const cos_string_t *object, 
-                                           const cos_string_t *upload_id, 
-                                           cos_list_t *complete_part_list, 
-                                           int *part_count)
+cos_status_t *cos_build_uploaded_part_index(cos_request_options_t *options,
+                                            const cos_string_t *bucket, 
+                                            const cos_string_t *object, 
+                                            const cos_string_t *upload_id, 
+                                            cos_part_index_t *index)
 {
     cos_pool_t *subpool = NULL;
     cos_pool_t *parent_pool = NULL;
     cos_status_t *s = NULL;
     cos_status_t *ret = NULL;
-    cos_upload_part_t *part_arr = NULL;
-    int part_index = 0;
-    int index = 0;
-    int uploaded_part_count = 0;
     cos_list_upload_part_params_t *params = NULL;
     cos_list_part_content_t *part_content = NULL;
-    cos_complete_part_content_t *complete_content = NULL;
     cos_table_t *list_part_resp_headers = NULL;
-    char *part_num_str = NULL;
 
     parent_pool = options->pool;
-    part_arr = cos_palloc(parent_pool, COS_MAX_PART_NUM * sizeof(cos_upload_part_t *));
     params = cos_create_list_upload_part_params(parent_pool);
     while (params->truncated) {
         cos_pool_create(&subpool, parent_pool);
         options->pool = subpool;
         s = cos_list_upload_part(options, bucket, object,
                 upload_id, params, &list_part_resp_headers);
+        ret = cos_status_dup(parent_pool, s);
         if (!cos_status_is_ok(s)) {
-            ret = cos_status_dup(parent_pool, s);
             cos_pool_destroy(subpool);
             options->pool = parent_pool;
             return ret;
         }
-        if (!params->truncated) {
-            ret = cos_status_dup(parent_pool, s);
-        }
+
+        // every part is put into its slot, no sort is needed
         cos_list_for_each_entry(cos_list_part_content_t, part_content, &params->part_list, node) {
-            cos_upload_part_t upload_part;
-            upload_part.etag = part_content->etag.data;
-            upload_part.part_num = atoi(part_content->part_number.data);
-            part_arr[part_index++] = upload_part;
-            uploaded_part_count++;
+            cos_part_index_set(index, atoi(part_content->part_number.data), 
+                               apr_pstrdup(parent_pool, part_content->etag.data),
+                               part_content->size.data == NULL ? -1 : cos_atoi64(part_content->size.data));
         }
 
         cos_list_init(&params->part_list);
         if (params->next_part_number_marker.data != NULL) {
             cos_str_set(&params->part_number_marker, 
-                        params->next_part_number_marker.data);
+                        apr_pstrdup(parent_pool, params->next_part_number_marker.data));
         }
-        
-        //sort multipart upload part content
-        qsort(part_arr, uploaded_part_count, sizeof(part_arr[0]), part_sort_cmp);
-
-        for (index = 0; index < part_index; ++index) {
-            complete_content = cos_create_complete_part_content(parent_pool);
-            part_num_str = apr_psprintf(parent_pool, "%d", part_arr[index].part_num);
-            cos_str_set(&complete_content->part_number, part_num_str);
-            cos_str_set(&complete_content->etag, part_arr[index].etag);
-            cos_list_add_tail(&complete_content->node, complete_part_list);
-        }
-        part_index = 0;
         cos_pool_destroy(subpool);
+        options->pool = parent_pool;
     }
 
-    *part_count = uploaded_part_count;
-    options->pool = parent_pool;
-
     return ret;
 }
 
+cos_status_t *cos_get_sorted_uploaded_part(cos_request_options_t *options,
+                                           const cos_string_t *bucket, 
+                                           const cos_string_t *object, 
+                                           const cos_string_t *upload_id, 
+                                           cos_list_t *complete_part_list, 
+                                           int *part_count)
+{
+    cos_part_index_t *index = NULL;
+    cos_status_t *s = NULL;
+
+    index = cos_create_part_index(options->pool, COS_MAX_PART_NUM);
+    s = cos_build_uploaded_part_index(options, bucket, object, upload_id, index);
+    if (!cos_status_is_ok(s)) {
+        return s;
+    }
+    *part_count = cos_part_index_get_completed(index, options->pool, COS_MAX_PART_NUM, complete_part_list);
+
+    return s;
+}
+
 cos_status_t *cos_upload_file(cos_request_options_t *options,
                               const cos_string_t *bucket, 
                               const cos_string_t *object, 
@@ -463,21 +527,21 @@ cos_status_t *cos_upload_file(cos_request_options_t *options,
     int64_t start_pos;
     int64_t end_pos;
     int part_num;
-    int part_count = 0;
+    int part_count;
     int res = COSE_OK;
     cos_status_t *s = NULL;
     cos_status_t *ret = NULL;
     cos_file_buf_t *fb = NULL;
     cos_upload_file_t *upload_file = NULL;
     cos_table_t *upload_part_resp_headers = NULL;
-    char *part_num_str = NULL;
     char *etag = NULL;
     cos_list_t complete_part_list;
-    cos_complete_part_content_t *complete_content = NULL;
+    cos_part_index_t *index = NULL;
     cos_table_t *complete_resp_headers = NULL;
 
     cos_list_init(&complete_part_list);
     parent_pool = options->pool;
+    index = cos_create_part_index(parent_pool, COS_MAX_PART_NUM);
 
     //get upload_id and uploaded part
     if (NULL == upload_id->data) {
@@ -492,8 +556,7 @@ cos_status_t *cos_upload_file(cos_request_options_t *options,
            return ret;
         }
     } else {
-        s = cos_get_sorted_uploaded_part(options, bucket, object, upload_id, 
-                &complete_part_list, &part_count);
+        s = cos_build_uploaded_part_index(options, bucket, object, upload_id, index);
         if (!cos_status_is_ok(s)) {
             ret = cos_status_dup(parent_pool, s);
             return ret;
@@ -510,15 +573,18 @@ cos_status_t *cos_upload_file(cos_request_options_t *options,
         return s;
     }
     cos_get_part_size(fb->file_last, &part_size);
+    part_count = fb->file_last > 0 ? cos_get_part_num(fb->file_last, part_size) : 1;
 
-    //upload part from file
+    //upload the parts missing or uploaded with another size
     upload_file = cos_create_upload_file(parent_pool);
     cos_str_set(&upload_file->filename, filepath->data);
-    start_pos = part_size * part_count;
-    end_pos = start_pos + part_size;
-    part_num = part_count + 1;
+    for (part_num = 1; part_num <= part_count; part_num++) {
+        start_pos = part_size * (part_num - 1);
+        end_pos = cos_min(start_pos + part_size, fb->file_last);
+        if (cos_part_index_has(index, part_num) && index->sizes[part_num - 1] == end_pos - start_pos) {
+            continue;
+        }
 
-    while (1) {
         cos_pool_create(&subpool, parent_pool);
         options->pool = subpool;
         upload_file->file_pos = start_pos;
@@ -533,25 +599,15 @@ cos_status_t *cos_upload_file(cos_request_options_t *options,
             return ret;
         }
          
-        complete_content = cos_create_complete_part_content(parent_pool);
-        part_num_str = apr_psprintf(parent_pool, "%d", part_num);
-        cos_str_set(&complete_content->part_number, part_num_str);
         etag = apr_pstrdup(parent_pool, 
                            (char*)apr_table_get(upload_part_resp_headers, "ETag"));
-        cos_str_set(&complete_content->etag, etag);
-        cos_list_add_tail(&complete_content->node, &complete_part_list);
+        cos_part_index_set(index, part_num, etag, end_pos - start_pos);
         cos_pool_destroy(subpool);
-        if (end_pos >= fb->file_last) {
-            break;
-        }
-        start_pos += part_size;
-        end_pos += part_size;
-        if (end_pos > fb->file_last)
-            end_pos = fb->file_last;
-        part_num += 1;
+        options->pool = parent_pool;
     }
 
-    //complete multipart
+    //complete multipart, the parts beyond the file are not included
+    cos_part_index_get_completed(index, parent_pool, part_count, &complete_part_list);
     cos_pool_create(&subpool, parent_pool);
     options->pool = subpool;
 
@@ -598,7 +654,7 @@ cos_status_t *cos_upload_object_by_part_copy
         options->pool = parent_pool;
         return ret;
     }
-    total_size = atol((char*)apr_table_get(head_resp_headers, COS_CONTENT_LENGTH));
+    total_size = cos_atoi64(apr_table_get(head_resp_headers, COS_CONTENT_LENGTH));
 
     //set part copy param
     cos_upload_part_copy_params_t *upload_part_copy_params = cos_create_upload_part_copy_params(parent_pool);
@@ -672,6 +728,39 @@ cos_status_t *cos_download_part_to_file(const cos_request_options_t *options,
                                         download_file, NULL, NULL, NULL, resp_headers);
 }
 
+static cos_status_t *cos_do_download_part_range(const cos_request_options_t *options,
+                                                const cos_string_t *bucket, 
+                                                const cos_string_t *object,
+                                                cos_upload_file_t *download_file,
+                                                apr_file_t *file,
+                                                char *buffer,
+                                                cos_progress_callback progress_callback,
+                                                cos_table_t *headers, 
+                                                cos_table_t *params,
+                                                cos_table_t **resp_headers);
+
+cos_status_t *cos_download_part_to_buffer(const cos_request_options_t *options,
+                                          const cos_string_t *bucket, 
+                                          const cos_string_t *object,
+                                          cos_upload_file_t *download_file,
+                                          char *buffer,
+                                          cos_table_t **resp_headers)
+{
+    return cos_do_download_part_range(options, bucket, object, download_file, NULL, buffer,
+                                      NULL, NULL, NULL, resp_headers);
+}
+
+cos_status_t *cos_download_part_to_shared_file(const cos_request_options_t *options,
+                                               const cos_string_t *bucket, 
+                                               const cos_string_t *object,
+                                               cos_upload_file_t *download_file,
+                                               apr_file_t *file,
+                                               cos_table_t **resp_headers)
+{
+    return cos_do_download_part_to_shared_file(options, bucket, object, download_file, file, 
+                                               NULL, NULL, NULL, resp_headers);
+}
+
 cos_status_t *cos_do_download_part_to_file(const cos_request_options_t *options,
                                            const cos_string_t *bucket, 
                                            const cos_string_t *object,
@@ -680,6 +769,35 @@ cos_status_t *cos_do_download_part_to_file(const cos_request_options_t *options,
                                            cos_table_t *headers, 
                                            cos_table_t *params,
                                            cos_table_t **resp_headers)
+{
+    return cos_do_download_part_to_shared_file(options, bucket, object, download_file, NULL, 
+                                               progress_callback, headers, params, resp_headers);
+}
+
+cos_status_t *cos_do_download_part_to_shared_file(const cos_request_options_t *options,
+                                                  const cos_string_t *bucket, 
+                                                  const cos_string_t *object,
+                                                  cos_upload_file_t *download_file,
+                                                  apr_file_t *file,
+                                                  cos_progress_callback progress_callback,
+                                                  cos_table_t *headers, 
+                                                  cos_table_t *params,
+                                                  cos_table_t **resp_headers)
+{
+    return cos_do_download_part_range(options, bucket, object, download_file, file, NULL,
+                                      progress_callback, headers, params, resp_headers);
+}
+
+static cos_status_t *cos_do_download_part_range(const cos_request_options_t *options,
+                                                const cos_string_t *bucket, 
+                                                const cos_string_t *object,
+                                                cos_upload_file_t *download_file,
+                                                apr_file_t *file,
+                                                char *buffer,
+                                                cos_progress_callback progress_callback,
+                                                cos_table_t *headers, 
+                                                cos_table_t *params,
+                                                cos_table_t **resp_headers)
 {
     cos_status_t *s = NULL;
     cos_http_request_t *req = NULL;
@@ -696,7 +814,13 @@ cos_status_t *cos_do_download_part_to_file(const cos_request_options_t *options,
                             &req, params, headers, progress_callback, 0, &resp);
 
     s = cos_status_create(options->pool);
-    res = cos_init_read_response_body_to_file_part(options->pool, download_file, resp);
+    if (NULL != buffer) {
+        res = cos_init_read_response_body_to_range_buffer(options->pool, download_file, buffer, resp);
+    } else if (NULL != file) {
+        res = cos_init_read_response_body_to_shared_file(options->pool, download_file, file, resp);
+    } else {
+        res = cos_init_read_response_body_to_file_part(options->pool, download_file, resp);
+    }
     if (res != COSE_OK) {
         cos_file_error_status_set(s, res);
         return s;
@@ -705,6 +829,19 @@ cos_status_t *cos_do_download_part_to_file(const cos_request_options_t *options,
     s = cos_process_request(options, req, resp);
     cos_fill_read_response_header(resp, resp_headers);
 
+    // a body cut short leaves the rest of the range unwritten, it fails the part to be retried
+    if (cos_status_is_ok(s) && resp->body_len != download_file->file_last - download_file->file_pos) {
+        cos_error_log("download range %s, body length %" APR_INT64_T_FMT " mismatch.", range_buf, resp->body_len);
+        cos_status_set(s, COSE_CONNECTION_FAILED, COS_HTTP_IO_ERROR_CODE, "The body length does not match the range");
+        return s;
+    }
+
+    // the crc64 of a range is not in the response, keep the local one for the caller
+    if (is_enable_crc(options) && cos_status_is_ok(s)) {
+        download_file->crc64 = resp->crc64;
+        download_file->has_crc64 = COS_TRUE;
+    }
+
     if (is_enable_crc(options) && has_crc_in_response(resp) && 
         !has_range_or_process_in_request(req)) {
             cos_check_crc_consistent(resp->crc64, resp->headers, s);
@@ -81,6 +81,11 @@ cos_status_t *cos_do_put_object_from_file(const cos_request_options_t *options,
     cos_http_request_t *req = NULL;
     cos_http_response_t *resp = NULL;
     cos_table_t *query_params = NULL;
+    cos_upload_file_t *upload_file = NULL;
+    cos_list_t read_ahead_body;
+    uint64_t read_ahead_crc64 = 0;
+    int read_ahead = COS_FALSE;
+    apr_finfo_t finfo;
     int res = COSE_OK;
 
     s = cos_status_create(options->pool);
@@ -91,15 +96,38 @@ cos_status_t *cos_do_put_object_from_file(const cos_request_options_t *options,
 
     query_params = cos_table_create_if_null(options, params, 0);
 
-    cos_add_content_md5_from_file(options, filename, headers);
+    if (options->ctl->options->read_ahead_size > 0 && 
+        APR_SUCCESS == apr_stat(&finfo, filename->data, APR_FINFO_SIZE, options->pool)) {
+        upload_file = cos_create_upload_file(options->pool);
+        cos_str_set(&upload_file->filename, filename->data);
+        upload_file->file_pos = 0;
+        upload_file->file_last = finfo.size;
+        read_ahead = cos_is_read_ahead_upload_file(options, upload_file);
+    }
+
+    if (read_ahead) {
+        // read the file once for md5, crc64 and sending
+        cos_list_init(&read_ahead_body);
+        res = cos_read_ahead_upload_file(options, upload_file, headers, &read_ahead_body, &read_ahead_crc64);
+        if (res != COSE_OK) {
+            cos_file_error_status_set(s, res);
+            return s;
+        }
+    } else {
+        cos_add_content_md5_from_file(options, filename, headers);
+    }
 
     cos_init_object_request(options, bucket, object, HTTP_PUT, &req, 
                             query_params, headers, progress_callback, 0, &resp);
 
-    res = cos_write_request_body_from_file(options->pool, filename, req);
-    if (res != COSE_OK) {
-        cos_file_error_status_set(s, res);
-        return s;
+    if (read_ahead) {
+        cos_write_request_body_from_read_ahead(&read_ahead_body, options, read_ahead_crc64, req);
+    } else {
+        res = cos_write_request_body_from_file(options->pool, filename, req);
+        if (res != COSE_OK) {
+            cos_file_error_status_set(s, res);
+            return s;
+        }
     }
 
     s = cos_process_request(options, req, resp);
@@ -650,7 +678,14 @@ cos_status_t *copy
         options->pool = parent_pool;
         return ret;
     }
-    total_size = atol((char*)apr_table_get(head_resp_headers, COS_CONTENT_LENGTH));
+    if (NULL == apr_table_get(head_resp_headers, COS_CONTENT_LENGTH)) {
+        ret = cos_status_create(parent_pool);
+        cos_status_set(ret, COSE_INVALID_ARGUMENT, COS_LACK_OF_CONTENT_LEN_ERROR_CODE, NULL);
+        cos_pool_destroy(subpool);
+        options->pool = parent_pool;
+        return ret;
+    }
+    total_size = cos_atoi64(apr_table_get(head_resp_headers, COS_CONTENT_LENGTH));
     options->pool = parent_pool;
     cos_pool_destroy(subpool);
 
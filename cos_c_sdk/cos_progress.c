@@ -0,0 +1,141 @@
+#include "cos_log.h"
+#include "cos_sys_util.h"
+#include "cos_progress.h"
+
+cos_progress_t *cos_progress_create(cos_pool_t *p, apr_interval_time_t interval,
+                                    cos_progress_report_callback callback, void *data)
+{
+    cos_progress_t *progress;
+    cos_pool_t *pool;
+
+    cos_pool_create(&pool, p);
+    progress = (cos_progress_t *)cos_pcalloc(pool, sizeof(cos_progress_t));
+    progress->pool = pool;
+    apr_thread_mutex_create(&progress->mutex, APR_THREAD_MUTEX_DEFAULT, pool);
+    apr_thread_mutex_create(&progress->counter_mutex, APR_THREAD_MUTEX_DEFAULT, pool);
+    progress->interval = interval > 0 ? interval : COS_PROGRESS_INTERVAL;
+    progress->callback = callback;
+    progress->data = data;
+    cos_progress_start(progress, 0, 0);
+
+    return progress;
+}
+
+void cos_progress_destroy(cos_progress_t *progress)
+{
+    if (progress == NULL) {
+        return;
+    }
+    apr_thread_mutex_destroy(progress->counter_mutex);
+    apr_thread_mutex_destroy(progress->mutex);
+    cos_pool_destroy(progress->pool);
+}
+
+void cos_progress_start(cos_progress_t *progress, int64_t total_bytes, int64_t consumed_bytes)
+{
+    apr_time_t now = apr_time_now();
+
+    apr_thread_mutex_lock(progress->mutex);
+    progress->total_bytes = cos_max(total_bytes, 0);
+    progress->start_time = now;
+    progress->start_bytes = consumed_bytes;
+    progress->last_time = now;
+    progress->last_bytes = consumed_bytes;
+    apr_thread_mutex_lock(progress->counter_mutex);
+    progress->consumed_bytes = consumed_bytes;
+    progress->next_report = now + progress->interval;
+    apr_thread_mutex_unlock(progress->counter_mutex);
+    apr_thread_mutex_unlock(progress->mutex);
+}
+
+// called with the mutex held
+static void cos_progress_do_report(cos_progress_t *progress, apr_time_t now)
+{
+    cos_progress_info_t info;
+    int64_t consumed;
+
+    apr_thread_mutex_lock(progress->counter_mutex);
+    consumed = progress->consumed_bytes;
+    apr_thread_mutex_unlock(progress->counter_mutex);
+
+    // retried bytes may be counted before they are taken back
+    consumed = cos_max(consumed, 0);
+    if (progress->total_bytes > 0) {
+        consumed = cos_min(consumed, progress->total_bytes);
+    }
+
+    info.consumed_bytes = consumed;
+    info.total_bytes = progress->total_bytes;
+    info.instant_rate = now > progress->last_time ?
+        cos_max(consumed - progress->last_bytes, 0) * APR_USEC_PER_SEC / (now - progress->last_time) : 0;
+    info.average_rate = now > progress->start_time ?
+        cos_max(consumed - progress->start_bytes, 0) * APR_USEC_PER_SEC / (now - progress->start_time) : 0;
+    if (progress->total_bytes > 0 && consumed >= progress->total_bytes) {
+        info.eta = 0;
+    } else if (progress->total_bytes > 0 && info.average_rate > 0) {
+        info.eta = (progress->total_bytes - consumed + info.average_rate - 1) / info.average_rate;
+    } else {
+        info.eta = -1;
+    }
+
+    progress->last_time = now;
+    progress->last_bytes = consumed;
+    apr_thread_mutex_lock(progress->counter_mutex);
+    progress->next_report = now + progress->interval;
+    apr_thread_mutex_unlock(progress->counter_mutex);
+
+    if (progress->callback != NULL) {
+        progress->callback(&info, progress->data);
+    }
+}
+
+// next_report is read with the counter mutex held
+static int cos_progress_is_due(cos_progress_t *progress, int64_t consumed, apr_time_t now, apr_time_t next_report)
+{
+    if (now >= next_report) {
+        return COS_TRUE;
+    }
+    // the completion is reported once without waiting for the interval
+    return progress->total_bytes > 0 && consumed >= progress->total_bytes &&
+        progress->last_bytes < progress->total_bytes;
+}
+
+void cos_progress_update(cos_progress_t *progress, int64_t bytes)
+{
+    int64_t consumed;
+    apr_time_t next_report;
+    apr_time_t now;
+
+    if (bytes == 0) {
+        return;
+    }
+
+    apr_thread_mutex_lock(progress->counter_mutex);
+    progress->consumed_bytes += bytes;
+    consumed = progress->consumed_bytes;
+    next_report = progress->next_report;
+    apr_thread_mutex_unlock(progress->counter_mutex);
+    now = apr_time_now();
+    if (!cos_progress_is_due(progress, consumed, now, next_report)) {
+        return;
+    }
+
+    // the thread holding the mutex reports, the others go on transferring
+    if (apr_thread_mutex_trylock(progress->mutex) != APR_SUCCESS) {
+        return;
+    }
+    apr_thread_mutex_lock(progress->counter_mutex);
+    next_report = progress->next_report;
+    apr_thread_mutex_unlock(progress->counter_mutex);
+    if (cos_progress_is_due(progress, consumed, now, next_report)) {
+        cos_progress_do_report(progress, now);
+    }
+    apr_thread_mutex_unlock(progress->mutex);
+}
+
+void cos_progress_report(cos_progress_t *progress)
+{
+    apr_thread_mutex_lock(progress->mutex);
+    cos_progress_do_report(progress, apr_time_now());
+    apr_thread_mutex_unlock(progress->mutex);
+}
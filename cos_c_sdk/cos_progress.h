@@ -0,0 +1,71 @@
+#ifndef LIBCOS_PROGRESS_H
+#define LIBCOS_PROGRESS_H
+
+#include "cos_sys_define.h"
+#include "apr_atomic.h"
+#include "apr_time.h"
+#include "apr_thread_mutex.h"
+
+COS_CPP_START
+
+typedef struct {
+    int64_t consumed_bytes;
+    int64_t total_bytes;       // 0 if unknown
+    int64_t instant_rate;      // byte/s since the last report
+    int64_t average_rate;      // byte/s since the transfer starts
+    int64_t eta;               // seconds left, -1 if unknown
+} cos_progress_info_t;
+
+typedef void (*cos_progress_report_callback)(const cos_progress_info_t *info, void *data);
+
+/*
+ * the progress of a transfer summed over the bytes sent and received by all of
+ * its requests, the callback is invoked at most once per interval by one thread,
+ * the bytes of a failed request are taken back so a retried part is not counted twice
+ */
+typedef struct cos_progress_s {
+    cos_pool_t *pool;
+    apr_thread_mutex_t *mutex;        // one report at a time
+    apr_thread_mutex_t *counter_mutex; // held only to read or change the counters below,
+                                       // 64-bit atomics need APR 1.7.0 or later
+    int64_t consumed_bytes;
+    apr_time_t next_report;
+    int64_t total_bytes;
+    apr_interval_time_t interval;
+    apr_time_t start_time;
+    int64_t start_bytes;              // the bytes done before start, e.g. parts of checkpoint
+    apr_time_t last_time;
+    int64_t last_bytes;
+    cos_progress_report_callback callback;
+    void *data;
+} cos_progress_t;
+
+/*
+ * create a progress, attach it to a transfer by cos_set_progress
+ * @param[in] interval    microsecond between reports, 0 for COS_PROGRESS_INTERVAL
+ */
+cos_progress_t *cos_progress_create(cos_pool_t *p, apr_interval_time_t interval,
+                                    cos_progress_report_callback callback, void *data);
+
+void cos_progress_destroy(cos_progress_t *progress);
+
+/*
+ * reset the progress for a transfer of total_bytes with consumed_bytes already done,
+ * multi-threaded transfers call it themselves, call it before a single request
+ */
+void cos_progress_start(cos_progress_t *progress, int64_t total_bytes, int64_t consumed_bytes);
+
+/*
+ * add bytes, negative to take them back, and report if the interval is passed or
+ * the transfer completes, a thread never blocks on the report of another thread
+ */
+void cos_progress_update(cos_progress_t *progress, int64_t bytes);
+
+/*
+ * report now regardless of the interval
+ */
+void cos_progress_report(cos_progress_t *progress);
+
+COS_CPP_END
+
+#endif
@@ -7,6 +7,9 @@
 #include "cos_utility.h"
 #include "cos_xml.h"
 #include "cos_api.h"
+#include "cos_crc64.h"
+#include "cos_digest_cache.h"
+#include "cos_progress.h"
 #include "cos_resumable.h"
 
 int32_t cos_get_thread_num(cos_resumable_clt_params_t *clt_params)
@@ -78,7 +81,8 @@ int cos_open_checkpoint_file(cos_pool_t *pool,  cos_string_t *checkpoint_path, c
     apr_status_t s;
     apr_file_t *thefile;
     char buf[256];
-    s = apr_file_open(&thefile, checkpoint_path->data, APR_CREATE | APR_WRITE, APR_UREAD | APR_UWRITE | APR_GREAD, pool);
+    s = apr_file_open(&thefile, checkpoint_path->data, APR_CREATE | APR_WRITE | APR_APPEND, 
+                      APR_UREAD | APR_UWRITE | APR_GREAD, pool);
     if (s == APR_SUCCESS) {
         cos_error_log("apr_file_info_get failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
         checkpoint->thefile = thefile;
@@ -103,1108 +107,3466 @@ void cos_build_parts(int64_t file_size, int64_t part_size, cos_checkpoint_part_t
         parts[i].offset = i * part_size;
         parts[i].size = cos_min(part_size, (file_size - i * part_size));
         parts[i].completed = COS_FALSE;
+        parts[i].crc64 = 0;
+        parts[i].has_crc64 = COS_FALSE;
     }
 }
 
-void cos_build_thread_params(cos_transport_thread_params_t *thr_params, int part_num, 
-                             cos_pool_t *parent_pool, cos_request_options_t *options, 
-                             cos_string_t *bucket, cos_string_t *object, cos_string_t *filepath,
-                             cos_string_t *upload_id, cos_checkpoint_part_t *parts,
+void cos_build_thread_params(cos_transport_thread_params_t *thr_params, int thread_num, 
+                             cos_pool_t *parent_pool, cos_string_t *bucket, cos_string_t *object,
+                             cos_string_t *filepath, cos_string_t *copy_source, cos_string_t *upload_id,
                              cos_part_task_result_t *result) 
 {
     int i = 0;
-    cos_pool_t *subpool = NULL;
-    cos_config_t *config = NULL;
-    cos_http_controller_t *ctl;
-    for (; i < part_num; i++) {
-        cos_pool_create(&subpool, parent_pool); 
-        config = cos_config_create(subpool);
-        cos_str_set(&config->endpoint, options->config->endpoint.data);
-        cos_str_set(&config->access_key_id, options->config->access_key_id.data);
-        cos_str_set(&config->access_key_secret, options->config->access_key_secret.data);
-        cos_str_set(&config->appid, options->config->appid.data);
-        if (options->config->sts_token.data != NULL) {
-            cos_str_set(&config->sts_token, options->config->sts_token.data);
-        }
-        config->is_cname = options->config->is_cname;
-        ctl = cos_http_controller_create(subpool, 0);
-        thr_params[i].options.config = config;
-        thr_params[i].options.ctl = ctl;
-        thr_params[i].options.pool = subpool;
+    for (; i < thread_num; i++) {
+        cos_pool_create(&thr_params[i].options.pool, parent_pool); 
+        thr_params[i].options.config = NULL;
+        thr_params[i].options.ctl = NULL;
         thr_params[i].bucket = bucket;
         thr_params[i].object = object;
         thr_params[i].filepath = filepath;
+        thr_params[i].copy_source = copy_source;
         thr_params[i].upload_id = upload_id;
-        thr_params[i].part = parts + i;
+        thr_params[i].part = NULL;
         thr_params[i].result = result + i;
-        thr_params[i].result->part = thr_params[i].part;
+        thr_params[i].result->part = NULL;
     }
 }
 
-void cos_build_copy_thread_params(cos_upload_copy_thread_params_t *thr_params, int part_num, 
-                             cos_pool_t *parent_pool, cos_request_options_t *options, 
-                             cos_string_t *bucket, cos_string_t *object, cos_string_t *copy_source,
-                             cos_string_t *upload_id, cos_checkpoint_part_t *parts,
-                             cos_part_task_result_t *result) 
+void cos_reset_thread_params(cos_transport_thread_params_t *thr_params, 
+                             cos_request_options_t *options, cos_checkpoint_part_t *part)
 {
-    int i = 0;
-    cos_pool_t *subpool = NULL;
+    cos_pool_t *pool = thr_params->options.pool;
     cos_config_t *config = NULL;
-    cos_http_controller_t *ctl;
-    for (; i < part_num; i++) {
-        cos_pool_create(&subpool, parent_pool); 
-        config = cos_config_create(subpool);
-        cos_str_set(&config->endpoint, options->config->endpoint.data);
-        cos_str_set(&config->access_key_id, options->config->access_key_id.data);
-        cos_str_set(&config->access_key_secret, options->config->access_key_secret.data);
-        cos_str_set(&config->appid, options->config->appid.data);
-        config->is_cname = options->config->is_cname;
-        ctl = cos_http_controller_create(subpool, 0);
-        thr_params[i].options.config = config;
-        thr_params[i].options.ctl = ctl;
-        thr_params[i].options.pool = subpool;
-        thr_params[i].bucket = bucket;
-        thr_params[i].object = object;
-        thr_params[i].copy_source = copy_source;
-        thr_params[i].upload_id = upload_id;
-        thr_params[i].part = parts + i;
-        thr_params[i].result = result + i;
-        thr_params[i].result->part = thr_params[i].part;
-    }
-}
 
+    // recycle the memory of the previous part
+    cos_pool_clear(pool);
+    config = cos_config_create(pool);
+    *config = *options->config;
+    thr_params->options.config = config;
+    thr_params->options.ctl = cos_http_controller_create(pool, 0);
+    thr_params->options.ctl->cancel = options->ctl->cancel;
+    thr_params->options.ctl->progress = options->ctl->progress;
+    thr_params->part = part;
+    thr_params->result->part = part;
+    thr_params->result->s = NULL;
+    thr_params->result->retries = 0;
+    cos_str_null(&thr_params->result->etag);
+}
 
-void cos_destroy_thread_pool(cos_transport_thread_params_t *thr_params, int part_num) 
+void cos_destroy_thread_pool(cos_transport_thread_params_t *thr_params, int thread_num) 
 {
     int i = 0;
-    for (; i < part_num; i++) {
+    for (; i < thread_num; i++) {
         cos_pool_destroy(thr_params[i].options.pool);
     }
 }
 
-void cos_destroy_copy_thread_pool(cos_upload_copy_thread_params_t *thr_params, int part_num) 
+void cos_set_task_tracker(cos_transport_thread_params_t *thr_params, int thread_num, 
+                          apr_uint32_t *failed, apr_uint32_t *retry_budget, apr_queue_t *finished_parts) 
 {
     int i = 0;
-    for (; i < part_num; i++) {
-        cos_pool_destroy(thr_params[i].options.pool);
+    for (; i < thread_num; i++) {
+        thr_params[i].failed = failed;
+        thr_params[i].retry_budget = retry_budget;
+        thr_params[i].finished_parts = finished_parts;
     }
 }
 
-void cos_set_task_tracker(cos_transport_thread_params_t *thr_params, int part_num, 
-                          apr_uint32_t *launched, apr_uint32_t *failed, apr_uint32_t *completed,
-                          apr_queue_t *failed_parts, apr_queue_t *completed_parts) 
+int32_t cos_get_part_retry_budget(int part_num)
 {
-    int i = 0;
-    for (; i < part_num; i++) {
-        thr_params[i].launched = launched;
-        thr_params[i].failed = failed;
-        thr_params[i].completed = completed;
-        thr_params[i].failed_parts = failed_parts;
-        thr_params[i].completed_parts = completed_parts;
-    }
+    return cos_max(part_num / 10, COS_PART_MIN_RETRY_BUDGET);
 }
 
-void cos_set_copy_task_tracker(cos_upload_copy_thread_params_t *thr_params, int part_num, 
-                          apr_uint32_t *launched, apr_uint32_t *failed, apr_uint32_t *completed,
-                          apr_queue_t *failed_parts, apr_queue_t *completed_parts) 
+int cos_should_retry_part(cos_status_t *s)
 {
-    int i = 0;
-    for (; i < part_num; i++) {
-        thr_params[i].launched = launched;
-        thr_params[i].failed = failed;
-        thr_params[i].completed = completed;
-        thr_params[i].failed_parts = failed_parts;
-        thr_params[i].completed_parts = completed_parts;
+    if (cos_should_retry(s)) {
+        return COS_TRUE;
+    }
+
+    switch (s->code) {
+        case COSE_CONNECTION_FAILED:
+        case COSE_REQUEST_TIMEOUT:
+        case COSE_FAILED_CONNECT:
+        case COSE_SERVICE_ERROR:
+        case COSE_NAME_LOOKUP_ERROR:
+        case COSE_CRC_INCONSISTENT_ERROR:
+            return COS_TRUE;
+        default:
+            return COS_FALSE;
     }
 }
 
-int cos_verify_checkpoint_md5(cos_pool_t *pool, const cos_checkpoint_t *checkpoint)
+int cos_retry_part_task(cos_transport_thread_params_t *thr_params, cos_status_t *s)
 {
+    apr_uint32_t left;
+    apr_interval_time_t delay;
+
+    if (!cos_should_retry_part(s) || thr_params->result->retries >= COS_PART_MAX_RETRY_TIME) {
+        return COS_FALSE;
+    }
+    if (apr_atomic_read32(thr_params->failed) > 0 || cos_is_canceled(thr_params->options.ctl)) {
+        return COS_FALSE;
+    }
+
+    // take one retry from the budget shared by all parts
+    do {
+        left = apr_atomic_read32(thr_params->retry_budget);
+        if (left == 0) {
+            cos_warn_log("retry budget is exhausted, part = %d fails.", thr_params->part->index + 1);
+            return COS_FALSE;
+        }
+    } while (apr_atomic_cas32(thr_params->retry_budget, left - 1, left) != left);
+
+    // exponential backoff with jitter, parts failed together do not retry together
+    delay = cos_min(COS_PART_RETRY_BASE_DELAY << thr_params->result->retries, COS_PART_RETRY_MAX_DELAY);
+    delay = delay / 2 + apr_time_now() % (delay / 2 + 1);
+    thr_params->result->retries++;
+    cos_warn_log("retry part = %d, times = %d, after %" APR_INT64_T_FMT " us, code = %d, error_code = %s.",
+                 thr_params->part->index + 1, thr_params->result->retries, (int64_t)delay, s->code,
+                 s->error_code == NULL ? "" : s->error_code);
+    apr_sleep(delay);
+
     return COS_TRUE;
 }
 
-void cos_build_upload_checkpoint(cos_pool_t *pool, cos_checkpoint_t *checkpoint, cos_string_t *file_path, 
-                                 apr_finfo_t *finfo, cos_string_t *upload_id, int64_t part_size) 
+void cos_init_part_tasks(cos_part_tasks_t *tasks, apr_thread_start_t task, 
+                         cos_string_t *bucket, cos_string_t *object,
+                         cos_checkpoint_part_t *parts, int part_num, int32_t thread_num)
 {
-    int i = 0;
+    memset(tasks, 0, sizeof(cos_part_tasks_t));
+    tasks->task = task;
+    tasks->bucket = bucket;
+    tasks->object = object;
+    tasks->parts = parts;
+    tasks->part_num = part_num;
+    tasks->thread_num = thread_num;
+    // copies are timed by the server and downloads by the other direction
+    tasks->observe_bandwidth = task == upload_part;
+}
 
-    checkpoint->cp_type = COS_CP_UPLOAD;
-    cos_str_set(&checkpoint->file_path, cos_pstrdup(pool, file_path));
-    checkpoint->file_size = finfo->size;
-    checkpoint->file_last_modified = finfo->mtime;
-    cos_str_set(&checkpoint->upload_id, cos_pstrdup(pool, upload_id));
+cos_transfer_pool_t *cos_transfer_pool_create(cos_pool_t *p, int32_t max_threads)
+{
+    cos_transfer_pool_t *transfer_pool;
+    cos_pool_t *pool;
+
+    cos_pool_create(&pool, p);
+    transfer_pool = (cos_transfer_pool_t *)cos_pcalloc(pool, sizeof(cos_transfer_pool_t));
+    transfer_pool->pool = pool;
+    transfer_pool->max_threads = cos_max(max_threads, 1);
+    if (APR_SUCCESS != apr_thread_pool_create(&transfer_pool->thrp, 0, transfer_pool->max_threads, pool)) {
+        cos_error_log("create transfer pool failure, max threads = %d.", transfer_pool->max_threads);
+        cos_pool_destroy(pool);
+        return NULL;
+    }
+    apr_atomic_set32(&transfer_pool->transfers, 0);
 
-    checkpoint->part_size = part_size;
-    for (; i * part_size < finfo->size; i++) {
-        checkpoint->parts[i].index = i;
-        checkpoint->parts[i].offset = i * part_size;
-        checkpoint->parts[i].size = cos_min(part_size, (finfo->size - i * part_size));
-        checkpoint->parts[i].completed = COS_FALSE;
-        cos_str_set(&checkpoint->parts[i].etag , "");
+    return transfer_pool;
+}
+
+void cos_transfer_pool_destroy(cos_transfer_pool_t *transfer_pool)
+{
+    if (transfer_pool == NULL) {
+        return;
     }
-    checkpoint->part_num = i;
+    apr_thread_pool_destroy(transfer_pool->thrp);
+    cos_pool_destroy(transfer_pool->pool);
 }
 
-int cos_dump_checkpoint(cos_pool_t *parent_pool, const cos_checkpoint_t *checkpoint) 
+int32_t cos_transfer_pool_get_share(cos_transfer_pool_t *transfer_pool)
 {
-    char *xml_body = NULL;
-    apr_status_t s;
-    char buf[256];
-    apr_size_t len;
-    cos_pool_t *pool; 
+    int32_t transfers = (int32_t)apr_atomic_read32(&transfer_pool->transfers);
 
-    cos_pool_create(&pool, parent_pool);
-    // to xml
-    xml_body = cos_build_checkpoint_xml(pool, checkpoint);
-    if (NULL == xml_body) {
-        cos_pool_destroy(pool);
-        return COSE_OUT_MEMORY;
+    if (transfers <= 1) {
+        return transfer_pool->max_threads;
     }
+    // round up, the surplus parts wait in the queue of the pool rather than leave threads idle
+    return cos_max((transfer_pool->max_threads + transfers - 1) / transfers, 1);
+}
 
-    // truncate to empty
-    s = apr_file_trunc(checkpoint->thefile, 0);
-    if (s != APR_SUCCESS) {
-        cos_error_log("apr_file_write fialure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
-        cos_pool_destroy(pool);
-        return COSE_FILE_TRUNC_ERROR;
-    }
-   
-    // write to file
-    len = strlen(xml_body);
-    s = apr_file_write(checkpoint->thefile, xml_body, &len);
-    if (s != APR_SUCCESS) {
-        cos_error_log("apr_file_write fialure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
-        cos_pool_destroy(pool);
-        return COSE_FILE_WRITE_ERROR;
+static volatile apr_uint32_t cos_observed_part_bandwidth = 0; // KB/s of one connection, 0 if unknown
+
+int64_t cos_get_observed_part_bandwidth()
+{
+    return (int64_t)apr_atomic_read32(&cos_observed_part_bandwidth) * 1024;
+}
+
+void cos_update_observed_part_bandwidth(int64_t bytes, apr_interval_time_t elapsed)
+{
+    int64_t sample;
+    int64_t last;
+
+    if (bytes <= 0 || elapsed <= 0) {
+        return;
     }
+    sample = cos_max(bytes * 1000 / 1024 * 1000 / elapsed, 1);
+    last = apr_atomic_read32(&cos_observed_part_bandwidth);
+    // moving average, 1/8 weight for the new sample
+    sample = last == 0 ? sample : (last * 7 + sample) / 8;
+    apr_atomic_set32(&cos_observed_part_bandwidth, (apr_uint32_t)cos_min(sample, (int64_t)0xFFFFFFFF));
+}
 
-    // flush file
-    s = apr_file_flush(checkpoint->thefile);
-    if (s != APR_SUCCESS) {
-        cos_error_log("apr_file_flush fialure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
-        cos_pool_destroy(pool);
-        return COSE_FILE_FLUSH_ERROR;
+int64_t cos_get_auto_part_size(int64_t file_size, int32_t thread_num)
+{
+    int64_t part_size;
+    int64_t bandwidth;
+
+    bandwidth = cos_get_observed_part_bandwidth();
+    if (bandwidth > 0) {
+        // a part keeps one connection busy for a while, so that the round trips
+        // of request setup are small relative to the transfer
+        part_size = bandwidth * COS_AUTO_PART_SECONDS;
+    } else {
+        part_size = file_size / (cos_max(thread_num, 1) * COS_AUTO_PARTS_PER_THREAD);
     }
+    // enough parts to keep all threads busy
+    part_size = cos_min(part_size, file_size / (cos_max(thread_num, 1) * 2));
+    part_size = cos_max(cos_min(part_size, COS_MAX_AUTO_PART_SIZE), COS_MIN_AUTO_PART_SIZE);
+    part_size = (part_size + COS_MIN_AUTO_PART_SIZE - 1) / COS_MIN_AUTO_PART_SIZE * COS_MIN_AUTO_PART_SIZE;
+    cos_get_part_size(file_size, &part_size);
 
-    cos_pool_destroy(pool);
-    return COSE_OK;
+    return part_size;
 }
 
-int cos_load_checkpoint(cos_pool_t *pool, const cos_string_t *filepath, cos_checkpoint_t *checkpoint) 
+void cos_init_part_tuner(cos_part_tuner_t *tuner, int32_t max_concurrency)
 {
-    apr_status_t s;
-    char buf[256];
-    apr_size_t len;
-    apr_finfo_t finfo;
-    char *xml_body = NULL;
-    apr_file_t *thefile;
+    memset(tuner, 0, sizeof(cos_part_tuner_t));
+    tuner->max_concurrency = cos_max(max_concurrency, 1);
+    tuner->concurrency = cos_min(COS_AUTO_INIT_THREAD_NUM, tuner->max_concurrency);
+    tuner->peak_concurrency = tuner->concurrency;
+    tuner->window_start = apr_time_now();
+}
 
-    // open file
-    s = apr_file_open(&thefile, filepath->data, APR_READ, APR_UREAD | APR_GREAD, pool);
-    if (s != APR_SUCCESS) {
-        cos_error_log("apr_file_open failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
-        return COSE_OPEN_FILE_ERROR;
+void cos_tune_part_concurrency(cos_part_tuner_t *tuner, int64_t part_size, int retries, apr_time_t now)
+{
+    int64_t throughput;
+
+    if (retries > 0) {
+        // multiplicative decrease on throttling or errors
+        tuner->concurrency = cos_max(tuner->concurrency / 2, 1);
+        tuner->window_parts = 0;
+        tuner->window_bytes = 0;
+        tuner->window_start = now;
+        return;
     }
 
-    // get file stat
-    s = apr_file_info_get(&finfo, APR_FINFO_NORM, thefile);
-    if (s != APR_SUCCESS) {
-        cos_error_log("apr_file_info_get failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
-        apr_file_close(thefile);
-        return COSE_FILE_INFO_ERROR;
+    tuner->window_parts++;
+    tuner->window_bytes += part_size;
+    if (tuner->window_parts < tuner->concurrency || now <= tuner->window_start) {
+        return;
     }
 
-    xml_body = (char *)cos_palloc(pool, (apr_size_t)(finfo.size + 1));
-
-    // read
-    s = apr_file_read_full(thefile, xml_body, (apr_size_t)finfo.size, &len);
-    if (s != APR_SUCCESS) {
-        cos_error_log("apr_file_read_full fialure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
-        apr_file_close(thefile);
-        return COSE_FILE_READ_ERROR;
+    // additive increase while a wider window still raises the throughput
+    throughput = tuner->window_bytes * 1000 / (now - tuner->window_start) * 1000;
+    if (throughput > tuner->throughput + tuner->throughput / 20) {
+        tuner->concurrency = cos_min(tuner->concurrency + 1, tuner->max_concurrency);
+    } else if (throughput < tuner->throughput - tuner->throughput * 3 / 10) {
+        tuner->concurrency = cos_max(tuner->concurrency / 2, 1);
     }
-    apr_file_close(thefile);
-    xml_body[len] = '\0';
+    tuner->peak_concurrency = cos_max(tuner->peak_concurrency, tuner->concurrency);
+    tuner->throughput = throughput;
+    tuner->window_parts = 0;
+    tuner->window_bytes = 0;
+    tuner->window_start = now;
+}
 
-    // parse
-    return cos_checkpoint_parse_from_body(pool, xml_body, checkpoint);
+int cos_is_pipelined_upload(cos_request_options_t *options, int64_t part_size)
+{
+    int64_t read_ahead_size = options->ctl->options->read_ahead_size;
+    return read_ahead_size > 0 && part_size > 0 && part_size <= read_ahead_size;
 }
 
-int cos_is_upload_checkpoint_valid(cos_pool_t *pool, cos_checkpoint_t *checkpoint, apr_finfo_t *finfo)
+static void * APR_THREAD_FUNC cos_prefetch_reader(apr_thread_t *thd, void *data)
 {
-    if (cos_verify_checkpoint_md5(pool, checkpoint) && 
-        (checkpoint->file_size == finfo->size) && 
-        (checkpoint->file_last_modified == finfo->mtime)) {
-        return COS_TRUE;
+    cos_part_prefetcher_t *prefetcher = (cos_part_prefetcher_t *)data;
+    cos_prefetch_slot_t *slot;
+    cos_checkpoint_part_t *part;
+    apr_file_t *thefile = NULL;
+    apr_off_t offset;
+    apr_size_t nbytes;
+    int res;
+    int k;
+
+    if (apr_file_open(&thefile, prefetcher->filepath, APR_READ, APR_UREAD | APR_GREAD, prefetcher->pool) != APR_SUCCESS) {
+        thefile = NULL;
     }
-    return COS_FALSE;
+
+    for (k = 0; k < prefetcher->part_num; k++) {
+        part = prefetcher->parts + k;
+        slot = prefetcher->slots + (k % prefetcher->depth);
+
+        apr_thread_mutex_lock(prefetcher->mutex);
+        while (!prefetcher->stop && slot->state != COS_PREFETCH_FREE) {
+            apr_thread_cond_wait(prefetcher->cond, prefetcher->mutex);
+        }
+        if (prefetcher->stop) {
+            apr_thread_mutex_unlock(prefetcher->mutex);
+            break;
+        }
+        slot->pos = k;
+        slot->state = COS_PREFETCH_READING;
+        apr_thread_mutex_unlock(prefetcher->mutex);
+
+        // one large sequential read of the whole part
+        res = COSE_OK;
+        nbytes = (apr_size_t)part->size;
+        offset = part->offset;
+        if (NULL == thefile) {
+            res = COSE_OPEN_FILE_ERROR;
+        } else if (apr_file_seek(thefile, APR_SET, &offset) != APR_SUCCESS) {
+            res = COSE_FILE_SEEK_ERROR;
+        } else if (apr_file_read_full(thefile, slot->data, nbytes, &nbytes) != APR_SUCCESS) {
+            res = COSE_FILE_READ_ERROR;
+        }
+
+        apr_thread_mutex_lock(prefetcher->mutex);
+        slot->res = res;
+        slot->len = nbytes;
+        slot->state = COS_PREFETCH_READ;
+        apr_thread_cond_broadcast(prefetcher->cond);
+        apr_thread_mutex_unlock(prefetcher->mutex);
+    }
+
+    if (NULL != thefile) {
+        apr_file_close(thefile);
+    }
+    return NULL;
 }
 
-void cos_update_checkpoint(cos_pool_t *pool, cos_checkpoint_t *checkpoint, int32_t part_index, cos_string_t *etag) 
+static void * APR_THREAD_FUNC cos_prefetch_hasher(apr_thread_t *thd, void *data)
 {
-    char *p = NULL;
-    checkpoint->parts[part_index].completed = COS_TRUE;
-    p = apr_pstrdup(pool, etag->data);
-    cos_str_set(&checkpoint->parts[part_index].etag, p);
+    cos_part_prefetcher_t *prefetcher = (cos_part_prefetcher_t *)data;
+    cos_prefetch_slot_t *slot;
+    unsigned char md5_data[APR_MD5_DIGESTSIZE];
+    int b64_len;
+    int k;
+
+    for (k = 0; k < prefetcher->part_num; k++) {
+        slot = prefetcher->slots + (k % prefetcher->depth);
+
+        apr_thread_mutex_lock(prefetcher->mutex);
+        while (!prefetcher->stop && !(slot->pos == k && slot->state == COS_PREFETCH_READ)) {
+            apr_thread_cond_wait(prefetcher->cond, prefetcher->mutex);
+        }
+        if (prefetcher->stop) {
+            apr_thread_mutex_unlock(prefetcher->mutex);
+            break;
+        }
+        apr_thread_mutex_unlock(prefetcher->mutex);
+
+        slot->content_md5[0] = '\0';
+        slot->crc64 = 0;
+        if (slot->res == COSE_OK) {
+            if (prefetcher->need_md5) {
+                apr_md5(md5_data, slot->data, (apr_size_t)slot->len);
+                b64_len = cos_base64_encode(md5_data, APR_MD5_DIGESTSIZE, slot->content_md5);
+                slot->content_md5[b64_len] = '\0';
+            }
+            if (prefetcher->need_crc) {
+                slot->crc64 = cos_crc64(0, slot->data, (size_t)slot->len);
+            }
+        }
+
+        apr_thread_mutex_lock(prefetcher->mutex);
+        slot->state = COS_PREFETCH_READY;
+        apr_thread_cond_broadcast(prefetcher->cond);
+        apr_thread_mutex_unlock(prefetcher->mutex);
+    }
+
+    return NULL;
 }
 
-void cos_get_checkpoint_undo_parts(cos_checkpoint_t *checkpoint, int *part_num, cos_checkpoint_part_t *parts)
+cos_part_prefetcher_t *cos_create_part_prefetcher(cos_request_options_t *options, cos_pool_t *pool,
+                                                  const cos_string_t *filepath, cos_checkpoint_part_t *parts,
+                                                  int part_num, int32_t thread_num)
 {
-    int i = 0;
-    int idx = 0;
-    for (; i < checkpoint->part_num; i++) {
-        if (!checkpoint->parts[i].completed) {
-            parts[idx].index = checkpoint->parts[i].index;
-            parts[idx].offset = checkpoint->parts[i].offset;
-            parts[idx].size = checkpoint->parts[i].size;
-            parts[idx].completed = checkpoint->parts[i].completed;
-            idx++;
+    cos_part_prefetcher_t *prefetcher;
+    cos_pool_t *subpool;
+    char *raw;
+    int i;
+
+    if (part_num <= 0) {
+        return NULL;
+    }
+
+    cos_pool_create(&subpool, pool);
+    prefetcher = (cos_part_prefetcher_t *)cos_pcalloc(subpool, sizeof(cos_part_prefetcher_t));
+    prefetcher->pool = subpool;
+    prefetcher->filepath = cos_pstrdup(subpool, filepath);
+    prefetcher->parts = parts;
+    prefetcher->part_num = part_num;
+    prefetcher->need_md5 = is_enable_md5(options);
+    prefetcher->need_crc = is_enable_crc(options);
+    prefetcher->depth = cos_min(thread_num + COS_PREFETCH_PART_NUM, part_num);
+    for (i = 0; i < part_num; i++) {
+        prefetcher->buffer_size = cos_max(prefetcher->buffer_size, parts[i].size);
+    }
+
+    // the buffers are allocated once and reused by parts
+    prefetcher->slots = (cos_prefetch_slot_t *)cos_pcalloc(subpool, sizeof(cos_prefetch_slot_t) * prefetcher->depth);
+    for (i = 0; i < prefetcher->depth; i++) {
+        raw = (char *)cos_palloc(subpool, (apr_size_t)(prefetcher->buffer_size + COS_PREFETCH_BUFFER_ALIGN));
+        if (NULL == raw) {
+            cos_pool_destroy(subpool);
+            return NULL;
         }
+        prefetcher->slots[i].data = (char *)(((uintptr_t)raw + COS_PREFETCH_BUFFER_ALIGN - 1) & 
+                                             ~((uintptr_t)COS_PREFETCH_BUFFER_ALIGN - 1));
+        prefetcher->slots[i].pos = -1;
+        prefetcher->slots[i].state = COS_PREFETCH_FREE;
     }
-    *part_num = idx;
+
+    if (apr_thread_mutex_create(&prefetcher->mutex, APR_THREAD_MUTEX_DEFAULT, subpool) != APR_SUCCESS ||
+        apr_thread_cond_create(&prefetcher->cond, subpool) != APR_SUCCESS) {
+        cos_pool_destroy(subpool);
+        return NULL;
+    }
+    if (apr_thread_create(&prefetcher->reader, NULL, cos_prefetch_reader, prefetcher, subpool) != APR_SUCCESS) {
+        cos_pool_destroy(subpool);
+        return NULL;
+    }
+    if (apr_thread_create(&prefetcher->hasher, NULL, cos_prefetch_hasher, prefetcher, subpool) != APR_SUCCESS) {
+        prefetcher->hasher = NULL;
+        cos_destroy_part_prefetcher(prefetcher);
+        return NULL;
+    }
+
+    return prefetcher;
 }
 
-void * APR_THREAD_FUNC upload_part(apr_thread_t *thd, void *data) 
+cos_prefetch_slot_t *cos_wait_prefetched_part(cos_part_prefetcher_t *prefetcher, cos_checkpoint_part_t *part)
 {
-    cos_status_t *s = NULL;
-    cos_upload_thread_params_t *params = NULL;
-    cos_upload_file_t *upload_file = NULL;
-    cos_table_t *resp_headers = NULL;
-    int part_num;
-    char *etag;
-    
-    params = (cos_upload_thread_params_t *)data;
-    if (apr_atomic_read32(params->failed) > 0) {
-        apr_atomic_inc32(params->launched);
-        return NULL;
+    cos_prefetch_slot_t *slot;
+    int k = (int)(part - prefetcher->parts);
+
+    slot = prefetcher->slots + (k % prefetcher->depth);
+    apr_thread_mutex_lock(prefetcher->mutex);
+    while (!prefetcher->stop && !(slot->pos == k && slot->state == COS_PREFETCH_READY)) {
+        apr_thread_cond_wait(prefetcher->cond, prefetcher->mutex);
     }
+    if (prefetcher->stop) {
+        slot = NULL;
+    }
+    apr_thread_mutex_unlock(prefetcher->mutex);
 
-    part_num = params->part->index + 1;
-    upload_file = cos_create_upload_file(params->options.pool);
-    cos_str_set(&upload_file->filename, params->filepath->data);
-    upload_file->file_pos = params->part->offset;
-    upload_file->file_last = params->part->offset + params->part->size;
+    return slot;
+}
 
-    s = cos_upload_part_from_file(&params->options, params->bucket, params->object, params->upload_id,
-        part_num, upload_file, &resp_headers);
-    if (!cos_status_is_ok(s)) {
-        apr_atomic_inc32(params->failed);
-        params->result->s = s;
-        apr_queue_push(params->failed_parts, params->result);
-        return s;
+void cos_release_prefetched_part(cos_part_prefetcher_t *prefetcher, cos_checkpoint_part_t *part)
+{
+    cos_prefetch_slot_t *slot;
+    int k = (int)(part - prefetcher->parts);
+
+    slot = prefetcher->slots + (k % prefetcher->depth);
+    apr_thread_mutex_lock(prefetcher->mutex);
+    if (slot->pos == k) {
+        slot->state = COS_PREFETCH_FREE;
+        apr_thread_cond_broadcast(prefetcher->cond);
     }
+    apr_thread_mutex_unlock(prefetcher->mutex);
+}
 
-    etag = apr_pstrdup(params->options.pool, (char*)apr_table_get(resp_headers, "ETag"));
-    cos_str_set(&params->result->etag, etag);
-    apr_atomic_inc32(params->completed);
-    apr_queue_push(params->completed_parts, params->result);
-    return NULL;
+void cos_stop_part_prefetcher(cos_part_prefetcher_t *prefetcher)
+{
+    apr_thread_mutex_lock(prefetcher->mutex);
+    prefetcher->stop = COS_TRUE;
+    apr_thread_cond_broadcast(prefetcher->cond);
+    apr_thread_mutex_unlock(prefetcher->mutex);
 }
 
-cos_status_t *cos_resumable_upload_file_without_cp(cos_request_options_t *options,
-                                                   cos_string_t *bucket, 
-                                                   cos_string_t *object, 
-                                                   cos_string_t *filepath,                           
-                                                   cos_table_t *headers,
-                                                   cos_table_t *params,
-                                                   int32_t thread_num,
-                                                   int64_t part_size,
-                                                   apr_finfo_t *finfo,
-                                                   cos_progress_callback progress_callback,
-                                                   cos_table_t **resp_headers,
-                                                   cos_list_t *resp_body) 
+void cos_destroy_part_prefetcher(cos_part_prefetcher_t *prefetcher)
+{
+    apr_status_t retval;
+
+    if (NULL == prefetcher) {
+        return;
+    }
+    cos_stop_part_prefetcher(prefetcher);
+    apr_thread_join(&retval, prefetcher->reader);
+    if (NULL != prefetcher->hasher) {
+        apr_thread_join(&retval, prefetcher->hasher);
+    }
+    apr_thread_cond_destroy(prefetcher->cond);
+    apr_thread_mutex_destroy(prefetcher->mutex);
+    cos_pool_destroy(prefetcher->pool);
+}
+
+cos_status_t *cos_run_part_tasks(cos_request_options_t *options, cos_part_tasks_t *tasks)
 {
     cos_pool_t *subpool = NULL;
     cos_pool_t *parent_pool = NULL;
     cos_status_t *s = NULL;
-    cos_status_t *ret = NULL;
-    cos_list_t completed_part_list;
-    cos_complete_part_content_t *complete_content = NULL;
-    cos_string_t upload_id;
-    cos_checkpoint_part_t *parts;
     cos_part_task_result_t *results;
     cos_part_task_result_t *task_res;
-    cos_upload_thread_params_t *thr_params;
-    cos_table_t *cb_headers = NULL;
+    cos_transport_thread_params_t *thr_params;
+    cos_transport_thread_params_t *idle_params;
+    cos_checkpoint_part_t *part;
+    cos_part_tuner_t tuner;
+    cos_transfer_pool_t *transfer_pool;
     apr_thread_pool_t *thrp;
-    apr_uint32_t launched = 0;
+    apr_queue_t *finished_parts;
     apr_uint32_t failed = 0;
-    apr_uint32_t completed = 0;
-    apr_uint32_t total_num = 0;
-    apr_queue_t *failed_parts;
-    apr_queue_t *completed_parts;
+    apr_uint32_t retry_budget = 0;
+    apr_time_t now;
+    char *failed_parts = NULL;
     int64_t consume_bytes = 0;
     void *task_result;
-    char *part_num_str;
-    char *etag;
-    int part_num = 0;
+    int *idle;
+    int idle_num = 0;
+    int thread_num = 0;
+    int next_part = 0;
+    int first_uncompleted = 0;
+    int running = 0;
     int i = 0;
     int rv;
 
-    // prepare
-    parent_pool = options->pool;
-    ret = cos_status_create(parent_pool);
+    if (tasks->part_num <= 0) {
+        return NULL;
+    }
+    // the callers clamp thread_num, no part is launched with 0 threads
+    assert(tasks->thread_num >= 1);
+
+    parent_pool = options->pool;
+    cos_pool_create(&subpool, parent_pool);
+
+    // the thread params are bounded by threads, not by parts
+    thread_num = cos_min(tasks->thread_num, tasks->part_num);
+    results = (cos_part_task_result_t *)cos_pcalloc(subpool, sizeof(cos_part_task_result_t) * thread_num);
+    thr_params = (cos_transport_thread_params_t *)cos_pcalloc(subpool, sizeof(cos_transport_thread_params_t) * thread_num);
+    idle = (int *)cos_pcalloc(subpool, sizeof(int) * thread_num);
+
+    rv = apr_queue_create(&finished_parts, thread_num, subpool);
+    if (APR_SUCCESS != rv) {
+        s = cos_status_create(parent_pool);
+        cos_status_set(s, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL); 
+        cos_pool_destroy(subpool);
+        return s;
+    }
+
+    transfer_pool = options->ctl->options->transfer_pool;
+    if (NULL != transfer_pool) {
+        thrp = transfer_pool->thrp;
+        apr_atomic_inc32(&transfer_pool->transfers);
+    } else {
+        rv = apr_thread_pool_create(&thrp, 0, thread_num, subpool);
+        if (APR_SUCCESS != rv) {
+            s = cos_status_create(parent_pool);
+            cos_status_set(s, rv, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL); 
+            cos_pool_destroy(subpool);
+            return s;
+        }
+    }
+
+    cos_build_thread_params(thr_params, thread_num, subpool, tasks->bucket, tasks->object, 
+                            tasks->filepath, tasks->copy_source, tasks->upload_id, results);
+    retry_budget = tasks->retry_budget > 0 ? tasks->retry_budget : cos_get_part_retry_budget(tasks->part_num);
+    cos_set_task_tracker(thr_params, thread_num, &failed, &retry_budget, finished_parts);
+    for (i = 0; i < thread_num; i++) {
+        thr_params[i].prefetcher = tasks->prefetcher;
+        thr_params[i].file = tasks->file;
+        thr_params[i].buffer = tasks->buffer;
+        thr_params[i].buffer_size = tasks->buffer_size;
+    }
+
+    // in auto tune mode thread_num is the upper bound of the parts in flight
+    cos_init_part_tuner(&tuner, thread_num);
+    if (!tasks->auto_tune) {
+        tuner.concurrency = thread_num;
+        tuner.peak_concurrency = thread_num;
+    }
+    for (i = thread_num - 1; i >= 0; i--) {
+        idle[idle_num++] = i;
+    }
+
+    if (NULL != options->ctl->progress) {
+        // the parts not in tasks are done before, e.g. by the last run of checkpoint
+        for (i = 0; i < tasks->part_num; i++) {
+            consume_bytes += tasks->parts[i].size;
+        }
+        cos_progress_start(options->ctl->progress, cos_max(tasks->total_size, consume_bytes),
+                           cos_max(tasks->total_size - consume_bytes, 0));
+        consume_bytes = 0;
+    }
+
+    // block until a part finishes, and hand the released thread params over to the next parts,
+    // every launched task pushes its result exactly once so the pop never waits forever
+    do {
+        if (NULL != s && NULL != tasks->prefetcher) {
+            // wake up the parts waiting for read-ahead, they are skipped
+            cos_stop_part_prefetcher(tasks->prefetcher);
+        }
+        while (running < tuner.concurrency && idle_num > 0 && next_part < tasks->part_num &&
+               (tasks->max_parts_ahead <= 0 || next_part - first_uncompleted < tasks->max_parts_ahead) &&
+               apr_atomic_read32(&failed) == 0 &&
+               (NULL == transfer_pool || running < cos_transfer_pool_get_share(transfer_pool))) 
+        {
+            idle_params = thr_params + idle[--idle_num];
+            cos_reset_thread_params(idle_params, options, tasks->parts + next_part++);
+            idle_params->result->start_time = apr_time_now();
+            rv = apr_thread_pool_push(thrp, tasks->task, idle_params, 0, NULL);
+            if (APR_SUCCESS != rv) {
+                // the task never runs, so no result is pushed for it
+                part = idle_params->result->part;
+                cos_error_log("part = %d fails to be launched, code = %d.", part->index + 1, rv);
+                failed_parts = NULL == failed_parts ? apr_psprintf(parent_pool, "%d", part->index + 1) :
+                    apr_psprintf(parent_pool, "%s,%d", failed_parts, part->index + 1);
+                if (NULL == s) {
+                    s = cos_status_create(parent_pool);
+                    cos_status_set(s, rv, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL);
+                }
+                apr_atomic_inc32(&failed);
+                idle[idle_num++] = (int)(idle_params - thr_params);
+                break;
+            }
+            running++;
+        }
+        if (running == 0) {
+            break;
+        }
+
+        rv = apr_queue_pop(finished_parts, &task_result);
+        if (rv == APR_EINTR) {
+            continue;
+        } else if (rv != APR_SUCCESS) {
+            break;
+        }
+        running--;
+        task_res = (cos_part_task_result_t*)task_result;
+        idle[idle_num++] = (int)(task_res - results);
+        part = task_res->part;
+
+        if (NULL == task_res->s) {
+            // skipped after failure or cancellation, the failure is reported by its own result
+            if (NULL == s && cos_is_canceled(options->ctl)) {
+                s = cos_status_create(parent_pool);
+                cos_status_set(s, COSE_CANCELED_ERROR, COS_CANCELED_ERROR_CODE, NULL);
+            }
+            continue;
+        }
+        if (!cos_status_is_ok(task_res->s)) {
+            cos_error_log("part = %d fails after %d retries, code = %d, error_code = %s.", part->index + 1,
+                          task_res->retries, task_res->s->code, 
+                          task_res->s->error_code == NULL ? "" : task_res->s->error_code);
+            failed_parts = NULL == failed_parts ? apr_psprintf(parent_pool, "%d", part->index + 1) :
+                apr_psprintf(parent_pool, "%s,%d", failed_parts, part->index + 1);
+            if (NULL == s) {
+                s = cos_status_dup(parent_pool, task_res->s);
+            }
+            continue;
+        }
+
+        now = apr_time_now();
+        if (tasks->observe_bandwidth && task_res->retries == 0) {
+            cos_update_observed_part_bandwidth(part->size, now - task_res->start_time);
+        }
+        if (tasks->auto_tune) {
+            cos_tune_part_concurrency(&tuner, part->size, task_res->retries, now);
+        }
+
+        part->completed = COS_TRUE;
+        while (first_uncompleted < tasks->part_num && tasks->parts[first_uncompleted].completed) {
+            first_uncompleted++;
+        }
+        if (NULL != task_res->etag.data) {
+            cos_str_set(&part->etag, apr_pstrdup(parent_pool, task_res->etag.data));
+        }
+        if (NULL != tasks->done_callback) {
+            rv = tasks->done_callback(parent_pool, tasks->done_data, part);
+            if (rv != COSE_OK && NULL == s) {
+                s = cos_status_create(parent_pool);
+                cos_status_set(s, rv, COS_WRITE_FILE_ERROR_CODE, NULL);
+                apr_atomic_inc32(&failed);
+            }
+        }
+        if (NULL != tasks->progress_callback) {
+            consume_bytes += part->size;
+            tasks->progress_callback(consume_bytes, tasks->total_size);
+        }
+        if (NULL != options->ctl->progress && NULL != tasks->copy_source) {
+            // the bytes of part copy are not seen by this client
+            cos_progress_update(options->ctl->progress, part->size);
+        }
+
+        if (NULL == s && next_part < tasks->part_num && cos_is_canceled(options->ctl)) {
+            // stop launching, the parts in flight are drained above
+            s = cos_status_create(parent_pool);
+            cos_status_set(s, COSE_CANCELED_ERROR, COS_CANCELED_ERROR_CODE, NULL);
+            apr_atomic_inc32(&failed);
+        }
+    } while (running > 0 || (next_part < tasks->part_num && apr_atomic_read32(&failed) == 0));
+
+    if (NULL != transfer_pool) {
+        // all parts of this transfer are drained, the threads are kept for other transfers
+        apr_atomic_dec32(&transfer_pool->transfers);
+    } else {
+        apr_thread_pool_destroy(thrp);
+    }
+    cos_destroy_thread_pool(thr_params, thread_num);
+    cos_pool_destroy(subpool);
+    if (NULL != options->ctl->progress) {
+        cos_progress_report(options->ctl->progress);
+    }
+
+    tasks->concurrency = tuner.concurrency;
+    tasks->peak_concurrency = tuner.peak_concurrency;
+    if (tasks->auto_tune) {
+        cos_info_log("auto tune, part size = %" APR_INT64_T_FMT ", concurrency = %d, peak concurrency = %d, "
+                     "max concurrency = %d, throughput = %" APR_INT64_T_FMT " B/s.", tasks->parts[0].size, 
+                     tuner.concurrency, tuner.peak_concurrency, thread_num, tuner.throughput);
+    }
+
+    if (NULL != failed_parts) {
+        s->error_msg = apr_psprintf(parent_pool, "%s, failed parts: %s", 
+                                    s->error_msg == NULL ? "" : s->error_msg, failed_parts);
+    }
+
+    return s;
+}
+
+int cos_verify_checkpoint_md5(cos_pool_t *pool, const cos_checkpoint_t *checkpoint)
+{
+    return COS_TRUE;
+}
+
+void cos_build_upload_checkpoint(cos_pool_t *pool, cos_checkpoint_t *checkpoint, cos_string_t *file_path, 
+                                 apr_finfo_t *finfo, cos_string_t *upload_id, int64_t part_size) 
+{
+    int i = 0;
+
+    checkpoint->cp_type = COS_CP_UPLOAD;
+    cos_str_set(&checkpoint->file_path, cos_pstrdup(pool, file_path));
+    checkpoint->file_size = finfo->size;
+    checkpoint->file_last_modified = finfo->mtime;
+    cos_str_set(&checkpoint->upload_id, cos_pstrdup(pool, upload_id));
+
+    checkpoint->part_size = part_size;
+    for (; i * part_size < finfo->size; i++) {
+        checkpoint->parts[i].index = i;
+        checkpoint->parts[i].offset = i * part_size;
+        checkpoint->parts[i].size = cos_min(part_size, (finfo->size - i * part_size));
+        checkpoint->parts[i].completed = COS_FALSE;
+        cos_str_set(&checkpoint->parts[i].etag , "");
+        checkpoint->parts[i].crc64 = 0;
+        checkpoint->parts[i].has_crc64 = COS_FALSE;
+    }
+    checkpoint->part_num = i;
+}
+
+static void cos_put_uint32(unsigned char *p, uint32_t v)
+{
+    int i = 0;
+    for (; i < 4; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static void cos_put_uint64(unsigned char *p, uint64_t v)
+{
+    int i = 0;
+    for (; i < 8; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static uint32_t cos_get_uint32(const unsigned char *p)
+{
+    uint32_t v = 0;
+    int i = 3;
+    for (; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static uint64_t cos_get_uint64(const unsigned char *p)
+{
+    uint64_t v = 0;
+    int i = 7;
+    for (; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+int cos_dump_checkpoint(cos_pool_t *parent_pool, const cos_checkpoint_t *checkpoint) 
+{
+    char *xml_body = NULL;
+    unsigned char *content = NULL;
+    apr_status_t s;
+    char buf[256];
+    apr_size_t xml_len;
+    apr_size_t len;
+    cos_pool_t *pool; 
+
+    cos_pool_create(&pool, parent_pool);
+    // to xml
+    xml_body = cos_build_checkpoint_xml(pool, checkpoint);
+    if (NULL == xml_body) {
+        cos_pool_destroy(pool);
+        return COSE_OUT_MEMORY;
+    }
+
+    // header and snapshot
+    xml_len = strlen(xml_body);
+    len = COS_CP_JOURNAL_HEADER_SIZE + xml_len;
+    content = (unsigned char *)cos_palloc(pool, len);
+    memcpy(content, COS_CP_JOURNAL_MAGIC, 4);
+    cos_put_uint32(content + 4, COS_CP_JOURNAL_VERSION);
+    cos_put_uint64(content + 8, (uint64_t)xml_len);
+    cos_put_uint64(content + 16, cos_crc64(0, xml_body, xml_len));
+    memcpy(content + COS_CP_JOURNAL_HEADER_SIZE, xml_body, xml_len);
+
+    // truncate to empty
+    s = apr_file_trunc(checkpoint->thefile, 0);
+    if (s != APR_SUCCESS) {
+        cos_error_log("apr_file_write fialure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        cos_pool_destroy(pool);
+        return COSE_FILE_TRUNC_ERROR;
+    }
+   
+    // write to file
+    s = apr_file_write_full(checkpoint->thefile, content, len, NULL);
+    if (s != APR_SUCCESS) {
+        cos_error_log("apr_file_write fialure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        cos_pool_destroy(pool);
+        return COSE_FILE_WRITE_ERROR;
+    }
+
+    // flush file
+    if (cos_file_sync(checkpoint->thefile) != COSE_OK) {
+        cos_pool_destroy(pool);
+        return COSE_FILE_FLUSH_ERROR;
+    }
+
+    cos_pool_destroy(pool);
+    return COSE_OK;
+}
+
+int cos_append_checkpoint_part(cos_pool_t *pool, cos_checkpoint_t *checkpoint, const cos_checkpoint_part_t *part)
+{
+    unsigned char record[COS_CP_JOURNAL_RECORD_SIZE + COS_CP_JOURNAL_MAX_ETAG];
+    apr_size_t etag_len;
+    apr_size_t len;
+    apr_status_t s;
+    char buf[256];
+    int res;
+
+    etag_len = part->etag.data == NULL ? 0 : (apr_size_t)part->etag.len;
+    if (etag_len > COS_CP_JOURNAL_MAX_ETAG || 
+        (checkpoint->journal_records >= COS_CHECKPOINT_COMPACT_RECORDS &&
+         checkpoint->journal_records >= checkpoint->part_num / 4)) {
+        // compaction, the snapshot has all the completed parts
+        res = cos_dump_checkpoint(pool, checkpoint);
+        if (res == COSE_OK) {
+            checkpoint->journal_records = 0;
+            checkpoint->unsynced_records = 0;
+        }
+        return res;
+    }
+
+    cos_put_uint32(record, (uint32_t)part->index);
+    cos_put_uint32(record + 4, part->has_crc64 ? 1 : 0);
+    cos_put_uint64(record + 8, part->crc64);
+    cos_put_uint32(record + 16, (uint32_t)etag_len);
+    if (etag_len > 0) {
+        memcpy(record + 20, part->etag.data, etag_len);
+    }
+    len = 20 + etag_len;
+    cos_put_uint64(record + len, cos_crc64(0, record, len));
+    len += 8;
+
+    s = apr_file_write_full(checkpoint->thefile, record, len, NULL);
+    if (s != APR_SUCCESS) {
+        cos_error_log("apr_file_write fialure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        return COSE_FILE_WRITE_ERROR;
+    }
+    checkpoint->journal_records++;
+
+    // a record lost in a crash costs the part only, so fsync is batched
+    if (++checkpoint->unsynced_records >= COS_CHECKPOINT_SYNC_RECORDS) {
+        checkpoint->unsynced_records = 0;
+        return cos_file_sync(checkpoint->thefile);
+    }
+    return COSE_OK;
+}
+
+void cos_close_checkpoint_file(cos_checkpoint_t *checkpoint)
+{
+    if (checkpoint->unsynced_records > 0) {
+        cos_file_sync(checkpoint->thefile);
+        checkpoint->unsynced_records = 0;
+    }
+    apr_file_close(checkpoint->thefile);
+}
+
+static void cos_replay_checkpoint_parts(cos_pool_t *pool, const unsigned char *records, apr_size_t len,
+                                        cos_checkpoint_t *checkpoint)
+{
+    cos_checkpoint_part_t *part;
+    uint32_t index;
+    apr_size_t etag_len;
+    apr_size_t record_len;
+    char *etag;
+
+    while (len >= COS_CP_JOURNAL_RECORD_SIZE) {
+        etag_len = (apr_size_t)cos_get_uint32(records + 16);
+        if (etag_len > COS_CP_JOURNAL_MAX_ETAG || len < COS_CP_JOURNAL_RECORD_SIZE + etag_len) {
+            break;
+        }
+        record_len = 20 + etag_len;
+        if (cos_crc64(0, (void *)records, record_len) != cos_get_uint64(records + record_len)) {
+            break;
+        }
+        index = cos_get_uint32(records);
+        if (index >= (uint32_t)checkpoint->part_num) {
+            break;
+        }
+
+        part = &checkpoint->parts[index];
+        part->completed = COS_TRUE;
+        part->has_crc64 = (cos_get_uint32(records + 4) & 1) ? COS_TRUE : COS_FALSE;
+        part->crc64 = cos_get_uint64(records + 8);
+        etag = (char *)cos_palloc(pool, etag_len + 1);
+        memcpy(etag, records + 20, etag_len);
+        etag[etag_len] = '\0';
+        cos_str_set(&part->etag, etag);
+
+        records += record_len + 8;
+        len -= record_len + 8;
+    }
+
+    if (len > 0) {
+        cos_warn_log("the tail %d bytes of checkpoint are torn or broken, ignored.", (int)len);
+    }
+}
+
+int cos_load_checkpoint(cos_pool_t *pool, const cos_string_t *filepath, cos_checkpoint_t *checkpoint) 
+{
+    apr_status_t s;
+    char buf[256];
+    apr_size_t len;
+    apr_size_t xml_len;
+    apr_finfo_t finfo;
+    char *xml_body = NULL;
+    char *content = NULL;
+    apr_file_t *thefile;
+    int res;
+
+    // open file
+    s = apr_file_open(&thefile, filepath->data, APR_READ, APR_UREAD | APR_GREAD, pool);
+    if (s != APR_SUCCESS) {
+        cos_error_log("apr_file_open failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        return COSE_OPEN_FILE_ERROR;
+    }
+
+    // get file stat
+    s = apr_file_info_get(&finfo, APR_FINFO_NORM, thefile);
+    if (s != APR_SUCCESS) {
+        cos_error_log("apr_file_info_get failure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        apr_file_close(thefile);
+        return COSE_FILE_INFO_ERROR;
+    }
+
+    content = (char *)cos_palloc(pool, (apr_size_t)(finfo.size + 1));
+
+    // read
+    s = apr_file_read_full(thefile, content, (apr_size_t)finfo.size, &len);
+    if (s != APR_SUCCESS) {
+        cos_error_log("apr_file_read_full fialure, code:%d %s.", s, apr_strerror(s, buf, sizeof(buf)));
+        apr_file_close(thefile);
+        return COSE_FILE_READ_ERROR;
+    }
+    apr_file_close(thefile);
+    content[len] = '\0';
+
+    // plain xml
+    if (len < COS_CP_JOURNAL_HEADER_SIZE || memcmp(content, COS_CP_JOURNAL_MAGIC, 4) != 0) {
+        return cos_checkpoint_parse_from_body(pool, content, checkpoint);
+    }
+
+    // the snapshot is dumped as a whole, it must be intact
+    xml_len = (apr_size_t)cos_get_uint64((unsigned char *)content + 8);
+    if (cos_get_uint32((unsigned char *)content + 4) != COS_CP_JOURNAL_VERSION ||
+        xml_len > len - COS_CP_JOURNAL_HEADER_SIZE ||
+        cos_crc64(0, content + COS_CP_JOURNAL_HEADER_SIZE, xml_len) != cos_get_uint64((unsigned char *)content + 16)) {
+        cos_error_log("the snapshot of checkpoint %s is broken.", filepath->data);
+        return COSE_XML_PARSE_ERROR;
+    }
+    xml_body = (char *)cos_palloc(pool, xml_len + 1);
+    memcpy(xml_body, content + COS_CP_JOURNAL_HEADER_SIZE, xml_len);
+    xml_body[xml_len] = '\0';
+
+    // parse
+    res = cos_checkpoint_parse_from_body(pool, xml_body, checkpoint);
+    if (res != COSE_OK) {
+        return res;
+    }
+    cos_replay_checkpoint_parts(pool, (unsigned char *)content + COS_CP_JOURNAL_HEADER_SIZE + xml_len, 
+                                len - COS_CP_JOURNAL_HEADER_SIZE - xml_len, checkpoint);
+    return COSE_OK;
+}
+
+int cos_is_upload_checkpoint_valid(cos_pool_t *pool, cos_checkpoint_t *checkpoint, apr_finfo_t *finfo)
+{
+    if (cos_verify_checkpoint_md5(pool, checkpoint) && 
+        (checkpoint->file_size == finfo->size) && 
+        (checkpoint->file_last_modified == finfo->mtime)) {
+        return COS_TRUE;
+    }
+    return COS_FALSE;
+}
+
+static int cos_is_same_string(const cos_string_t *a, const cos_string_t *b)
+{
+    return a->len == b->len && (a->len == 0 || memcmp(a->data, b->data, a->len) == 0);
+}
+
+static void cos_build_object_checkpoint(cos_pool_t *pool, cos_checkpoint_t *checkpoint, int cp_type, 
+                                        cos_string_t *file_path, cos_string_t *object, int64_t object_size, 
+                                        cos_string_t *last_modified, cos_string_t *etag, int64_t part_size)
+{
+    int i = 0;
+
+    checkpoint->cp_type = cp_type;
+    cos_str_set(&checkpoint->file_path, cos_pstrdup(pool, file_path));
+    cos_str_set(&checkpoint->object_name, cos_pstrdup(pool, object));
+    checkpoint->object_size = object_size;
+    cos_str_set(&checkpoint->object_last_modified, cos_pstrdup(pool, last_modified));
+    cos_str_set(&checkpoint->object_etag, cos_pstrdup(pool, etag));
+
+    checkpoint->part_size = part_size;
+    for (; i * part_size < object_size; i++) {
+        checkpoint->parts[i].index = i;
+        checkpoint->parts[i].offset = i * part_size;
+        checkpoint->parts[i].size = cos_min(part_size, (object_size - i * part_size));
+        checkpoint->parts[i].completed = COS_FALSE;
+        cos_str_set(&checkpoint->parts[i].etag , "");
+        checkpoint->parts[i].crc64 = 0;
+        checkpoint->parts[i].has_crc64 = COS_FALSE;
+    }
+    checkpoint->part_num = i;
+}
+
+void cos_build_download_checkpoint(cos_pool_t *pool, cos_checkpoint_t *checkpoint, cos_string_t *file_path,
+                                   cos_string_t *object, int64_t object_size, cos_string_t *last_modified,
+                                   cos_string_t *etag, int64_t part_size)
+{
+    cos_build_object_checkpoint(pool, checkpoint, COS_CP_DOWNLOAD, file_path, object, object_size, 
+                                last_modified, etag, part_size);
+}
+
+static int cos_is_object_checkpoint_valid(cos_pool_t *pool, cos_checkpoint_t *checkpoint, int cp_type, 
+                                          cos_string_t *file_path, cos_string_t *object, int64_t object_size, 
+                                          cos_string_t *last_modified, cos_string_t *etag)
+{
+    if (cos_verify_checkpoint_md5(pool, checkpoint) && 
+        (checkpoint->cp_type == cp_type) &&
+        (checkpoint->object_size == object_size) &&
+        cos_is_same_string(&checkpoint->file_path, file_path) &&
+        cos_is_same_string(&checkpoint->object_name, object) &&
+        cos_is_same_string(&checkpoint->object_last_modified, last_modified) &&
+        cos_is_same_string(&checkpoint->object_etag, etag)) {
+        return COS_TRUE;
+    }
+    return COS_FALSE;
+}
+
+int cos_is_download_checkpoint_valid(cos_pool_t *pool, cos_checkpoint_t *checkpoint, cos_string_t *file_path,
+                                     cos_string_t *object, int64_t object_size, cos_string_t *last_modified,
+                                     cos_string_t *etag)
+{
+    return cos_is_object_checkpoint_valid(pool, checkpoint, COS_CP_DOWNLOAD, file_path, object, object_size, 
+                                          last_modified, etag);
+}
+
+void cos_build_copy_checkpoint(cos_pool_t *pool, cos_checkpoint_t *checkpoint, cos_string_t *dest,
+                               cos_string_t *copy_source, int64_t object_size, cos_string_t *last_modified,
+                               cos_string_t *etag, cos_string_t *upload_id, int64_t part_size)
+{
+    cos_build_object_checkpoint(pool, checkpoint, COS_CP_COPY, dest, copy_source, object_size, 
+                                last_modified, etag, part_size);
+    cos_str_set(&checkpoint->upload_id, cos_pstrdup(pool, upload_id));
+}
+
+int cos_is_copy_checkpoint_valid(cos_pool_t *pool, cos_checkpoint_t *checkpoint, cos_string_t *dest,
+                                 cos_string_t *copy_source, int64_t object_size, cos_string_t *last_modified,
+                                 cos_string_t *etag)
+{
+    return cos_is_object_checkpoint_valid(pool, checkpoint, COS_CP_COPY, dest, copy_source, object_size, 
+                                          last_modified, etag) && checkpoint->upload_id.len > 0;
+}
+
+int cos_verify_download_checkpoint_parts(cos_pool_t *pool, cos_checkpoint_t *checkpoint, const char *filepath)
+{
+    apr_status_t s;
+    apr_file_t *thefile;
+    apr_off_t offset;
+    apr_size_t nbytes;
+    int64_t bytes_left;
+    uint64_t crc64;
+    char buff[64 * 1024];
+    int invalid = 0;
+    int i = 0;
+
+    s = apr_file_open(&thefile, filepath, APR_READ, APR_UREAD | APR_GREAD, pool);
+    if (s != APR_SUCCESS) {
+        return -1;
+    }
+
+    for (; i < checkpoint->part_num; i++) {
+        if (!checkpoint->parts[i].completed || !checkpoint->parts[i].has_crc64) {
+            continue;
+        }
+
+        crc64 = 0;
+        offset = checkpoint->parts[i].offset;
+        s = apr_file_seek(thefile, APR_SET, &offset);
+        for (bytes_left = checkpoint->parts[i].size; s == APR_SUCCESS && bytes_left > 0; bytes_left -= nbytes) {
+            nbytes = (apr_size_t)cos_min((int64_t)sizeof(buff), bytes_left);
+            s = apr_file_read_full(thefile, buff, nbytes, &nbytes);
+            crc64 = cos_crc64(crc64, buff, nbytes);
+        }
+
+        // a part lost or torn on the local disk is downloaded again
+        if (s != APR_SUCCESS || crc64 != checkpoint->parts[i].crc64) {
+            cos_warn_log("part %d of %s is broken, download it again.", checkpoint->parts[i].index + 1, filepath);
+            checkpoint->parts[i].completed = COS_FALSE;
+            checkpoint->parts[i].has_crc64 = COS_FALSE;
+            invalid++;
+        }
+    }
+    apr_file_close(thefile);
+
+    return invalid;
+}
+
+void cos_update_checkpoint(cos_pool_t *pool, cos_checkpoint_t *checkpoint, int32_t part_index, cos_string_t *etag) 
+{
+    char *p = NULL;
+    checkpoint->parts[part_index].completed = COS_TRUE;
+    p = apr_pstrdup(pool, etag->data);
+    cos_str_set(&checkpoint->parts[part_index].etag, p);
+}
+
+void cos_update_checkpoint_crc64(cos_checkpoint_t *checkpoint, const cos_checkpoint_part_t *part)
+{
+    checkpoint->parts[part->index].crc64 = part->crc64;
+    checkpoint->parts[part->index].has_crc64 = part->has_crc64;
+}
+
+int cos_get_parts_crc64(const cos_checkpoint_part_t *parts, int part_num, uint64_t *crc64)
+{
+    int i = 0;
+    uint64_t crc = 0;
+    for (; i < part_num; i++) {
+        if (!parts[i].has_crc64) {
+            return COS_FALSE;
+        }
+        crc = cos_crc64_combine(crc, parts[i].crc64, parts[i].size);
+    }
+    *crc64 = crc;
+    return COS_TRUE;
+}
+
+void cos_check_parts_crc64_consistent(cos_request_options_t *options,
+                                      const cos_string_t *bucket,
+                                      const cos_string_t *object,
+                                      const cos_checkpoint_part_t *parts,
+                                      int part_num,
+                                      cos_table_t *complete_resp_headers,
+                                      cos_status_t *s)
+{
+    uint64_t crc64 = 0;
+    cos_status_t *head_s = NULL;
+    cos_table_t *head_resp_headers = NULL;
+
+    if (!is_enable_crc(options) || !cos_status_is_ok(s)) {
+        return;
+    }
+    if (!cos_get_parts_crc64(parts, part_num, &crc64)) {
+        cos_warn_log("crc64 of some parts is unknown, skip crc64 check of object %s.", object->data);
+        return;
+    }
+
+    // complete may not carry the crc64 of the object, ask for it by head
+    if (NULL == complete_resp_headers || NULL == apr_table_get(complete_resp_headers, COS_HASH_CRC64_ECMA)) {
+        head_s = cos_head_object(options, bucket, object, NULL, &head_resp_headers);
+        if (!cos_status_is_ok(head_s) || NULL == apr_table_get(head_resp_headers, COS_HASH_CRC64_ECMA)) {
+            cos_warn_log("crc64 of object %s is unavailable, skip crc64 check.", object->data);
+            return;
+        }
+        complete_resp_headers = head_resp_headers;
+    }
+
+    if (COSE_OK != cos_check_crc_consistent(crc64, complete_resp_headers, s)) {
+        cos_error_log("crc64 of object %s is inconsistent with its parts, local:%" APR_UINT64_T_FMT ", remote:%s.",
+            object->data, crc64, apr_table_get(complete_resp_headers, COS_HASH_CRC64_ECMA));
+    }
+}
+
+void cos_get_checkpoint_undo_parts(cos_checkpoint_t *checkpoint, int *part_num, cos_checkpoint_part_t *parts)
+{
+    int i = 0;
+    int idx = 0;
+    for (; i < checkpoint->part_num; i++) {
+        if (!checkpoint->parts[i].completed) {
+            parts[idx].index = checkpoint->parts[i].index;
+            parts[idx].offset = checkpoint->parts[i].offset;
+            parts[idx].size = checkpoint->parts[i].size;
+            parts[idx].completed = checkpoint->parts[i].completed;
+            parts[idx].crc64 = 0;
+            parts[idx].has_crc64 = COS_FALSE;
+            idx++;
+        }
+    }
+    *part_num = idx;
+}
+
+static cos_status_t *cos_upload_prefetched_part(cos_upload_thread_params_t *params, int part_num,
+                                               cos_table_t **resp_headers)
+{
+    cos_status_t *s = NULL;
+    cos_prefetch_slot_t *slot;
+    cos_list_t buffer;
+    cos_buf_t *content;
+
+    slot = cos_wait_prefetched_part(params->prefetcher, params->part);
+    if (NULL == slot) {
+        return NULL;
+    }
+    if (slot->res != COSE_OK) {
+        s = cos_status_create(params->options.pool);
+        cos_file_error_status_set(s, slot->res);
+        return s;
+    }
+
+    do {
+        cos_list_init(&buffer);
+        content = cos_buf_pack(params->options.pool, slot->data, (int)slot->len);
+        cos_list_add_tail(&content->node, &buffer);
+        s = cos_upload_part_from_read_ahead(&params->options, params->bucket, params->object, params->upload_id,
+            part_num, &buffer, slot->content_md5[0] == '\0' ? NULL : slot->content_md5, slot->crc64, resp_headers);
+    } while (!cos_status_is_ok(s) && cos_retry_part_task(params, s));
+
+    return s;
+}
+
+void * APR_THREAD_FUNC upload_part(apr_thread_t *thd, void *data) 
+{
+    cos_status_t *s = NULL;
+    cos_upload_thread_params_t *params = NULL;
+    cos_upload_file_t *upload_file = NULL;
+    cos_table_t *resp_headers = NULL;
+    const char *crc64;
+    const char *etag;
+    int part_num;
+    
+    params = (cos_upload_thread_params_t *)data;
+    if (apr_atomic_read32(params->failed) > 0 || cos_is_canceled(params->options.ctl)) {
+        apr_queue_push(params->finished_parts, params->result);
+        return NULL;
+    }
+
+    part_num = params->part->index + 1;
+    if (NULL != params->prefetcher) {
+        s = cos_upload_prefetched_part(params, part_num, &resp_headers);
+        if (NULL == s) {
+            // the pipeline is stopped by a failure
+            apr_queue_push(params->finished_parts, params->result);
+            return NULL;
+        }
+        cos_release_prefetched_part(params->prefetcher, params->part);
+    } else {
+        upload_file = cos_create_upload_file(params->options.pool);
+        cos_str_set(&upload_file->filename, params->filepath->data);
+        upload_file->file_pos = params->part->offset;
+        upload_file->file_last = params->part->offset + params->part->size;
+
+        do {
+            s = cos_upload_part_from_file(&params->options, params->bucket, params->object, params->upload_id,
+                part_num, upload_file, &resp_headers);
+        } while (!cos_status_is_ok(s) && cos_retry_part_task(params, s));
+    }
+    params->result->s = s;
+    if (!cos_status_is_ok(s)) {
+        apr_atomic_inc32(params->failed);
+        apr_queue_push(params->finished_parts, params->result);
+        return s;
+    }
+
+    etag = apr_table_get(resp_headers, "ETag");
+    if (NULL != etag) {
+        cos_str_set(&params->result->etag, apr_pstrdup(params->options.pool, etag));
+    }
+    crc64 = apr_table_get(resp_headers, COS_HASH_CRC64_ECMA);
+    if (NULL != crc64) {
+        params->part->crc64 = cos_atoui64(crc64);
+        params->part->has_crc64 = COS_TRUE;
+    }
+    apr_queue_push(params->finished_parts, params->result);
+    return NULL;
+}
+
+// the parts in flight are tuned by throughput and errors if auto_tune is set
+static cos_status_t *cos_do_resumable_upload_file_without_cp(cos_request_options_t *options,
+                                                             cos_string_t *bucket, 
+                                                             cos_string_t *object, 
+                                                             cos_string_t *filepath,                           
+                                                             cos_table_t *headers,
+                                                             cos_table_t *params,
+                                                             int32_t thread_num,
+                                                             int64_t part_size,
+                                                             int auto_tune,
+                                                             apr_finfo_t *finfo,
+                                                             cos_progress_callback progress_callback,
+                                                             cos_table_t **resp_headers,
+                                                             cos_list_t *resp_body) 
+{
+    cos_pool_t *subpool = NULL;
+    cos_pool_t *parent_pool = NULL;
+    cos_status_t *s = NULL;
+    cos_list_t completed_part_list;
+    cos_complete_part_content_t *complete_content = NULL;
+    cos_string_t upload_id;
+    cos_checkpoint_part_t *parts;
+    cos_part_tasks_t tasks;
+    cos_table_t *cb_headers = NULL;
+    cos_table_t *complete_resp_headers = NULL;
+    char *part_num_str;
+    int part_num = 0;
+    int i = 0;
+
+    // prepare
+    parent_pool = options->pool;
     part_num = cos_get_part_num(finfo->size, part_size);
     parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * part_num);
     cos_build_parts(finfo->size, part_size, parts);
-    results = (cos_part_task_result_t *)cos_palloc(parent_pool, sizeof(cos_part_task_result_t) * part_num);
-    thr_params = (cos_upload_thread_params_t *)cos_palloc(parent_pool, sizeof(cos_upload_thread_params_t) * part_num);
-    cos_build_thread_params(thr_params, part_num, parent_pool, options, bucket, object, filepath, &upload_id, parts, results);
     
     // init upload
     cos_pool_create(&subpool, parent_pool);
     options->pool = subpool;
-    s = cos_init_multipart_upload(options, bucket, object, &upload_id, headers, resp_headers);
+    s = cos_init_multipart_upload(options, bucket, object, &upload_id, headers, resp_headers);
+    if (!cos_status_is_ok(s)) {
+        s = cos_status_dup(parent_pool, s);
+        cos_pool_destroy(subpool);
+        options->pool = parent_pool;
+        return s;
+    }
+    cos_str_set(&upload_id, apr_pstrdup(parent_pool, upload_id.data));
+    options->pool = parent_pool;
+    cos_pool_destroy(subpool);
+
+    // upload parts
+    cos_init_part_tasks(&tasks, upload_part, bucket, object, parts, part_num, thread_num);
+    tasks.upload_id = &upload_id;
+    tasks.filepath = filepath;
+    tasks.total_size = finfo->size;
+    tasks.progress_callback = progress_callback;
+    tasks.auto_tune = auto_tune;
+    if (cos_is_pipelined_upload(options, part_size)) {
+        tasks.prefetcher = cos_create_part_prefetcher(options, parent_pool, filepath, parts, part_num, thread_num);
+    }
+    s = cos_run_part_tasks(options, &tasks);
+    cos_destroy_part_prefetcher(tasks.prefetcher);
+    if (NULL != s) {
+        return s;
+    }
+
+    // successful
+    cos_pool_create(&subpool, parent_pool);
+    cos_list_init(&completed_part_list);
+    for (i = 0; i < part_num; i++) {
+        complete_content = cos_create_complete_part_content(subpool);
+        part_num_str = apr_psprintf(subpool, "%d", parts[i].index + 1);
+        cos_str_set(&complete_content->part_number, part_num_str);
+        cos_str_set(&complete_content->etag, parts[i].etag.data);
+        cos_list_add_tail(&complete_content->node, &completed_part_list);
+    }
+
+    // complete upload
+    options->pool = subpool;
+    if (NULL != headers && NULL != apr_table_get(headers, COS_CALLBACK)) {
+        cb_headers = cos_table_make(subpool, 2);
+        apr_table_set(cb_headers, COS_CALLBACK, apr_table_get(headers, COS_CALLBACK));
+        if (NULL != apr_table_get(headers, COS_CALLBACK_VAR)) {
+            apr_table_set(cb_headers, COS_CALLBACK_VAR, apr_table_get(headers, COS_CALLBACK_VAR));
+        }
+    }
+    s = cos_do_complete_multipart_upload(options, bucket, object, &upload_id, 
+        &completed_part_list, cb_headers, NULL, &complete_resp_headers, resp_body);
+    cos_check_parts_crc64_consistent(options, bucket, object, parts, part_num, complete_resp_headers, s);
+    if (NULL != resp_headers) {
+        *resp_headers = complete_resp_headers;
+    }
+    s = cos_status_dup(parent_pool, s);
+    cos_pool_destroy(subpool);
+    options->pool = parent_pool;
+
+    return s;
+}
+
+static int cos_checkpoint_part_done(cos_pool_t *pool, void *data, cos_checkpoint_part_t *part)
+{
+    cos_checkpoint_t *checkpoint = (cos_checkpoint_t *)data;
+
+    cos_update_checkpoint(pool, checkpoint, part->index, &part->etag);
+    cos_update_checkpoint_crc64(checkpoint, part);
+    return cos_append_checkpoint_part(pool, checkpoint, &checkpoint->parts[part->index]);
+}
+
+// the parts in flight are tuned by throughput and errors if auto_tune is set
+static cos_status_t *cos_do_resumable_upload_file_with_cp(cos_request_options_t *options,
+                                                          cos_string_t *bucket, 
+                                                          cos_string_t *object, 
+                                                          cos_string_t *filepath,                           
+                                                          cos_table_t *headers,
+                                                          cos_table_t *params,
+                                                          int32_t thread_num,
+                                                          int64_t part_size,
+                                                          int auto_tune,
+                                                          cos_string_t *checkpoint_path,
+                                                          apr_finfo_t *finfo,
+                                                          cos_progress_callback progress_callback,
+                                                          cos_table_t **resp_headers,
+                                                          cos_list_t *resp_body) 
+{
+    cos_pool_t *subpool = NULL;
+    cos_pool_t *parent_pool = NULL;
+    cos_status_t *s = NULL;
+    cos_status_t *ret = NULL;
+    cos_list_t completed_part_list;
+    cos_complete_part_content_t *complete_content = NULL;
+    cos_string_t upload_id;
+    cos_checkpoint_part_t *parts;
+    cos_part_tasks_t tasks;
+    cos_table_t *cb_headers = NULL;
+    cos_table_t *complete_resp_headers = NULL;
+    cos_checkpoint_t *checkpoint = NULL;
+    int need_init_upload = COS_TRUE;
+    char *part_num_str;
+    int part_num = 0;
+    int i = 0;
+    int rv;
+
+    // checkpoint
+    parent_pool = options->pool;
+    ret = cos_status_create(parent_pool);
+    checkpoint = cos_create_checkpoint_content(parent_pool);
+    if(cos_does_file_exist(checkpoint_path, parent_pool)) {
+        if (COSE_OK == cos_load_checkpoint(parent_pool, checkpoint_path, checkpoint) && 
+            cos_is_upload_checkpoint_valid(parent_pool, checkpoint, finfo)) {
+                cos_str_set(&upload_id, checkpoint->upload_id.data);
+                need_init_upload = COS_FALSE;
+        } else {
+            apr_file_remove(checkpoint_path->data, parent_pool);
+        }
+    }
+
+    if (need_init_upload) {
+        // init upload 
+        cos_pool_create(&subpool, parent_pool);
+        options->pool = subpool;
+        s = cos_init_multipart_upload(options, bucket, object, &upload_id, headers, resp_headers);
+        if (!cos_status_is_ok(s)) {
+            s = cos_status_dup(parent_pool, s);
+            cos_pool_destroy(subpool);
+            options->pool = parent_pool;
+            return s;
+        }
+        cos_str_set(&upload_id, apr_pstrdup(parent_pool, upload_id.data));
+        options->pool = parent_pool;
+        cos_pool_destroy(subpool);
+
+        // build checkpoint
+        cos_build_upload_checkpoint(parent_pool, checkpoint, filepath, finfo, &upload_id, part_size);
+    }
+
+    rv = cos_open_checkpoint_file(parent_pool, checkpoint_path, checkpoint);
+    if (rv != APR_SUCCESS) {
+        cos_status_set(ret, rv, COS_OPEN_FILE_ERROR_CODE, NULL);
+        return ret;
+    }
+    // a fresh snapshot, parts are appended to it and a torn tail left by the last run is dropped
+    rv = cos_dump_checkpoint(parent_pool, checkpoint);
+    if (rv != COSE_OK) {
+        cos_close_checkpoint_file(checkpoint);
+        cos_file_error_status_set(ret, rv);
+        return ret;
+    }
+
+    // prepare
+    parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * (checkpoint->part_num));
+    cos_get_checkpoint_undo_parts(checkpoint, &part_num, parts);
+
+    // upload parts, the checkpoint is dumped when every part completes
+    cos_init_part_tasks(&tasks, upload_part, bucket, object, parts, part_num, thread_num);
+    tasks.upload_id = &upload_id;
+    tasks.filepath = filepath;
+    tasks.total_size = finfo->size;
+    tasks.progress_callback = progress_callback;
+    tasks.done_callback = cos_checkpoint_part_done;
+    tasks.done_data = checkpoint;
+    tasks.auto_tune = auto_tune;
+    if (cos_is_pipelined_upload(options, checkpoint->part_size)) {
+        tasks.prefetcher = cos_create_part_prefetcher(options, parent_pool, filepath, parts, part_num, thread_num);
+    }
+    s = cos_run_part_tasks(options, &tasks);
+    cos_destroy_part_prefetcher(tasks.prefetcher);
+    cos_close_checkpoint_file(checkpoint);
+    if (NULL != s) {
+        return s;
+    }
+    
+    // successful
+    cos_pool_create(&subpool, parent_pool);
+    cos_list_init(&completed_part_list);
+    for (i = 0; i < checkpoint->part_num; i++) {
+        complete_content = cos_create_complete_part_content(subpool);
+        part_num_str = apr_psprintf(subpool, "%d", checkpoint->parts[i].index + 1);
+        cos_str_set(&complete_content->part_number, part_num_str);
+        cos_str_set(&complete_content->etag, checkpoint->parts[i].etag.data);
+        cos_list_add_tail(&complete_content->node, &completed_part_list);
+    }
+
+    // complete upload
+    options->pool = subpool;
+    if (NULL != headers && NULL != apr_table_get(headers, COS_CALLBACK)) {
+        cb_headers = cos_table_make(subpool, 2);
+        apr_table_set(cb_headers, COS_CALLBACK, apr_table_get(headers, COS_CALLBACK));
+        if (NULL != apr_table_get(headers, COS_CALLBACK_VAR)) {
+            apr_table_set(cb_headers, COS_CALLBACK_VAR, apr_table_get(headers, COS_CALLBACK_VAR));
+        }
+    }
+    s = cos_do_complete_multipart_upload(options, bucket, object, &upload_id, 
+        &completed_part_list, cb_headers, NULL, &complete_resp_headers, resp_body);
+    cos_check_parts_crc64_consistent(options, bucket, object, checkpoint->parts, checkpoint->part_num, complete_resp_headers, s);
+    if (NULL != resp_headers) {
+        *resp_headers = complete_resp_headers;
+    }
+    s = cos_status_dup(parent_pool, s);
+    cos_pool_destroy(subpool);
+    options->pool = parent_pool;
+
+    // remove chepoint file
+    apr_file_remove(checkpoint_path->data, parent_pool);
+    
+    return s;
+}
+
+cos_status_t *cos_resumable_upload_file_without_cp(cos_request_options_t *options,
+                                                   cos_string_t *bucket, 
+                                                   cos_string_t *object, 
+                                                   cos_string_t *filepath,                           
+                                                   cos_table_t *headers,
+                                                   cos_table_t *params,
+                                                   int32_t thread_num,
+                                                   int64_t part_size,
+                                                   apr_finfo_t *finfo,
+                                                   cos_progress_callback progress_callback,
+                                                   cos_table_t **resp_headers,
+                                                   cos_list_t *resp_body) 
+{
+    return cos_do_resumable_upload_file_without_cp(options, bucket, object, filepath, headers, params, thread_num,
+        part_size, COS_FALSE, finfo, progress_callback, resp_headers, resp_body);
+}
+
+cos_status_t *cos_resumable_upload_file_with_cp(cos_request_options_t *options,
+                                                cos_string_t *bucket, 
+                                                cos_string_t *object, 
+                                                cos_string_t *filepath,                           
+                                                cos_table_t *headers,
+                                                cos_table_t *params,
+                                                int32_t thread_num,
+                                                int64_t part_size,
+                                                cos_string_t *checkpoint_path,
+                                                apr_finfo_t *finfo,
+                                                cos_progress_callback progress_callback,
+                                                cos_table_t **resp_headers,
+                                                cos_list_t *resp_body) 
+{
+    return cos_do_resumable_upload_file_with_cp(options, bucket, object, filepath, headers, params, thread_num,
+        part_size, COS_FALSE, checkpoint_path, finfo, progress_callback, resp_headers, resp_body);
+}
+
+cos_status_t *cos_resumable_upload_file(cos_request_options_t *options,
+                                        cos_string_t *bucket, 
+                                        cos_string_t *object, 
+                                        cos_string_t *filepath,                           
+                                        cos_table_t *headers,
+                                        cos_table_t *params,
+                                        cos_resumable_clt_params_t *clt_params, 
+                                        cos_progress_callback progress_callback,
+                                        cos_table_t **resp_headers,
+                                        cos_list_t *resp_body) 
+{
+    int32_t thread_num = 0;
+    int64_t part_size = 0;
+    int auto_tune = COS_FALSE;
+    cos_string_t checkpoint_path;
+    cos_pool_t *sub_pool;
+    apr_finfo_t finfo;
+    cos_status_t *s;
+    int res;
+
+    thread_num = cos_get_thread_num(clt_params);
+
+    cos_pool_create(&sub_pool, options->pool);
+    res = cos_get_file_info(filepath, sub_pool, &finfo);
+    if (res != COSE_OK) {
+        cos_error_log("Open read file fail, filename:%s\n", filepath->data);
+        s = cos_status_create(options->pool);
+        cos_file_error_status_set(s, res);
+        cos_pool_destroy(sub_pool);
+        return s;
+    }
+    part_size = clt_params->part_size;
+    if (NULL != clt_params && clt_params->auto_tune) {
+        auto_tune = COS_TRUE;
+        if (clt_params->thread_num <= 0) {
+            thread_num = COS_AUTO_MAX_THREAD_NUM;
+        }
+        if (part_size <= 0) {
+            part_size = cos_get_auto_part_size(finfo.size, thread_num);
+        }
+        cos_info_log("auto tune, file size = %" APR_INT64_T_FMT ", part size = %" APR_INT64_T_FMT 
+                     ", max concurrency = %d.", (int64_t)finfo.size, part_size, thread_num);
+    }
+    cos_get_part_size(finfo.size, &part_size);
+
+    if (NULL != clt_params && clt_params->enable_checkpoint) {
+        cos_get_checkpoint_path(clt_params, filepath, sub_pool, &checkpoint_path);
+        s = cos_do_resumable_upload_file_with_cp(options, bucket, object, filepath, headers, params, thread_num, 
+            part_size, auto_tune, &checkpoint_path, &finfo, progress_callback, resp_headers, resp_body);
+    } else {
+        s = cos_do_resumable_upload_file_without_cp(options, bucket, object, filepath, headers, params, thread_num, 
+            part_size, auto_tune, &finfo, progress_callback, resp_headers, resp_body);
+    }
+
+    cos_pool_destroy(sub_pool);
+    return s;
+}
+
+cos_status_t *cos_upload_file_mt(cos_request_options_t *options,
+                                 const cos_string_t *bucket, 
+                                 const cos_string_t *object, 
+                                 cos_string_t *upload_id,
+                                 cos_string_t *filepath, 
+                                 int64_t part_size,
+                                 int32_t thread_num,
+                                 cos_table_t *headers,
+                                 cos_progress_callback progress_callback)
+{
+    cos_pool_t *subpool = NULL;
+    cos_pool_t *parent_pool = NULL;
+    cos_status_t *s = NULL;
+    cos_list_t completed_part_list;
+    cos_complete_part_content_t *complete_content = NULL;
+    cos_checkpoint_part_t *parts;
+    cos_checkpoint_part_t *undo_parts;
+    cos_part_index_t *index = NULL;
+    cos_part_tasks_t tasks;
+    cos_table_t *complete_resp_headers = NULL;
+    apr_finfo_t finfo;
+    char *part_num_str;
+    int part_num = 0;
+    int undo_part_num = 0;
+    int i = 0;
+    int res;
+
+    parent_pool = options->pool;
+    s = cos_status_create(parent_pool);
+    if (thread_num <= 0 || thread_num > 1024) {
+        thread_num = 1;
+    }
+    res = cos_get_file_info(filepath, parent_pool, &finfo);
+    if (res != COSE_OK) {
+        cos_file_error_status_set(s, res);
+        return s;
+    }
+    cos_get_part_size(finfo.size, &part_size);
+    part_num = cos_get_part_num(finfo.size, part_size);
+    parts = (cos_checkpoint_part_t *)cos_pcalloc(parent_pool, sizeof(cos_checkpoint_part_t) * (part_num + 1));
+    cos_build_parts(finfo.size, part_size, parts);
+
+    //get upload_id and uploaded part
+    if (NULL == upload_id->data) {
+        cos_table_t *init_multipart_headers = cos_table_make(parent_pool, 0);
+        cos_table_t *init_multipart_resp_headers = NULL;
+        s = cos_init_multipart_upload(options, bucket, object, 
+                upload_id, init_multipart_headers, &init_multipart_resp_headers);
+        if (!cos_status_is_ok(s)) {
+            return s;
+        }
+    } else {
+        // a part uploaded with another part size is uploaded again
+        index = cos_create_part_index(parent_pool, COS_MAX_PART_NUM);
+        s = cos_build_uploaded_part_index(options, bucket, object, upload_id, index);
+        if (!cos_status_is_ok(s)) {
+            return s;
+        }
+        for (i = 0; i < part_num; i++) {
+            if (cos_part_index_has(index, i + 1) && index->sizes[i] == parts[i].size) {
+                parts[i].completed = COS_TRUE;
+                cos_str_set(&parts[i].etag, index->etags[i]);
+            }
+        }
+    }
+
+    // upload the missing parts only
+    undo_parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * (part_num + 1));
+    for (i = 0; i < part_num; i++) {
+        if (!parts[i].completed) {
+            undo_parts[undo_part_num++] = parts[i];
+        }
+    }
+    cos_init_part_tasks(&tasks, upload_part, (cos_string_t *)bucket, (cos_string_t *)object, 
+                        undo_parts, undo_part_num, thread_num);
+    tasks.upload_id = upload_id;
+    tasks.filepath = filepath;
+    tasks.total_size = finfo.size;
+    tasks.progress_callback = progress_callback;
+    if (cos_is_pipelined_upload(options, part_size)) {
+        tasks.prefetcher = cos_create_part_prefetcher(options, parent_pool, filepath, undo_parts, undo_part_num, 
+                                                      thread_num);
+    }
+    s = cos_run_part_tasks(options, &tasks);
+    cos_destroy_part_prefetcher(tasks.prefetcher);
+    if (NULL != s) {
+        return s;
+    }
+    for (i = 0; i < undo_part_num; i++) {
+        parts[undo_parts[i].index].etag = undo_parts[i].etag;
+    }
+
+    //complete multipart, the parts are in order
+    cos_pool_create(&subpool, parent_pool);
+    cos_list_init(&completed_part_list);
+    for (i = 0; i < part_num; i++) {
+        complete_content = cos_create_complete_part_content(subpool);
+        part_num_str = apr_psprintf(subpool, "%d", parts[i].index + 1);
+        cos_str_set(&complete_content->part_number, part_num_str);
+        cos_str_set(&complete_content->etag, parts[i].etag.data);
+        cos_list_add_tail(&complete_content->node, &completed_part_list);
+    }
+    options->pool = subpool;
+    headers = cos_table_create_if_null(options, headers, 0);
+    s = cos_complete_multipart_upload(options, bucket, object, upload_id,
+            &completed_part_list, headers, &complete_resp_headers);
+    s = cos_status_dup(parent_pool, s);
+    cos_pool_destroy(subpool);
+    options->pool = parent_pool;
+
+    return s;
+}
+
+void * APR_THREAD_FUNC upload_part_copy(apr_thread_t *thd, void *data) 
+{
+    cos_status_t *s = NULL;
+    cos_upload_copy_thread_params_t *params = NULL;
+    cos_upload_part_copy_params_t *upload_part_copy_params = NULL;
+    cos_table_t *resp_headers = NULL;
+    
+    params = (cos_upload_copy_thread_params_t *)data;
+    if (apr_atomic_read32(params->failed) > 0 || cos_is_canceled(params->options.ctl)) {
+        apr_queue_push(params->finished_parts, params->result);
+        return NULL;
+    }
+
+    upload_part_copy_params = cos_create_upload_part_copy_params(params->options.pool);
+    cos_str_set(&upload_part_copy_params->copy_source, params->copy_source->data);
+    cos_str_set(&upload_part_copy_params->dest_bucket, params->bucket->data);
+    cos_str_set(&upload_part_copy_params->dest_object, params->object->data);
+    cos_str_set(&upload_part_copy_params->upload_id, params->upload_id->data);
+    upload_part_copy_params->range_start = params->part->offset;
+    upload_part_copy_params->range_end = params->part->offset + params->part->size - 1;
+    upload_part_copy_params->part_num = params->part->index + 1;
+
+    do {
+        s = cos_upload_part_copy(&params->options, upload_part_copy_params, NULL, &resp_headers);
+    } while (!cos_status_is_ok(s) && cos_retry_part_task(params, s));
+    params->result->s = s;
+    if (!cos_status_is_ok(s)) {
+        apr_atomic_inc32(params->failed);
+        apr_queue_push(params->finished_parts, params->result);
+        return s;
+    }
+
+    if (NULL != upload_part_copy_params->rsp_content->etag.data) {
+        cos_str_set(&params->result->etag, upload_part_copy_params->rsp_content->etag.data);
+    }
+    apr_queue_push(params->finished_parts, params->result);
+    return NULL;
+}
+
+static cos_status_t *cos_head_copy_source(cos_request_options_t *options,
+                                          cos_string_t *src_bucket,
+                                          cos_string_t *src_object,
+                                          cos_string_t *src_endpoint,
+                                          int64_t *total_size,
+                                          cos_string_t *etag,
+                                          cos_string_t *last_modified)
+{
+    cos_pool_t *subpool = NULL;
+    cos_pool_t *parent_pool = NULL;
+    cos_status_t *s = NULL;
+    cos_status_t *ret = NULL;
+    cos_table_t *head_resp_headers = NULL;
+    cos_request_options_t *head_options = NULL;
+    const char *value = NULL;
+
+    parent_pool = options->pool;
+    cos_pool_create(&subpool, parent_pool);
+
+    // the source may be in another region
+    head_options = cos_request_options_create(subpool);
+    head_options->config = cos_config_create(subpool);
+    cos_str_set(&head_options->config->endpoint, src_endpoint->data);
+    cos_str_set(&head_options->config->access_key_id, options->config->access_key_id.data);
+    cos_str_set(&head_options->config->access_key_secret, options->config->access_key_secret.data);
+    cos_str_set(&head_options->config->appid, "");
+    head_options->ctl = cos_http_controller_create(subpool, 0);
+    s = cos_head_object(head_options, src_bucket, src_object, NULL, &head_resp_headers);
+    ret = cos_status_dup(parent_pool, s);
+    if (!cos_status_is_ok(s)) {
+        cos_pool_destroy(subpool);
+        return ret;
+    }
+
+    value = apr_table_get(head_resp_headers, COS_CONTENT_LENGTH);
+    if (NULL == value) {
+        cos_status_set(ret, COSE_INVALID_ARGUMENT, COS_LACK_OF_CONTENT_LEN_ERROR_CODE, NULL);
+        cos_pool_destroy(subpool);
+        return ret;
+    }
+    *total_size = cos_atoi64(value);
+    if (NULL != etag) {
+        value = apr_table_get(head_resp_headers, "ETag");
+        cos_str_set(etag, apr_pstrdup(parent_pool, NULL == value ? "" : value));
+    }
+    if (NULL != last_modified) {
+        value = apr_table_get(head_resp_headers, "Last-Modified");
+        cos_str_set(last_modified, apr_pstrdup(parent_pool, NULL == value ? "" : value));
+    }
+    cos_pool_destroy(subpool);
+
+    return ret;
+}
+
+static char *cos_get_copy_source(cos_pool_t *pool, cos_string_t *src_bucket, cos_string_t *src_object, 
+                                 cos_string_t *src_endpoint)
+{
+    return apr_psprintf(pool, "%.*s.%.*s/%.*s", 
+                        src_bucket->len, src_bucket->data,
+                        src_endpoint->len, src_endpoint->data,
+                        src_object->len, src_object->data);
+}
+
+static void cos_abort_part_copy(cos_request_options_t *options, cos_string_t *dest_bucket, 
+                                cos_string_t *dest_object, cos_string_t *upload_id)
+{
+    cos_pool_t *subpool = NULL;
+    cos_pool_t *parent_pool = NULL;
+    cos_status_t *s = NULL;
+    cos_table_t *resp_headers = NULL;
+
+    parent_pool = options->pool;
+    cos_pool_create(&subpool, parent_pool);
+    options->pool = subpool;
+    s = cos_abort_multipart_upload(options, dest_bucket, dest_object, upload_id, &resp_headers);
+    if (!cos_status_is_ok(s)) {
+        cos_warn_log("abort upload %s of %s failure, code:%d.", upload_id->data, dest_object->data, s->code);
+    }
+    cos_pool_destroy(subpool);
+    options->pool = parent_pool;
+}
+
+static cos_status_t *cos_complete_part_copy(cos_request_options_t *options, cos_string_t *dest_bucket, 
+                                            cos_string_t *dest_object, cos_string_t *upload_id,
+                                            cos_checkpoint_part_t *parts, int part_num)
+{
+    cos_pool_t *subpool = NULL;
+    cos_pool_t *parent_pool = NULL;
+    cos_status_t *s = NULL;
+    cos_list_t completed_part_list;
+    cos_complete_part_content_t *complete_content = NULL;
+    char *part_num_str = NULL;
+    int i = 0;
+
+    parent_pool = options->pool;
+    cos_pool_create(&subpool, parent_pool);
+    cos_list_init(&completed_part_list);
+    for (i = 0; i < part_num; i++) {
+        complete_content = cos_create_complete_part_content(subpool);
+        part_num_str = apr_psprintf(subpool, "%d", parts[i].index + 1);
+        cos_str_set(&complete_content->part_number, part_num_str);
+        cos_str_set(&complete_content->etag, parts[i].etag.data);
+        cos_list_add_tail(&complete_content->node, &completed_part_list);
+    }
+
+    // complete upload
+    options->pool = subpool;
+    s = cos_do_complete_multipart_upload(options, dest_bucket, dest_object, upload_id, 
+        &completed_part_list, NULL, NULL, NULL, NULL);
+    s = cos_status_dup(parent_pool, s);
+    cos_pool_destroy(subpool);
+    options->pool = parent_pool;
+
+    return s;
+}
+
+cos_status_t *cos_upload_object_by_part_copy_mt
+(
+        cos_request_options_t *options,
+        cos_string_t *src_bucket,
+        cos_string_t *src_object,
+        cos_string_t *src_endpoint,
+        cos_string_t *dest_bucket, 
+        cos_string_t *dest_object,
+        int64_t part_size,
+        int32_t thread_num,
+        cos_progress_callback progress_callback
+)
+{
+    cos_pool_t *subpool = NULL;
+    cos_pool_t *parent_pool = NULL;
+    cos_status_t *s = NULL;
+    int64_t total_size = 0;
+    int part_num = 0;
+    cos_string_t upload_id;
+    cos_checkpoint_part_t *parts;
+    cos_part_tasks_t tasks;
+    cos_string_t copy_source;
+
+    parent_pool = options->pool;
+    if (thread_num <= 0 || thread_num > 1024) {
+        thread_num = 1;
+    }
+    cos_str_set(&copy_source, cos_get_copy_source(parent_pool, src_bucket, src_object, src_endpoint));
+
+    //get object size
+    s = cos_head_copy_source(options, src_bucket, src_object, src_endpoint, &total_size, NULL, NULL);
+    if (!cos_status_is_ok(s)) {
+        return s;
+    }
+
+    // prepare
+    cos_get_part_size(total_size, &part_size);
+    part_num = cos_get_part_num(total_size, part_size);
+    parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * part_num);
+    cos_build_parts(total_size, part_size, parts);
+
+    // init upload
+    cos_pool_create(&subpool, parent_pool);
+    options->pool = subpool;
+    cos_table_t *init_multipart_headers = NULL;
+    cos_table_t *init_multipart_resp_headers = NULL;
+    s = cos_init_multipart_upload(options, dest_bucket, dest_object, &upload_id, init_multipart_headers, &init_multipart_resp_headers);
     if (!cos_status_is_ok(s)) {
         s = cos_status_dup(parent_pool, s);
         cos_pool_destroy(subpool);
         options->pool = parent_pool;
-        return s;
+        return s;
+    }
+    cos_str_set(&upload_id, apr_pstrdup(parent_pool, upload_id.data));
+    options->pool = parent_pool;
+    cos_pool_destroy(subpool);
+
+    // upload parts, failed parts are retried before giving up
+    cos_init_part_tasks(&tasks, upload_part_copy, dest_bucket, dest_object, parts, part_num, thread_num);
+    tasks.upload_id = &upload_id;
+    tasks.copy_source = &copy_source;
+    tasks.total_size = total_size;
+    tasks.progress_callback = progress_callback;
+    s = cos_run_part_tasks(options, &tasks);
+    if (NULL == s) {
+        s = cos_complete_part_copy(options, dest_bucket, dest_object, &upload_id, parts, part_num);
+    }
+
+    // nothing can resume the upload, never leave it behind
+    if (!cos_status_is_ok(s)) {
+        cos_abort_part_copy(options, dest_bucket, dest_object, &upload_id);
+    }
+
+    return s;
+}
+
+cos_status_t *cos_upload_object_by_part_copy_mt_with_cp
+(
+        cos_request_options_t *options,
+        cos_string_t *src_bucket,
+        cos_string_t *src_object,
+        cos_string_t *src_endpoint,
+        cos_string_t *dest_bucket, 
+        cos_string_t *dest_object,
+        int64_t part_size,
+        int32_t thread_num,
+        cos_string_t *checkpoint_path,
+        cos_progress_callback progress_callback
+)
+{
+    cos_pool_t *subpool = NULL;
+    cos_pool_t *parent_pool = NULL;
+    cos_status_t *s = NULL;
+    cos_status_t *ret = NULL;
+    cos_checkpoint_t *checkpoint = NULL;
+    cos_checkpoint_part_t *parts;
+    cos_part_index_t *index = NULL;
+    cos_part_tasks_t tasks;
+    cos_string_t copy_source;
+    cos_string_t dest;
+    cos_string_t upload_id;
+    cos_string_t etag;
+    cos_string_t last_modified;
+    int64_t total_size = 0;
+    int need_init_upload = COS_TRUE;
+    int part_num = 0;
+    int i = 0;
+    int rv;
+
+    parent_pool = options->pool;
+    ret = cos_status_create(parent_pool);
+    if (thread_num <= 0 || thread_num > 1024) {
+        thread_num = 1;
+    }
+    cos_str_set(&copy_source, cos_get_copy_source(parent_pool, src_bucket, src_object, src_endpoint));
+    cos_str_set(&dest, apr_psprintf(parent_pool, "%.*s/%.*s", dest_bucket->len, dest_bucket->data,
+                                    dest_object->len, dest_object->data));
+
+    // the source is copied again from the beginning if it is changed
+    s = cos_head_copy_source(options, src_bucket, src_object, src_endpoint, &total_size, &etag, &last_modified);
+    if (!cos_status_is_ok(s)) {
+        return s;
+    }
+    cos_get_part_size(total_size, &part_size);
+
+    // checkpoint, the upload must be alive and the parts completed must be in it
+    checkpoint = cos_create_checkpoint_content(parent_pool);
+    if (cos_does_file_exist(checkpoint_path, parent_pool)) {
+        if (COSE_OK == cos_load_checkpoint(parent_pool, checkpoint_path, checkpoint) && 
+            cos_is_copy_checkpoint_valid(parent_pool, checkpoint, &dest, &copy_source, total_size, 
+                                         &last_modified, &etag)) {
+            index = cos_create_part_index(parent_pool, COS_MAX_PART_NUM);
+            s = cos_build_uploaded_part_index(options, dest_bucket, dest_object, &checkpoint->upload_id, index);
+            if (cos_status_is_ok(s)) {
+                for (i = 0; i < checkpoint->part_num; i++) {
+                    if (checkpoint->parts[i].completed && (!cos_part_index_has(index, i + 1) || 
+                        index->sizes[i] != checkpoint->parts[i].size)) {
+                        checkpoint->parts[i].completed = COS_FALSE;
+                    }
+                }
+                cos_str_set(&upload_id, checkpoint->upload_id.data);
+                need_init_upload = COS_FALSE;
+            } else if (s->code != 404) {
+                // the upload may be alive, the checkpoint is kept for the next run
+                return s;
+            }
+        } else if (checkpoint->upload_id.len > 0 && (checkpoint->cp_type == COS_CP_COPY)) {
+            // the upload of a stale checkpoint can not be resumed any more
+            cos_abort_part_copy(options, dest_bucket, dest_object, &checkpoint->upload_id);
+        }
+        if (need_init_upload) {
+            apr_file_remove(checkpoint_path->data, parent_pool);
+        }
+    }
+
+    if (need_init_upload) {
+        // init upload
+        cos_pool_create(&subpool, parent_pool);
+        options->pool = subpool;
+        s = cos_init_multipart_upload(options, dest_bucket, dest_object, &upload_id, NULL, NULL);
+        if (!cos_status_is_ok(s)) {
+            s = cos_status_dup(parent_pool, s);
+            cos_pool_destroy(subpool);
+            options->pool = parent_pool;
+            return s;
+        }
+        cos_str_set(&upload_id, apr_pstrdup(parent_pool, upload_id.data));
+        options->pool = parent_pool;
+        cos_pool_destroy(subpool);
+
+        // build checkpoint
+        checkpoint = cos_create_checkpoint_content(parent_pool);
+        cos_build_copy_checkpoint(parent_pool, checkpoint, &dest, &copy_source, total_size, 
+                                  &last_modified, &etag, &upload_id, part_size);
     }
-    cos_str_set(&upload_id, apr_pstrdup(parent_pool, upload_id.data));
-    options->pool = parent_pool;
-    cos_pool_destroy(subpool);
 
-    // upload parts    
-    rv = apr_thread_pool_create(&thrp, 0, thread_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL); 
+    rv = cos_open_checkpoint_file(parent_pool, checkpoint_path, checkpoint);
+    if (rv != APR_SUCCESS) {
+        cos_status_set(ret, rv, COS_OPEN_FILE_ERROR_CODE, NULL);
         return ret;
     }
-
-    rv = apr_queue_create(&failed_parts, part_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL); 
+    // a fresh snapshot, parts are appended to it and a torn tail left by the last run is dropped
+    rv = cos_dump_checkpoint(parent_pool, checkpoint);
+    if (rv != COSE_OK) {
+        cos_close_checkpoint_file(checkpoint);
+        cos_file_error_status_set(ret, rv);
         return ret;
     }
 
-    rv = apr_queue_create(&completed_parts, part_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL); 
-        return ret;
+    // copy the undone parts, the upload and the checkpoint are kept on failure to resume
+    parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * (checkpoint->part_num + 1));
+    cos_get_checkpoint_undo_parts(checkpoint, &part_num, parts);
+    cos_init_part_tasks(&tasks, upload_part_copy, dest_bucket, dest_object, parts, part_num, thread_num);
+    tasks.upload_id = &upload_id;
+    tasks.copy_source = &copy_source;
+    tasks.total_size = total_size;
+    tasks.progress_callback = progress_callback;
+    tasks.done_callback = cos_checkpoint_part_done;
+    tasks.done_data = checkpoint;
+    s = cos_run_part_tasks(options, &tasks);
+    cos_close_checkpoint_file(checkpoint);
+    if (NULL != s) {
+        return s;
     }
 
-    // launch
-    cos_set_task_tracker(thr_params, part_num, &launched, &failed, &completed, failed_parts, completed_parts);
-    for (i = 0; i < part_num; i++) {
-        apr_thread_pool_push(thrp, upload_part, thr_params + i, 0, NULL);
+    s = cos_complete_part_copy(options, dest_bucket, dest_object, &upload_id, checkpoint->parts, checkpoint->part_num);
+    if (cos_status_is_ok(s)) {
+        apr_file_remove(checkpoint_path->data, parent_pool);
     }
 
-    // wait until all tasks exit
-    total_num = apr_atomic_read32(&launched) + apr_atomic_read32(&failed) + apr_atomic_read32(&completed);
-    for ( ; total_num < (apr_uint32_t)part_num; ) {
-        rv = apr_queue_trypop(completed_parts, &task_result);
-        if (rv == APR_EINTR || rv == APR_EAGAIN) {
-            apr_sleep(1000);
-        } else if(rv == APR_EOF) {
-            break;
-        } else if(rv == APR_SUCCESS) {
-            task_res = (cos_part_task_result_t*)task_result;
-            if (NULL != progress_callback) {
-                consume_bytes += task_res->part->size;
-                progress_callback(consume_bytes, finfo->size);
-            }
-        }
-        total_num = apr_atomic_read32(&launched) + apr_atomic_read32(&failed) + apr_atomic_read32(&completed);
+    return s;
+}
+
+void * APR_THREAD_FUNC download_part(apr_thread_t *thd, void *data) 
+{
+    cos_status_t *s = NULL;
+    cos_upload_thread_params_t *params = NULL;
+    cos_upload_file_t *download_file = NULL;
+    cos_table_t *resp_headers = NULL;
+    const char *etag;
+    char *range_buffer = NULL;
+    int part_num;
+    
+    params = (cos_upload_thread_params_t *)data;
+    if (apr_atomic_read32(params->failed) > 0 || cos_is_canceled(params->options.ctl)) {
+        apr_queue_push(params->finished_parts, params->result);
+        return NULL;
     }
 
-    // deal with left successful parts
-    while(APR_SUCCESS == apr_queue_trypop(completed_parts, &task_result)) {
-        task_res = (cos_part_task_result_t*)task_result;
-        if (NULL != progress_callback) {
-            consume_bytes += task_res->part->size;
-            progress_callback(consume_bytes, finfo->size);
-        }
+    part_num = params->part->index + 1;
+    download_file = cos_create_upload_file(params->options.pool);
+    cos_str_set(&download_file->filename, params->filepath->data);
+    download_file->file_pos = params->part->offset;
+    download_file->file_last = params->part->offset + params->part->size;
+
+    if (NULL != params->buffer) {
+        // a part never crosses the end of the ring, the ring is a multiple of the part size
+        range_buffer = params->buffer + (params->buffer_size > 0 ? 
+            params->part->offset % params->buffer_size : params->part->offset);
     }
 
-    // failed
-    if (apr_atomic_read32(&failed) > 0) {
-        apr_queue_pop(failed_parts, &task_result);
-        task_res = (cos_part_task_result_t*)task_result;
-        s = cos_status_dup(parent_pool, task_res->s);
-        cos_destroy_thread_pool(thr_params, part_num);
+    do {
+        if (NULL != range_buffer) {
+            s = cos_download_part_to_buffer(&params->options, params->bucket, params->object, download_file, 
+                                            range_buffer, &resp_headers);
+        } else {
+            s = cos_download_part_to_shared_file(&params->options, params->bucket, params->object, download_file, 
+                                                 params->file, &resp_headers);
+        }
+    } while (!cos_status_is_ok(s) && cos_retry_part_task(params, s));
+    params->result->s = s;
+    if (!cos_status_is_ok(s)) {
+        apr_atomic_inc32(params->failed);
+        apr_queue_push(params->finished_parts, params->result);
         return s;
     }
 
-    // successful
-    cos_pool_create(&subpool, parent_pool);
-    cos_list_init(&completed_part_list);
-    for (i = 0; i < part_num; i++) {
-        complete_content = cos_create_complete_part_content(subpool);
-        part_num_str = apr_psprintf(subpool, "%d", thr_params[i].part->index + 1);
-        cos_str_set(&complete_content->part_number, part_num_str);
-        etag = apr_pstrdup(subpool, thr_params[i].result->etag.data);
-        cos_str_set(&complete_content->etag, etag);
-        cos_list_add_tail(&complete_content->node, &completed_part_list);
+    cos_warn_log("download part = %d, start byte = %"APR_INT64_T_FMT", end byte = %"APR_INT64_T_FMT, part_num, download_file->file_pos, download_file->file_last-1);
+
+    etag = apr_table_get(resp_headers, "ETag");
+    if (NULL != etag) {
+        cos_str_set(&params->result->etag, apr_pstrdup(params->options.pool, etag));
     }
-    cos_destroy_thread_pool(thr_params, part_num);
+    params->part->crc64 = download_file->crc64;
+    params->part->has_crc64 = download_file->has_crc64;
+    apr_queue_push(params->finished_parts, params->result);
+    return NULL;
+}
 
-    // complete upload
+int64_t cos_get_safe_size_for_download(int64_t part_size)
+{
+    if (part_size < 4*1024*1024) return 4*1024*1024;
+    else if (part_size > 20*1024*1024) return 20*1024*1024;
+    else return part_size;
+}
+
+cos_status_t *cos_resumable_download_file_without_cp(cos_request_options_t *options,
+                                                   cos_string_t *bucket, 
+                                                   cos_string_t *object, 
+                                                   cos_string_t *filepath,                           
+                                                   cos_table_t *headers,
+                                                   cos_table_t *params,
+                                                   int32_t thread_num,
+                                                   int64_t part_size,
+                                                   cos_progress_callback progress_callback) 
+{
+    cos_pool_t *subpool = NULL;
+    cos_pool_t *parent_pool = NULL;
+    cos_status_t *s = NULL;
+    cos_status_t *ret = NULL;
+    cos_checkpoint_part_t *parts;
+    cos_part_tasks_t tasks;
+    cos_string_t write_path;
+    apr_file_t *file = NULL;
+    int part_num = 0;
+    const char *value = NULL;
+    int64_t file_size = 0;
+    cos_table_t *resp_headers = NULL;
+    int res;
+
+    // prepare
+    parent_pool = options->pool;
+    ret = cos_status_create(parent_pool);
+    // get object file size
+    cos_pool_create(&subpool, parent_pool);
     options->pool = subpool;
-    if (NULL != headers && NULL != apr_table_get(headers, COS_CALLBACK)) {
-        cb_headers = cos_table_make(subpool, 2);
-        apr_table_set(cb_headers, COS_CALLBACK, apr_table_get(headers, COS_CALLBACK));
-        if (NULL != apr_table_get(headers, COS_CALLBACK_VAR)) {
-            apr_table_set(cb_headers, COS_CALLBACK_VAR, apr_table_get(headers, COS_CALLBACK_VAR));
-        }
+    s = cos_head_object(options, bucket, object, NULL, &resp_headers);
+    if (!cos_status_is_ok(s)) {
+        s = cos_status_dup(parent_pool, s);
+        cos_pool_destroy(subpool);
+        options->pool = parent_pool;
+        return s;
     }
-    s = cos_do_complete_multipart_upload(options, bucket, object, &upload_id, 
-        &completed_part_list, cb_headers, NULL, resp_headers, resp_body);
-    s = cos_status_dup(parent_pool, s);
+    value = apr_table_get(resp_headers, COS_CONTENT_LENGTH);
+    if (NULL == value) {
+        cos_status_set(ret, COSE_INVALID_ARGUMENT, COS_LACK_OF_CONTENT_LEN_ERROR_CODE, NULL);
+        cos_pool_destroy(subpool);
+        options->pool = parent_pool;
+        return ret;
+    }
+    file_size = cos_atoi64(value);
     cos_pool_destroy(subpool);
     options->pool = parent_pool;
+    // init download params
+    part_size = cos_get_safe_size_for_download(part_size);
+    part_num = cos_get_part_num(file_size, part_size);
+    parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * part_num);
+    cos_build_parts(file_size, part_size, parts);
+
+    // one preallocated file shared by parts, optionally a temporary one renamed on success
+    write_path = *filepath;
+    if (options->ctl->options->download_temp_file) {
+        cos_get_temporary_file_name(parent_pool, filepath, &write_path);
+    }
+    res = cos_open_file_for_shared_write(parent_pool, write_path.data, file_size, &file);
+    if (res != COSE_OK) {
+        cos_file_error_status_set(ret, res);
+        return ret;
+    }
+    
+    // download parts
+    cos_init_part_tasks(&tasks, download_part, bucket, object, parts, part_num, thread_num);
+    tasks.filepath = &write_path;
+    tasks.file = file;
+    tasks.total_size = file_size;
+    tasks.progress_callback = progress_callback;
+    s = cos_run_part_tasks(options, &tasks);
+    apr_file_close(file);
+    if (write_path.data != filepath->data) {
+        if (NULL != s) {
+            apr_file_remove(write_path.data, parent_pool);
+        } else if (apr_file_rename(write_path.data, filepath->data, parent_pool) != APR_SUCCESS) {
+            apr_file_remove(write_path.data, parent_pool);
+            cos_status_set(ret, COSE_FILE_WRITE_ERROR, COS_WRITE_FILE_ERROR_CODE, NULL);
+            return ret;
+        }
+    }
+    if (NULL != s) {
+        return s;
+    }
 
+    // successful
+    s = cos_status_create(options->pool);
     return s;
 }
 
-cos_status_t *cos_resumable_upload_file_with_cp(cos_request_options_t *options,
-                                                cos_string_t *bucket, 
-                                                cos_string_t *object, 
-                                                cos_string_t *filepath,                           
-                                                cos_table_t *headers,
-                                                cos_table_t *params,
-                                                int32_t thread_num,
-                                                int64_t part_size,
-                                                cos_string_t *checkpoint_path,
-                                                apr_finfo_t *finfo,
-                                                cos_progress_callback progress_callback,
-                                                cos_table_t **resp_headers,
-                                                cos_list_t *resp_body) 
+/*
+ * get the size and the crc64 header of the object to download, crc_headers is NULL
+ * if the object has no crc64
+ * @return NULL success, otherwise the status of failure in options->pool
+ */
+static cos_status_t *cos_head_download_object(cos_request_options_t *options,
+                                              cos_string_t *bucket, 
+                                              cos_string_t *object,
+                                              int64_t *object_size,
+                                              cos_table_t **crc_headers)
 {
     cos_pool_t *subpool = NULL;
+    cos_pool_t *parent_pool = options->pool;
+    cos_status_t *s = NULL;
+    cos_table_t *resp_headers = NULL;
+    const char *value = NULL;
+
+    cos_pool_create(&subpool, parent_pool);
+    options->pool = subpool;
+    s = cos_head_object(options, bucket, object, NULL, &resp_headers);
+    if (!cos_status_is_ok(s)) {
+        s = cos_status_dup(parent_pool, s);
+        goto done;
+    }
+    value = apr_table_get(resp_headers, COS_CONTENT_LENGTH);
+    if (NULL == value) {
+        s = cos_status_create(parent_pool);
+        cos_status_set(s, COSE_INVALID_ARGUMENT, COS_LACK_OF_CONTENT_LEN_ERROR_CODE, NULL);
+        goto done;
+    }
+    *object_size = cos_atoi64(value);
+    *crc_headers = NULL;
+    value = apr_table_get(resp_headers, COS_HASH_CRC64_ECMA);
+    if (NULL != value) {
+        *crc_headers = cos_table_make(parent_pool, 1);
+        apr_table_set(*crc_headers, COS_HASH_CRC64_ECMA, value);
+    }
+    s = NULL;
+
+done:
+    cos_pool_destroy(subpool);
+    options->pool = parent_pool;
+    return s;
+}
+
+cos_status_t *cos_download_object_to_buffer_mt(cos_request_options_t *options,
+                                               cos_string_t *bucket, 
+                                               cos_string_t *object, 
+                                               int64_t part_size,
+                                               int32_t thread_num,
+                                               char **buffer,
+                                               int64_t *buffer_len,
+                                               cos_progress_callback progress_callback)
+{
     cos_pool_t *parent_pool = NULL;
     cos_status_t *s = NULL;
     cos_status_t *ret = NULL;
-    cos_list_t completed_part_list;
-    cos_complete_part_content_t *complete_content = NULL;
-    cos_string_t upload_id;
     cos_checkpoint_part_t *parts;
-    cos_part_task_result_t *results;
-    cos_part_task_result_t *task_res;
-    cos_upload_thread_params_t *thr_params;
-    cos_table_t *cb_headers = NULL;
-    apr_thread_pool_t *thrp;
-    apr_uint32_t launched = 0;
-    apr_uint32_t failed = 0;
-    apr_uint32_t completed = 0;
-    apr_uint32_t total_num = 0;
-    apr_queue_t *failed_parts;
-    apr_queue_t *completed_parts;
-    cos_checkpoint_t *checkpoint = NULL;
-    int need_init_upload = COS_TRUE;
-    int has_left_result = COS_FALSE;
-    int64_t consume_bytes = 0;
-    void *task_result;
-    char *part_num_str;
+    cos_part_tasks_t tasks;
+    cos_string_t filepath;
+    cos_table_t *crc_headers = NULL;
+    char *memory = NULL;
+    int64_t object_size = 0;
+    uint64_t crc64 = 0;
     int part_num = 0;
-    int i = 0;
-    int rv;
 
-    // checkpoint
+    // get object size and crc64
     parent_pool = options->pool;
     ret = cos_status_create(parent_pool);
-    checkpoint = cos_create_checkpoint_content(parent_pool);
-    if(cos_does_file_exist(checkpoint_path, parent_pool)) {
-        if (COSE_OK == cos_load_checkpoint(parent_pool, checkpoint_path, checkpoint) && 
-            cos_is_upload_checkpoint_valid(parent_pool, checkpoint, finfo)) {
-                cos_str_set(&upload_id, checkpoint->upload_id.data);
-                need_init_upload = COS_FALSE;
-        } else {
-            apr_file_remove(checkpoint_path->data, parent_pool);
+    if (thread_num <= 0 || thread_num > 1024) {
+        thread_num = 1;
+    }
+    s = cos_head_download_object(options, bucket, object, &object_size, &crc_headers);
+    if (NULL != s) {
+        return s;
+    }
+
+    // one contiguous memory, parts write their ranges of it directly
+    if (NULL != *buffer) {
+        if (*buffer_len < object_size) {
+            cos_status_set(ret, COSE_INVALID_ARGUMENT, COS_CLIENT_ERROR_CODE, "Buffer is smaller than object");
+            return ret;
+        }
+        memory = *buffer;
+    } else {
+        memory = (char *)cos_palloc(parent_pool, (apr_size_t)cos_max(object_size, 1));
+        if (NULL == memory) {
+            cos_status_set(ret, COSE_OVER_MEMORY, COS_CLIENT_ERROR_CODE, NULL);
+            return ret;
         }
     }
 
-    if (need_init_upload) {
-        // init upload 
-        cos_pool_create(&subpool, parent_pool);
-        options->pool = subpool;
-        s = cos_init_multipart_upload(options, bucket, object, &upload_id, headers, resp_headers);
-        if (!cos_status_is_ok(s)) {
-            s = cos_status_dup(parent_pool, s);
-            cos_pool_destroy(subpool);
-            options->pool = parent_pool;
-            return s;
+    part_size = cos_get_safe_size_for_download(part_size);
+    cos_get_part_size(object_size, &part_size);
+    part_num = cos_get_part_num(object_size, part_size);
+    parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * cos_max(part_num, 1));
+    cos_build_parts(object_size, part_size, parts);
+
+    // download parts, filepath is only for log
+    cos_str_set(&filepath, "<memory>");
+    cos_init_part_tasks(&tasks, download_part, bucket, object, parts, part_num, thread_num);
+    tasks.filepath = &filepath;
+    tasks.buffer = memory;
+    tasks.total_size = object_size;
+    tasks.progress_callback = progress_callback;
+    s = cos_run_part_tasks(options, &tasks);
+    if (NULL != s) {
+        return s;
+    }
+
+    // the parts make up the object, their crc64 must combine to the one of the object
+    s = cos_status_create(parent_pool);
+    if (is_enable_crc(options) && NULL != crc_headers && 
+        cos_get_parts_crc64(parts, part_num, &crc64) &&
+        COSE_OK != cos_check_crc_consistent(crc64, crc_headers, s)) {
+        cos_error_log("crc64 of object %s is inconsistent with its parts, local:%" APR_UINT64_T_FMT ", remote:%s.",
+            object->data, crc64, apr_table_get(crc_headers, COS_HASH_CRC64_ECMA));
+        return s;
+    }
+
+    *buffer = memory;
+    *buffer_len = object_size;
+    return s;
+}
+
+typedef struct {
+    cos_checkpoint_part_t *parts;
+    int part_num;
+    int next_part;            // the first part not delivered to sink
+    char *ring;
+    int64_t ring_size;
+    cos_download_sink_callback sink;
+    void *sink_data;
+} cos_download_sink_t;
+
+// the parts complete out of order, deliver the ones following the delivered parts
+static int cos_deliver_sink_parts(cos_pool_t *pool, void *data, cos_checkpoint_part_t *part)
+{
+    cos_download_sink_t *sink = (cos_download_sink_t *)data;
+    cos_checkpoint_part_t *next;
+    int res;
+
+    while (sink->next_part < sink->part_num && sink->parts[sink->next_part].completed) {
+        next = sink->parts + sink->next_part;
+        res = sink->sink(sink->sink_data, sink->ring + next->offset % sink->ring_size, next->size);
+        if (res != COSE_OK) {
+            cos_error_log("sink failure, part = %d, code = %d.", next->index + 1, res);
+            return res;
         }
-        cos_str_set(&upload_id, apr_pstrdup(parent_pool, upload_id.data));
-        options->pool = parent_pool;
-        cos_pool_destroy(subpool);
+        sink->next_part++;
+    }
+
+    return COSE_OK;
+}
+
+cos_status_t *cos_download_object_to_sink_mt(cos_request_options_t *options,
+                                             cos_string_t *bucket, 
+                                             cos_string_t *object, 
+                                             int64_t part_size,
+                                             int32_t thread_num,
+                                             cos_download_sink_callback sink_callback,
+                                             void *sink_data,
+                                             cos_progress_callback progress_callback)
+{
+    cos_pool_t *parent_pool = NULL;
+    cos_status_t *s = NULL;
+    cos_checkpoint_part_t *parts;
+    cos_part_tasks_t tasks;
+    cos_download_sink_t sink;
+    cos_string_t filepath;
+    cos_table_t *crc_headers = NULL;
+    int64_t object_size = 0;
+    uint64_t crc64 = 0;
+    int ring_parts = 0;
+    int part_num = 0;
+
+    // get object size and crc64
+    parent_pool = options->pool;
+    if (thread_num <= 0 || thread_num > 1024) {
+        thread_num = 1;
+    }
+    s = cos_head_download_object(options, bucket, object, &object_size, &crc_headers);
+    if (NULL != s) {
+        return s;
+    }
 
-        // build checkpoint
-        cos_build_upload_checkpoint(parent_pool, checkpoint, filepath, finfo, &upload_id, part_size);
+    part_size = cos_get_safe_size_for_download(part_size);
+    cos_get_part_size(object_size, &part_size);
+    part_num = cos_get_part_num(object_size, part_size);
+    parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * cos_max(part_num, 1));
+    cos_build_parts(object_size, part_size, parts);
+
+    // the parts in flight and the completed ones waiting for the slow parts before them
+    // share a ring, no part is launched until the part a ring ahead of it is delivered
+    ring_parts = cos_max(cos_min(part_num, thread_num + COS_PREFETCH_PART_NUM), 1);
+    memset(&sink, 0, sizeof(sink));
+    sink.parts = parts;
+    sink.part_num = part_num;
+    sink.ring_size = part_size * ring_parts;
+    sink.ring = (char *)cos_palloc(parent_pool, (apr_size_t)sink.ring_size);
+    sink.sink = sink_callback;
+    sink.sink_data = sink_data;
+    if (NULL == sink.ring) {
+        s = cos_status_create(parent_pool);
+        cos_status_set(s, COSE_OVER_MEMORY, COS_CLIENT_ERROR_CODE, NULL);
+        return s;
     }
 
-    rv = cos_open_checkpoint_file(parent_pool, checkpoint_path, checkpoint);
-    if (rv != APR_SUCCESS) {
-        cos_status_set(ret, rv, COS_OPEN_FILE_ERROR_CODE, NULL);
-        return ret;
+    // download parts, filepath is only for log, the sink is called in this thread
+    // so a slow consumer holds back the launch of parts
+    cos_str_set(&filepath, "<sink>");
+    cos_init_part_tasks(&tasks, download_part, bucket, object, parts, part_num, thread_num);
+    tasks.filepath = &filepath;
+    tasks.buffer = sink.ring;
+    tasks.buffer_size = sink.ring_size;
+    tasks.max_parts_ahead = ring_parts;
+    tasks.total_size = object_size;
+    tasks.progress_callback = progress_callback;
+    tasks.done_callback = cos_deliver_sink_parts;
+    tasks.done_data = &sink;
+    s = cos_run_part_tasks(options, &tasks);
+    if (NULL != s) {
+        return s;
+    }
+
+    // the content is delivered already, a mismatch tells the consumer to discard it
+    s = cos_status_create(parent_pool);
+    if (is_enable_crc(options) && NULL != crc_headers && 
+        cos_get_parts_crc64(parts, part_num, &crc64) &&
+        COSE_OK != cos_check_crc_consistent(crc64, crc_headers, s)) {
+        cos_error_log("crc64 of object %s is inconsistent with its parts, local:%" APR_UINT64_T_FMT ", remote:%s.",
+            object->data, crc64, apr_table_get(crc_headers, COS_HASH_CRC64_ECMA));
+        return s;
     }
 
+    return s;
+}
+
+cos_status_t *cos_resumable_download_file_with_cp(cos_request_options_t *options,
+                                                cos_string_t *bucket, 
+                                                cos_string_t *object, 
+                                                cos_string_t *filepath,                           
+                                                cos_table_t *headers,
+                                                cos_table_t *params,
+                                                int32_t thread_num,
+                                                int64_t part_size,
+                                                cos_string_t *checkpoint_path,
+                                                cos_progress_callback progress_callback) 
+{
+    cos_pool_t *subpool = NULL;
+    cos_pool_t *parent_pool = NULL;
+    cos_status_t *s = NULL;
+    cos_status_t *ret = NULL;
+    cos_checkpoint_part_t *parts;
+    cos_checkpoint_t *checkpoint = NULL;
+    cos_part_tasks_t tasks;
+    cos_string_t write_path;
+    cos_string_t etag;
+    cos_string_t last_modified;
+    cos_table_t *resp_headers = NULL;
+    cos_table_t *crc_headers = NULL;
+    apr_file_t *file = NULL;
+    apr_finfo_t finfo;
+    const char *value = NULL;
+    int64_t file_size = 0;
+    uint64_t crc64 = 0;
+    int need_rebuild = COS_TRUE;
+    int part_num = 0;
+    int res;
+
     // prepare
+    parent_pool = options->pool;
     ret = cos_status_create(parent_pool);
-    parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * (checkpoint->part_num));
-    cos_get_checkpoint_undo_parts(checkpoint, &part_num, parts);
-    results = (cos_part_task_result_t *)cos_palloc(parent_pool, sizeof(cos_part_task_result_t) * part_num);
-    thr_params = (cos_upload_thread_params_t *)cos_palloc(parent_pool, sizeof(cos_upload_thread_params_t) * part_num);
-    cos_build_thread_params(thr_params, part_num, parent_pool, options, bucket, object, filepath, &upload_id, parts, results);
-
-    // upload parts    
-    rv = apr_thread_pool_create(&thrp, 0, thread_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL); 
-        return ret;
+    // get object file size, etag and last modified time
+    cos_pool_create(&subpool, parent_pool);
+    options->pool = subpool;
+    s = cos_head_object(options, bucket, object, NULL, &resp_headers);
+    if (!cos_status_is_ok(s)) {
+        s = cos_status_dup(parent_pool, s);
+        cos_pool_destroy(subpool);
+        options->pool = parent_pool;
+        return s;
     }
-
-    rv = apr_queue_create(&failed_parts, part_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL); 
+    value = apr_table_get(resp_headers, COS_CONTENT_LENGTH);
+    if (NULL == value) {
+        cos_status_set(ret, COSE_INVALID_ARGUMENT, COS_LACK_OF_CONTENT_LEN_ERROR_CODE, NULL);
+        cos_pool_destroy(subpool);
+        options->pool = parent_pool;
         return ret;
     }
-
-    rv = apr_queue_create(&completed_parts, part_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL); 
-        return ret;
+    file_size = cos_atoi64(value);
+    value = apr_table_get(resp_headers, "ETag");
+    cos_str_set(&etag, apr_pstrdup(parent_pool, NULL == value ? "" : value));
+    value = apr_table_get(resp_headers, "Last-Modified");
+    cos_str_set(&last_modified, apr_pstrdup(parent_pool, NULL == value ? "" : value));
+    value = apr_table_get(resp_headers, COS_HASH_CRC64_ECMA);
+    if (NULL != value) {
+        crc_headers = cos_table_make(parent_pool, 1);
+        apr_table_set(crc_headers, COS_HASH_CRC64_ECMA, value);
     }
+    cos_pool_destroy(subpool);
+    options->pool = parent_pool;
 
-    // launch
-    cos_set_task_tracker(thr_params, part_num, &launched, &failed, &completed, failed_parts, completed_parts);
-    for (i = 0; i < part_num; i++) {
-        apr_thread_pool_push(thrp, upload_part, thr_params + i, 0, NULL);
-    }
+    part_size = cos_get_safe_size_for_download(part_size);
+    cos_get_part_size(file_size, &part_size);
+    // parts are written to a temporary file kept between runs, renamed on success
+    cos_get_temporary_file_name(parent_pool, filepath, &write_path);
 
-    // wait until all tasks exit
-    total_num = apr_atomic_read32(&launched) + apr_atomic_read32(&failed) + apr_atomic_read32(&completed);
-    for ( ; total_num < (apr_uint32_t)part_num; ) {
-        rv = apr_queue_trypop(completed_parts, &task_result);
-        if (rv == APR_EINTR || rv == APR_EAGAIN) {
-            apr_sleep(1000);
-        } else if(rv == APR_EOF) {
-            break;
-        } else if(rv == APR_SUCCESS) {
-            task_res = (cos_part_task_result_t*)task_result;
-            cos_update_checkpoint(parent_pool, checkpoint, task_res->part->index, &task_res->etag);
-            rv = cos_dump_checkpoint(parent_pool, checkpoint);
-            if (rv != COSE_OK) {
-                int idx = task_res->part->index;
-                cos_status_set(ret, rv, COS_WRITE_FILE_ERROR_CODE, NULL);
-                apr_atomic_inc32(&failed);
-                thr_params[idx].result->s = ret;
-                apr_queue_push(failed_parts, thr_params[idx].result);
-            }
-            if (NULL != progress_callback) {
-                consume_bytes += task_res->part->size;
-                progress_callback(consume_bytes, finfo->size);
-            }
+    // checkpoint, resume only if neither the object nor the temporary file is changed
+    checkpoint = cos_create_checkpoint_content(parent_pool);
+    if (cos_does_file_exist(checkpoint_path, parent_pool)) {
+        if (COSE_OK == cos_load_checkpoint(parent_pool, checkpoint_path, checkpoint) &&
+            cos_is_download_checkpoint_valid(parent_pool, checkpoint, filepath, object, file_size, 
+                                             &last_modified, &etag) &&
+            COSE_OK == cos_get_file_info(&write_path, parent_pool, &finfo) && finfo.size == file_size &&
+            cos_verify_download_checkpoint_parts(parent_pool, checkpoint, write_path.data) >= 0 &&
+            COSE_OK == cos_open_file_for_shared_resume(parent_pool, write_path.data, file_size, &file)) {
+            need_rebuild = COS_FALSE;
+        } else {
+            apr_file_remove(checkpoint_path->data, parent_pool);
         }
-        total_num = apr_atomic_read32(&launched) + apr_atomic_read32(&failed) + apr_atomic_read32(&completed);
     }
 
-    // deal with left successful parts
-    while(APR_SUCCESS == apr_queue_trypop(completed_parts, &task_result)) {
-        task_res = (cos_part_task_result_t*)task_result;
-        cos_update_checkpoint(parent_pool, checkpoint, task_res->part->index, &task_res->etag);
-        consume_bytes += task_res->part->size;
-        has_left_result = COS_TRUE;
-    }
-    if (has_left_result) {
-        rv = cos_dump_checkpoint(parent_pool, checkpoint);
-        if (rv != COSE_OK) {
-            cos_status_set(ret, rv, COS_WRITE_FILE_ERROR_CODE, NULL);
+    if (need_rebuild) {
+        checkpoint = cos_create_checkpoint_content(parent_pool);
+        cos_build_download_checkpoint(parent_pool, checkpoint, filepath, object, file_size, 
+                                      &last_modified, &etag, part_size);
+        res = cos_open_file_for_shared_write(parent_pool, write_path.data, file_size, &file);
+        if (res != COSE_OK) {
+            cos_file_error_status_set(ret, res);
             return ret;
         }
-        if (NULL != progress_callback) {
-            progress_callback(consume_bytes, finfo->size);
-        }
     }
-    apr_file_close(checkpoint->thefile);
 
-    // failed
-    if (apr_atomic_read32(&failed) > 0) {
-        apr_queue_pop(failed_parts, &task_result);
-        task_res = (cos_part_task_result_t*)task_result;
-        s = cos_status_dup(parent_pool, task_res->s);
-        cos_destroy_thread_pool(thr_params, part_num);
+    res = cos_open_checkpoint_file(parent_pool, checkpoint_path, checkpoint);
+    if (res != APR_SUCCESS) {
+        apr_file_close(file);
+        cos_status_set(ret, res, COS_OPEN_FILE_ERROR_CODE, NULL);
+        return ret;
+    }
+    // a fresh snapshot, parts are appended to it and a torn tail left by the last run is dropped
+    res = cos_dump_checkpoint(parent_pool, checkpoint);
+    if (res != COSE_OK) {
+        apr_file_close(file);
+        cos_close_checkpoint_file(checkpoint);
+        cos_file_error_status_set(ret, res);
+        return ret;
+    }
+
+    // download the undone parts only, the checkpoint is dumped when every part completes
+    parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * (checkpoint->part_num + 1));
+    cos_get_checkpoint_undo_parts(checkpoint, &part_num, parts);
+    cos_init_part_tasks(&tasks, download_part, bucket, object, parts, part_num, thread_num);
+    tasks.filepath = &write_path;
+    tasks.file = file;
+    tasks.total_size = file_size;
+    tasks.progress_callback = progress_callback;
+    tasks.done_callback = cos_checkpoint_part_done;
+    tasks.done_data = checkpoint;
+    s = cos_run_part_tasks(options, &tasks);
+    apr_file_close(file);
+    cos_close_checkpoint_file(checkpoint);
+    if (NULL != s) {
+        // the temporary file and the checkpoint are kept for the next run
         return s;
     }
-    
-    // successful
-    cos_pool_create(&subpool, parent_pool);
-    cos_list_init(&completed_part_list);
-    for (i = 0; i < checkpoint->part_num; i++) {
-        complete_content = cos_create_complete_part_content(subpool);
-        part_num_str = apr_psprintf(subpool, "%d", checkpoint->parts[i].index + 1);
-        cos_str_set(&complete_content->part_number, part_num_str);
-        cos_str_set(&complete_content->etag, checkpoint->parts[i].etag.data);
-        cos_list_add_tail(&complete_content->node, &completed_part_list);
+
+    // the parts make up the object, their crc64 must combine to the one of the object
+    s = cos_status_create(parent_pool);
+    if (is_enable_crc(options) && NULL != crc_headers && 
+        cos_get_parts_crc64(checkpoint->parts, checkpoint->part_num, &crc64) &&
+        COSE_OK != cos_check_crc_consistent(crc64, crc_headers, s)) {
+        cos_error_log("crc64 of object %s is inconsistent with its parts, local:%" APR_UINT64_T_FMT ", remote:%s.",
+            object->data, crc64, apr_table_get(crc_headers, COS_HASH_CRC64_ECMA));
+        apr_file_remove(write_path.data, parent_pool);
+        apr_file_remove(checkpoint_path->data, parent_pool);
+        return s;
     }
-    cos_destroy_thread_pool(thr_params, part_num);
 
-    // complete upload
-    options->pool = subpool;
-    if (NULL != headers && NULL != apr_table_get(headers, COS_CALLBACK)) {
-        cb_headers = cos_table_make(subpool, 2);
-        apr_table_set(cb_headers, COS_CALLBACK, apr_table_get(headers, COS_CALLBACK));
-        if (NULL != apr_table_get(headers, COS_CALLBACK_VAR)) {
-            apr_table_set(cb_headers, COS_CALLBACK_VAR, apr_table_get(headers, COS_CALLBACK_VAR));
-        }
+    if (apr_file_rename(write_path.data, filepath->data, parent_pool) != APR_SUCCESS) {
+        cos_status_set(ret, COSE_FILE_WRITE_ERROR, COS_WRITE_FILE_ERROR_CODE, NULL);
+        return ret;
     }
-    s = cos_do_complete_multipart_upload(options, bucket, object, &upload_id, 
-        &completed_part_list, cb_headers, NULL, resp_headers, resp_body);
-    s = cos_status_dup(parent_pool, s);
-    cos_pool_destroy(subpool);
-    options->pool = parent_pool;
 
     // remove chepoint file
     apr_file_remove(checkpoint_path->data, parent_pool);
-    
+
+    s = cos_status_create(parent_pool);
     return s;
 }
 
-cos_status_t *cos_resumable_upload_file(cos_request_options_t *options,
-                                        cos_string_t *bucket, 
-                                        cos_string_t *object, 
-                                        cos_string_t *filepath,                           
-                                        cos_table_t *headers,
-                                        cos_table_t *params,
-                                        cos_resumable_clt_params_t *clt_params, 
-                                        cos_progress_callback progress_callback,
-                                        cos_table_t **resp_headers,
-                                        cos_list_t *resp_body) 
+cos_status_t *cos_resumable_download_file(cos_request_options_t *options,
+                                          cos_string_t *bucket, 
+                                          cos_string_t *object, 
+                                          cos_string_t *filepath,                           
+                                          cos_table_t *headers,
+                                          cos_table_t *params,
+                                          cos_resumable_clt_params_t *clt_params, 
+                                          cos_progress_callback progress_callback) 
 {
     int32_t thread_num = 0;
     int64_t part_size = 0;
     cos_string_t checkpoint_path;
     cos_pool_t *sub_pool;
-    apr_finfo_t finfo;
     cos_status_t *s;
-    int res;
 
     thread_num = cos_get_thread_num(clt_params);
+    part_size = NULL == clt_params ? 0 : clt_params->part_size;
 
     cos_pool_create(&sub_pool, options->pool);
-    res = cos_get_file_info(filepath, sub_pool, &finfo);
-    if (res != COSE_OK) {
-        cos_error_log("Open read file fail, filename:%s\n", filepath->data);
-        s = cos_status_create(options->pool);
-        cos_file_error_status_set(s, res);
-        cos_pool_destroy(sub_pool);
-        return s;
-    }
-    part_size = clt_params->part_size;
-    cos_get_part_size(finfo.size, &part_size);
-
     if (NULL != clt_params && clt_params->enable_checkpoint) {
         cos_get_checkpoint_path(clt_params, filepath, sub_pool, &checkpoint_path);
-        s = cos_resumable_upload_file_with_cp(options, bucket, object, filepath, headers, params, thread_num, 
-            part_size, &checkpoint_path, &finfo, progress_callback, resp_headers, resp_body);
+        s = cos_resumable_download_file_with_cp(options, bucket, object, filepath, headers, params, thread_num, 
+            part_size, &checkpoint_path, progress_callback);
     } else {
-        s = cos_resumable_upload_file_without_cp(options, bucket, object, filepath, headers, params, thread_num, 
-            part_size, &finfo, progress_callback, resp_headers, resp_body);
+        s = cos_resumable_download_file_without_cp(options, bucket, object, filepath, headers, params, thread_num, 
+            part_size, progress_callback);
     }
 
     cos_pool_destroy(sub_pool);
     return s;
 }
 
-void * APR_THREAD_FUNC upload_part_copy(apr_thread_t *thd, void *data) 
+enum {
+    COS_DIR_OP_UPLOAD,
+    COS_DIR_OP_DOWNLOAD,
+    COS_DIR_OP_COMPARE      // tell whether the local file differs from the object, sync only
+};
+
+typedef struct {
+    cos_request_options_t options;   // options.pool is owned by the task
+    cos_string_t *bucket;
+    cos_table_t *headers;
+    cos_dir_transfer_result_t *file;
+    int op;
+    cos_status_t *s;
+    apr_queue_t *finished;
+} cos_dir_file_task_t;
+
+typedef struct {
+    cos_request_options_t *options;  // ctl->options carries the transfer pool of the directory
+    cos_pool_t *pool;                // owned by the thread of large files, statuses live here
+    cos_string_t *bucket;
+    cos_table_t *headers;
+    cos_resumable_clt_params_t clt_params;
+    cos_list_t *files;
+    int64_t small_file_size;
+    int upload;
+} cos_dir_transfer_t;
+
+static int cos_is_transfer_ok(cos_status_t *s)
+{
+    // resumable transfers return 0, single requests return 2xx
+    return NULL != s && (s->code == 0 || cos_status_is_ok(s));
+}
+
+static void cos_make_parent_dir(cos_pool_t *pool, const char *path)
+{
+    const char *sep = strrchr(path, '/');
+
+    if (NULL != sep && sep != path) {
+        apr_dir_make_recursive(apr_pstrndup(pool, path, sep - path), APR_OS_DEFAULT, pool);
+    }
+}
+
+static void cos_copy_request_options(cos_pool_t *pool, const cos_request_options_t *options, 
+                                     cos_request_options_t *copy)
+{
+    copy->pool = pool;
+    copy->config = cos_config_create(pool);
+    *copy->config = *options->config;
+    copy->ctl = cos_http_controller_create(pool, 0);
+    copy->ctl->options = options->ctl->options;
+    copy->ctl->cancel = options->ctl->cancel;
+}
+
+/*
+ * the sizes are equal when it is called, the object is the same as the file if its
+ * crc64 is, the crc64 of the file is taken from the digest cache while it is unchanged
+ */
+static int cos_is_dir_file_changed(cos_dir_file_task_t *task)
 {
-    cos_status_t *s = NULL;
-    cos_upload_copy_thread_params_t *params = NULL;
     cos_table_t *resp_headers = NULL;
-    char *etag;
-    
-    params = (cos_upload_copy_thread_params_t *)data;
-    if (apr_atomic_read32(params->failed) > 0) {
-        apr_atomic_inc32(params->launched);
-        return NULL;
+    cos_status_t *s;
+    cos_digest_t digest;
+    const char *crc64;
+
+    s = cos_head_object(&task->options, task->bucket, &task->file->object, NULL, &resp_headers);
+    if (!cos_status_is_ok(s) || NULL == resp_headers) {
+        return COS_TRUE;
+    }
+    crc64 = apr_table_get(resp_headers, COS_HASH_CRC64_ECMA);
+    if (NULL == crc64) {
+        return COS_TRUE;
+    }
+    if (COSE_OK != cos_get_file_range_digest(task->options.pool, task->options.ctl->options->digest_cache, 
+                                             task->file->local_path.data, 0, task->file->size, &digest)) {
+        return COS_TRUE;
     }
 
-    cos_upload_part_copy_params_t *upload_part_copy_params = cos_create_upload_part_copy_params(params->options.pool);
-    cos_str_set(&upload_part_copy_params->copy_source, params->copy_source->data);
-    cos_str_set(&upload_part_copy_params->dest_bucket, params->bucket->data);
-    cos_str_set(&upload_part_copy_params->dest_object, params->object->data);
-    cos_str_set(&upload_part_copy_params->upload_id, params->upload_id->data);
-    upload_part_copy_params->range_start = params->part->offset;
-    upload_part_copy_params->range_end = params->part->offset + params->part->size - 1;
-    upload_part_copy_params->part_num = params->part->index + 1;
+    return digest.crc64 != cos_atoui64(crc64);
+}
 
-    s = cos_upload_part_copy(&params->options, upload_part_copy_params, NULL, &resp_headers);
-    if (!cos_status_is_ok(s)) {
-        apr_atomic_inc32(params->failed);
-        params->result->s = s;
-        apr_queue_push(params->failed_parts, params->result);
-        return s;
+static void * APR_THREAD_FUNC cos_run_dir_file_task(apr_thread_t *thd, void *data)
+{
+    cos_dir_file_task_t *task = (cos_dir_file_task_t *)data;
+    cos_table_t *headers = NULL;
+
+    if (task->op == COS_DIR_OP_UPLOAD) {
+        // the request headers are extended per request
+        headers = NULL == task->headers ? NULL : apr_table_copy(task->options.pool, task->headers);
+        task->s = cos_put_object_from_file(&task->options, task->bucket, &task->file->object, 
+                                           &task->file->local_path, headers, NULL);
+    } else if (task->op == COS_DIR_OP_DOWNLOAD) {
+        cos_make_parent_dir(task->options.pool, task->file->local_path.data);
+        task->s = cos_get_object_to_file(&task->options, task->bucket, &task->file->object, 
+                                         NULL, NULL, &task->file->local_path, NULL);
+    } else {
+        // only this task touches the file until it is popped from finished
+        task->file->action = cos_is_dir_file_changed(task) ? COS_DIR_TRANSFERRED : COS_DIR_SKIPPED;
+    }
+    apr_queue_push(task->finished, task);
+    return NULL;
+}
+
+// large files one after another, their parts run on the transfer pool with the small files
+static void * APR_THREAD_FUNC cos_transfer_dir_large_files(apr_thread_t *thd, void *data)
+{
+    cos_dir_transfer_t *dir = (cos_dir_transfer_t *)data;
+    cos_dir_transfer_result_t *file;
+    cos_request_options_t options;
+    cos_pool_t *subpool;
+    cos_table_t *headers;
+    cos_status_t *s;
+
+    cos_list_for_each_entry(cos_dir_transfer_result_t, file, dir->files, node) {
+        if (file->size <= dir->small_file_size || NULL != file->s) {
+            continue;
+        }
+        if (cos_is_canceled(dir->options->ctl)) {
+            file->s = cos_status_create(dir->pool);
+            cos_status_set(file->s, COSE_CANCELED_ERROR, COS_CANCELED_ERROR_CODE, NULL);
+            continue;
+        }
+
+        cos_pool_create(&subpool, dir->pool);
+        cos_copy_request_options(subpool, dir->options, &options);
+        if (dir->upload) {
+            headers = NULL == dir->headers ? NULL : apr_table_copy(subpool, dir->headers);
+            s = cos_resumable_upload_file(&options, dir->bucket, &file->object, &file->local_path, headers, NULL,
+                                          &dir->clt_params, NULL, NULL, NULL);
+        } else {
+            cos_make_parent_dir(subpool, file->local_path.data);
+            s = cos_resumable_download_file(&options, dir->bucket, &file->object, &file->local_path, NULL, NULL,
+                                            &dir->clt_params, NULL);
+        }
+        file->s = cos_status_dup(dir->pool, s);
+        cos_pool_destroy(subpool);
     }
 
-    etag = apr_pstrdup(params->options.pool, (char*)upload_part_copy_params->rsp_content->etag.data);
-    cos_str_set(&params->result->etag, etag);
-    apr_atomic_inc32(params->completed);
-    apr_queue_push(params->completed_parts, params->result);
     return NULL;
 }
 
-cos_status_t *cos_upload_object_by_part_copy_mt
-(
-        cos_request_options_t *options,
-        cos_string_t *src_bucket,
-        cos_string_t *src_object,
-        cos_string_t *src_endpoint,
-        cos_string_t *dest_bucket, 
-        cos_string_t *dest_object,
-        int64_t part_size,
-        int32_t thread_num,
-        cos_progress_callback progress_callback
-)
+static void cos_finish_dir_file_task(cos_pool_t *pool, cos_dir_file_task_t *task)
+{
+    task->file->s = NULL == task->s ? NULL : cos_status_dup(pool, task->s);
+    cos_pool_destroy(task->options.pool);
+}
+
+/*
+ * take the transfer pool of options, or create one of the threads of clt_params,
+ * and the queue the tasks of files report to
+ * @return NULL success, other failure
+ */
+static cos_status_t *cos_get_dir_transfer_pool(cos_request_options_t *options,
+                                               cos_resumable_clt_params_t *clt_params,
+                                               cos_transfer_pool_t **transfer_pool,
+                                               cos_transfer_pool_t **own_pool,
+                                               apr_queue_t **finished)
 {
-    cos_pool_t *subpool = NULL;
-    cos_pool_t *parent_pool = NULL;
     cos_status_t *s = NULL;
-    cos_status_t *ret = NULL;
-    char *part_num_str = NULL;
-    char *etag = NULL;
-    cos_list_t completed_part_list;
-    cos_complete_part_content_t *complete_content = NULL;
-    int64_t total_size = 0;
-    int part_num = 0;
-    cos_string_t upload_id;
-    cos_checkpoint_part_t *parts;
-    cos_part_task_result_t *results;
-    cos_part_task_result_t *task_res;
-    cos_upload_copy_thread_params_t *thr_params;
-    cos_table_t *cb_headers = NULL;
-    apr_thread_pool_t *thrp;
-    apr_uint32_t launched = 0;
-    apr_uint32_t failed = 0;
-    apr_uint32_t completed = 0;
-    apr_uint32_t total_num = 0;
-    apr_queue_t *failed_parts;
-    apr_queue_t *completed_parts;
-    int64_t consume_bytes = 0;
-    void *task_result;
-    int i = 0;
     int rv;
-    cos_string_t copy_source;
-    char *copy_source_str = NULL;
 
-    copy_source_str = apr_psprintf(options->pool, "%.*s.%.*s/%.*s", 
-                                   src_bucket->len, src_bucket->data,
-                                   src_endpoint->len, src_endpoint->data,
-                                   src_object->len, src_object->data);
-    cos_str_set(&copy_source, copy_source_str);
+    *own_pool = NULL;
+    *transfer_pool = options->ctl->options->transfer_pool;
+    if (NULL == *transfer_pool) {
+        *own_pool = cos_transfer_pool_create(options->pool, cos_get_thread_num(clt_params));
+        if (NULL == *own_pool) {
+            s = cos_status_create(options->pool);
+            cos_status_set(s, COSE_INTERNAL_ERROR, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL);
+            return s;
+        }
+        *transfer_pool = *own_pool;
+    }
+    rv = apr_queue_create(finished, (*transfer_pool)->max_threads, options->pool);
+    if (APR_SUCCESS != rv) {
+        cos_transfer_pool_destroy(*own_pool);
+        *own_pool = NULL;
+        s = cos_status_create(options->pool);
+        cos_status_set(s, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL);
+        return s;
+    }
+
+    return NULL;
+}
 
-    cos_list_init(&completed_part_list);
-    parent_pool = options->pool;
-    cos_pool_create(&subpool, options->pool);
-    options->pool = subpool;
+/*
+ * run a task for each file not larger than max_size, the tasks count as one transfer
+ * of the transfer pool, and are launched up to its share of the threads
+ */
+static void cos_run_dir_file_tasks(cos_request_options_t *options,
+                                   cos_transfer_pool_t *transfer_pool,
+                                   apr_queue_t *finished,
+                                   cos_string_t *bucket,
+                                   cos_table_t *headers,
+                                   int op,
+                                   cos_list_t *files,
+                                   int64_t max_size)
+{
+    cos_pool_t *parent_pool = options->pool;
+    cos_dir_transfer_result_t *file;
+    cos_dir_file_task_t *task;
+    cos_pool_t *task_pool;
+    void *task_result;
+    int running = 0;
+    int rv;
 
-    //get object size
-    cos_table_t *head_resp_headers = NULL;
-    cos_request_options_t *head_options = cos_request_options_create(subpool);
-    head_options->config = cos_config_create(subpool);
-    cos_str_set(&head_options->config->endpoint, src_endpoint->data);
-    cos_str_set(&head_options->config->access_key_id, options->config->access_key_id.data);
-    cos_str_set(&head_options->config->access_key_secret, options->config->access_key_secret.data);
-    cos_str_set(&head_options->config->appid, "");
-    head_options->ctl = cos_http_controller_create(subpool, 0);
-    s = cos_head_object(head_options, src_bucket, src_object, NULL, &head_resp_headers);
-    if (!cos_status_is_ok(s)) {
-        ret = cos_status_dup(parent_pool, s);
-        cos_pool_destroy(subpool);
-        options->pool = parent_pool;
-        return ret;
+    apr_atomic_inc32(&transfer_pool->transfers);
+    cos_list_for_each_entry(cos_dir_transfer_result_t, file, files, node) {
+        if (file->size > max_size || NULL != file->s) {
+            continue;
+        }
+        while (running > 0 && running >= cos_transfer_pool_get_share(transfer_pool)) {
+            rv = apr_queue_pop(finished, &task_result);
+            if (rv == APR_EINTR) {
+                continue;
+            } else if (rv != APR_SUCCESS) {
+                break;
+            }
+            cos_finish_dir_file_task(parent_pool, (cos_dir_file_task_t *)task_result);
+            running--;
+        }
+        if (cos_is_canceled(options->ctl)) {
+            file->s = cos_status_create(parent_pool);
+            cos_status_set(file->s, COSE_CANCELED_ERROR, COS_CANCELED_ERROR_CODE, NULL);
+            continue;
+        }
+
+        // the task lives in its own pool, released once its status is taken
+        cos_pool_create(&task_pool, parent_pool);
+        task = (cos_dir_file_task_t *)cos_pcalloc(task_pool, sizeof(cos_dir_file_task_t));
+        cos_copy_request_options(task_pool, options, &task->options);
+        task->bucket = bucket;
+        task->headers = headers;
+        task->file = file;
+        task->op = op;
+        task->finished = finished;
+        rv = apr_thread_pool_push(transfer_pool->thrp, cos_run_dir_file_task, task, 0, NULL);
+        if (APR_SUCCESS != rv) {
+            task->s = cos_status_create(task->options.pool);
+            cos_status_set(task->s, rv, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL);
+            cos_finish_dir_file_task(parent_pool, task);
+            continue;
+        }
+        running++;
     }
-    total_size = atol((char*)apr_table_get(head_resp_headers, COS_CONTENT_LENGTH));
-    options->pool = parent_pool;
-    cos_pool_destroy(subpool);
+    while (running > 0) {
+        rv = apr_queue_pop(finished, &task_result);
+        if (rv == APR_EINTR) {
+            continue;
+        } else if (rv != APR_SUCCESS) {
+            break;
+        }
+        cos_finish_dir_file_task(parent_pool, (cos_dir_file_task_t *)task_result);
+        running--;
+    }
+    apr_atomic_dec32(&transfer_pool->transfers);
+}
 
-    // prepare
-    ret = cos_status_create(parent_pool);
-    part_num = cos_get_part_num(total_size, part_size);
-    parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * part_num);
-    cos_build_parts(total_size, part_size, parts);
-    results = (cos_part_task_result_t *)cos_palloc(parent_pool, sizeof(cos_part_task_result_t) * part_num);
-    thr_params = (cos_upload_copy_thread_params_t *)cos_palloc(parent_pool, sizeof(cos_upload_copy_thread_params_t) * part_num);
-    cos_build_copy_thread_params(thr_params, part_num, parent_pool, options, dest_bucket, dest_object, &copy_source, &upload_id, parts, results);
+// the status of the first failed file, every file has its own status in files
+static cos_status_t *cos_get_dir_status(cos_pool_t *pool, cos_list_t *files)
+{
+    cos_status_t *s = NULL;
+    cos_dir_transfer_result_t *file;
+    int failed_files = 0;
 
-    // init upload
-    cos_pool_create(&subpool, parent_pool);
-    options->pool = subpool;
-    cos_table_t *init_multipart_headers = NULL;
-    cos_table_t *init_multipart_resp_headers = NULL;
-    s = cos_init_multipart_upload(options, dest_bucket, dest_object, &upload_id, init_multipart_headers, &init_multipart_resp_headers);
-    if (!cos_status_is_ok(s)) {
-        s = cos_status_dup(parent_pool, s);
-        cos_pool_destroy(subpool);
-        options->pool = parent_pool;
+    cos_list_for_each_entry(cos_dir_transfer_result_t, file, files, node) {
+        if (!cos_is_transfer_ok(file->s)) {
+            if (failed_files++ == 0) {
+                s = NULL == file->s ? cos_status_create(pool) : cos_status_dup(pool, file->s);
+            }
+        }
+    }
+    if (failed_files > 0) {
+        s->error_msg = apr_psprintf(pool, "%s, failed files: %d", 
+                                    s->error_msg == NULL ? "" : s->error_msg, failed_files);
         return s;
     }
-    cos_str_set(&upload_id, apr_pstrdup(parent_pool, upload_id.data));
-    options->pool = parent_pool;
-    cos_pool_destroy(subpool);
 
-    // upload parts    
-    rv = apr_thread_pool_create(&thrp, 0, thread_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL); 
-        return ret;
-    }
+    return cos_status_create(pool);
+}
 
-    rv = apr_queue_create(&failed_parts, part_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL); 
-        return ret;
-    }
+static cos_status_t *cos_transfer_dir(cos_request_options_t *options,
+                                      cos_string_t *bucket,
+                                      cos_table_t *headers,
+                                      cos_resumable_clt_params_t *clt_params,
+                                      int upload,
+                                      cos_list_t *files)
+{
+    cos_pool_t *parent_pool = options->pool;
+    cos_status_t *s = NULL;
+    cos_transfer_pool_t *transfer_pool = NULL;
+    cos_transfer_pool_t *own_pool = NULL;
+    cos_http_request_options_t *http_options;
+    cos_request_options_t dir_options;
+    cos_dir_transfer_t dir;
+    cos_dir_transfer_result_t *file;
+    apr_thread_t *large_thread = NULL;
+    apr_queue_t *finished;
+    apr_status_t retval;
+    int large_files = 0;
+    int rv;
 
-    rv = apr_queue_create(&completed_parts, part_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL); 
-        return ret;
+    memset(&dir, 0, sizeof(dir));
+    if (NULL != clt_params) {
+        dir.clt_params = *clt_params;
     }
+    // every file has its own checkpoint at the default path
+    cos_str_null(&dir.clt_params.checkpoint_path);
+    dir.small_file_size = cos_max(dir.clt_params.part_size, COS_DIR_SMALL_FILE_SIZE);
 
-    // launch
-    cos_set_copy_task_tracker(thr_params, part_num, &launched, &failed, &completed, failed_parts, completed_parts);
-    for (i = 0; i < part_num; i++) {
-        apr_thread_pool_push(thrp, upload_part_copy, thr_params + i, 0, NULL);
+    // the small files and the parts of large files share the threads and their cap
+    s = cos_get_dir_transfer_pool(options, clt_params, &transfer_pool, &own_pool, &finished);
+    if (NULL != s) {
+        return s;
     }
 
-    // wait until all tasks exit
-    total_num = apr_atomic_read32(&launched) + apr_atomic_read32(&failed) + apr_atomic_read32(&completed);
-    for ( ; total_num < (apr_uint32_t)part_num; ) {
-        rv = apr_queue_trypop(completed_parts, &task_result);
-        if (rv == APR_EINTR || rv == APR_EAGAIN) {
-            apr_sleep(1000);
-        } else if(rv == APR_EOF) {
-            break;
-        } else if(rv == APR_SUCCESS) {
-            task_res = (cos_part_task_result_t*)task_result;
-            if (NULL != progress_callback) {
-                consume_bytes += task_res->part->size;
-                progress_callback(consume_bytes, total_size);
-            }
+    // the global options are untouched, the transfer pool is for this call only
+    http_options = cos_http_request_options_create(parent_pool);
+    *http_options = *options->ctl->options;
+    http_options->transfer_pool = transfer_pool;
+    cos_copy_request_options(parent_pool, options, &dir_options);
+    dir_options.ctl->options = http_options;
+
+    dir.options = &dir_options;
+    dir.bucket = bucket;
+    dir.headers = headers;
+    dir.files = files;
+    dir.upload = upload;
+    cos_list_for_each_entry(cos_dir_transfer_result_t, file, files, node) {
+        large_files += file->size > dir.small_file_size ? 1 : 0;
+    }
+    if (large_files > 0) {
+        cos_pool_create(&dir.pool, parent_pool);
+        rv = apr_thread_create(&large_thread, NULL, cos_transfer_dir_large_files, &dir, parent_pool);
+        if (APR_SUCCESS != rv) {
+            cos_error_log("create thread of large files failure, code = %d.", rv);
+            large_thread = NULL;
         }
-        total_num = apr_atomic_read32(&launched) + apr_atomic_read32(&failed) + apr_atomic_read32(&completed);
     }
 
-    // deal with left successful parts
-    while(APR_SUCCESS == apr_queue_trypop(completed_parts, &task_result)) {
-        task_res = (cos_part_task_result_t*)task_result;
-        if (NULL != progress_callback) {
-            consume_bytes += task_res->part->size;
-            progress_callback(consume_bytes, total_size);
+    cos_run_dir_file_tasks(options, transfer_pool, finished, bucket, headers, 
+                           upload ? COS_DIR_OP_UPLOAD : COS_DIR_OP_DOWNLOAD, files, dir.small_file_size);
+
+    if (NULL != large_thread) {
+        apr_thread_join(&retval, large_thread);
+    }
+    cos_list_for_each_entry(cos_dir_transfer_result_t, file, files, node) {
+        if (file->size > dir.small_file_size) {
+            if (NULL != file->s) {
+                file->s = cos_status_dup(parent_pool, file->s);
+            } else {
+                file->s = cos_status_create(parent_pool);
+                cos_status_set(file->s, COSE_INTERNAL_ERROR, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL);
+            }
         }
     }
+    if (NULL != dir.pool) {
+        cos_pool_destroy(dir.pool);
+    }
+    cos_transfer_pool_destroy(own_pool);
 
-    // failed
-    if (apr_atomic_read32(&failed) > 0) {
-        apr_queue_pop(failed_parts, &task_result);
-        task_res = (cos_part_task_result_t*)task_result;
-        s = cos_status_dup(parent_pool, task_res->s);
-        cos_destroy_copy_thread_pool(thr_params, part_num);
-        return s;
+    return cos_get_dir_status(parent_pool, files);
+}
+
+/*
+ * the regular files and the links to them are added to files, the keys of the other entries,
+ * ended with '/' for a linked dir which is never followed, are added to kept if it is not NULL
+ */
+static int cos_walk_local_dir(cos_pool_t *pool, const char *dir_path, const char *object_prefix, 
+                              cos_list_t *files, apr_array_header_t *kept)
+{
+    cos_pool_t *subpool;
+    cos_dir_transfer_result_t *file;
+    apr_dir_t *dir;
+    apr_finfo_t finfo;
+    apr_finfo_t target;
+    char *path;
+    char *object;
+    int res = COSE_OK;
+    int rv;
+
+    cos_pool_create(&subpool, pool);
+    if (APR_SUCCESS != apr_dir_open(&dir, dir_path, subpool)) {
+        cos_error_log("open dir %s failure.", dir_path);
+        cos_pool_destroy(subpool);
+        return COSE_OPEN_FILE_ERROR;
     }
 
-    // successful
-    cos_pool_create(&subpool, parent_pool);
-    cos_list_init(&completed_part_list);
-    for (i = 0; i < part_num; i++) {
-        complete_content = cos_create_complete_part_content(subpool);
-        part_num_str = apr_psprintf(subpool, "%d", thr_params[i].part->index + 1);
-        cos_str_set(&complete_content->part_number, part_num_str);
-        etag = apr_pstrdup(subpool, thr_params[i].result->etag.data);
-        cos_str_set(&complete_content->etag, etag);
-        cos_list_add_tail(&complete_content->node, &completed_part_list);
+    while (res == COSE_OK) {
+        rv = apr_dir_read(&finfo, APR_FINFO_TYPE | APR_FINFO_NAME | APR_FINFO_SIZE, dir);
+        if (rv == APR_ENOENT) {
+            break;
+        }
+        if (rv != APR_SUCCESS && !(rv == APR_INCOMPLETE && (finfo.valid & APR_FINFO_TYPE))) {
+            // a dir read in part must not look complete to sync
+            cos_error_log("read dir %s failure, code:%d.", dir_path, rv);
+            res = COSE_FILE_READ_ERROR;
+            break;
+        }
+        if (strcmp(finfo.name, ".") == 0 || strcmp(finfo.name, "..") == 0) {
+            continue;
+        }
+        path = apr_psprintf(pool, "%s/%s", dir_path, finfo.name);
+        object = apr_psprintf(pool, "%s%s", object_prefix, finfo.name);
+        if (finfo.filetype == APR_LNK) {
+            target.filetype = APR_NOFILE;
+            if (APR_SUCCESS == apr_stat(&target, path, APR_FINFO_TYPE | APR_FINFO_SIZE, subpool) &&
+                target.filetype == APR_REG) {
+                finfo.filetype = APR_REG;
+                finfo.size = target.size;
+                finfo.valid |= APR_FINFO_SIZE;
+            } else if (target.filetype == APR_DIR) {
+                object = apr_psprintf(pool, "%s/", object);
+            }
+        }
+        if (finfo.filetype == APR_DIR) {
+            res = cos_walk_local_dir(pool, path, apr_psprintf(subpool, "%s/", object), files, kept);
+        } else if (finfo.filetype == APR_REG) {
+            file = (cos_dir_transfer_result_t *)cos_pcalloc(pool, sizeof(cos_dir_transfer_result_t));
+            cos_str_set(&file->local_path, path);
+            cos_str_set(&file->object, object);
+            file->size = (finfo.valid & APR_FINFO_SIZE) ? finfo.size : 0;
+            cos_list_add_tail(&file->node, files);
+        } else if (NULL != kept) {
+            APR_ARRAY_PUSH(kept, char *) = object;
+        }
     }
-    cos_destroy_copy_thread_pool(thr_params, part_num);
 
-    // complete upload
-    options->pool = subpool;
-    s = cos_do_complete_multipart_upload(options, dest_bucket, dest_object, &upload_id, 
-        &completed_part_list, cb_headers, NULL, NULL, NULL);
-    s = cos_status_dup(parent_pool, s);
+    apr_dir_close(dir);
     cos_pool_destroy(subpool);
-    options->pool = parent_pool;
+    return res;
+}
 
-    return s;
+// the part of a key after the prefix must stay under the local dir
+static int cos_is_safe_relative_path(const char *path, int len)
+{
+    int start = 0;
+    int i;
+
+#ifdef WIN32
+    if (len > 0 && (path[0] == '\\' || (len > 1 && path[1] == ':'))) {
+        return COS_FALSE;
+    }
+#endif
+    if (len > 0 && path[0] == '/') {
+        return COS_FALSE;
+    }
+    for (i = 0; i <= len; i++) {
+#ifdef WIN32
+        if (i < len && path[i] != '/' && path[i] != '\\') {
+#else
+        if (i < len && path[i] != '/') {
+#endif
+            continue;
+        }
+        if (i - start == 2 && path[start] == '.' && path[start + 1] == '.') {
+            return COS_FALSE;
+        }
+        start = i + 1;
+    }
+    return COS_TRUE;
 }
 
-void * APR_THREAD_FUNC download_part(apr_thread_t *thd, void *data) 
+static cos_status_t *cos_walk_object_prefix(cos_request_options_t *options,
+                                            cos_string_t *bucket,
+                                            cos_string_t *prefix,
+                                            cos_string_t *local_dir,
+                                            cos_list_t *files)
 {
+    cos_pool_t *parent_pool = options->pool;
+    cos_pool_t *subpool = NULL;
     cos_status_t *s = NULL;
-    cos_upload_thread_params_t *params = NULL;
-    cos_upload_file_t *download_file = NULL;
+    cos_list_object_params_t *params;
+    cos_list_object_content_t *content;
+    cos_dir_transfer_result_t *file;
     cos_table_t *resp_headers = NULL;
-    int part_num;
-    char *etag;
-    
-    params = (cos_upload_thread_params_t *)data;
-    if (apr_atomic_read32(params->failed) > 0) {
-        apr_atomic_inc32(params->launched);
-        return NULL;
-    }
+    int prefix_len = NULL == prefix->data ? 0 : prefix->len;
 
-    part_num = params->part->index + 1;
-    download_file = cos_create_upload_file(params->options.pool);
-    cos_str_set(&download_file->filename, params->filepath->data);
-    download_file->file_pos = params->part->offset;
-    download_file->file_last = params->part->offset + params->part->size;
+    params = cos_create_list_object_params(parent_pool);
+    cos_str_set(&params->prefix, NULL == prefix->data ? "" : apr_pstrndup(parent_pool, prefix->data, prefix->len));
+    while (params->truncated) {
+        cos_pool_create(&subpool, parent_pool);
+        options->pool = subpool;
+        cos_list_init(&params->object_list);
+        cos_list_init(&params->common_prefix_list);
+        s = cos_list_object(options, bucket, params, &resp_headers);
+        options->pool = parent_pool;
+        if (!cos_status_is_ok(s)) {
+            s = cos_status_dup(parent_pool, s);
+            cos_pool_destroy(subpool);
+            return s;
+        }
 
-    s = cos_download_part_to_file(&params->options, params->bucket, params->object, download_file, &resp_headers);
-    if (!cos_status_is_ok(s)) {
-        apr_atomic_inc32(params->failed);
-        params->result->s = s;
-        apr_queue_push(params->failed_parts, params->result);
-        return s;
-    }
+        cos_list_for_each_entry(cos_list_object_content_t, content, &params->object_list, node) {
+            // the keys ending with '/' are directory markers
+            if (content->key.len <= prefix_len || content->key.data[content->key.len - 1] == '/') {
+                continue;
+            }
+            file = (cos_dir_transfer_result_t *)cos_pcalloc(parent_pool, sizeof(cos_dir_transfer_result_t));
+            cos_str_set(&file->object, apr_pstrndup(parent_pool, content->key.data, content->key.len));
+            file->size = cos_atoi64(apr_pstrndup(subpool, content->size.data, content->size.len));
+            if (cos_is_safe_relative_path(content->key.data + prefix_len, content->key.len - prefix_len)) {
+                cos_str_set(&file->local_path, apr_psprintf(parent_pool, "%.*s/%.*s", local_dir->len, local_dir->data,
+                            content->key.len - prefix_len, content->key.data + prefix_len));
+            } else {
+                // failed already, never transferred
+                cos_error_log("object %s is out of local dir.", file->object.data);
+                cos_str_set(&file->local_path, "");
+                file->s = cos_status_create(parent_pool);
+                cos_status_set(file->s, COSE_INVALID_ARGUMENT, COS_CLIENT_ERROR_CODE, 
+                               "the object key is out of the local dir");
+            }
+            cos_list_add_tail(&file->node, files);
+        }
 
-    cos_warn_log("download part = %d, start byte = %"APR_INT64_T_FMT", end byte = %"APR_INT64_T_FMT, part_num, download_file->file_pos, download_file->file_last-1);
+        if (params->truncated && NULL != params->next_marker.data) {
+            cos_str_set(&params->marker, apr_pstrndup(parent_pool, params->next_marker.data, params->next_marker.len));
+        }
+        cos_pool_destroy(subpool);
+    }
 
-    etag = apr_pstrdup(params->options.pool, (char*)apr_table_get(resp_headers, "ETag"));
-    cos_str_set(&params->result->etag, etag);
-    apr_atomic_inc32(params->completed);
-    apr_queue_push(params->completed_parts, params->result);
     return NULL;
 }
 
-int64_t cos_get_safe_size_for_download(int64_t part_size)
+cos_status_t *cos_upload_dir(cos_request_options_t *options,
+                             cos_string_t *bucket, 
+                             cos_string_t *local_dir, 
+                             cos_string_t *prefix,
+                             cos_table_t *headers,
+                             cos_resumable_clt_params_t *clt_params,
+                             cos_list_t *results)
 {
-    if (part_size < 4*1024*1024) return 4*1024*1024;
-    else if (part_size > 20*1024*1024) return 20*1024*1024;
-    else return part_size;
+    cos_status_t *s = NULL;
+    char *dir_path;
+    int res;
+
+    dir_path = apr_pstrndup(options->pool, local_dir->data, local_dir->len);
+    res = cos_walk_local_dir(options->pool, dir_path, 
+                             NULL == prefix->data ? "" : apr_pstrndup(options->pool, prefix->data, prefix->len), 
+                             results, NULL);
+    if (res != COSE_OK) {
+        s = cos_status_create(options->pool);
+        cos_file_error_status_set(s, res);
+        return s;
+    }
+
+    return cos_transfer_dir(options, bucket, headers, clt_params, COS_TRUE, results);
 }
 
-cos_status_t *cos_resumable_download_file_without_cp(cos_request_options_t *options,
-                                                   cos_string_t *bucket, 
-                                                   cos_string_t *object, 
-                                                   cos_string_t *filepath,                           
-                                                   cos_table_t *headers,
-                                                   cos_table_t *params,
-                                                   int32_t thread_num,
-                                                   int64_t part_size,
-                                                   cos_progress_callback progress_callback) 
+cos_status_t *cos_download_dir(cos_request_options_t *options,
+                               cos_string_t *bucket, 
+                               cos_string_t *prefix,
+                               cos_string_t *local_dir, 
+                               cos_resumable_clt_params_t *clt_params,
+                               cos_list_t *results)
 {
-    cos_pool_t *subpool = NULL;
-    cos_pool_t *parent_pool = NULL;
     cos_status_t *s = NULL;
-    cos_status_t *ret = NULL;
-    cos_string_t upload_id;
-    cos_checkpoint_part_t *parts;
-    cos_part_task_result_t *results;
-    cos_part_task_result_t *task_res;
-    cos_transport_thread_params_t *thr_params;
-    apr_thread_pool_t *thrp;
-    apr_uint32_t launched = 0;
-    apr_uint32_t failed = 0;
-    apr_uint32_t completed = 0;
-    apr_uint32_t total_num = 0;
-    apr_queue_t *failed_parts;
-    apr_queue_t *completed_parts;
-    int64_t consume_bytes = 0;
-    void *task_result;
-    int part_num = 0;
-    int i = 0;
-    int rv;
-    const char *value = NULL;
-    int64_t file_size = 0;
-    cos_table_t *resp_headers = NULL;
 
-    // prepare
-    parent_pool = options->pool;
-    ret = cos_status_create(parent_pool);
-    // get object file size
-    cos_pool_create(&subpool, parent_pool);
-    options->pool = subpool;
-    s = cos_head_object(options, bucket, object, NULL, &resp_headers);
-    if (!cos_status_is_ok(s)) {
-        s = cos_status_dup(parent_pool, s);
-        cos_pool_destroy(subpool);
-        options->pool = parent_pool;
+    s = cos_walk_object_prefix(options, bucket, prefix, local_dir, results);
+    if (NULL != s) {
         return s;
     }
-    value = apr_table_get(resp_headers, COS_CONTENT_LENGTH);
-    if (NULL == value) {
-        cos_status_set(ret, COSE_INVALID_ARGUMENT, COS_LACK_OF_CONTENT_LEN_ERROR_CODE, NULL);
-        cos_pool_destroy(subpool);
+
+    return cos_transfer_dir(options, bucket, NULL, clt_params, COS_FALSE, results);
+}
+
+// delete the objects of files by batches, a file gets the error of its key, or the status of its batch
+static void cos_delete_dir_objects(cos_request_options_t *options, cos_string_t *bucket, cos_list_t *files)
+{
+    cos_pool_t *parent_pool = options->pool;
+    cos_pool_t *subpool;
+    cos_status_t *s;
+    cos_dir_transfer_result_t *file;
+    cos_dir_transfer_result_t *batch_first;
+    cos_dir_transfer_result_t *batch_end;
+    cos_object_key_t *object_key;
+    cos_object_delete_error_t *error;
+    cos_table_t *resp_headers = NULL;
+    apr_hash_t *errors;
+    cos_list_t object_list;
+    cos_list_t error_list;
+    int keys;
+
+    batch_first = cos_list_get_first(files, cos_dir_transfer_result_t, node);
+    while (NULL != batch_first && &batch_first->node != files) {
+        cos_pool_create(&subpool, parent_pool);
+        cos_list_init(&object_list);
+        cos_list_init(&error_list);
+        keys = 0;
+        for (file = batch_first; &file->node != files && keys < COS_DELETE_OBJECTS_MAX_NUM; 
+             file = cos_list_entry(file->node.next, cos_dir_transfer_result_t, node), keys++) {
+            object_key = cos_create_cos_object_key(subpool);
+            cos_str_set(&object_key->key, file->object.data);
+            cos_list_add_tail(&object_key->node, &object_list);
+        }
+        batch_end = file;
+
+        options->pool = subpool;
+        s = cos_delete_objects_quiet(options, bucket, &object_list, &resp_headers, &error_list);
         options->pool = parent_pool;
-        return ret;
-    }
-    file_size = cos_atoi64(value);
-    cos_pool_destroy(subpool);
-    options->pool = parent_pool;
-    // init download params
-    part_size = cos_get_safe_size_for_download(part_size);
-    part_num = cos_get_part_num(file_size, part_size);
-    parts = (cos_checkpoint_part_t *)cos_palloc(parent_pool, sizeof(cos_checkpoint_part_t) * part_num);
-    cos_build_parts(file_size, part_size, parts);
-    results = (cos_part_task_result_t *)cos_palloc(parent_pool, sizeof(cos_part_task_result_t) * part_num);
-    thr_params = (cos_transport_thread_params_t *)cos_palloc(parent_pool, sizeof(cos_transport_thread_params_t) * part_num);
-    cos_build_thread_params(thr_params, part_num, parent_pool, options, bucket, object, filepath, &upload_id, parts, results);
-    
-    // download parts    
-    rv = apr_thread_pool_create(&thrp, 0, thread_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_THREAD_POOL_ERROR_CODE, NULL); 
-        return ret;
+        s = cos_status_dup(parent_pool, s);
+        errors = apr_hash_make(subpool);
+        cos_list_for_each_entry(cos_object_delete_error_t, error, &error_list, node) {
+            apr_hash_set(errors, error->key.data, error->key.len, error);
+        }
+        for (file = batch_first; file != batch_end; 
+             file = cos_list_entry(file->node.next, cos_dir_transfer_result_t, node)) {
+            file->action = COS_DIR_DELETED;
+            error = (cos_object_delete_error_t *)apr_hash_get(errors, file->object.data, file->object.len);
+            if (NULL == error || !cos_status_is_ok(s)) {
+                file->s = s;
+                continue;
+            }
+            file->s = cos_status_create(parent_pool);
+            cos_status_set(file->s, COSE_SERVICE_ERROR, 
+                           NULL == error->code.data ? COS_DELETE_OBJECTS_ERROR_CODE : 
+                           apr_pstrdup(parent_pool, error->code.data),
+                           NULL == error->message.data ? NULL : apr_pstrdup(parent_pool, error->message.data));
+        }
+        cos_pool_destroy(subpool);
+        batch_first = batch_end;
     }
+}
 
-    rv = apr_queue_create(&failed_parts, part_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL); 
-        return ret;
+// the entries not walked, e.g. broken links, may have their objects, which are never deleted
+static int cos_is_kept_object(apr_array_header_t *kept, const cos_string_t *object)
+{
+    const char *key;
+    int len;
+    int i;
+
+    for (i = 0; i < kept->nelts; i++) {
+        key = APR_ARRAY_IDX(kept, i, const char *);
+        len = (int)strlen(key);
+        if (object->len < len || strncmp(object->data, key, len) != 0) {
+            continue;
+        }
+        // a linked dir keeps all the objects under it
+        if (object->len == len || (len > 0 && key[len - 1] == '/')) {
+            return COS_TRUE;
+        }
     }
+    return COS_FALSE;
+}
 
-    rv = apr_queue_create(&completed_parts, part_num, parent_pool);
-    if (APR_SUCCESS != rv) {
-        cos_status_set(ret, rv, COS_CREATE_QUEUE_ERROR_CODE, NULL); 
-        return ret;
-    }
+cos_status_t *cos_sync_dir(cos_request_options_t *options,
+                           cos_string_t *bucket, 
+                           cos_string_t *local_dir, 
+                           cos_string_t *prefix,
+                           cos_table_t *headers,
+                           cos_resumable_clt_params_t *clt_params,
+                           int delete_extraneous,
+                           cos_list_t *results)
+{
+    cos_pool_t *parent_pool = options->pool;
+    cos_status_t *s = NULL;
+    cos_transfer_pool_t *transfer_pool = NULL;
+    cos_transfer_pool_t *own_pool = NULL;
+    cos_dir_transfer_result_t *file;
+    cos_dir_transfer_result_t *next;
+    cos_dir_transfer_result_t *remote;
+    apr_queue_t *finished;
+    apr_hash_t *remote_files;
+    apr_array_header_t *kept;
+    cos_list_t local_list;
+    cos_list_t remote_list;
+    cos_list_t compare_list;
+    cos_list_t upload_list;
+    char *dir_path;
+    int res;
 
-    // launch
-    cos_set_task_tracker(thr_params, part_num, &launched, &failed, &completed, failed_parts, completed_parts);
-    for (i = 0; i < part_num; i++) {
-        apr_thread_pool_push(thrp, download_part, thr_params + i, 0, NULL);
+    cos_list_init(&local_list);
+    cos_list_init(&remote_list);
+    cos_list_init(&compare_list);
+    cos_list_init(&upload_list);
+
+    dir_path = apr_pstrndup(parent_pool, local_dir->data, local_dir->len);
+    kept = apr_array_make(parent_pool, 8, sizeof(char *));
+    res = cos_walk_local_dir(parent_pool, dir_path, 
+                             NULL == prefix->data ? "" : apr_pstrndup(parent_pool, prefix->data, prefix->len), 
+                             &local_list, kept);
+    if (res != COSE_OK) {
+        s = cos_status_create(parent_pool);
+        cos_file_error_status_set(s, res);
+        return s;
+    }
+    s = cos_walk_object_prefix(options, bucket, prefix, local_dir, &remote_list);
+    if (NULL != s) {
+        return s;
     }
 
-    // wait until all tasks exit
-    total_num = apr_atomic_read32(&launched) + apr_atomic_read32(&failed) + apr_atomic_read32(&completed);
-    for ( ; total_num < (apr_uint32_t)part_num; ) {
-        rv = apr_queue_trypop(completed_parts, &task_result);
-        if (rv == APR_EINTR || rv == APR_EAGAIN) {
-            apr_sleep(1000);
-        } else if(rv == APR_EOF) {
-            break;
-        } else if(rv == APR_SUCCESS) {
-            task_res = (cos_part_task_result_t*)task_result;
-            if (NULL != progress_callback) {
-                consume_bytes += task_res->part->size;
-                progress_callback(consume_bytes, file_size);
-            }
+    // the listing gives the remote sizes, an object left in the hash has no local file,
+    // the objects out of the local dir are failed and never deleted
+    remote_files = apr_hash_make(parent_pool);
+    cos_list_for_each_entry_safe(cos_dir_transfer_result_t, remote, next, &remote_list, node) {
+        if (NULL != remote->s) {
+            cos_list_del(&remote->node);
+            cos_list_add_tail(&remote->node, results);
+            continue;
+        }
+        apr_hash_set(remote_files, remote->object.data, remote->object.len, remote);
+    }
+    cos_list_for_each_entry_safe(cos_dir_transfer_result_t, file, next, &local_list, node) {
+        remote = (cos_dir_transfer_result_t *)apr_hash_get(remote_files, file->object.data, file->object.len);
+        if (NULL != remote) {
+            apr_hash_set(remote_files, file->object.data, file->object.len, NULL);
+        }
+        cos_list_del(&file->node);
+        if (NULL != remote && remote->size == file->size) {
+            cos_list_add_tail(&file->node, &compare_list);
+        } else {
+            cos_list_add_tail(&file->node, &upload_list);
         }
-        total_num = apr_atomic_read32(&launched) + apr_atomic_read32(&failed) + apr_atomic_read32(&completed);
     }
 
-    // deal with left successful parts
-    while(APR_SUCCESS == apr_queue_trypop(completed_parts, &task_result)) {
-        task_res = (cos_part_task_result_t*)task_result;
-        if (NULL != progress_callback) {
-            consume_bytes += task_res->part->size;
-            progress_callback(consume_bytes, file_size);
+    // the files of the same size are compared by crc64 in parallel, on the threads of the transfer
+    if (!cos_list_empty(&compare_list)) {
+        s = cos_get_dir_transfer_pool(options, clt_params, &transfer_pool, &own_pool, &finished);
+        if (NULL != s) {
+            return s;
+        }
+        cos_run_dir_file_tasks(options, transfer_pool, finished, bucket, NULL, COS_DIR_OP_COMPARE, 
+                               &compare_list, INT64_MAX);
+        cos_transfer_pool_destroy(own_pool);
+    }
+    cos_list_for_each_entry_safe(cos_dir_transfer_result_t, file, next, &compare_list, node) {
+        cos_list_del(&file->node);
+        if (file->action == COS_DIR_SKIPPED) {
+            file->s = cos_status_create(parent_pool);
+            cos_list_add_tail(&file->node, results);
+        } else {
+            file->action = COS_DIR_TRANSFERRED;
+            file->s = NULL;
+            cos_list_add_tail(&file->node, &upload_list);
         }
     }
 
-    // failed
-    if (apr_atomic_read32(&failed) > 0) {
-        apr_queue_pop(failed_parts, &task_result);
-        task_res = (cos_part_task_result_t*)task_result;
-        s = cos_status_dup(parent_pool, task_res->s);
-        cos_destroy_thread_pool(thr_params, part_num);
-        return s;
+    if (!cos_list_empty(&upload_list)) {
+        s = cos_transfer_dir(options, bucket, headers, clt_params, COS_TRUE, &upload_list);
+        cos_list_for_each_entry_safe(cos_dir_transfer_result_t, file, next, &upload_list, node) {
+            // the transfer fails before the file is started
+            if (NULL == file->s) {
+                file->s = s;
+            }
+            cos_list_del(&file->node);
+            cos_list_add_tail(&file->node, results);
+        }
+        // the objects are kept while the local dir is not fully uploaded
+        if (!cos_is_transfer_ok(s)) {
+            return cos_get_dir_status(parent_pool, results);
+        }
     }
 
-    // successful
-    cos_destroy_thread_pool(thr_params, part_num);
+    if (delete_extraneous && !cos_is_canceled(options->ctl)) {
+        cos_list_for_each_entry_safe(cos_dir_transfer_result_t, remote, next, &remote_list, node) {
+            if (NULL == apr_hash_get(remote_files, remote->object.data, remote->object.len) ||
+                cos_is_kept_object(kept, &remote->object)) {
+                cos_list_del(&remote->node);
+            }
+        }
+        cos_delete_dir_objects(options, bucket, &remote_list);
+        cos_list_for_each_entry_safe(cos_dir_transfer_result_t, remote, next, &remote_list, node) {
+            cos_list_del(&remote->node);
+            cos_list_add_tail(&remote->node, results);
+        }
+    }
 
-    s = cos_status_create(options->pool);
-    return s;
+    return cos_get_dir_status(parent_pool, results);
 }
-
-
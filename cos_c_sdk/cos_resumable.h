@@ -3,6 +3,7 @@
 
 #include "cos_sys_define.h"
 #include "apr_atomic.h"
+#include "apr_thread_cond.h"
 #include "apr_queue.h"
 #include "apr_thread_pool.h"
 
@@ -10,6 +11,19 @@ COS_CPP_START
 
 #define COS_CP_UPLOAD   1
 #define COS_CP_DOWNLOAD 2
+#define COS_CP_COPY     3
+
+/*
+ * the checkpoint file is a fixed header, a snapshot of the checkpoint in xml
+ * and the part records appended when parts complete, all integers are little endian
+ *   header: "COSJ", version(4), snapshot length(8), snapshot crc64(8)
+ *   record: part index(4), flags(4), part crc64(8), etag length(4), etag, record crc64(8)
+ */
+#define COS_CP_JOURNAL_MAGIC       "COSJ"
+#define COS_CP_JOURNAL_VERSION     1
+#define COS_CP_JOURNAL_HEADER_SIZE 24
+#define COS_CP_JOURNAL_RECORD_SIZE 28  // without the etag
+#define COS_CP_JOURNAL_MAX_ETAG    1024
 
 typedef struct {
     int32_t index;  // the index of part, start from 0
@@ -17,70 +31,187 @@ typedef struct {
     int64_t size;   // the size of part
     int completed;  // COS_TRUE completed, COS_FALSE uncompleted
     cos_string_t etag; // the etag of part, for upload
+    uint64_t crc64;    // the crc64 of part, for upload
+    int has_crc64;     // COS_TRUE crc64 is valid, COS_FALSE unknown
 } cos_checkpoint_part_t;
 
 typedef struct {
     cos_string_t md5;      // the md5 of checkout content
-    int cp_type;           // 1 upload, 2 download
+    int cp_type;           // 1 upload, 2 download, 3 copy
     apr_file_t *thefile;   // the handle of checkpoint file
 
-    cos_string_t file_path;        // local file path 
+    cos_string_t file_path;        // local file path, bucket/object copied to for copy
     int64_t    file_size;          // local file size, for upload
     apr_time_t file_last_modified; // local file last modified time, for upload
     cos_string_t file_md5;         // the md5 of the local file content, for upload, reserved
 
-    cos_string_t object_name;          // object name
-    int64_t object_size;               // object size, for download
-    cos_string_t object_last_modified; // object last modified time, for download
-    cos_string_t object_etag;          // object etag, for download
+    cos_string_t object_name;          // object name, copy source for copy
+    int64_t object_size;               // object size, for download and copy
+    cos_string_t object_last_modified; // object last modified time, for download and copy
+    cos_string_t object_etag;          // object etag, for download and copy
 
     cos_string_t upload_id;  // upload id
 
     int  part_num;                 // the total number of parts
     int64_t part_size;             // the part size, byte
     cos_checkpoint_part_t *parts;  // the parts of local or object, from 0
+
+    int journal_records;   // the part records appended since the last dump
+    int unsynced_records;  // the part records appended since the last fsync
 } cos_checkpoint_t;
 
+typedef enum {
+    COS_PREFETCH_FREE = 0,
+    COS_PREFETCH_READING,
+    COS_PREFETCH_READ,
+    COS_PREFETCH_READY
+} cos_prefetch_state_e;
+
+typedef struct {
+    int pos;                  // the position of the part in parts, -1 if never used
+    cos_prefetch_state_e state;
+    char *data;               // aligned buffer of the part size, reused by parts
+    int64_t len;
+    int res;                  // COSE_OK or the error of reading
+    uint64_t crc64;           // valid if crc is enabled
+    char content_md5[32];     // base64 md5, empty if md5 is disabled
+} cos_prefetch_slot_t;
+
+/*
+ * read-ahead pipeline of upload parts, a reader thread reads the coming parts
+ * into a ring of buffers with one large sequential read, a hashing thread
+ * digests them, and the part tasks send them from memory, so disk and
+ * network are busy at the same time
+ */
+typedef struct cos_part_prefetcher_s {
+    cos_pool_t *pool;
+    apr_thread_mutex_t *mutex;
+    apr_thread_cond_t *cond;
+    apr_thread_t *reader;
+    apr_thread_t *hasher;
+    const char *filepath;
+    cos_checkpoint_part_t *parts;  // in the order the part tasks are launched
+    int part_num;
+    cos_prefetch_slot_t *slots;
+    int depth;                     // the number of buffers
+    int64_t buffer_size;
+    int need_md5;
+    int need_crc;
+    int stop;
+} cos_part_prefetcher_t;
+
 typedef struct {
     cos_checkpoint_part_t *part;
-    cos_status_t *s;
+    cos_status_t *s;       // the status of part task, NULL if the task is skipped
     cos_string_t etag; 
+    int retries;           // the times the part is retried
+    apr_time_t start_time; // the time the part is launched
 } cos_part_task_result_t;
 
 typedef struct {
-    cos_request_options_t options;
+    cos_request_options_t options; // options.pool is recycled for every part
     cos_string_t *bucket;
     cos_string_t *object; 
     cos_string_t *upload_id;
-    cos_string_t *filepath;
+    cos_string_t *filepath;        // the local file, for upload and download
+    cos_string_t *copy_source;     // the source object, for upload part copy
     cos_checkpoint_part_t *part;
     cos_part_task_result_t *result;
 
-    apr_uint32_t *launched;        // the number of launched part tasks, use atomic
     apr_uint32_t *failed;          // the number of failed part tasks, use atomic
-    apr_uint32_t *completed;       // the number of completed part tasks, use atomic
-    apr_queue_t  *failed_parts;    // the queue of failed parts tasks, thread safe
-    apr_queue_t  *completed_parts; // the queue of completed parts tasks, thread safe
+    apr_uint32_t *retry_budget;    // the retries left for all parts, use atomic
+    cos_part_prefetcher_t *prefetcher; // the read-ahead parts, NULL to read the file in task
+    apr_file_t *file;              // the download file shared by parts, NULL to open per part
+    char *buffer;                  // the download memory shared by parts, NULL to write file
+    int64_t buffer_size;           // the size of buffer as a ring of parts, 0 if it holds the object
+    apr_queue_t  *finished_parts;  // the queue of finished part tasks, thread safe
 } cos_upload_thread_params_t;
 
+typedef cos_upload_thread_params_t cos_upload_copy_thread_params_t;
+
+typedef cos_upload_thread_params_t cos_transport_thread_params_t;
+
+/*
+ * consumes the object content in order, returns COSE_OK or an error code which fails the transfer
+ */
+typedef int (*cos_download_sink_callback)(void *data, const char *buffer, int64_t len);
+
+/*
+ * called in the launching thread when a part task completes successfully,
+ * returns COSE_OK or an error code which fails the transfer
+ */
+typedef int (*cos_part_done_callback)(cos_pool_t *pool, void *data, cos_checkpoint_part_t *part);
+
 typedef struct {
-    cos_request_options_t options;
+    apr_thread_start_t task;          // upload_part, upload_part_copy or download_part
     cos_string_t *bucket;
-    cos_string_t *object; 
+    cos_string_t *object;
     cos_string_t *upload_id;
+    cos_string_t *filepath;
     cos_string_t *copy_source;
-    cos_checkpoint_part_t *part;
-    cos_part_task_result_t *result;
-
-    apr_uint32_t *launched;        // the number of launched part tasks, use atomic
-    apr_uint32_t *failed;          // the number of failed part tasks, use atomic
-    apr_uint32_t *completed;       // the number of completed part tasks, use atomic
-    apr_queue_t  *failed_parts;    // the queue of failed parts tasks, thread safe
-    apr_queue_t  *completed_parts; // the queue of completed parts tasks, thread safe
-} cos_upload_copy_thread_params_t;
-
-
-typedef cos_upload_thread_params_t cos_transport_thread_params_t;
+    cos_checkpoint_part_t *parts;     // the parts to transfer, etag and completed are filled in
+    int part_num;
+    int32_t thread_num;
+    int64_t total_size;               // the total size for progress callback
+    int32_t retry_budget;             // the retries shared by all parts, 0 for default
+    int auto_tune;                    // adjust the parts in flight up to thread_num by throughput and errors
+    int observe_bandwidth;            // the parts sample the upload bandwidth of the auto part size, upload only
+    cos_part_prefetcher_t *prefetcher; // the read-ahead parts of upload, NULL to read in task
+    apr_file_t *file;                 // the download file shared by parts, NULL to open per part
+    char *buffer;                     // the download memory shared by parts, NULL to write file
+    int64_t buffer_size;              // the size of buffer as a ring of parts, 0 if it holds the object
+    int32_t max_parts_ahead;          // the parts launched from the first uncompleted one, 0 for unbounded
+    int32_t concurrency;              // output, the parts in flight at the end
+    int32_t peak_concurrency;         // output, the most parts in flight
+    cos_progress_callback progress_callback;
+    cos_part_done_callback done_callback;
+    void *done_data;
+} cos_part_tasks_t;
+
+/*
+ * AIMD control of the parts in flight, grows by one while a wider window
+ * raises the throughput, halves on retried parts or a throughput collapse
+ */
+typedef struct {
+    int32_t concurrency;
+    int32_t max_concurrency;
+    int32_t peak_concurrency;
+    int32_t window_parts;      // the parts completed in current window
+    int64_t window_bytes;
+    apr_time_t window_start;
+    int64_t throughput;        // byte/s of the last window
+} cos_part_tuner_t;
+
+/*
+ * the worker threads shared by the part tasks of all transfers of a client,
+ * the threads outlive the transfers and the parts in flight across transfers
+ * are bounded by max_threads, each transfer launches at most its fair share
+ */
+typedef struct cos_transfer_pool_s {
+    cos_pool_t *pool;
+    apr_thread_pool_t *thrp;
+    int32_t max_threads;
+    volatile apr_uint32_t transfers;  // the transfers running on the pool, use atomic
+} cos_transfer_pool_t;
+
+/*
+ * create a transfer pool with at most max_threads worker threads, attach it to
+ * a client by cos_set_transfer_pool
+ * @return NULL if the threads can not be created
+ */
+cos_transfer_pool_t *cos_transfer_pool_create(cos_pool_t *p, int32_t max_threads);
+
+/*
+ * wait for the tasks in flight and release the threads, no transfer may run on the pool,
+ * the controllers still used are reset by cos_set_transfer_pool(ctl, NULL) before
+ */
+void cos_transfer_pool_destroy(cos_transfer_pool_t *transfer_pool);
+
+/*
+ * @return the parts in flight one transfer may launch, max_threads divided by
+ *         the running transfers and at least 1
+ */
+int32_t cos_transfer_pool_get_share(cos_transfer_pool_t *transfer_pool);
 
 int32_t cos_get_thread_num(cos_resumable_clt_params_t *clt_params);
 
@@ -99,38 +230,186 @@ int cos_get_part_num(int64_t file_size, int64_t part_size);
 
 void cos_build_parts(int64_t file_size, int64_t part_size, cos_checkpoint_part_t *parts);
 
-void cos_build_thread_params(cos_transport_thread_params_t *thr_params, int part_num, 
-                             cos_pool_t *parent_pool, cos_request_options_t *options, 
-                             cos_string_t *bucket, cos_string_t *object, cos_string_t *filepath,
-                             cos_string_t *upload_id, cos_checkpoint_part_t *parts,
-                             cos_part_task_result_t *result);
-
-void cos_build_copy_thread_params(cos_upload_copy_thread_params_t *thr_params, int part_num, 
-                             cos_pool_t *parent_pool, cos_request_options_t *options, 
-                             cos_string_t *bucket, cos_string_t *object, cos_string_t *copy_source,
-                             cos_string_t *upload_id, cos_checkpoint_part_t *parts,
+void cos_build_thread_params(cos_transport_thread_params_t *thr_params, int thread_num, 
+                             cos_pool_t *parent_pool, cos_string_t *bucket, cos_string_t *object,
+                             cos_string_t *filepath, cos_string_t *copy_source, cos_string_t *upload_id,
                              cos_part_task_result_t *result);
 
-
-void cos_destroy_thread_pool(cos_transport_thread_params_t *thr_params, int part_num);
-
-void cos_set_task_tracker(cos_transport_thread_params_t *thr_params, int part_num, 
-                          apr_uint32_t *launched, apr_uint32_t *failed, apr_uint32_t *completed,
-                          apr_queue_t *failed_parts, apr_queue_t *completed_parts);
+/*
+ * recycle the thread params for the next part
+ */
+void cos_reset_thread_params(cos_transport_thread_params_t *thr_params, 
+                             cos_request_options_t *options, cos_checkpoint_part_t *part);
+
+void cos_destroy_thread_pool(cos_transport_thread_params_t *thr_params, int thread_num);
+
+void cos_set_task_tracker(cos_transport_thread_params_t *thr_params, int thread_num, 
+                          apr_uint32_t *failed, apr_uint32_t *retry_budget, apr_queue_t *finished_parts);
+
+/*
+ * the default retries shared by all parts of a transfer
+ */
+int32_t cos_get_part_retry_budget(int part_num);
+
+/*
+ * the upload throughput of one connection observed by recent upload parts of this process,
+ * byte/s, 0 if unknown
+ */
+int64_t cos_get_observed_part_bandwidth();
+
+void cos_update_observed_part_bandwidth(int64_t bytes, apr_interval_time_t elapsed);
+
+/*
+ * choose the part size from the file size and the observed bandwidth, so a part
+ * takes about COS_AUTO_PART_SECONDS on one connection and all threads get parts
+ */
+int64_t cos_get_auto_part_size(int64_t file_size, int32_t thread_num);
+
+void cos_init_part_tuner(cos_part_tuner_t *tuner, int32_t max_concurrency);
+
+/*
+ * whether the parts of the upload are read ahead by a pipeline, it is enabled
+ * by cos_set_read_ahead_size not smaller than part size
+ */
+int cos_is_pipelined_upload(cos_request_options_t *options, int64_t part_size);
+
+/*
+ * start reading parts ahead, thread_num + COS_PREFETCH_PART_NUM parts at most are in memory
+ * @return NULL if the threads can not be created, the parts are read by tasks then
+ */
+cos_part_prefetcher_t *cos_create_part_prefetcher(cos_request_options_t *options, cos_pool_t *pool,
+                                                  const cos_string_t *filepath, cos_checkpoint_part_t *parts,
+                                                  int part_num, int32_t thread_num);
+
+/*
+ * wait until the part is read and digested
+ * @return NULL if the prefetcher is stopped
+ */
+cos_prefetch_slot_t *cos_wait_prefetched_part(cos_part_prefetcher_t *prefetcher, cos_checkpoint_part_t *part);
+
+/*
+ * give the buffer of a sent part back to the reader
+ */
+void cos_release_prefetched_part(cos_part_prefetcher_t *prefetcher, cos_checkpoint_part_t *part);
+
+/*
+ * wake up and stop all stages, the parts waited for are skipped
+ */
+void cos_stop_part_prefetcher(cos_part_prefetcher_t *prefetcher);
+
+void cos_destroy_part_prefetcher(cos_part_prefetcher_t *prefetcher);
+
+void cos_tune_part_concurrency(cos_part_tuner_t *tuner, int64_t part_size, int retries, apr_time_t now);
+
+/*
+ * whether a failed part is worth retrying, e.g. 5xx, timeout, broken connection or crc mismatch
+ */
+int cos_should_retry_part(cos_status_t *s);
+
+/*
+ * called by a part task after a failure, takes one retry from the budget of
+ * the transfer and sleeps with exponential backoff
+ * @return COS_TRUE retry the part, COS_FALSE the part fails
+ */
+int cos_retry_part_task(cos_transport_thread_params_t *thr_params, cos_status_t *s);
+
+void cos_init_part_tasks(cos_part_tasks_t *tasks, apr_thread_start_t task, 
+                         cos_string_t *bucket, cos_string_t *object,
+                         cos_checkpoint_part_t *parts, int part_num, int32_t thread_num);
+
+/*
+ * run the part tasks with at most thread_num threads, the thread params are
+ * created for threads and reused by parts, so memory does not grow with parts,
+ * a failed part is retried while the retry budget lasts, no part is launched after
+ * a failure or after the cancel flag of options->ctl is set, the parts run on the
+ * transfer pool of options->ctl if one is set, otherwise on threads of this call
+ * @return NULL if all parts complete, otherwise the status of the first failure with
+ *         the failed parts in error_msg, or COSE_CANCELED_ERROR if canceled
+ */
+cos_status_t *cos_run_part_tasks(cos_request_options_t *options, cos_part_tasks_t *tasks);
 
 int cos_verify_checkpoint_md5(cos_pool_t *pool, const cos_checkpoint_t *checkpoint);
 
 void cos_build_upload_checkpoint(cos_pool_t *pool, cos_checkpoint_t *checkpoint, cos_string_t *file_path, 
                                  apr_finfo_t *finfo, cos_string_t *upload_id, int64_t part_size);
 
+/*
+ * rewrite the whole checkpoint file with the header and a snapshot, the appended part records are dropped
+ */
 int cos_dump_checkpoint(cos_pool_t *pool, const cos_checkpoint_t *checkpoint);
 
+/*
+ * append the record of a completed part to the checkpoint file, the file is
+ * synced every COS_CHECKPOINT_SYNC_RECORDS records and compacted by dump when
+ * the records outnumber both COS_CHECKPOINT_COMPACT_RECORDS and a quarter of the parts
+ */
+int cos_append_checkpoint_part(cos_pool_t *pool, cos_checkpoint_t *checkpoint, const cos_checkpoint_part_t *part);
+
+/*
+ * sync the appended part records and close the checkpoint file
+ */
+void cos_close_checkpoint_file(cos_checkpoint_t *checkpoint);
+
+/*
+ * load the snapshot and replay the part records, a torn or broken record ends
+ * the replay and the records after it are ignored, a checkpoint of plain xml is loaded too
+ */
 int cos_load_checkpoint(cos_pool_t *pool, const cos_string_t *filepath, cos_checkpoint_t *checkpoint);
 
 int cos_is_upload_checkpoint_valid(cos_pool_t *pool, cos_checkpoint_t *checkpoint, apr_finfo_t *finfo);
 
+void cos_build_download_checkpoint(cos_pool_t *pool, cos_checkpoint_t *checkpoint, cos_string_t *file_path,
+                                   cos_string_t *object, int64_t object_size, cos_string_t *last_modified,
+                                   cos_string_t *etag, int64_t part_size);
+
+/*
+ * a download checkpoint is valid only if the object is unchanged since it was built
+ */
+int cos_is_download_checkpoint_valid(cos_pool_t *pool, cos_checkpoint_t *checkpoint, cos_string_t *file_path,
+                                     cos_string_t *object, int64_t object_size, cos_string_t *last_modified,
+                                     cos_string_t *etag);
+
+/*
+ * read back the completed parts which have crc64 from the local file, the
+ * parts whose crc64 mismatch are marked uncompleted to be downloaded again
+ * @return the number of parts marked uncompleted, -1 if the file can not be read
+ */
+int cos_verify_download_checkpoint_parts(cos_pool_t *pool, cos_checkpoint_t *checkpoint, const char *filepath);
+
+void cos_build_copy_checkpoint(cos_pool_t *pool, cos_checkpoint_t *checkpoint, cos_string_t *dest,
+                               cos_string_t *copy_source, int64_t object_size, cos_string_t *last_modified,
+                               cos_string_t *etag, cos_string_t *upload_id, int64_t part_size);
+
+/*
+ * a copy checkpoint is valid only if the source is unchanged since it was built
+ */
+int cos_is_copy_checkpoint_valid(cos_pool_t *pool, cos_checkpoint_t *checkpoint, cos_string_t *dest,
+                                 cos_string_t *copy_source, int64_t object_size, cos_string_t *last_modified,
+                                 cos_string_t *etag);
+
 void cos_update_checkpoint(cos_pool_t *pool, cos_checkpoint_t *checkpoint, int32_t part_index, cos_string_t *etag);
 
+void cos_update_checkpoint_crc64(cos_checkpoint_t *checkpoint, const cos_checkpoint_part_t *part);
+
+/*
+ * combine the crc64 of all parts into the crc64 of the whole object,
+ * return COS_FALSE if the crc64 of any part is unknown
+ */
+int cos_get_parts_crc64(const cos_checkpoint_part_t *parts, int part_num, uint64_t *crc64);
+
+/*
+ * verify the combined crc64 of parts against the x-cos-hash-crc64ecma of the
+ * assembled object, taken from complete response headers or a following head,
+ * s is set to COSE_CRC_INCONSISTENT_ERROR if they are not equal
+ */
+void cos_check_parts_crc64_consistent(cos_request_options_t *options,
+                                      const cos_string_t *bucket,
+                                      const cos_string_t *object,
+                                      const cos_checkpoint_part_t *parts,
+                                      int part_num,
+                                      cos_table_t *complete_resp_headers,
+                                      cos_status_t *s);
+
 void cos_get_checkpoint_undo_parts(cos_checkpoint_t *checkpoint, int *part_num, cos_checkpoint_part_t *parts);
 
 void * APR_THREAD_FUNC upload_part(apr_thread_t *thd, void *data);
@@ -191,6 +470,16 @@ cos_status_t *cos_resumable_download_file_without_cp(cos_request_options_t *opti
                                                    int64_t part_size,
                                                    cos_progress_callback progress_callback);
 
+cos_status_t *cos_resumable_download_file_with_cp(cos_request_options_t *options,
+                                                cos_string_t *bucket, 
+                                                cos_string_t *object, 
+                                                cos_string_t *filepath,                           
+                                                cos_table_t *headers,
+                                                cos_table_t *params,
+                                                int32_t thread_num,
+                                                int64_t part_size,
+                                                cos_string_t *checkpoint_path,
+                                                cos_progress_callback progress_callback);
 
 
 COS_CPP_END
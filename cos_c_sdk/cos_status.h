@@ -53,6 +53,8 @@ extern const char COS_INCONSISTENT_ERROR_CODE[];
 extern const char COS_CREATE_QUEUE_ERROR_CODE[];
 extern const char COS_CREATE_THREAD_POOL_ERROR_CODE[];
 extern const char COS_LACK_OF_CONTENT_LEN_ERROR_CODE[];
+extern const char COS_CANCELED_ERROR_CODE[];
+extern const char COS_DELETE_OBJECTS_ERROR_CODE[];
 
 COS_CPP_END
 
@@ -59,6 +59,7 @@ typedef enum {
     COSE_CRC_INCONSISTENT_ERROR = -978,
     COSE_FILE_FLUSH_ERROR = -977,
     COSE_FILE_TRUNC_ERROR = -976,
+    COSE_CANCELED_ERROR = -975,
     COSE_UNKNOWN_ERROR = -100
 } cos_error_code_e;
 
@@ -90,10 +91,15 @@ typedef apr_array_header_t cos_array_header_t;
 
 #define cos_pool_create(n, p) apr_pool_create(n, p)
 #define cos_pool_destroy(p) apr_pool_destroy(p)
+#define cos_pool_clear(p) apr_pool_clear(p)
 #define cos_palloc(p, s) apr_palloc(p, s)
 #define cos_pcalloc(p, s) apr_pcalloc(p, s)
 
 #define COS_RETRY_TIME 2
+#define COS_PART_MAX_RETRY_TIME 5
+#define COS_PART_MIN_RETRY_BUDGET 16
+#define COS_PART_RETRY_BASE_DELAY (200*1000L)      // usec, doubled on every retry of a part
+#define COS_PART_RETRY_MAX_DELAY (10*1000*1000L)   // usec
 
 #define COS_INIT_WINSOCK 1
 #define COS_MD5_STRING_LEN 32
@@ -110,8 +116,33 @@ typedef apr_array_header_t cos_array_header_t;
 #define COS_MIN_SPEED_LIMIT 8
 #define COS_MIN_SPEED_TIME 120
 #define COS_MAX_MEMORY_SIZE 1024*1024*1024L
+#define COS_MAX_READ_AHEAD_SIZE 512*1024*1024L
 #define COS_MAX_PART_SIZE 512*1024*1024L
 #define COS_DEFAULT_PART_SIZE 1024*1024L
+#define COS_MIN_AUTO_PART_SIZE (1024*1024L)
+#define COS_MAX_AUTO_PART_SIZE (64*1024*1024L)
+#define COS_AUTO_PART_SECONDS 4          // the seconds one connection takes to transfer an auto sized part
+#define COS_AUTO_PARTS_PER_THREAD 4      // the parts per thread if the bandwidth is unknown
+#define COS_AUTO_INIT_THREAD_NUM 2
+#define COS_AUTO_MAX_THREAD_NUM 16
+#define COS_PREFETCH_PART_NUM 2          // the parts read ahead of the parts in flight
+#define COS_PREFETCH_BUFFER_ALIGN 4096
+#define COS_CHECKPOINT_SYNC_RECORDS 32      // the part records appended between two fsync of checkpoint
+#define COS_CHECKPOINT_COMPACT_RECORDS 1024 // the least part records appended before checkpoint compaction
+#define COS_PROGRESS_INTERVAL 500000        // the default microsecond between two progress reports
+#define COS_DIR_SMALL_FILE_SIZE 8*1024*1024L // the files of directory transfer not larger are sent as whole objects
+#define COS_DELETE_OBJECTS_MAX_NUM 1000     // the keys of one delete objects request at most
+#define COS_DELETE_PREFIX_THREAD_NUM 4      // the default delete requests in flight of delete by prefix
+#define COS_DELETE_PREFIX_RETRY_NUM 3       // the default rounds failed keys of delete by prefix are retried
+#define COS_LIST_PARALLEL_THREAD_NUM 8      // the default partitions listed at the same time by parallel listing
+#define COS_LIST_PARALLEL_BUFFER_PAGES 2    // the default pages of the later partitions buffered per thread by ordered listing
+#define COS_LIST_ITERATOR_PAGES 2           // the pages of list iterator, one consumed and one fetched
+#define COS_XML_STREAM_MAX_DEPTH 16         // the elements nested of the xml parsed by streaming
+#define COS_XML_STREAM_MAX_NAME 64          // the longest element name of the xml parsed by streaming
+#define COS_XML_STREAM_MAX_TEXT 8192        // the longest text of an element, before the entities are decoded
+#define COS_LIST_PARSER_RECORD_SIZE 16384   // the text of all fields of one record of the list parser
+#define COS_LIST_COMPACT_INIT_NUM 1024      // the objects the columns of compact listing hold at first
+#define COS_DIGEST_CACHE_MAX_ENTRIES 16384  // the ranges kept by the digest cache, the oldest is evicted
 
 #define COS_REQUEST_STACK_SIZE 32
 
@@ -4,6 +4,7 @@
 #include "cos_http_io.h"
 #include "cos_transport.h"
 #include "cos_crc64.h"
+#include "cos_progress.h"
 
 int cos_curl_code_to_status(CURLcode code);
 static void cos_init_curl_headers(cos_curl_http_transport_t *t);
@@ -295,6 +296,9 @@ size_t cos_curl_default_write_callback(char *ptr, size_t size, size_t nmemb, voi
         if (NULL != t->resp->progress_callback) {
             t->resp->progress_callback(t->resp->body_len, t->resp->content_length);
         }
+        if (NULL != t->controller->progress) {
+            cos_progress_update(t->controller->progress, bytes);
+        }
 
         // crc
         if (t->controller->options->enable_crc) {
@@ -334,9 +338,12 @@ size_t cos_curl_default_read_callback(char *buffer, size_t size, size_t nitems,
         if (NULL != t->req->progress_callback) {
             t->req->progress_callback(t->req->consumed_bytes, t->req->body_len);
         }
+        if (NULL != t->controller->progress) {
+            cos_progress_update(t->controller->progress, bytes);
+        }
 
         // crc
-        if (t->controller->options->enable_crc) {
+        if (t->controller->options->enable_crc && !t->req->crc64_ready) {
             t->req->crc64 = cos_crc64(t->req->crc64, buffer, bytes);
         }
     }
@@ -496,6 +503,14 @@ do_retry:
         }
     }
     
+    // the bytes of a failed request are sent or received again by its retry
+    if (NULL != t->controller->progress && 
+        (t->controller->error_code != COSE_OK || t->resp->status < 200 || t->resp->status > 299)) 
+    {
+        cos_progress_update(t->controller->progress, -(t->req->consumed_bytes + 
+            (t->resp->status >= 200 && t->resp->status <= 299 ? t->resp->body_len : 0)));
+    }
+
     cos_curl_transport_finish(t);
     
     return t->controller->error_code;
@@ -31,6 +31,10 @@ struct cos_http_request_options_s {
     int dns_cache_timeout;
     int connect_timeout;
     int64_t max_memory_size;
+    int64_t read_ahead_size;
+    int download_temp_file;
+    struct cos_digest_cache_s *digest_cache;
+    struct cos_transfer_pool_s *transfer_pool;
     int enable_crc;
     int enable_md5;
     char *proxy_host;
@@ -52,6 +56,8 @@ struct cos_http_transport_options_s {
     int64_t first_byte_time;                    \
     int64_t finish_time;                        \
     uint32_t owner:1;                           \
+    apr_uint32_t *cancel;                       \
+    struct cos_progress_s *progress;            \
     void *user_data;
 
 struct cos_http_controller_s {
@@ -95,6 +101,7 @@ struct cos_http_request_s {
 
     cos_progress_callback progress_callback;
     uint64_t crc64;
+    int crc64_ready;    // crc64 of body is calculated before sending
     int64_t  consumed_bytes;
 };
 
@@ -106,6 +113,7 @@ struct cos_http_response_s {
     int64_t body_len;
     char *file_path;
     cos_file_buf_t* file_buf;
+    cos_buf_t *range_buf;   // the caller memory the body is written to, see cos_write_http_body_range_buffer
     int64_t content_length;
 
     cos_pool_t *pool;
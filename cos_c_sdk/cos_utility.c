@@ -4,6 +4,9 @@
 #include "cos_status.h"
 #include "cos_auth.h"
 #include "cos_utility.h"
+#include "cos_crc64.h"
+#include "cos_digest_cache.h"
+#include "apr_atomic.h"
 
 #ifndef WIN32
 #include<sys/socket.h>
@@ -463,6 +466,44 @@ int cos_init_read_response_body_to_file_part(cos_pool_t *p,
     return res;
 }
 
+int cos_init_read_response_body_to_shared_file(cos_pool_t *p, 
+                                               cos_upload_file_t *download_file,
+                                               apr_file_t *file,
+                                               cos_http_response_t *resp)
+{
+    cos_file_buf_t *fb = cos_create_file_buf(p);
+
+    // the file is owned by the caller and written at the part offset
+    fb->file = file;
+    fb->owner = 0;
+    fb->file_pos = download_file->file_pos;
+    fb->file_last = download_file->file_last;
+    resp->file_path = download_file->filename.data;
+    resp->file_buf = fb;
+    resp->write_body = cos_write_http_body_shared_file;
+    resp->type = BODY_IN_FILE;
+
+    return COSE_OK;
+}
+
+int cos_init_read_response_body_to_range_buffer(cos_pool_t *p, 
+                                                cos_upload_file_t *download_file,
+                                                char *buffer,
+                                                cos_http_response_t *resp)
+{
+    cos_buf_t *b = (cos_buf_t *)cos_pcalloc(p, sizeof(cos_buf_t));
+
+    // the memory is owned by the caller, a retry writes the range again from its start
+    b->start = (uint8_t *)buffer;
+    b->pos = b->start;
+    b->last = b->start;
+    b->end = b->start + (download_file->file_last - download_file->file_pos);
+    resp->range_buf = b;
+    resp->write_body = cos_write_http_body_range_buffer;
+    resp->type = BODY_IN_CALLBACK;
+
+    return COSE_OK;
+}
 
 void cos_fill_read_response_header(cos_http_response_t *resp, 
                                    cos_table_t **headers)
@@ -586,6 +627,20 @@ cos_list_object_params_t *cos_create_list_object_params(cos_pool_t *p)
     return params;
 }
 
+cos_list_object_parallel_params_t *cos_create_list_object_parallel_params(cos_pool_t *p)
+{
+    cos_list_object_parallel_params_t *params;
+    params = (cos_list_object_parallel_params_t *)cos_pcalloc(
+            p, sizeof(cos_list_object_parallel_params_t));
+    cos_str_set(&params->prefix, "");
+    cos_str_set(&params->delimiter, "/");
+    cos_list_init(&params->split_list);
+    cos_list_init(&params->object_list);
+    params->thread_num = COS_LIST_PARALLEL_THREAD_NUM;
+    params->ordered = COS_TRUE;
+    return params;
+}
+
 cos_list_upload_part_params_t *cos_create_list_upload_part_params(cos_pool_t *p)
 {
     cos_list_upload_part_params_t *params;
@@ -825,6 +880,16 @@ cos_object_key_t *cos_create_cos_object_key(cos_pool_t *p)
     return (cos_object_key_t *)cos_pcalloc(p, sizeof(cos_object_key_t));
 }
 
+cos_delete_by_prefix_params_t *cos_create_delete_by_prefix_params(cos_pool_t *p)
+{
+    cos_delete_by_prefix_params_t *params;
+    params = (cos_delete_by_prefix_params_t *)cos_pcalloc(p, sizeof(cos_delete_by_prefix_params_t));
+    params->thread_num = COS_DELETE_PREFIX_THREAD_NUM;
+    params->max_retries = COS_DELETE_PREFIX_RETRY_NUM;
+    cos_list_init(&params->failed_list);
+    return params;
+}
+
 #if 0
 cos_live_channel_publish_url_t *cos_create_live_channel_publish_url(cos_pool_t *p)
 {
@@ -1106,6 +1171,73 @@ int part_sort_cmp(const void *a, const void *b)
             ((cos_upload_part_t*)b)->part_num > 0 ? 1 : -1);
 }
 
+cos_part_index_t *cos_create_part_index(cos_pool_t *p, int max_part_num)
+{
+    cos_part_index_t *index;
+    index = (cos_part_index_t *)cos_pcalloc(p, sizeof(cos_part_index_t));
+    index->max_part_num = max_part_num;
+    index->bitmap = (unsigned char *)cos_pcalloc(p, (max_part_num + 7) / 8);
+    index->etags = (char **)cos_pcalloc(p, sizeof(char *) * max_part_num);
+    index->sizes = (int64_t *)cos_pcalloc(p, sizeof(int64_t) * max_part_num);
+    return index;
+}
+
+int cos_part_index_set(cos_part_index_t *index, int part_number, char *etag, int64_t size)
+{
+    int i = part_number - 1;
+    if (part_number < 1 || part_number > index->max_part_num) {
+        return COSE_INVALID_ARGUMENT;
+    }
+    if (!(index->bitmap[i / 8] & (1 << (i % 8)))) {
+        index->bitmap[i / 8] |= (unsigned char)(1 << (i % 8));
+        index->count++;
+    }
+    index->etags[i] = etag;
+    index->sizes[i] = size;
+    return COSE_OK;
+}
+
+int cos_part_index_has(const cos_part_index_t *index, int part_number)
+{
+    int i = part_number - 1;
+    if (part_number < 1 || part_number > index->max_part_num) {
+        return COS_FALSE;
+    }
+    return (index->bitmap[i / 8] & (1 << (i % 8))) ? COS_TRUE : COS_FALSE;
+}
+
+int cos_part_index_get_missing(const cos_part_index_t *index, int part_num, int *missing)
+{
+    int n = 1;
+    int count = 0;
+    for (; n <= part_num; n++) {
+        if (!cos_part_index_has(index, n)) {
+            missing[count++] = n;
+        }
+    }
+    return count;
+}
+
+int cos_part_index_get_completed(const cos_part_index_t *index, cos_pool_t *p, int part_num, 
+                                 cos_list_t *complete_part_list)
+{
+    cos_complete_part_content_t *complete_content = NULL;
+    int n = 1;
+    int count = 0;
+    part_num = cos_min(part_num, index->max_part_num);
+    for (; n <= part_num; n++) {
+        if (!cos_part_index_has(index, n)) {
+            continue;
+        }
+        complete_content = cos_create_complete_part_content(p);
+        cos_str_set(&complete_content->part_number, apr_psprintf(p, "%d", n));
+        cos_str_set(&complete_content->etag, index->etags[n - 1]);
+        cos_list_add_tail(&complete_content->node, complete_part_list);
+        count++;
+    }
+    return count;
+}
+
 char *get_content_type_by_suffix(const char *suffix)
 {
     cos_content_type_t *content_type;
@@ -1281,6 +1413,25 @@ int cos_add_content_md5_from_buffer(const cos_request_options_t *options,
     return 0;
 }
 
+static int cos_add_content_md5_from_digest_cache(const cos_request_options_t *options,
+                                                 const char *filename,
+                                                 int64_t file_pos,
+                                                 int64_t file_last,
+                                                 cos_table_t *headers)
+{
+    cos_digest_t digest;
+    int res;
+
+    res = cos_get_file_range_digest(options->pool, options->ctl->options->digest_cache, 
+                                    filename, file_pos, file_last, &digest);
+    if (res != COSE_OK) {
+        return res;
+    }
+    apr_table_addn(headers, COS_CONTENT_MD5, apr_pstrdup(options->pool, digest.content_md5));
+
+    return 0;
+}
+
 int cos_add_content_md5_from_file(const cos_request_options_t *options,
                                   const cos_string_t *filename,
                                   cos_table_t *headers)
@@ -1307,6 +1458,11 @@ int cos_add_content_md5_from_file(const cos_request_options_t *options,
         return 0;
     }
 
+    /* use the cached digest of unchanged file */
+    if (NULL != options->ctl->options->digest_cache) {
+        return cos_add_content_md5_from_digest_cache(options, filename->data, 0, INT64_MAX, headers);
+    }
+
     /* open input file */
     if ((s = apr_file_open(&thefile, filename->data, APR_READ, APR_UREAD | APR_GREAD, options->pool)) != APR_SUCCESS) {
         return COSE_OPEN_FILE_ERROR;
@@ -1379,6 +1535,12 @@ int cos_add_content_md5_from_file_range(const cos_request_options_t *options,
         return 0;
     }
 
+    /* use the cached digest of unchanged file */
+    if (NULL != options->ctl->options->digest_cache) {
+        return cos_add_content_md5_from_digest_cache(options, upload_file->filename.data, 
+                                                     upload_file->file_pos, upload_file->file_last, headers);
+    }
+
     /* open input file */
     if ((s = apr_file_open(&thefile, upload_file->filename.data, APR_READ, APR_UREAD | APR_GREAD, options->pool)) != APR_SUCCESS) {
         return COSE_OPEN_FILE_ERROR;
@@ -1433,6 +1595,168 @@ int cos_add_content_md5_from_file_range(const cos_request_options_t *options,
     return 0;
 }
 
+int cos_is_read_ahead_upload_file(const cos_request_options_t *options,
+                                  const cos_upload_file_t *upload_file)
+{
+    int64_t size = upload_file->file_last - upload_file->file_pos;
+    int64_t read_ahead_size = options->ctl->options->read_ahead_size;
+
+    return read_ahead_size > 0 && size > 0 && size <= read_ahead_size;
+}
+
+int cos_read_ahead_upload_file(const cos_request_options_t *options,
+                               cos_upload_file_t *upload_file,
+                               cos_table_t *headers,
+                               cos_list_t *buffer,
+                               uint64_t *crc64)
+{
+    char *b64_value = NULL;
+    int b64_buf_len = (20 + 1) * 4 / 3;
+    int b64_len;
+    unsigned char md5_data[APR_MD5_DIGESTSIZE + 1];
+    apr_md5_ctx_t context;
+    apr_file_t *thefile;
+    apr_finfo_t finfo;
+    cos_buf_t *content;
+    int s;
+    int need_md5;
+    int need_crc;
+    apr_size_t nbytes;
+    apr_size_t bytes_left;
+    apr_off_t offset;
+    apr_off_t file_last;
+
+    need_md5 = is_enable_md5(options) && NULL == apr_table_get(headers, COS_CONTENT_MD5);
+    need_crc = is_enable_crc(options);
+    *crc64 = 0;
+
+    /* open input file */
+    if ((s = apr_file_open(&thefile, upload_file->filename.data, APR_READ, APR_UREAD | APR_GREAD, options->pool)) != APR_SUCCESS) {
+        return COSE_OPEN_FILE_ERROR;
+    }
+    if ((s = apr_file_info_get(&finfo, APR_FINFO_NORM, thefile)) != APR_SUCCESS) {
+        apr_file_close(thefile);
+        return COSE_FILE_INFO_ERROR;
+    }
+    offset = upload_file->file_pos;
+    if ((s = apr_file_seek(thefile, APR_SET, &offset)) != APR_SUCCESS) {
+        apr_file_close(thefile);
+        return COSE_FILE_SEEK_ERROR;
+    }
+    file_last = cos_min(finfo.size, upload_file->file_last);
+    if (offset >= file_last) {
+        apr_file_close(thefile);
+        return COSE_FILE_INFO_ERROR;
+    }
+    bytes_left = file_last - offset;
+
+    content = cos_create_buf(options->pool, (int)bytes_left);
+    if (NULL == content) {
+        apr_file_close(thefile);
+        return COSE_OUT_MEMORY;
+    }
+    if (need_md5 && 0 != apr_md5_init(&context)) {
+        apr_file_close(thefile);
+        return COSE_INTERNAL_ERROR;
+    }
+
+    /* read once, digest the chunk while it is hot in cache */
+    while (bytes_left) {
+        nbytes = cos_min(64 * 1024, bytes_left);
+        if ((s = apr_file_read(thefile, content->last, &nbytes)) != APR_SUCCESS) {
+            apr_file_close(thefile);
+            return COSE_FILE_READ_ERROR;
+        }
+        if (need_md5 && 0 != apr_md5_update(&context, content->last, nbytes)) {
+            apr_file_close(thefile);
+            return COSE_INTERNAL_ERROR;
+        }
+        if (need_crc) {
+            *crc64 = cos_crc64(*crc64, content->last, nbytes);
+        }
+        content->last += nbytes;
+        bytes_left -= nbytes;
+    }
+    apr_file_close(thefile);
+    cos_list_add_tail(&content->node, buffer);
+
+    if (!need_md5) {
+        return COSE_OK;
+    }
+    if (0 != apr_md5_final(md5_data, &context)) {
+        return COSE_INTERNAL_ERROR;
+    }
+    md5_data[APR_MD5_DIGESTSIZE] = '\0';
+
+    /* add content-md5 header */
+    b64_value = cos_pcalloc(options->pool, b64_buf_len);
+    b64_len = cos_base64_encode(md5_data, 16, b64_value);
+    b64_value[b64_len] = '\0';
+    apr_table_addn(headers, COS_CONTENT_MD5, b64_value);
+
+    return COSE_OK;
+}
+
+void cos_write_request_body_from_read_ahead(cos_list_t *buffer,
+                                            const cos_request_options_t *options,
+                                            uint64_t crc64,
+                                            cos_http_request_t *req)
+{
+    cos_write_request_body_from_buffer(buffer, req);
+    if (is_enable_crc(options)) {
+        req->crc64 = crc64;
+        req->crc64_ready = COS_TRUE;
+    }
+}
+
+// a controller starts with the process-wide default options, they are copied before a change
+static cos_http_request_options_t *cos_get_own_request_options(cos_http_controller_t *ctl)
+{
+    cos_http_request_options_t *options;
+
+    if (ctl->options == cos_default_http_request_options) {
+        options = cos_http_request_options_create(ctl->pool);
+        *options = *ctl->options;
+        ctl->options = options;
+    }
+    return ctl->options;
+}
+
+void cos_set_read_ahead_size(cos_http_controller_t *ctl, int64_t size)
+{
+    cos_get_own_request_options(ctl)->read_ahead_size = cos_min(cos_max(size, 0), COS_MAX_READ_AHEAD_SIZE);
+}
+
+void cos_set_digest_cache(cos_http_controller_t *ctl, struct cos_digest_cache_s *cache)
+{
+    cos_get_own_request_options(ctl)->digest_cache = cache;
+}
+
+void cos_set_transfer_pool(cos_http_controller_t *ctl, struct cos_transfer_pool_s *transfer_pool)
+{
+    cos_get_own_request_options(ctl)->transfer_pool = transfer_pool;
+}
+
+void cos_set_download_temp_file(cos_http_controller_t *ctl, int enable)
+{
+    cos_get_own_request_options(ctl)->download_temp_file = enable;
+}
+
+void cos_set_cancel_flag(cos_http_controller_t *ctl, apr_uint32_t *cancel)
+{
+    ctl->cancel = cancel;
+}
+
+void cos_set_progress(cos_http_controller_t *ctl, struct cos_progress_s *progress)
+{
+    ctl->progress = progress;
+}
+
+int cos_is_canceled(cos_http_controller_t *ctl)
+{
+    return NULL != ctl->cancel && apr_atomic_read32(ctl->cancel) != 0;
+}
+
 void cos_set_content_md5_enable(cos_http_controller_t *ctl, int enable)
 {
     ctl->options->enable_md5 = enable;
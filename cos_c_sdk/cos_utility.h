@@ -192,6 +192,12 @@ cos_get_service_params_t *cos_create_get_service_params(cos_pool_t *p);
   * @return cos api list parameters
 **/
 cos_list_object_params_t *cos_create_list_object_params(cos_pool_t *p);
+
+/**
+  * @brief  create cos api parallel list parameters
+  * @return cos api parallel list parameters
+**/
+cos_list_object_parallel_params_t *cos_create_list_object_parallel_params(cos_pool_t *p);
 cos_list_upload_part_params_t *cos_create_list_upload_part_params(cos_pool_t *p);
 cos_list_multipart_upload_params_t *cos_create_list_multipart_upload_params(cos_pool_t *p);
 cos_list_live_channel_params_t *cos_create_list_live_channel_params(cos_pool_t *p);
@@ -284,6 +290,12 @@ cos_object_restore_params_t *cos_create_object_restore_params(cos_pool_t *p);
 **/
 cos_object_key_t *cos_create_cos_object_key(cos_pool_t *p);
 
+/**
+  * @brief  create the parameters of delete objects by prefix
+  * @return the parameters of delete objects by prefix
+**/
+cos_delete_by_prefix_params_t *cos_create_delete_by_prefix_params(cos_pool_t *p);
+
 /**
   * @brief  create cos live channel publish url content for delete objects
   * @return cos live channel publish url content
@@ -337,6 +349,37 @@ void cos_get_part_size(int64_t filesize, int64_t *part_size);
 **/
 int part_sort_cmp(const void *a, const void *b);
 
+/**
+  * @brief  create an empty part index for part number 1 to max_part_num
+**/
+cos_part_index_t *cos_create_part_index(cos_pool_t *p, int max_part_num);
+
+/**
+  * @brief  index a part, the part indexed before is replaced
+  * @return COSE_OK success, COSE_INVALID_ARGUMENT part number out of range
+**/
+int cos_part_index_set(cos_part_index_t *index, int part_number, char *etag, int64_t size);
+
+/**
+  * @brief  get if the part is indexed
+  * @return COS_TRUE indexed, COS_FALSE not
+**/
+int cos_part_index_has(const cos_part_index_t *index, int part_number);
+
+/**
+  * @brief  get the part numbers from 1 to part_num not indexed, in order
+  * @param[out]   missing   room for part_num part numbers
+  * @return the number of parts missing
+**/
+int cos_part_index_get_missing(const cos_part_index_t *index, int part_num, int *missing);
+
+/**
+  * @brief  append the indexed parts from 1 to part_num to the list of complete part content, in order
+  * @return the number of parts appended
+**/
+int cos_part_index_get_completed(const cos_part_index_t *index, cos_pool_t *p, int part_num, 
+                                 cos_list_t *complete_part_list);
+
 /**
   * @brief  set content type for object according to objectname
   * @return cos content type
@@ -373,6 +416,24 @@ int cos_init_read_response_body_to_file_part(cos_pool_t *p,
                                         cos_upload_file_t *download_file,
                                         cos_http_response_t *resp);
 
+/**
+ * @brief write the response body at the range of download_file in the shared file,
+ *        see cos_open_file_for_shared_write
+**/
+int cos_init_read_response_body_to_shared_file(cos_pool_t *p, 
+                                               cos_upload_file_t *download_file,
+                                               apr_file_t *file,
+                                               cos_http_response_t *resp);
+
+/**
+ * @brief write the response body of the range of download_file to buffer, 
+ *        the memory of the range in the memory shared by parts
+**/
+int cos_init_read_response_body_to_range_buffer(cos_pool_t *p, 
+                                                cos_upload_file_t *download_file,
+                                                char *buffer,
+                                                cos_http_response_t *resp);
+
 /**
  * @brief add Content-MD5 header, md5 calculated from buffer
 **/
@@ -394,6 +455,91 @@ int cos_add_content_md5_from_file_range(const cos_request_options_t *options,
                                   cos_upload_file_t *upload_file,
                                   cos_table_t *headers);
 
+/**
+ * @brief whether the upload file range is small enough to be read ahead into memory
+**/
+int cos_is_read_ahead_upload_file(const cos_request_options_t *options,
+                                  const cos_upload_file_t *upload_file);
+
+/**
+ * @brief read the upload file range into memory in a single pass, calculating
+ *        Content-MD5 and crc64 on the way, so the body is sent from memory
+ *        without reading the file a second time
+ * @param[out] buffer   the content of the file range
+ * @param[out] crc64    the crc64 of the content, valid when crc is enabled
+**/
+int cos_read_ahead_upload_file(const cos_request_options_t *options,
+                               cos_upload_file_t *upload_file,
+                               cos_table_t *headers,
+                               cos_list_t *buffer,
+                               uint64_t *crc64);
+
+/**
+ * @brief send body from memory which is read ahead from upload file
+**/
+void cos_write_request_body_from_read_ahead(cos_list_t *buffer,
+                                            const cos_request_options_t *options,
+                                            uint64_t crc64,
+                                            cos_http_request_t *req);
+
+/*
+ * the setters below change the options of ctl only, on the first change ctl gets its own copy
+ * of the process-wide default options from ctl->pool, the request options sharing ctl see it too
+ */
+
+/**
+ * @brief set the max size of file body read ahead into memory for upload
+ * @param[in] size    0: disable read ahead, the file is read once for Content-MD5 and once for sending;
+ *                    other: file body not larger than size is read once, hashed and sent from memory
+**/
+void cos_set_read_ahead_size(cos_http_controller_t *ctl, int64_t size);
+
+/**
+ * @brief set the digest cache consulted for Content-MD5 of files
+ * @param[in] cache    NULL: md5 is calculated by reading file every time;
+ *                     other: md5 of unchanged file range is taken from cache, see cos_digest_cache_create,
+ *                     reset to NULL before cos_digest_cache_destroy if ctl is still used
+**/
+void cos_set_digest_cache(cos_http_controller_t *ctl, struct cos_digest_cache_s *cache);
+
+/**
+ * @brief set the transfer pool the part tasks of resumable upload, download and copy run on
+ * @param[in] transfer_pool    NULL: every transfer creates and destroys its own threads;
+ *                             other: the threads are shared by transfers, see cos_transfer_pool_create,
+ *                             reset to NULL before cos_transfer_pool_destroy if ctl is still used
+**/
+void cos_set_transfer_pool(cos_http_controller_t *ctl, struct cos_transfer_pool_s *transfer_pool);
+
+/**
+ * @brief whether multi-threaded download writes a temporary file, e.g. cos_resumable_download_file_without_cp
+ * @param[in] enable    COS_FALSE: parts are written to the destination file directly;
+ *                      COS_TRUE: parts are written to filepath.tmp, which is renamed to filepath on success
+ *                      and removed on failure, so a half-written destination is never visible
+**/
+void cos_set_download_temp_file(cos_http_controller_t *ctl, int enable);
+
+/**
+ * @brief set the flag to cancel multi-threaded transfers, e.g. cos_resumable_upload_file
+ * @param[in] cancel    NULL: the transfer can not be canceled;
+ *                      other: set *cancel to non zero with apr_atomic_set32 from any thread to cancel,
+ *                      the parts in flight are finished and the transfer fails with COSE_CANCELED_ERROR
+**/
+void cos_set_cancel_flag(cos_http_controller_t *ctl, apr_uint32_t *cancel);
+
+/**
+ * @brief set the progress the bytes of the transfer are summed to, e.g. cos_resumable_upload_file
+ * @param[in] progress    NULL: no progress is summed;
+ *                        other: bytes of all parts in flight are counted and reported at the
+ *                        interval of the progress, see cos_progress_create
+**/
+void cos_set_progress(cos_http_controller_t *ctl, struct cos_progress_s *progress);
+
+/**
+ * @brief whether the cancel flag of the controller is set
+ * @return COS_TRUE canceled, COS_FALSE not
+**/
+int cos_is_canceled(cos_http_controller_t *ctl);
+
 /**
  * @brief set flag of adding Content-MD5 header
  * @param[in] enable    COS_TRUE: sdk will add Content-MD5 automatically; COS_FALSE:sdk does not add Content-MD5
@@ -1930,6 +1930,54 @@ int cos_delete_objects_parse_from_body(cos_pool_t *p, cos_list_t *bc, cos_list_t
     return res;
 }
 
+void cos_object_delete_error_parse(cos_pool_t *p, mxml_node_t *xml_node, cos_object_delete_error_t *content)
+{
+    char *key;
+    char *value;
+    const char *node_content;
+    mxml_node_t *node;
+
+    node = mxmlFindElement(xml_node, xml_node, "Key", NULL, NULL, MXML_DESCEND);
+    node_content = mxmlGetOpaque(node);
+    if (node_content != NULL) {
+        key = (char *)cos_palloc(p, strlen(node_content) + 1);
+        cos_url_decode(node_content, key);
+        cos_str_set(&content->key, key);
+    }
+
+    value = get_xmlnode_value(p, xml_node, "Code");
+    if (value != NULL) {
+        cos_str_set(&content->code, value);
+    }
+    value = get_xmlnode_value(p, xml_node, "Message");
+    if (value != NULL) {
+        cos_str_set(&content->message, value);
+    }
+}
+
+int cos_delete_objects_error_parse_from_body(cos_pool_t *p, cos_list_t *bc, cos_list_t *error_list)
+{
+    int res;
+    mxml_node_t *root = NULL;
+    mxml_node_t *node;
+    cos_object_delete_error_t *content;
+    const char error_xml_path[] = "Error";
+
+    res = get_xmldoc(bc, &root);
+    if (res == COSE_OK) {
+        node = mxmlFindElement(root, root, error_xml_path, NULL, NULL, MXML_DESCEND);
+        for ( ; node != NULL; ) {
+            content = (cos_object_delete_error_t *)cos_pcalloc(p, sizeof(cos_object_delete_error_t));
+            cos_object_delete_error_parse(p, node, content);
+            cos_list_add_tail(&content->node, error_list);
+            node = mxmlFindElement(node, root, error_xml_path, NULL, NULL, MXML_DESCEND);
+        }
+        mxmlDelete(root);
+    }
+
+    return res;
+}
+
 #if 0
 void cos_publish_url_parse(cos_pool_t *p, mxml_node_t *node, cos_live_channel_publish_url_t *content)
 {   
@@ -2537,6 +2585,15 @@ mxml_node_t	*set_xmlnode_value_int64(mxml_node_t *parent, const char *name, int6
     return mxmlNewText(node, 0, buff);
 }
 
+mxml_node_t	*set_xmlnode_value_uint64(mxml_node_t *parent, const char *name, uint64_t value)
+{
+    mxml_node_t *node;
+    char buff[COS_MAX_INT64_STRING_LEN];
+    node = mxmlNewElement(parent, name);
+    apr_snprintf(buff, COS_MAX_INT64_STRING_LEN, "%" APR_UINT64_T_FMT, value);
+    return mxmlNewText(node, 0, buff);
+}
+
 int get_xmlnode_value_str(cos_pool_t *p, mxml_node_t *xml_node, const char *xml_path, cos_string_t *value)
 {
     char *node_content;
@@ -2570,6 +2627,17 @@ int get_xmlnode_value_int64(cos_pool_t *p, mxml_node_t *xml_node, const char *xm
     return COS_TRUE;
 }
 
+int get_xmlnode_value_uint64(cos_pool_t *p, mxml_node_t *xml_node, const char *xml_path, uint64_t *value)
+{
+    char *node_content;
+    node_content = get_xmlnode_value(p, xml_node, xml_path);
+    if (NULL == node_content) {
+        return COS_FALSE;
+    }
+    *value = cos_atoui64(node_content);
+    return COS_TRUE;
+}
+
 char *cos_build_checkpoint_xml(cos_pool_t *p, const cos_checkpoint_t *checkpoint)
 {
     char *checkpoint_xml;
@@ -2632,6 +2700,9 @@ char *cos_build_checkpoint_xml(cos_pool_t *p, const cos_checkpoint_t *checkpoint
         set_xmlnode_value_int64(part_node, "Size", checkpoint->parts[i].size);
         set_xmlnode_value_int(part_node, "Completed", checkpoint->parts[i].completed);
         set_xmlnode_value_str(part_node, "ETag", &checkpoint->parts[i].etag);
+        if (checkpoint->parts[i].has_crc64) {
+            set_xmlnode_value_uint64(part_node, "Crc64", checkpoint->parts[i].crc64);
+        }
     }
 
     // dump
@@ -2710,6 +2781,7 @@ int cos_checkpoint_parse_from_body(cos_pool_t *p, const char *xml_body, cos_chec
         get_xmlnode_value_int64(p, node, "Size", &checkpoint->parts[index].size);
         get_xmlnode_value_int(p, node, "Completed", &checkpoint->parts[index].completed);
         get_xmlnode_value_str(p, node, "ETag", &checkpoint->parts[index].etag);
+        checkpoint->parts[index].has_crc64 = get_xmlnode_value_uint64(p, node, "Crc64", &checkpoint->parts[index].crc64);
         node = mxmlFindElement(node, parts_node, "Part", NULL, NULL, MXML_DESCEND);
     }
 
@@ -132,10 +132,12 @@ void build_delete_objects_body(cos_pool_t *p, cos_list_t *object_list, int is_qu
 mxml_node_t *set_xmlnode_value_str(mxml_node_t *parent, const char *name, const cos_string_t *value);
 mxml_node_t *set_xmlnode_value_int(mxml_node_t *parent, const char *name, int value);
 mxml_node_t *set_xmlnode_value_int64(mxml_node_t *parent, const char *name, int64_t value);
+mxml_node_t *set_xmlnode_value_uint64(mxml_node_t *parent, const char *name, uint64_t value);
 
 int get_xmlnode_value_str(cos_pool_t *p, mxml_node_t *xml_node, const char *xml_path, cos_string_t *value);
 int get_xmlnode_value_int(cos_pool_t *p, mxml_node_t *xml_node, const char *xml_path, int *value);
 int get_xmlnode_value_int64(cos_pool_t *p, mxml_node_t *xml_node, const char *xml_path, int64_t *value);
+int get_xmlnode_value_uint64(cos_pool_t *p, mxml_node_t *xml_node, const char *xml_path, uint64_t *value);
 
 /**
   * @brief  build xml for checkpoint
@@ -294,6 +296,12 @@ void cos_delete_objects_contents_parse(cos_pool_t *p, mxml_node_t *root, const c
 void cos_object_key_parse(cos_pool_t *p, mxml_node_t * xml_node, cos_object_key_t *content);
 int cos_delete_objects_parse_from_body(cos_pool_t *p, cos_list_t *bc, cos_list_t *object_list);
 
+/**
+  * @brief parse the keys failed to delete from xml body of delete objects
+**/
+void cos_object_delete_error_parse(cos_pool_t *p, mxml_node_t *xml_node, cos_object_delete_error_t *content);
+int cos_delete_objects_error_parse_from_body(cos_pool_t *p, cos_list_t *bc, cos_list_t *error_list);
+
 /**
   * @brief  build body for create live channel
 **/
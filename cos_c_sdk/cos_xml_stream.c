@@ -0,0 +1,614 @@
+#include "cos_log.h"
+#include "cos_sys_util.h"
+#include "cos_list.h"
+#include "cos_utility.h"
+#include "cos_xml_stream.h"
+
+enum {
+    COS_XML_TEXT,          // the text between tags
+    COS_XML_TAG,           // after <
+    COS_XML_START_NAME,    // the name of a start tag
+    COS_XML_ATTRS,         // the attributes of a start tag
+    COS_XML_END_NAME,      // the name of an end tag
+    COS_XML_END_TAIL,      // the spaces after the name of an end tag
+    COS_XML_PI,            // <? ... ?>
+    COS_XML_BANG,          // after <!
+    COS_XML_COMMENT,       // <!-- ... -->
+    COS_XML_DECL           // <!DOCTYPE ... >
+};
+
+static int cos_xml_is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static int cos_xml_put_utf8(char *out, unsigned long cp)
+{
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    } else if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    } else if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// decode the entities of text in place, the decoded text is never longer
+static int cos_xml_decode_text(char *text, int len)
+{
+    static const struct {
+        const char *name;
+        int len;
+        char c;
+    } entities[] = {{"&amp;", 5, '&'}, {"&lt;", 4, '<'}, {"&gt;", 4, '>'},
+                    {"&quot;", 6, '"'}, {"&apos;", 6, '\''}};
+    int i = 0;
+    int j = 0;
+    int k;
+    int end;
+    unsigned long cp;
+    char *last;
+
+    while (i < len) {
+        if (text[i] != '&') {
+            text[j++] = text[i++];
+            continue;
+        }
+        for (end = i + 1; end < len && text[end] != ';'; end++);
+        if (end == len) {
+            return -1;
+        }
+        if (text[i + 1] == '#') {
+            if (text[i + 2] == 'x' || text[i + 2] == 'X') {
+                cp = strtoul(text + i + 3, &last, 16);
+            } else {
+                cp = strtoul(text + i + 2, &last, 10);
+            }
+            if (last != text + end || cp == 0 || cp > 0x10FFFF) {
+                return -1;
+            }
+            j += cos_xml_put_utf8(text + j, cp);
+        } else {
+            for (k = 0; k < (int)(sizeof(entities) / sizeof(entities[0])); k++) {
+                if (end + 1 - i == entities[k].len && strncmp(text + i, entities[k].name, entities[k].len) == 0) {
+                    break;
+                }
+            }
+            if (k == (int)(sizeof(entities) / sizeof(entities[0]))) {
+                return -1;
+            }
+            text[j++] = entities[k].c;
+        }
+        i = end + 1;
+    }
+    text[j] = '\0';
+
+    return j;
+}
+
+static int cos_xml_open(cos_xml_stream_t *xml)
+{
+    if (xml->name_len == 0 || xml->root_done || xml->depth == COS_XML_STREAM_MAX_DEPTH) {
+        return COSE_XML_PARSE_ERROR;
+    }
+    memcpy(xml->path[xml->depth], xml->name, xml->name_len);
+    xml->path[xml->depth][xml->name_len] = '\0';
+    xml->depth++;
+    xml->text_len = 0;
+
+    return xml->start(xml->data, xml->depth, xml->path[xml->depth - 1]);
+}
+
+static int cos_xml_close(cos_xml_stream_t *xml, const char *name)
+{
+    int res;
+    int len;
+
+    if (xml->depth == 0 || strcmp(xml->path[xml->depth - 1], name) != 0) {
+        return COSE_XML_PARSE_ERROR;
+    }
+    if ((len = cos_xml_decode_text(xml->text, xml->text_len)) < 0) {
+        return COSE_XML_PARSE_ERROR;
+    }
+    res = xml->end(xml->data, xml->depth, xml->path[xml->depth - 1], xml->text, len);
+    xml->depth--;
+    xml->text_len = 0;
+    if (xml->depth == 0) {
+        xml->root_done = COS_TRUE;
+    }
+
+    return res;
+}
+
+static int cos_xml_put_name(cos_xml_stream_t *xml, char c)
+{
+    if (xml->name_len == COS_XML_STREAM_MAX_NAME - 1) {
+        return COSE_XML_PARSE_ERROR;
+    }
+    xml->name[xml->name_len++] = c;
+    xml->name[xml->name_len] = '\0';
+
+    return COSE_OK;
+}
+
+static int cos_xml_step(cos_xml_stream_t *xml, char c)
+{
+    int res = COSE_OK;
+
+    switch (xml->state) {
+    case COS_XML_TEXT:
+        if (c == '<') {
+            xml->state = COS_XML_TAG;
+            xml->name_len = 0;
+            xml->name[0] = '\0';
+        } else if (xml->depth == 0) {
+            res = cos_xml_is_space(c) ? COSE_OK : COSE_XML_PARSE_ERROR;
+        } else if (xml->text_len == COS_XML_STREAM_MAX_TEXT) {
+            res = COSE_XML_PARSE_ERROR;
+        } else {
+            xml->text[xml->text_len++] = c;
+        }
+        break;
+    case COS_XML_TAG:
+        xml->match = 0;
+        xml->empty = 0;
+        xml->quote = 0;
+        if (c == '/') {
+            xml->state = COS_XML_END_NAME;
+        } else if (c == '?') {
+            xml->state = COS_XML_PI;
+        } else if (c == '!') {
+            xml->state = COS_XML_BANG;
+        } else if (cos_xml_is_space(c) || c == '>') {
+            res = COSE_XML_PARSE_ERROR;
+        } else {
+            xml->state = COS_XML_START_NAME;
+            res = cos_xml_put_name(xml, c);
+        }
+        break;
+    case COS_XML_START_NAME:
+        if (c == '>') {
+            xml->state = COS_XML_TEXT;
+            res = cos_xml_open(xml);
+        } else if (c == '/') {
+            xml->state = COS_XML_ATTRS;
+            xml->empty = 1;
+        } else if (cos_xml_is_space(c)) {
+            xml->state = COS_XML_ATTRS;
+        } else {
+            res = cos_xml_put_name(xml, c);
+        }
+        break;
+    case COS_XML_ATTRS:
+        if (xml->quote) {
+            if (c == xml->quote) {
+                xml->quote = 0;
+            }
+        } else if (c == '"' || c == '\'') {
+            xml->quote = c;
+            xml->empty = 0;
+        } else if (c == '/') {
+            xml->empty = 1;
+        } else if (c == '>') {
+            xml->state = COS_XML_TEXT;
+            res = cos_xml_open(xml);
+            if (res == COSE_OK && xml->empty) {
+                res = cos_xml_close(xml, xml->name);
+            }
+        } else if (!cos_xml_is_space(c)) {
+            xml->empty = 0;
+        }
+        break;
+    case COS_XML_END_NAME:
+        if (c == '>') {
+            xml->state = COS_XML_TEXT;
+            res = cos_xml_close(xml, xml->name);
+        } else if (cos_xml_is_space(c)) {
+            xml->state = xml->name_len > 0 ? COS_XML_END_TAIL : COS_XML_END_NAME;
+        } else {
+            res = cos_xml_put_name(xml, c);
+        }
+        break;
+    case COS_XML_END_TAIL:
+        if (c == '>') {
+            xml->state = COS_XML_TEXT;
+            res = cos_xml_close(xml, xml->name);
+        } else if (!cos_xml_is_space(c)) {
+            res = COSE_XML_PARSE_ERROR;
+        }
+        break;
+    case COS_XML_PI:
+        if (c == '>' && xml->match) {
+            xml->state = COS_XML_TEXT;
+        }
+        xml->match = c == '?';
+        break;
+    case COS_XML_BANG:
+        if (c == '-' && xml->match) {
+            xml->state = COS_XML_COMMENT;
+            xml->match = 0;
+        } else if (c == '-') {
+            xml->match = 1;
+        } else {
+            xml->state = c == '>' ? COS_XML_TEXT : COS_XML_DECL;
+        }
+        break;
+    case COS_XML_COMMENT:
+        if (c == '>' && xml->match == 2) {
+            xml->state = COS_XML_TEXT;
+        }
+        xml->match = c == '-' ? (xml->match < 2 ? xml->match + 1 : 2) : 0;
+        break;
+    case COS_XML_DECL:
+        if (c == '>') {
+            xml->state = COS_XML_TEXT;
+        }
+        break;
+    default:
+        res = COSE_XML_PARSE_ERROR;
+        break;
+    }
+
+    return res;
+}
+
+void cos_xml_stream_init(cos_xml_stream_t *xml, cos_xml_stream_start_pt start,
+                         cos_xml_stream_end_pt end, void *data)
+{
+    memset(xml, 0, sizeof(cos_xml_stream_t));
+    xml->state = COS_XML_TEXT;
+    xml->start = start;
+    xml->end = end;
+    xml->data = data;
+}
+
+int cos_xml_stream_feed(cos_xml_stream_t *xml, const char *buffer, int len)
+{
+    int i;
+
+    for (i = 0; i < len && xml->error == COSE_OK; i++) {
+        xml->error = cos_xml_step(xml, buffer[i]);
+    }
+
+    return xml->error;
+}
+
+int cos_xml_stream_finish(cos_xml_stream_t *xml)
+{
+    if (xml->error == COSE_OK && (!xml->root_done || xml->state != COS_XML_TEXT)) {
+        xml->error = COSE_XML_PARSE_ERROR;
+    }
+
+    return xml->error;
+}
+
+typedef struct {
+    const char *name;     // the element of the field
+    size_t offset;        // the cos_string_t set
+} cos_list_parser_field_t;
+
+typedef struct {
+    const char *name;     // the element of the record, a child of the root
+    size_t size;          // the content, it starts with the node of the list
+    size_t list_offset;   // the list of the params the contents are added to
+    const cos_list_parser_field_t *fields;
+    int field_num;
+} cos_list_parser_record_t;
+
+typedef struct {
+    const cos_list_parser_record_t *records;
+    int record_num;
+    const cos_list_parser_field_t *markers;  // the children of the root set in the params
+    int marker_num;
+    size_t truncated_offset;
+} cos_list_parser_spec_t;
+
+#define COS_LIST_PARSER_NUM(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+static const cos_list_parser_field_t cos_list_object_fields[] = {
+    {"Key", APR_OFFSETOF(cos_list_object_content_t, key)},
+    {"LastModified", APR_OFFSETOF(cos_list_object_content_t, last_modified)},
+    {"ETag", APR_OFFSETOF(cos_list_object_content_t, etag)},
+    {"Size", APR_OFFSETOF(cos_list_object_content_t, size)},
+    {"ID", APR_OFFSETOF(cos_list_object_content_t, owner_id)},
+    {"DisplayName", APR_OFFSETOF(cos_list_object_content_t, owner_display_name)},
+    {"StorageClass", APR_OFFSETOF(cos_list_object_content_t, storage_class)}
+};
+
+static const cos_list_parser_field_t cos_list_common_prefix_fields[] = {
+    {"Prefix", APR_OFFSETOF(cos_list_object_common_prefix_t, prefix)}
+};
+
+// the object is the first record, the one passed to the callback
+static const cos_list_parser_record_t cos_list_objects_records[] = {
+    {"Contents", sizeof(cos_list_object_content_t), APR_OFFSETOF(cos_list_object_params_t, object_list),
+     cos_list_object_fields, COS_LIST_PARSER_NUM(cos_list_object_fields)},
+    {"CommonPrefixes", sizeof(cos_list_object_common_prefix_t),
+     APR_OFFSETOF(cos_list_object_params_t, common_prefix_list),
+     cos_list_common_prefix_fields, COS_LIST_PARSER_NUM(cos_list_common_prefix_fields)}
+};
+
+static const cos_list_parser_field_t cos_list_objects_markers[] = {
+    {"NextMarker", APR_OFFSETOF(cos_list_object_params_t, next_marker)}
+};
+
+static const cos_list_parser_spec_t cos_list_objects_spec = {
+    cos_list_objects_records, COS_LIST_PARSER_NUM(cos_list_objects_records),
+    cos_list_objects_markers, COS_LIST_PARSER_NUM(cos_list_objects_markers),
+    APR_OFFSETOF(cos_list_object_params_t, truncated)
+};
+
+static const cos_list_parser_field_t cos_list_part_fields[] = {
+    {"PartNumber", APR_OFFSETOF(cos_list_part_content_t, part_number)},
+    {"LastModified", APR_OFFSETOF(cos_list_part_content_t, last_modified)},
+    {"ETag", APR_OFFSETOF(cos_list_part_content_t, etag)},
+    {"Size", APR_OFFSETOF(cos_list_part_content_t, size)}
+};
+
+static const cos_list_parser_record_t cos_list_parts_records[] = {
+    {"Part", sizeof(cos_list_part_content_t), APR_OFFSETOF(cos_list_upload_part_params_t, part_list),
+     cos_list_part_fields, COS_LIST_PARSER_NUM(cos_list_part_fields)}
+};
+
+static const cos_list_parser_field_t cos_list_parts_markers[] = {
+    {"NextPartNumberMarker", APR_OFFSETOF(cos_list_upload_part_params_t, next_part_number_marker)}
+};
+
+static const cos_list_parser_spec_t cos_list_parts_spec = {
+    cos_list_parts_records, COS_LIST_PARSER_NUM(cos_list_parts_records),
+    cos_list_parts_markers, COS_LIST_PARSER_NUM(cos_list_parts_markers),
+    APR_OFFSETOF(cos_list_upload_part_params_t, truncated)
+};
+
+// the names are matched ignoring case, the upload id is UploadId or UploadID
+static const cos_list_parser_field_t cos_list_upload_fields[] = {
+    {"Key", APR_OFFSETOF(cos_list_multipart_upload_content_t, key)},
+    {"UploadId", APR_OFFSETOF(cos_list_multipart_upload_content_t, upload_id)},
+    {"Initiated", APR_OFFSETOF(cos_list_multipart_upload_content_t, initiated)}
+};
+
+static const cos_list_parser_record_t cos_list_uploads_records[] = {
+    {"Upload", sizeof(cos_list_multipart_upload_content_t),
+     APR_OFFSETOF(cos_list_multipart_upload_params_t, upload_list),
+     cos_list_upload_fields, COS_LIST_PARSER_NUM(cos_list_upload_fields)}
+};
+
+static const cos_list_parser_field_t cos_list_uploads_markers[] = {
+    {"NextKeyMarker", APR_OFFSETOF(cos_list_multipart_upload_params_t, next_key_marker)},
+    {"NextUploadIdMarker", APR_OFFSETOF(cos_list_multipart_upload_params_t, next_upload_id_marker)}
+};
+
+static const cos_list_parser_spec_t cos_list_uploads_spec = {
+    cos_list_uploads_records, COS_LIST_PARSER_NUM(cos_list_uploads_records),
+    cos_list_uploads_markers, COS_LIST_PARSER_NUM(cos_list_uploads_markers),
+    APR_OFFSETOF(cos_list_multipart_upload_params_t, truncated)
+};
+
+struct cos_list_parser_s {
+    cos_xml_stream_t xml;
+    cos_pool_t *pool;                          // the contents added to the lists and the markers
+    const cos_list_parser_spec_t *spec;
+    char *params;
+    cos_list_object_callback callback;         // the objects are passed to it if not NULL
+    void *callback_data;
+    int stopped;                               // the callback stops, the rest objects are skipped
+    int truncated;                             // set to params once the body is parsed completely
+    const cos_list_parser_record_t *record;    // the record being parsed
+    union {
+        cos_list_object_content_t object;
+        cos_list_object_common_prefix_t common_prefix;
+        cos_list_part_content_t part;
+        cos_list_multipart_upload_content_t upload;
+    } content;
+    char arena[COS_LIST_PARSER_RECORD_SIZE];   // the fields of the record being parsed
+    int arena_len;
+};
+
+static int cos_list_parser_start(void *data, int depth, const char *name)
+{
+    cos_list_parser_t *parser = (cos_list_parser_t *)data;
+    int i;
+
+    if (depth != 2) {
+        return COSE_OK;
+    }
+    for (i = 0; i < parser->spec->record_num; i++) {
+        if (strcmp(name, parser->spec->records[i].name) == 0) {
+            parser->record = &parser->spec->records[i];
+            memset(&parser->content, 0, parser->record->size);
+            cos_list_init((cos_list_t *)&parser->content);
+            parser->arena_len = 0;
+            break;
+        }
+    }
+
+    return COSE_OK;
+}
+
+static const cos_list_parser_field_t *cos_list_parser_find(const cos_list_parser_field_t *fields,
+                                                           int field_num, const char *name)
+{
+    int i;
+
+    for (i = 0; i < field_num; i++) {
+        if (strcasecmp(name, fields[i].name) == 0) {
+            return &fields[i];
+        }
+    }
+    return NULL;
+}
+
+// add the record parsed to its list, or pass it to the callback
+static int cos_list_parser_emit(cos_list_parser_t *parser)
+{
+    const cos_list_parser_record_t *record = parser->record;
+    cos_list_t *content;
+    cos_string_t *str;
+    int i;
+
+    if (record == &parser->spec->records[0] && NULL != parser->callback) {
+        if (!parser->stopped &&
+            parser->callback(parser->callback_data, &parser->content.object) != COSE_OK) {
+            parser->stopped = COS_TRUE;
+        }
+        return COSE_OK;
+    }
+
+    content = (cos_list_t *)cos_palloc(parser->pool, record->size);
+    if (NULL == content) {
+        return COSE_OUT_MEMORY;
+    }
+    memcpy(content, &parser->content, record->size);
+    for (i = 0; i < record->field_num; i++) {
+        str = (cos_string_t *)((char *)content + record->fields[i].offset);
+        if (NULL != str->data) {
+            str->data = apr_pstrndup(parser->pool, str->data, str->len);
+        }
+    }
+    cos_list_add_tail(content, (cos_list_t *)(parser->params + record->list_offset));
+
+    return COSE_OK;
+}
+
+static int cos_list_parser_end(void *data, int depth, const char *name, char *text, int len)
+{
+    cos_list_parser_t *parser = (cos_list_parser_t *)data;
+    const cos_list_parser_field_t *field;
+    cos_string_t *str;
+    int res;
+
+    if (NULL != parser->record) {
+        if (depth == 2) {
+            res = cos_list_parser_emit(parser);
+            parser->record = NULL;
+            return res;
+        }
+        field = cos_list_parser_find(parser->record->fields, parser->record->field_num, name);
+        if (NULL == field || len == 0) {
+            return COSE_OK;
+        }
+        if (parser->arena_len + len + 1 > COS_LIST_PARSER_RECORD_SIZE) {
+            cos_error_log("list record is longer than %d.", COS_LIST_PARSER_RECORD_SIZE);
+            return COSE_XML_PARSE_ERROR;
+        }
+        memcpy(parser->arena + parser->arena_len, text, len + 1);
+        str = (cos_string_t *)((char *)&parser->content + field->offset);
+        str->data = parser->arena + parser->arena_len;
+        str->len = len;
+        parser->arena_len += len + 1;
+        return COSE_OK;
+    }
+
+    if (depth != 2) {
+        return COSE_OK;
+    }
+    if (strcmp(name, "IsTruncated") == 0) {
+        parser->truncated = strcasecmp(text, "false") == 0 ? 0 : 1;
+    } else if (len > 0 &&
+        NULL != (field = cos_list_parser_find(parser->spec->markers, parser->spec->marker_num, name))) {
+        str = (cos_string_t *)(parser->params + field->offset);
+        str->data = apr_pstrndup(parser->pool, text, len);
+        str->len = len;
+    }
+
+    return COSE_OK;
+}
+
+static cos_list_parser_t *cos_list_parser_create(cos_pool_t *p, const cos_list_parser_spec_t *spec, void *params)
+{
+    cos_list_parser_t *parser;
+
+    parser = (cos_list_parser_t *)cos_palloc(p, sizeof(cos_list_parser_t));
+    cos_xml_stream_init(&parser->xml, cos_list_parser_start, cos_list_parser_end, parser);
+    parser->pool = p;
+    parser->spec = spec;
+    parser->params = (char *)params;
+    parser->callback = NULL;
+    parser->callback_data = NULL;
+    parser->stopped = COS_FALSE;
+    parser->record = NULL;
+    parser->arena_len = 0;
+    parser->truncated = 0;
+
+    return parser;
+}
+
+cos_list_parser_t *cos_list_objects_parser_create(cos_pool_t *p,
+                                                  cos_list_object_params_t *params,
+                                                  cos_list_object_callback callback,
+                                                  void *data)
+{
+    cos_list_parser_t *parser = cos_list_parser_create(p, &cos_list_objects_spec, params);
+
+    parser->callback = callback;
+    parser->callback_data = data;
+    return parser;
+}
+
+cos_list_parser_t *cos_list_parts_parser_create(cos_pool_t *p, cos_list_upload_part_params_t *params)
+{
+    return cos_list_parser_create(p, &cos_list_parts_spec, params);
+}
+
+cos_list_parser_t *cos_list_multipart_uploads_parser_create(cos_pool_t *p,
+                                                            cos_list_multipart_upload_params_t *params)
+{
+    return cos_list_parser_create(p, &cos_list_uploads_spec, params);
+}
+
+int cos_list_parser_feed(cos_list_parser_t *parser, const char *buffer, int len)
+{
+    return cos_xml_stream_feed(&parser->xml, buffer, len);
+}
+
+int cos_list_parser_finish(cos_list_parser_t *parser)
+{
+    if (cos_xml_stream_finish(&parser->xml) != COSE_OK) {
+        return COSE_XML_PARSE_ERROR;
+    }
+    // a broken body never ends a listing loop as the last page
+    *(int *)(parser->params + parser->spec->truncated_offset) = parser->truncated;
+    return COSE_OK;
+}
+
+int cos_list_parser_parse_from_body(cos_list_parser_t *parser, cos_list_t *bc)
+{
+    cos_buf_t *b;
+
+    cos_list_for_each_entry(cos_buf_t, b, bc, node) {
+        if (cos_list_parser_feed(parser, (const char *)b->pos, cos_buf_size(b)) != COSE_OK) {
+            break;
+        }
+    }
+
+    return cos_list_parser_finish(parser);
+}
+
+int cos_write_http_body_list_parser(cos_http_response_t *resp, const char *buffer, int len)
+{
+    if (cos_list_parser_feed((cos_list_parser_t *)resp->user_data, buffer, len) != COSE_OK) {
+        cos_error_log("parse list result failure.");
+        return COSE_XML_PARSE_ERROR;
+    }
+    resp->body_len += len;
+
+    return len;
+}
+
+void cos_init_read_response_body_to_list_parser(cos_list_parser_t *parser, cos_http_response_t *resp)
+{
+    resp->user_data = parser;
+    resp->write_body = cos_write_http_body_list_parser;
+    resp->type = BODY_IN_CALLBACK;
+}
@@ -0,0 +1,109 @@
+#ifndef LIBCOS_XML_STREAM_H
+#define LIBCOS_XML_STREAM_H
+
+#include "cos_sys_define.h"
+#include "cos_string.h"
+#include "cos_transport.h"
+#include "cos_define.h"
+
+COS_CPP_START
+
+/*
+ * called when an element starts, depth of the root is 1
+ * @return COSE_OK to go on parsing, other to stop
+ */
+typedef int (*cos_xml_stream_start_pt)(void *data, int depth, const char *name);
+
+/*
+ * called when an element ends, text is the decoded text of the element after its last child,
+ * it is valid only in the call
+ * @return COSE_OK to go on parsing, other to stop
+ */
+typedef int (*cos_xml_stream_end_pt)(void *data, int depth, const char *name, char *text, int len);
+
+/*
+ * the incremental xml tokenizer, the body is fed as it arrives in any pieces, the memory is
+ * bounded by COS_XML_STREAM_MAX_DEPTH, COS_XML_STREAM_MAX_NAME and COS_XML_STREAM_MAX_TEXT,
+ * the declaration, processing instructions, comments and attributes are skipped
+ */
+typedef struct {
+    int state;
+    int depth;
+    char path[COS_XML_STREAM_MAX_DEPTH][COS_XML_STREAM_MAX_NAME];  // the open elements
+    char name[COS_XML_STREAM_MAX_NAME];                            // the name of the tag being read
+    int name_len;
+    char text[COS_XML_STREAM_MAX_TEXT + 1];
+    int text_len;
+    char quote;        // the quote of the attribute value being read
+    int empty;         // the tag being read ends with />
+    int match;         // the chars matched of the end of the comment or processing instruction
+    int root_done;
+    cos_xml_stream_start_pt start;
+    cos_xml_stream_end_pt end;
+    void *data;
+    int error;
+} cos_xml_stream_t;
+
+void cos_xml_stream_init(cos_xml_stream_t *xml, cos_xml_stream_start_pt start,
+                         cos_xml_stream_end_pt end, void *data);
+
+/*
+ * @return COSE_OK, COSE_XML_PARSE_ERROR or the error of the callbacks, the error is kept
+ *         by the later calls
+ */
+int cos_xml_stream_feed(cos_xml_stream_t *xml, const char *buffer, int len);
+
+/*
+ * @return COSE_OK if the root element is closed, COSE_XML_PARSE_ERROR if the body is incomplete
+ */
+int cos_xml_stream_finish(cos_xml_stream_t *xml);
+
+/*
+ * the parser of the results of list object, list parts and list multipart uploads, built on
+ * the tokenizer, so the body is parsed in the write callback of the response without being
+ * kept in memory or built into a document
+ */
+typedef struct cos_list_parser_s cos_list_parser_t;
+
+/*
+ * the objects are added to params->object_list, or passed to callback if it is not NULL,
+ * the content passed is valid only in the call and the rest of the page is skipped if the
+ * callback stops, the common prefixes are added to params->common_prefix_list,
+ * next_marker is set as well, truncated is set by cos_list_parser_finish only,
+ * the lists and the markers are undefined if the body fails to be parsed
+ */
+cos_list_parser_t *cos_list_objects_parser_create(cos_pool_t *p,
+                                                  cos_list_object_params_t *params,
+                                                  cos_list_object_callback callback,
+                                                  void *data);
+
+// the parts are added to params->part_list, next_part_number_marker and truncated are set
+cos_list_parser_t *cos_list_parts_parser_create(cos_pool_t *p, cos_list_upload_part_params_t *params);
+
+// the uploads are added to params->upload_list, the markers and truncated are set
+cos_list_parser_t *cos_list_multipart_uploads_parser_create(cos_pool_t *p,
+                                                            cos_list_multipart_upload_params_t *params);
+
+int cos_list_parser_feed(cos_list_parser_t *parser, const char *buffer, int len);
+
+/*
+ * set truncated of params if the body is parsed completely, it is left unchanged otherwise
+ * @return COSE_OK if the body is parsed completely, COSE_XML_PARSE_ERROR otherwise
+ */
+int cos_list_parser_finish(cos_list_parser_t *parser);
+
+/*
+ * parse the body kept in memory, as cos_list_objects_parse_from_body does
+ */
+int cos_list_parser_parse_from_body(cos_list_parser_t *parser, cos_list_t *bc);
+
+/*
+ * write the 2xx body of resp to the parser kept in resp->user_data
+ */
+int cos_write_http_body_list_parser(cos_http_response_t *resp, const char *buffer, int len);
+
+void cos_init_read_response_body_to_list_parser(cos_list_parser_t *parser, cos_http_response_t *resp);
+
+COS_CPP_END
+
+#endif
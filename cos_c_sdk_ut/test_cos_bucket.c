@@ -7,6 +7,7 @@
 #include "cos_utility.h"
 #include "cos_xml.h"
 #include "cos_api.h"
+#include "cos_list_iterator.h"
 #include "cos_config.h"
 #include "cos_test_util.h"
 
@@ -474,6 +475,222 @@ void test_lifecycle(CuTest *tc)
     printf("test_lifecycle ok\n");
 }
 
+static int count_list_object(void *data, cos_list_object_content_t *content)
+{
+    (*(int *)data)++;
+    return COSE_OK;
+}
+
+// the first partition ends with cos_tmp5/a/2, its keys are taken slowly
+static int slow_list_object(void *data, cos_list_object_content_t *content)
+{
+    if (strcmp(content->key.data, "cos_tmp5/a/2") <= 0) {
+        apr_sleep(apr_time_from_msec(200));
+    }
+    (*(int *)data)++;
+    return COSE_OK;
+}
+
+void test_list_object_parallel(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    int is_cname = 0;
+    cos_string_t bucket;
+    cos_status_t *s = NULL;
+    cos_table_t *headers = NULL;
+    cos_request_options_t *options = NULL;
+    cos_list_object_parallel_params_t *params = NULL;
+    cos_list_object_content_t *content = NULL;
+    cos_object_key_t *split = NULL;
+    const char *keys[] = {"cos_tmp5/0", "cos_tmp5/a/1", "cos_tmp5/a/2", "cos_tmp5/a0", 
+                          "cos_tmp5/b/1", "cos_tmp5/c/1", "cos_tmp5/c/d/1", "cos_tmp5/z"};
+    int key_num = sizeof(keys) / sizeof(keys[0]);
+    int count = 0;
+    int i;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    init_test_request_options(options, is_cname);
+    cos_str_set(&bucket, TEST_BUCKET_NAME);
+    for (i = 0; i < key_num; i++) {
+        headers = cos_table_make(p, 0);
+        s = create_test_object(options, TEST_BUCKET_NAME, keys[i], "a", headers);
+        CuAssertIntEquals(tc, 200, s->code);
+    }
+
+    // partitions of the common prefixes, merged in key order
+    params = cos_create_list_object_parallel_params(p);
+    cos_str_set(&params->prefix, "cos_tmp5/");
+    params->thread_num = 2;
+    s = cos_list_object_parallel(options, &bucket, params);
+    CuAssertIntEquals(tc, 200, s->code);
+    CuAssertIntEquals(tc, key_num, (int)params->object_count);
+    i = 0;
+    cos_list_for_each_entry(cos_list_object_content_t, content, &params->object_list, node) {
+        CuAssertStrEquals(tc, keys[i++], content->key.data);
+    }
+    CuAssertIntEquals(tc, key_num, i);
+
+    // partitions ended by the split keys
+    split = cos_create_cos_object_key(p);
+    cos_str_set(&split->key, "cos_tmp5/a/2");
+    cos_list_add_tail(&split->node, &params->split_list);
+    split = cos_create_cos_object_key(p);
+    cos_str_set(&split->key, "cos_tmp5/c");
+    cos_list_add_tail(&split->node, &params->split_list);
+    s = cos_list_object_parallel(options, &bucket, params);
+    CuAssertIntEquals(tc, 200, s->code);
+    i = 0;
+    cos_list_for_each_entry(cos_list_object_content_t, content, &params->object_list, node) {
+        CuAssertStrEquals(tc, keys[i++], content->key.data);
+    }
+    CuAssertIntEquals(tc, key_num, i);
+
+    // a page a request, the later partitions buffer one page at most while the first one is slow
+    params->max_ret = 1;
+    params->max_buffered_pages = 1;
+    params->thread_num = 3;
+    params->callback = slow_list_object;
+    params->callback_data = &count;
+    s = cos_list_object_parallel(options, &bucket, params);
+    CuAssertIntEquals(tc, 200, s->code);
+    CuAssertIntEquals(tc, key_num, count);
+    CuAssertIntEquals(tc, key_num, (int)params->object_count);
+    CuAssertTrue(tc, params->peak_buffered_pages <= 1);
+
+    // streamed to the callback unordered
+    count = 0;
+    params->max_ret = 0;
+    params->max_buffered_pages = 0;
+    params->thread_num = 2;
+    cos_list_init(&params->split_list);
+    params->ordered = COS_FALSE;
+    params->callback = count_list_object;
+    params->callback_data = &count;
+    s = cos_list_object_parallel(options, &bucket, params);
+    CuAssertIntEquals(tc, 200, s->code);
+    CuAssertIntEquals(tc, key_num, count);
+    CuAssertTrue(tc, cos_list_empty(&params->object_list));
+
+    cos_pool_destroy(p);
+
+    printf("test_list_object_parallel ok\n");
+}
+
+static int stop_list_object(void *data, cos_list_object_content_t *content)
+{
+    (*(int *)data)++;
+    return COSE_ABORT_CALLBACK;
+}
+
+void test_list_object_with_callback(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    int is_cname = 0;
+    cos_string_t bucket;
+    cos_status_t *s = NULL;
+    cos_table_t *headers = NULL;
+    cos_table_t *resp_headers = NULL;
+    cos_request_options_t *options = NULL;
+    cos_list_object_params_t *params = NULL;
+    cos_list_object_common_prefix_t *common_prefix = NULL;
+    const char *keys[] = {"cos_tmp7/0", "cos_tmp7/1", "cos_tmp7/2", "cos_tmp7/d/0"};
+    int key_num = sizeof(keys) / sizeof(keys[0]);
+    int count = 0;
+    int i;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    init_test_request_options(options, is_cname);
+    cos_str_set(&bucket, TEST_BUCKET_NAME);
+    for (i = 0; i < key_num; i++) {
+        headers = cos_table_make(p, 0);
+        s = create_test_object(options, TEST_BUCKET_NAME, keys[i], "a", headers);
+        CuAssertIntEquals(tc, 200, s->code);
+    }
+
+    // the objects are passed to the callback, the common prefixes are collected
+    params = cos_create_list_object_params(p);
+    cos_str_set(&params->prefix, "cos_tmp7/");
+    cos_str_set(&params->delimiter, "/");
+    s = cos_list_object_with_callback(options, &bucket, params, count_list_object, &count, &resp_headers);
+    CuAssertIntEquals(tc, 200, s->code);
+    CuAssertIntEquals(tc, key_num - 1, count);
+    CuAssertIntEquals(tc, 0, params->truncated);
+    CuAssertTrue(tc, cos_list_empty(&params->object_list));
+    i = 0;
+    cos_list_for_each_entry(cos_list_object_common_prefix_t, common_prefix, &params->common_prefix_list, node) {
+        CuAssertStrEquals(tc, "cos_tmp7/d/", common_prefix->prefix.data);
+        i++;
+    }
+    CuAssertIntEquals(tc, 1, i);
+
+    // the rest of the page is skipped once the callback stops
+    count = 0;
+    params = cos_create_list_object_params(p);
+    cos_str_set(&params->prefix, "cos_tmp7/");
+    s = cos_list_object_with_callback(options, &bucket, params, stop_list_object, &count, &resp_headers);
+    CuAssertIntEquals(tc, 200, s->code);
+    CuAssertIntEquals(tc, 1, count);
+
+    cos_pool_destroy(p);
+
+    printf("test_list_object_with_callback ok\n");
+}
+
+void test_list_iterator(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    int is_cname = 0;
+    cos_string_t bucket;
+    cos_status_t *s = NULL;
+    cos_table_t *headers = NULL;
+    cos_request_options_t *options = NULL;
+    cos_list_object_params_t *params = NULL;
+    cos_list_object_content_t *content = NULL;
+    cos_list_iterator_t *it = NULL;
+    char *key = NULL;
+    int key_num = 5;
+    int i;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    init_test_request_options(options, is_cname);
+    cos_str_set(&bucket, TEST_BUCKET_NAME);
+    for (i = 0; i < key_num; i++) {
+        headers = cos_table_make(p, 0);
+        s = create_test_object(options, TEST_BUCKET_NAME, apr_psprintf(p, "cos_tmp6/%d", i), "a", headers);
+        CuAssertIntEquals(tc, 200, s->code);
+    }
+
+    // two objects a page, the pages are fetched in the background
+    params = cos_create_list_object_params(p);
+    cos_str_set(&params->prefix, "cos_tmp6/");
+    params->max_ret = 2;
+    it = cos_list_iterator_create(options, &bucket, params);
+    CuAssertPtrNotNull(tc, it);
+    CuAssertIntEquals(tc, 0, cos_list_iterator_status(it)->code);
+    i = 0;
+    while (cos_list_iterator_next(it, &content)) {
+        key = apr_psprintf(p, "cos_tmp6/%d", i++);
+        CuAssertStrEquals(tc, key, content->key.data);
+    }
+    CuAssertIntEquals(tc, key_num, i);
+    CuAssertIntEquals(tc, 200, cos_list_iterator_status(it)->code);
+    cos_list_iterator_destroy(it);
+
+    // destroyed before the end
+    it = cos_list_iterator_create(options, &bucket, params);
+    CuAssertPtrNotNull(tc, it);
+    CuAssertIntEquals(tc, COS_TRUE, cos_list_iterator_next(it, &content));
+    CuAssertStrEquals(tc, "cos_tmp6/0", content->key.data);
+    cos_list_iterator_destroy(it);
+
+    cos_pool_destroy(p);
+
+    printf("test_list_iterator ok\n");
+}
+
 void test_delete_objects_quiet(CuTest *tc)
 {
     cos_pool_t *p = NULL;
@@ -582,6 +799,55 @@ void test_delete_objects_by_prefix(CuTest *tc)
     printf("test_delete_object_by_prefix ok\n");
 }
 
+void test_delete_objects_by_prefix_mt(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_request_options_t *options = NULL;
+    int is_cname = 0;
+    cos_string_t bucket;
+    cos_status_t *s = NULL;
+    cos_string_t prefix;
+    cos_table_t *headers = NULL;
+    cos_delete_by_prefix_params_t *params = NULL;
+    char *prefix_str = "cos_tmp4/";
+    int i;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    init_test_request_options(options, is_cname);
+    cos_str_set(&bucket, TEST_BUCKET_NAME);
+    cos_str_set(&prefix, prefix_str);
+
+    for (i = 0; i < 10; i++) {
+        headers = cos_table_make(p, 0);
+        s = create_test_object(options, TEST_BUCKET_NAME, apr_psprintf(p, "%s%d", prefix_str, i), "a", headers);
+        CuAssertIntEquals(tc, 200, s->code);
+    }
+
+    params = cos_create_delete_by_prefix_params(p);
+    params->thread_num = 3;
+    params->dry_run = COS_TRUE;
+    s = cos_delete_objects_by_prefix_mt(options, &bucket, &prefix, params);
+    CuAssertIntEquals(tc, 200, s->code);
+    CuAssertIntEquals(tc, 10, (int)params->listed_keys);
+    CuAssertIntEquals(tc, 0, (int)params->deleted_keys);
+
+    params->dry_run = COS_FALSE;
+    s = cos_delete_objects_by_prefix_mt(options, &bucket, &prefix, params);
+    CuAssertIntEquals(tc, 200, s->code);
+    CuAssertIntEquals(tc, 10, (int)params->listed_keys);
+    CuAssertIntEquals(tc, 10, (int)params->deleted_keys);
+    CuAssertTrue(tc, cos_list_empty(&params->failed_list));
+
+    params->dry_run = COS_TRUE;
+    s = cos_delete_objects_by_prefix_mt(options, &bucket, &prefix, params);
+    CuAssertIntEquals(tc, 200, s->code);
+    CuAssertIntEquals(tc, 0, (int)params->listed_keys);
+    cos_pool_destroy(p);
+
+    printf("test_delete_objects_by_prefix_mt ok\n");
+}
+
 CuSuite *test_cos_bucket()
 {
     CuSuite* suite = CuSuiteNew();
@@ -591,8 +857,12 @@ CuSuite *test_cos_bucket()
     //SUITE_ADD_TEST(suite, test_put_bucket_acl);
     //SUITE_ADD_TEST(suite, test_get_bucket_acl);
     SUITE_ADD_TEST(suite, test_delete_objects_by_prefix);
+    SUITE_ADD_TEST(suite, test_delete_objects_by_prefix_mt);
     SUITE_ADD_TEST(suite, test_list_object);
     SUITE_ADD_TEST(suite, test_list_object_with_delimiter);
+    SUITE_ADD_TEST(suite, test_list_object_parallel);
+    SUITE_ADD_TEST(suite, test_list_object_with_callback);
+    SUITE_ADD_TEST(suite, test_list_iterator);
     SUITE_ADD_TEST(suite, test_lifecycle);
     SUITE_ADD_TEST(suite, test_bucket_acl);
     SUITE_ADD_TEST(suite, test_bucket_cors);
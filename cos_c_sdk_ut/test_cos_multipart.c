@@ -609,6 +609,58 @@ void test_upload_file_from_recover_failed(CuTest *tc)
     printf("test_upload_file_from_recover_failed ok\n");
 }
 
+void test_upload_file_mt_from_recover(CuTest *tc) 
+{
+    cos_pool_t *p = NULL;
+    cos_string_t bucket;
+    char *object_name = "cos_test_multipart_upload_from_file";
+    char *local_file = "test_upload_file_mt.dat";
+    cos_string_t object; 
+    int is_cname = 0; 
+    cos_request_options_t *options = NULL;
+    cos_status_t *s = NULL;
+    int64_t part_size = 1024 * 1024;
+    cos_string_t upload_id;
+    cos_string_t filepath;
+    cos_upload_file_t *upload_file = NULL;
+    cos_table_t *upload_part_resp_headers = NULL;
+    cos_table_t *head_resp_headers = NULL;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    init_test_request_options(options, is_cname);
+    cos_str_set(&bucket, TEST_BUCKET_NAME);
+    cos_str_set(&object, object_name);
+    make_random_file(p, local_file, 4 * 1024 * 1024 + 1000);
+    cos_str_set(&filepath, local_file);
+
+    //init mulitipart and upload the third part only
+    s = init_test_multipart_upload(options, TEST_BUCKET_NAME, 
+                                   object_name, &upload_id);
+    CuAssertIntEquals(tc, 200, s->code);
+    upload_file = cos_create_upload_file(p);
+    cos_str_set(&upload_file->filename, local_file);
+    upload_file->file_pos = 2 * part_size;
+    upload_file->file_last = 3 * part_size;
+    s = cos_upload_part_from_file(options, &bucket, &object, &upload_id,
+        3, upload_file, &upload_part_resp_headers);
+    CuAssertIntEquals(tc, 200, s->code);
+
+    // the missing parts are uploaded at the same time
+    s = cos_upload_file_mt(options, &bucket, &object, &upload_id, &filepath, 
+                           part_size, 3, NULL, NULL);
+    CuAssertIntEquals(tc, 200, s->code);
+
+    s = cos_head_object(options, &bucket, &object, NULL, &head_resp_headers);
+    CuAssertIntEquals(tc, 200, s->code);
+    CuAssertStrEquals(tc, "4195304", apr_table_get(head_resp_headers, COS_CONTENT_LENGTH));
+
+    apr_file_remove(local_file, p);
+    cos_pool_destroy(p);
+
+    printf("test_upload_file_mt_from_recover ok\n");
+}
+
 void test_list_upload_part_with_empty(CuTest *tc)
 {
     cos_pool_t *p = NULL;
@@ -799,6 +851,7 @@ CuSuite *test_cos_multipart()
     SUITE_ADD_TEST(suite, test_upload_file_failed_without_uploadid);
     SUITE_ADD_TEST(suite, test_upload_file_from_recover);
     SUITE_ADD_TEST(suite, test_upload_file_from_recover_failed);
+    SUITE_ADD_TEST(suite, test_upload_file_mt_from_recover);
     SUITE_ADD_TEST(suite, test_list_upload_part_with_empty);
     SUITE_ADD_TEST(suite, test_cos_get_sorted_uploaded_part);
     SUITE_ADD_TEST(suite, test_cos_get_sorted_uploaded_part_with_empty);
@@ -11,6 +11,10 @@
 #include "cos_test_util.h"
 #include "cos_crc64.h"
 
+#if !defined(WIN32)
+#include <unistd.h>
+#endif
+
 #if defined(WIN32)
 static char *test_local_file = "..\\cos_c_sdk_ut\\BingWallpaper-2017-01-19.jpg";
 #else
@@ -325,6 +329,90 @@ void test_resumable_cos_load_checkpoint(CuTest *tc)
     printf("test_resumable_cos_load_checkpoint ok\n");
 }
 
+void test_resumable_checkpoint_journal(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_string_t file_path = cos_null_string;
+    char *cp_file = "test_resumable_checkpoint_journal.ucp";
+    cos_checkpoint_t *cp;
+    cos_checkpoint_t *cp_l;
+    apr_finfo_t finfo;
+    cos_string_t upload_id;
+    cos_string_t etag;
+    apr_size_t len;
+    int rv;
+
+    cos_pool_create(&p, NULL);
+
+    finfo.size = 510598;
+    finfo.mtime = 1459922563;  
+    cos_str_set(&file_path, "D:\\work\\cos\\BingWallpaper-2017-01-19.jpg");
+    cos_str_set(&upload_id, "0004B9894A22E5B1888A1E29F8236E2D");
+    cp = cos_create_checkpoint_content(p);
+    cos_build_upload_checkpoint(p, cp, &file_path, &finfo, &upload_id, 1024 * 100);
+
+    cos_str_set(&file_path, cp_file);
+    rv = cos_open_checkpoint_file(p, &file_path, cp); 
+    CuAssertIntEquals(tc, APR_SUCCESS, rv);
+    rv = cos_dump_checkpoint(p, cp);
+    CuAssertIntEquals(tc, COSE_OK, rv);
+
+    // completed parts are appended
+    cos_str_set(&etag, "\"e1ab2b2c3a6ba63ea1c4b8ef3d8d5c13\"");
+    cos_update_checkpoint(p, cp, 1, &etag);
+    cp->parts[1].crc64 = 1234567890123456789ULL;
+    cp->parts[1].has_crc64 = COS_TRUE;
+    rv = cos_append_checkpoint_part(p, cp, &cp->parts[1]);
+    CuAssertIntEquals(tc, COSE_OK, rv);
+    cos_update_checkpoint(p, cp, 3, &etag);
+    rv = cos_append_checkpoint_part(p, cp, &cp->parts[3]);
+    CuAssertIntEquals(tc, COSE_OK, rv);
+    CuAssertIntEquals(tc, 2, cp->journal_records);
+
+    // torn record at the tail
+    len = 10;
+    apr_file_write(cp->thefile, "\x02\x00\x00\x00\x01\x00\x00\x00\x00\x00", &len);
+    cos_close_checkpoint_file(cp);
+
+    cp_l = cos_create_checkpoint_content(p);
+    rv = cos_load_checkpoint(p, &file_path, cp_l);
+    CuAssertIntEquals(tc, COSE_OK, rv);
+    CuAssertStrEquals(tc, cp->upload_id.data, cp_l->upload_id.data);
+    CuAssertIntEquals(tc, cp->part_num, cp_l->part_num);
+    CuAssertIntEquals(tc, COS_FALSE, cp_l->parts[0].completed);
+    CuAssertIntEquals(tc, COS_TRUE, cp_l->parts[1].completed);
+    CuAssertStrEquals(tc, etag.data, cp_l->parts[1].etag.data);
+    CuAssertIntEquals(tc, COS_TRUE, cp_l->parts[1].has_crc64);
+    CuAssertTrue(tc, cp_l->parts[1].crc64 == 1234567890123456789ULL);
+    CuAssertIntEquals(tc, COS_FALSE, cp_l->parts[2].completed);
+    CuAssertIntEquals(tc, COS_TRUE, cp_l->parts[3].completed);
+    CuAssertIntEquals(tc, COS_FALSE, cp_l->parts[3].has_crc64);
+
+    // compaction keeps the completed parts in the snapshot
+    rv = cos_open_checkpoint_file(p, &file_path, cp_l); 
+    CuAssertIntEquals(tc, APR_SUCCESS, rv);
+    cp_l->journal_records = COS_CHECKPOINT_COMPACT_RECORDS;
+    cos_update_checkpoint(p, cp_l, 4, &etag);
+    rv = cos_append_checkpoint_part(p, cp_l, &cp_l->parts[4]);
+    CuAssertIntEquals(tc, COSE_OK, rv);
+    CuAssertIntEquals(tc, 0, cp_l->journal_records);
+    cos_close_checkpoint_file(cp_l);
+
+    cp = cos_create_checkpoint_content(p);
+    rv = cos_load_checkpoint(p, &file_path, cp);
+    CuAssertIntEquals(tc, COSE_OK, rv);
+    CuAssertIntEquals(tc, COS_TRUE, cp->parts[1].completed);
+    CuAssertIntEquals(tc, COS_TRUE, cp->parts[3].completed);
+    CuAssertIntEquals(tc, COS_TRUE, cp->parts[4].completed);
+    CuAssertIntEquals(tc, COS_FALSE, cp->parts[2].completed);
+
+    apr_file_remove(cp_file, p);
+
+    cos_pool_destroy(p);
+
+    printf("test_resumable_checkpoint_journal ok\n");
+}
+
 void test_resumable_cos_is_upload_checkpoint_valid(CuTest *tc)
 {
     cos_pool_t *p = NULL;
@@ -450,6 +538,496 @@ void test_resumable_checkpoint_xml(CuTest *tc)
     printf("test_resumable_checkpoint_xml ok\n");
 }
 
+void test_resumable_checkpoint_crc64(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_checkpoint_t *cp = NULL;
+    cos_checkpoint_t *cp_actual = NULL;
+    char *xml_doc = NULL;
+    char buffer[1000];
+    int64_t part_size = 300;
+    uint64_t crc64 = 0;
+    int i = 0;
+
+    cos_pool_create(&p, NULL);
+    for (i = 0; i < (int)sizeof(buffer); i++) {
+        buffer[i] = (char)(i * 31 + 7);
+    }
+
+    cp = cos_create_checkpoint_content(p);
+    cp->cp_type = COS_CP_UPLOAD;
+    cp->file_size = sizeof(buffer);
+    cp->part_size = part_size;
+    for (i = 0; i * part_size < cp->file_size; i++) {
+        cp->parts[i].index = i;
+        cp->parts[i].offset = i * part_size;
+        cp->parts[i].size = cos_min(part_size, (cp->file_size - i * part_size));
+        cp->parts[i].completed = COS_TRUE;
+        cos_str_set(&cp->parts[i].etag, "");
+        cp->parts[i].crc64 = cos_crc64(0, buffer + cp->parts[i].offset, (size_t)cp->parts[i].size);
+        cp->parts[i].has_crc64 = COS_TRUE;
+    }
+    cp->part_num = i;
+
+    // combined crc64 equals crc64 of the whole content
+    CuAssertIntEquals(tc, COS_TRUE, cos_get_parts_crc64(cp->parts, cp->part_num, &crc64));
+    CuAssertTrue(tc, cos_crc64(0, buffer, sizeof(buffer)) == crc64);
+
+    // crc64 of parts survives the checkpoint
+    xml_doc = cos_build_checkpoint_xml(p, cp);
+    cp_actual = cos_create_checkpoint_content(p);
+    cos_checkpoint_parse_from_body(p, xml_doc, cp_actual);
+    CuAssertIntEquals(tc, 4, cp_actual->part_num);
+    crc64 = 0;
+    CuAssertIntEquals(tc, COS_TRUE, cos_get_parts_crc64(cp_actual->parts, cp_actual->part_num, &crc64));
+    CuAssertTrue(tc, cos_crc64(0, buffer, sizeof(buffer)) == crc64);
+
+    // unknown crc64 of any part
+    cp->parts[2].has_crc64 = COS_FALSE;
+    CuAssertIntEquals(tc, COS_FALSE, cos_get_parts_crc64(cp->parts, cp->part_num, &crc64));
+
+    cos_pool_destroy(p);
+
+    printf("test_resumable_checkpoint_crc64 ok\n");
+}
+
+void test_resumable_download_checkpoint(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_checkpoint_t *cp = NULL;
+    cos_string_t file_path;
+    cos_string_t object;
+    cos_string_t last_modified;
+    cos_string_t etag;
+    cos_string_t other;
+    apr_file_t *thefile = NULL;
+    char buffer[1000];
+    apr_size_t len = sizeof(buffer);
+    int64_t part_size = 300;
+    int i = 0;
+
+    cos_pool_create(&p, NULL);
+    for (i = 0; i < (int)sizeof(buffer); i++) {
+        buffer[i] = (char)(i * 31 + 7);
+    }
+    cos_str_set(&file_path, "test_download_checkpoint.dat");
+    cos_str_set(&object, "test_download_checkpoint");
+    cos_str_set(&last_modified, "Tue, 12 Jun 2018 09:15:21 GMT");
+    cos_str_set(&etag, "\"2d30c95d5ba2b2a2d7e84e4c5ef5ab1a\"");
+
+    cp = cos_create_checkpoint_content(p);
+    cos_build_download_checkpoint(p, cp, &file_path, &object, sizeof(buffer), &last_modified, &etag, part_size);
+    CuAssertIntEquals(tc, COS_CP_DOWNLOAD, cp->cp_type);
+    CuAssertIntEquals(tc, 4, cp->part_num);
+    CuAssertIntEquals(tc, 100, (int)cp->parts[3].size);
+
+    // valid only if the object is unchanged
+    CuAssertIntEquals(tc, COS_TRUE, cos_is_download_checkpoint_valid(p, cp, &file_path, &object, 
+        sizeof(buffer), &last_modified, &etag));
+    CuAssertIntEquals(tc, COS_FALSE, cos_is_download_checkpoint_valid(p, cp, &file_path, &object, 
+        sizeof(buffer) + 1, &last_modified, &etag));
+    cos_str_set(&other, "\"00000000000000000000000000000000\"");
+    CuAssertIntEquals(tc, COS_FALSE, cos_is_download_checkpoint_valid(p, cp, &file_path, &object, 
+        sizeof(buffer), &last_modified, &other));
+    cos_str_set(&other, "Wed, 13 Jun 2018 09:15:21 GMT");
+    CuAssertIntEquals(tc, COS_FALSE, cos_is_download_checkpoint_valid(p, cp, &file_path, &object, 
+        sizeof(buffer), &other, &etag));
+
+    // completed parts are verified against the local file
+    apr_file_open(&thefile, file_path.data, APR_CREATE | APR_WRITE | APR_TRUNCATE, APR_UREAD | APR_UWRITE | APR_GREAD, p);
+    apr_file_write(thefile, buffer, &len);
+    apr_file_close(thefile);
+    for (i = 0; i < cp->part_num; i++) {
+        cp->parts[i].completed = COS_TRUE;
+        cp->parts[i].crc64 = cos_crc64(0, buffer + cp->parts[i].offset, (size_t)cp->parts[i].size);
+        cp->parts[i].has_crc64 = COS_TRUE;
+    }
+    cp->parts[1].crc64++;
+    cp->parts[2].has_crc64 = COS_FALSE;
+    CuAssertIntEquals(tc, 1, cos_verify_download_checkpoint_parts(p, cp, file_path.data));
+    CuAssertIntEquals(tc, COS_TRUE, cp->parts[0].completed);
+    CuAssertIntEquals(tc, COS_FALSE, cp->parts[1].completed);
+    CuAssertIntEquals(tc, COS_TRUE, cp->parts[2].completed);
+    CuAssertIntEquals(tc, COS_TRUE, cp->parts[3].completed);
+
+    apr_file_remove(file_path.data, p);
+    CuAssertIntEquals(tc, -1, cos_verify_download_checkpoint_parts(p, cp, file_path.data));
+
+    cos_pool_destroy(p);
+
+    printf("test_resumable_download_checkpoint ok\n");
+}
+
+void test_resumable_copy_checkpoint(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_checkpoint_t *cp = NULL;
+    cos_checkpoint_t *cp_actual = NULL;
+    cos_string_t dest;
+    cos_string_t copy_source;
+    cos_string_t last_modified;
+    cos_string_t etag;
+    cos_string_t upload_id;
+    char *xml_doc = NULL;
+    int64_t object_size = (int64_t)6 * 1024 * 1024 * 1024;
+
+    cos_pool_create(&p, NULL);
+    cos_str_set(&dest, "dest-1253666666/test_copy_checkpoint");
+    cos_str_set(&copy_source, "src-1253666666.cos.ap-guangzhou.myqcloud.com/test_copy_checkpoint");
+    cos_str_set(&last_modified, "Tue, 12 Jun 2018 09:15:21 GMT");
+    cos_str_set(&etag, "\"2d30c95d5ba2b2a2d7e84e4c5ef5ab1a-1000\"");
+    cos_str_set(&upload_id, "0004B9894A22E5B1888A1E29F8236E2D");
+
+    cp = cos_create_checkpoint_content(p);
+    cos_build_copy_checkpoint(p, cp, &dest, &copy_source, object_size, &last_modified, &etag, 
+                              &upload_id, 1024 * 1024 * 1024);
+    CuAssertIntEquals(tc, COS_CP_COPY, cp->cp_type);
+    CuAssertIntEquals(tc, 6, cp->part_num);
+
+    // the upload survives the checkpoint
+    xml_doc = cos_build_checkpoint_xml(p, cp);
+    cp_actual = cos_create_checkpoint_content(p);
+    cos_checkpoint_parse_from_body(p, xml_doc, cp_actual);
+    CuAssertStrEquals(tc, upload_id.data, cp_actual->upload_id.data);
+    CuAssertIntEquals(tc, COS_TRUE, cos_is_copy_checkpoint_valid(p, cp_actual, &dest, &copy_source, 
+        object_size, &last_modified, &etag));
+
+    // the source is changed
+    CuAssertIntEquals(tc, COS_FALSE, cos_is_copy_checkpoint_valid(p, cp_actual, &dest, &copy_source, 
+        object_size - 1, &last_modified, &etag));
+    cos_str_set(&etag, "\"00000000000000000000000000000000-1000\"");
+    CuAssertIntEquals(tc, COS_FALSE, cos_is_copy_checkpoint_valid(p, cp_actual, &dest, &copy_source, 
+        object_size, &last_modified, &etag));
+
+    // a download checkpoint is never a copy one
+    cp_actual->cp_type = COS_CP_DOWNLOAD;
+    CuAssertIntEquals(tc, COS_FALSE, cos_is_copy_checkpoint_valid(p, cp_actual, &dest, &copy_source, 
+        object_size, &last_modified, &cp->object_etag));
+
+    cos_pool_destroy(p);
+
+    printf("test_resumable_copy_checkpoint ok\n");
+}
+
+static void * APR_THREAD_FUNC fake_part_task(apr_thread_t *thd, void *data)
+{
+    cos_transport_thread_params_t *params = (cos_transport_thread_params_t *)data;
+    cos_status_t *s = cos_status_create(params->options.pool);
+
+    if (apr_atomic_read32(params->failed) > 0) {
+        apr_queue_push(params->finished_parts, params->result);
+        return NULL;
+    }
+
+    // the part with size 0 fails
+    s->code = params->part->size > 0 ? 200 : 503;
+    params->result->s = s;
+    if (!cos_status_is_ok(s)) {
+        apr_atomic_inc32(params->failed);
+    } else {
+        cos_str_set(&params->result->etag, apr_psprintf(params->options.pool, "etag-%d", params->part->index));
+    }
+    apr_queue_push(params->finished_parts, params->result);
+    return NULL;
+}
+
+static int cancel_after_parts(cos_pool_t *pool, void *data, cos_checkpoint_part_t *part)
+{
+    if (part->index == 10) {
+        apr_atomic_set32((apr_uint32_t *)data, 1);
+    }
+    return COSE_OK;
+}
+
+void test_resumable_run_part_tasks(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_request_options_t *options = NULL;
+    cos_checkpoint_part_t *parts = NULL;
+    cos_part_tasks_t tasks;
+    cos_string_t bucket;
+    cos_string_t object;
+    cos_status_t *s = NULL;
+    apr_uint32_t cancel = 0;
+    int part_num = 100;
+    int i = 0;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    init_test_request_options(options, 0);
+    cos_str_set(&bucket, TEST_BUCKET_NAME);
+    cos_str_set(&object, "test_run_part_tasks");
+
+    parts = (cos_checkpoint_part_t *)cos_pcalloc(p, sizeof(cos_checkpoint_part_t) * part_num);
+    cos_build_parts(part_num * 1024, 1024, parts);
+
+    // all parts complete with 3 reused thread params
+    cos_init_part_tasks(&tasks, fake_part_task, &bucket, &object, parts, part_num, 3);
+    s = cos_run_part_tasks(options, &tasks);
+    CuAssertTrue(tc, NULL == s);
+    for (i = 0; i < part_num; i++) {
+        CuAssertIntEquals(tc, COS_TRUE, parts[i].completed);
+        CuAssertStrEquals(tc, apr_psprintf(p, "etag-%d", i), parts[i].etag.data);
+    }
+
+    // the first failure is returned
+    cos_build_parts(part_num * 1024, 1024, parts);
+    parts[50].size = 0;
+    s = cos_run_part_tasks(options, &tasks);
+    CuAssertTrue(tc, NULL != s);
+    CuAssertIntEquals(tc, 503, s->code);
+    CuAssertTrue(tc, NULL != strstr(s->error_msg, "failed parts: 51"));
+    CuAssertIntEquals(tc, COS_FALSE, parts[50].completed);
+    CuAssertIntEquals(tc, COS_FALSE, parts[part_num - 1].completed);
+
+    // no part is launched after cancellation
+    cos_build_parts(part_num * 1024, 1024, parts);
+    cos_set_cancel_flag(options->ctl, &cancel);
+    tasks.done_callback = cancel_after_parts;
+    tasks.done_data = &cancel;
+    s = cos_run_part_tasks(options, &tasks);
+    CuAssertTrue(tc, NULL != s);
+    CuAssertIntEquals(tc, COSE_CANCELED_ERROR, s->code);
+    CuAssertStrEquals(tc, COS_CANCELED_ERROR_CODE, s->error_code);
+    CuAssertIntEquals(tc, COS_TRUE, parts[10].completed);
+    CuAssertIntEquals(tc, COS_FALSE, parts[part_num - 1].completed);
+    cos_set_cancel_flag(options->ctl, NULL);
+
+    cos_pool_destroy(p);
+
+    printf("test_resumable_run_part_tasks ok\n");
+}
+
+void test_resumable_transfer_pool(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_request_options_t *options = NULL;
+    cos_transfer_pool_t *transfer_pool = NULL;
+    cos_checkpoint_part_t *parts = NULL;
+    cos_part_tasks_t tasks;
+    cos_string_t bucket;
+    cos_string_t object;
+    cos_status_t *s = NULL;
+    int part_num = 100;
+    int round = 0;
+    int i = 0;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    init_test_request_options(options, 0);
+    cos_str_set(&bucket, TEST_BUCKET_NAME);
+    cos_str_set(&object, "test_transfer_pool");
+
+    transfer_pool = cos_transfer_pool_create(p, 4);
+    CuAssertTrue(tc, NULL != transfer_pool);
+
+    // the share of a transfer shrinks with the transfers running on the pool
+    CuAssertIntEquals(tc, 4, cos_transfer_pool_get_share(transfer_pool));
+    apr_atomic_set32(&transfer_pool->transfers, 3);
+    CuAssertIntEquals(tc, 2, cos_transfer_pool_get_share(transfer_pool));
+    apr_atomic_set32(&transfer_pool->transfers, 8);
+    CuAssertIntEquals(tc, 1, cos_transfer_pool_get_share(transfer_pool));
+    apr_atomic_set32(&transfer_pool->transfers, 0);
+
+    // the threads outlive the transfers and are reused by the next one
+    cos_set_transfer_pool(options->ctl, transfer_pool);
+    parts = (cos_checkpoint_part_t *)cos_pcalloc(p, sizeof(cos_checkpoint_part_t) * part_num);
+    cos_init_part_tasks(&tasks, fake_part_task, &bucket, &object, parts, part_num, 8);
+    for (round = 0; round < 2; round++) {
+        cos_build_parts(part_num * 1024, 1024, parts);
+        s = cos_run_part_tasks(options, &tasks);
+        CuAssertTrue(tc, NULL == s);
+        for (i = 0; i < part_num; i++) {
+            CuAssertIntEquals(tc, COS_TRUE, parts[i].completed);
+        }
+        CuAssertIntEquals(tc, 0, (int)apr_atomic_read32(&transfer_pool->transfers));
+    }
+
+    // a failed transfer leaves the pool usable
+    cos_build_parts(part_num * 1024, 1024, parts);
+    parts[50].size = 0;
+    s = cos_run_part_tasks(options, &tasks);
+    CuAssertTrue(tc, NULL != s);
+    CuAssertIntEquals(tc, 503, s->code);
+    CuAssertIntEquals(tc, 0, (int)apr_atomic_read32(&transfer_pool->transfers));
+
+    cos_set_transfer_pool(options->ctl, NULL);
+    cos_transfer_pool_destroy(transfer_pool);
+    cos_pool_destroy(p);
+
+    printf("test_resumable_transfer_pool ok\n");
+}
+
+void test_resumable_retry_part_task(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_transport_thread_params_t params;
+    cos_part_task_result_t result;
+    cos_checkpoint_part_t part;
+    cos_status_t s;
+    apr_uint32_t failed = 0;
+    apr_uint32_t retry_budget = 2;
+
+    cos_pool_create(&p, NULL);
+    memset(&params, 0, sizeof(params));
+    memset(&result, 0, sizeof(result));
+    memset(&part, 0, sizeof(part));
+    params.options.pool = p;
+    params.options.ctl = cos_http_controller_create(p, 0);
+    params.part = &part;
+    params.result = &result;
+    params.failed = &failed;
+    params.retry_budget = &retry_budget;
+
+    // client errors are not retried
+    cos_status_set(&s, 404, "NoSuchUpload", NULL);
+    CuAssertIntEquals(tc, COS_FALSE, cos_should_retry_part(&s));
+    CuAssertIntEquals(tc, COS_FALSE, cos_retry_part_task(&params, &s));
+    CuAssertIntEquals(tc, 2, retry_budget);
+
+    cos_status_set(&s, COSE_REQUEST_TIMEOUT, COS_HTTP_IO_ERROR_CODE, NULL);
+    CuAssertIntEquals(tc, COS_TRUE, cos_should_retry_part(&s));
+
+    // the budget is shared, the third retry fails
+    cos_status_set(&s, 503, "SlowDown", NULL);
+    CuAssertIntEquals(tc, COS_TRUE, cos_retry_part_task(&params, &s));
+    CuAssertIntEquals(tc, COS_TRUE, cos_retry_part_task(&params, &s));
+    CuAssertIntEquals(tc, COS_FALSE, cos_retry_part_task(&params, &s));
+    CuAssertIntEquals(tc, 2, result.retries);
+    CuAssertIntEquals(tc, 0, retry_budget);
+
+    // no retry after another part fails
+    retry_budget = 2;
+    failed = 1;
+    CuAssertIntEquals(tc, COS_FALSE, cos_retry_part_task(&params, &s));
+
+    CuAssertTrue(tc, cos_get_part_retry_budget(10000) >= 1000);
+
+    cos_pool_destroy(p);
+
+    printf("test_resumable_retry_part_task ok\n");
+}
+
+void test_resumable_part_tuner(CuTest *tc)
+{
+    cos_part_tuner_t tuner;
+    apr_time_t now = 0;
+    int64_t part_size = 0;
+    int i = 0;
+    int j = 0;
+    int n = 0;
+
+    cos_init_part_tuner(&tuner, 8);
+    CuAssertIntEquals(tc, COS_AUTO_INIT_THREAD_NUM, tuner.concurrency);
+
+    // grows by one a window while throughput rises, every part takes 1 second
+    now = tuner.window_start;
+    for (i = 0; i < 100 && tuner.concurrency < 8; i++) {
+        n = tuner.concurrency;
+        now += 1000 * 1000;
+        for (j = 0; j < n; j++) {
+            cos_tune_part_concurrency(&tuner, 1024 * 1024, 0, now);
+        }
+    }
+    CuAssertIntEquals(tc, 8, tuner.concurrency);
+    CuAssertIntEquals(tc, 8, tuner.peak_concurrency);
+
+    // never exceeds the max
+    now += 1000;
+    for (i = 0; i < 8; i++) {
+        cos_tune_part_concurrency(&tuner, 1024 * 1024 * 1024, 0, now);
+    }
+    CuAssertIntEquals(tc, 8, tuner.concurrency);
+
+    // halves on a retried part
+    cos_tune_part_concurrency(&tuner, 1024 * 1024, 1, now);
+    CuAssertIntEquals(tc, 4, tuner.concurrency);
+    cos_tune_part_concurrency(&tuner, 1024 * 1024, 2, now);
+    cos_tune_part_concurrency(&tuner, 1024 * 1024, 2, now);
+    cos_tune_part_concurrency(&tuner, 1024 * 1024, 2, now);
+    CuAssertIntEquals(tc, 1, tuner.concurrency);
+
+    // auto part size is in range and keeps the part number limit
+    part_size = cos_get_auto_part_size(100 * 1024 * 1024, 4);
+    CuAssertTrue(tc, part_size >= COS_MIN_AUTO_PART_SIZE && part_size <= COS_MAX_AUTO_PART_SIZE);
+    CuAssertTrue(tc, part_size % COS_MIN_AUTO_PART_SIZE == 0);
+    part_size = cos_get_auto_part_size(1024, 4);
+    CuAssertTrue(tc, part_size == COS_MIN_AUTO_PART_SIZE);
+    part_size = cos_get_auto_part_size(COS_MAX_AUTO_PART_SIZE * (int64_t)COS_MAX_PART_NUM * 2, 4);
+    CuAssertTrue(tc, part_size * COS_MAX_PART_NUM >= COS_MAX_AUTO_PART_SIZE * (int64_t)COS_MAX_PART_NUM * 2);
+
+    printf("test_resumable_part_tuner ok\n");
+}
+
+void test_resumable_part_prefetcher(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_request_options_t *options = NULL;
+    cos_part_prefetcher_t *prefetcher = NULL;
+    cos_prefetch_slot_t *slot = NULL;
+    cos_checkpoint_part_t *parts = NULL;
+    cos_upload_file_t *upload_file = NULL;
+    cos_table_t *headers = NULL;
+    cos_string_t filepath;
+    char *filename = "test_part_prefetcher.dat";
+    int part_num = 0;
+    int i = 0;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    options->ctl = cos_http_controller_create(p, 0);
+    make_random_file(p, filename, 1000 * 1024 + 100);
+    cos_str_set(&filepath, filename);
+
+    // enabled by read ahead size
+    CuAssertIntEquals(tc, COS_FALSE, cos_is_pipelined_upload(options, 100 * 1024));
+    cos_set_read_ahead_size(options->ctl, 100 * 1024);
+    CuAssertIntEquals(tc, COS_TRUE, cos_is_pipelined_upload(options, 100 * 1024));
+    CuAssertIntEquals(tc, COS_FALSE, cos_is_pipelined_upload(options, 200 * 1024));
+    cos_set_read_ahead_size(options->ctl, 0);
+
+    part_num = cos_get_part_num(1000 * 1024 + 100, 100 * 1024);
+    parts = (cos_checkpoint_part_t *)cos_pcalloc(p, sizeof(cos_checkpoint_part_t) * part_num);
+    cos_build_parts(1000 * 1024 + 100, 100 * 1024, parts);
+
+    // the parts are read in order through a ring of 2 + COS_PREFETCH_PART_NUM buffers
+    cos_set_content_md5_enable(options->ctl, COS_TRUE);
+    prefetcher = cos_create_part_prefetcher(options, p, &filepath, parts, part_num, 2);
+    CuAssertTrue(tc, NULL != prefetcher);
+    CuAssertIntEquals(tc, 2 + COS_PREFETCH_PART_NUM, prefetcher->depth);
+    for (i = 0; i < part_num; i++) {
+        slot = cos_wait_prefetched_part(prefetcher, parts + i);
+        CuAssertTrue(tc, NULL != slot);
+        CuAssertIntEquals(tc, COSE_OK, slot->res);
+        CuAssertTrue(tc, parts[i].size == slot->len);
+        CuAssertTrue(tc, 0 == ((uintptr_t)slot->data) % COS_PREFETCH_BUFFER_ALIGN);
+
+        upload_file = cos_create_upload_file(p);
+        cos_str_set(&upload_file->filename, filename);
+        upload_file->file_pos = parts[i].offset;
+        upload_file->file_last = parts[i].offset + parts[i].size;
+        headers = cos_table_make(p, 1);
+        cos_add_content_md5_from_file_range(options, upload_file, headers);
+        CuAssertStrEquals(tc, apr_table_get(headers, COS_CONTENT_MD5), slot->content_md5);
+        CuAssertTrue(tc, cos_crc64(0, slot->data, (size_t)slot->len) == slot->crc64);
+
+        cos_release_prefetched_part(prefetcher, parts + i);
+    }
+    cos_destroy_part_prefetcher(prefetcher);
+
+    // the parts waited for are skipped once stopped
+    prefetcher = cos_create_part_prefetcher(options, p, &filepath, parts, part_num, 1);
+    CuAssertTrue(tc, NULL != prefetcher);
+    cos_stop_part_prefetcher(prefetcher);
+    CuAssertTrue(tc, NULL == cos_wait_prefetched_part(prefetcher, parts + part_num - 1));
+    cos_destroy_part_prefetcher(prefetcher);
+
+    apr_file_remove(filename, p);
+    cos_pool_destroy(p);
+
+    printf("test_resumable_part_prefetcher ok\n");
+}
+
 // ---------------------------- FT ----------------------------
 
 void test_resumable_upload_without_checkpoint(CuTest *tc)
@@ -1191,6 +1769,314 @@ void test_resumable_download(CuTest *tc)
 }
 
 
+void test_resumable_download_to_buffer(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_status_t *s = NULL;
+    cos_request_options_t *options = NULL;
+    cos_http_response_t *resp = NULL;
+    cos_upload_file_t *range = NULL;
+    cos_string_t bucket;
+    cos_string_t object;
+    apr_file_t *thefile = NULL;
+    apr_size_t len = 0;
+    char *filename = "test_download_to_buffer.dat";
+    char *expected = NULL;
+    char *buffer = NULL;
+    char small[16];
+    int64_t buffer_len = 0;
+    int file_size = 9 * 1024 * 1024 + 100;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    init_test_request_options(options, 0);
+    cos_str_set(&bucket, TEST_BUCKET_NAME);
+    cos_str_set(&object, "test_download_to_buffer");
+
+    // a part never writes beyond its range of the memory
+    memset(small, 0, sizeof(small));
+    resp = cos_http_response_create(p);
+    range = cos_create_upload_file(p);
+    range->file_pos = 4;
+    range->file_last = 8;
+    cos_init_read_response_body_to_range_buffer(p, range, small + 4, resp);
+    CuAssertIntEquals(tc, 3, resp->write_body(resp, "abc", 3));
+    CuAssertIntEquals(tc, COSE_OVER_MEMORY, resp->write_body(resp, "de", 2));
+    CuAssertStrEquals(tc, "abc", small + 4);
+    CuAssertIntEquals(tc, 0, small[0]);
+
+    make_random_file(p, filename, file_size);
+    s = create_test_object_from_file(options, TEST_BUCKET_NAME, object.data, filename, NULL);
+    CuAssertIntEquals(tc, 200, s->code);
+    expected = (char *)cos_palloc(p, file_size);
+    apr_file_open(&thefile, filename, APR_READ, APR_UREAD | APR_GREAD, p);
+    apr_file_read_full(thefile, expected, file_size, &len);
+    apr_file_close(thefile);
+
+    // the memory is allocated by the sdk
+    s = cos_download_object_to_buffer_mt(options, &bucket, &object, 4 * 1024 * 1024, 3, 
+                                         &buffer, &buffer_len, NULL);
+    CuAssertIntEquals(tc, 0, s->code);
+    CuAssertIntEquals(tc, file_size, (int)buffer_len);
+    CuAssertTrue(tc, 0 == memcmp(expected, buffer, file_size));
+
+    // the memory of caller
+    buffer_len = file_size + 1;
+    buffer = (char *)cos_pcalloc(p, (apr_size_t)buffer_len);
+    s = cos_download_object_to_buffer_mt(options, &bucket, &object, 4 * 1024 * 1024, 3, 
+                                         &buffer, &buffer_len, NULL);
+    CuAssertIntEquals(tc, 0, s->code);
+    CuAssertIntEquals(tc, file_size, (int)buffer_len);
+    CuAssertTrue(tc, 0 == memcmp(expected, buffer, file_size));
+
+    // the memory of caller is too small
+    buffer = small;
+    buffer_len = sizeof(small);
+    s = cos_download_object_to_buffer_mt(options, &bucket, &object, 4 * 1024 * 1024, 3, 
+                                         &buffer, &buffer_len, NULL);
+    CuAssertIntEquals(tc, COSE_INVALID_ARGUMENT, s->code);
+
+    apr_file_remove(filename, p);
+    cos_pool_destroy(p);
+
+    printf("test_resumable_download_to_buffer ok\n");
+}
+
+typedef struct {
+    char *data;
+    int64_t len;
+    int64_t fail_at;   // fail once len reaches it, -1 never
+} test_sink_t;
+
+static int append_to_test_sink(void *data, const char *buffer, int64_t len)
+{
+    test_sink_t *sink = (test_sink_t *)data;
+
+    if (sink->fail_at >= 0 && sink->len >= sink->fail_at) {
+        return COSE_FILE_WRITE_ERROR;
+    }
+    memcpy(sink->data + sink->len, buffer, (size_t)len);
+    sink->len += len;
+    return COSE_OK;
+}
+
+void test_resumable_download_to_sink(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_status_t *s = NULL;
+    cos_request_options_t *options = NULL;
+    cos_string_t bucket;
+    cos_string_t object;
+    apr_file_t *thefile = NULL;
+    apr_size_t len = 0;
+    test_sink_t sink;
+    char *filename = "test_download_to_sink.dat";
+    char *expected = NULL;
+    int file_size = 17 * 1024 * 1024 + 100;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    init_test_request_options(options, 0);
+    cos_str_set(&bucket, TEST_BUCKET_NAME);
+    cos_str_set(&object, "test_download_to_sink");
+
+    make_random_file(p, filename, file_size);
+    s = create_test_object_from_file(options, TEST_BUCKET_NAME, object.data, filename, NULL);
+    CuAssertIntEquals(tc, 200, s->code);
+    expected = (char *)cos_palloc(p, file_size);
+    apr_file_open(&thefile, filename, APR_READ, APR_UREAD | APR_GREAD, p);
+    apr_file_read_full(thefile, expected, file_size, &len);
+    apr_file_close(thefile);
+
+    // 5 parts through a ring of 4 parts, delivered in order
+    memset(&sink, 0, sizeof(sink));
+    sink.data = (char *)cos_palloc(p, file_size);
+    sink.fail_at = -1;
+    s = cos_download_object_to_sink_mt(options, &bucket, &object, 4 * 1024 * 1024, 2, 
+                                       append_to_test_sink, &sink, NULL);
+    CuAssertIntEquals(tc, 0, s->code);
+    CuAssertIntEquals(tc, file_size, (int)sink.len);
+    CuAssertTrue(tc, 0 == memcmp(expected, sink.data, file_size));
+
+    // a sink failure stops the download
+    sink.len = 0;
+    sink.fail_at = 4 * 1024 * 1024;
+    s = cos_download_object_to_sink_mt(options, &bucket, &object, 4 * 1024 * 1024, 2, 
+                                       append_to_test_sink, &sink, NULL);
+    CuAssertIntEquals(tc, COSE_FILE_WRITE_ERROR, s->code);
+    CuAssertIntEquals(tc, 4 * 1024 * 1024, (int)sink.len);
+    CuAssertTrue(tc, 0 == memcmp(expected, sink.data, (size_t)sink.len));
+
+    apr_file_remove(filename, p);
+    cos_pool_destroy(p);
+
+    printf("test_resumable_download_to_sink ok\n");
+}
+
+void test_resumable_upload_download_dir(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_status_t *s = NULL;
+    cos_request_options_t *options = NULL;
+    cos_resumable_clt_params_t *clt_params = NULL;
+    cos_dir_transfer_result_t *result = NULL;
+    cos_list_t results;
+    cos_string_t bucket;
+    cos_string_t local_dir;
+    cos_string_t prefix;
+    int files = 0;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    init_test_request_options(options, 0);
+    cos_str_set(&bucket, TEST_BUCKET_NAME);
+    cos_str_set(&prefix, "test_dir/");
+
+    // small files in nested directories and a file larger than 8MB sent by parts
+    apr_dir_make_recursive("test_upload_dir/a/b", APR_OS_DEFAULT, p);
+    make_random_file(p, "test_upload_dir/1.dat", 1024);
+    make_random_file(p, "test_upload_dir/a/2.dat", 10);
+    make_random_file(p, "test_upload_dir/a/b/3.dat", 0);
+    make_random_file(p, "test_upload_dir/a/b/large.dat", 9 * 1024 * 1024);
+    clt_params = cos_create_resumable_clt_params_content(p, 4 * 1024 * 1024, 4, COS_FALSE, NULL);
+
+    cos_str_set(&local_dir, "test_upload_dir");
+    cos_list_init(&results);
+    s = cos_upload_dir(options, &bucket, &local_dir, &prefix, NULL, clt_params, &results);
+    CuAssertIntEquals(tc, 0, s->code);
+    cos_list_for_each_entry(cos_dir_transfer_result_t, result, &results, node) {
+        CuAssertTrue(tc, 0 == strncmp(result->object.data, "test_dir/", 9));
+        CuAssertTrue(tc, result->s->code == 0 || result->s->code == 200);
+        files++;
+    }
+    CuAssertIntEquals(tc, 4, files);
+
+    cos_str_set(&local_dir, "test_download_dir");
+    cos_list_init(&results);
+    files = 0;
+    s = cos_download_dir(options, &bucket, &prefix, &local_dir, clt_params, &results);
+    CuAssertIntEquals(tc, 0, s->code);
+    cos_list_for_each_entry(cos_dir_transfer_result_t, result, &results, node) {
+        CuAssertTrue(tc, result->s->code == 0 || result->s->code == 200);
+        CuAssertIntEquals(tc, (int)result->size, (int)get_file_size(result->local_path.data));
+        files++;
+    }
+    CuAssertIntEquals(tc, 4, files);
+    CuAssertIntEquals(tc, 9 * 1024 * 1024, (int)get_file_size("test_download_dir/a/b/large.dat"));
+
+    cos_pool_destroy(p);
+
+    printf("test_resumable_upload_download_dir ok\n");
+}
+
+void test_resumable_sync_dir(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_status_t *s = NULL;
+    cos_request_options_t *options = NULL;
+    cos_resumable_clt_params_t *clt_params = NULL;
+    cos_dir_transfer_result_t *result = NULL;
+    cos_list_t results;
+    cos_string_t bucket;
+    cos_string_t local_dir;
+    cos_string_t prefix;
+    cos_string_t object;
+    cos_table_t *resp_headers = NULL;
+    int transferred = 0;
+    int skipped = 0;
+    int deleted = 0;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    init_test_request_options(options, 0);
+    cos_str_set(&bucket, TEST_BUCKET_NAME);
+    cos_str_set(&prefix, "test_sync_dir/");
+    cos_str_set(&local_dir, "test_sync_dir");
+    clt_params = cos_create_resumable_clt_params_content(p, 4 * 1024 * 1024, 4, COS_FALSE, NULL);
+
+    apr_dir_make_recursive("test_sync_dir/a", APR_OS_DEFAULT, p);
+    make_random_file(p, "test_sync_dir/1.dat", 1024);
+    make_random_file(p, "test_sync_dir/a/2.dat", 10);
+    make_random_file(p, "test_sync_dir/a/large.dat", 9 * 1024 * 1024);
+    cos_list_init(&results);
+    s = cos_sync_dir(options, &bucket, &local_dir, &prefix, NULL, clt_params, COS_TRUE, &results);
+    CuAssertIntEquals(tc, 0, s->code);
+    cos_list_for_each_entry(cos_dir_transfer_result_t, result, &results, node) {
+        CuAssertIntEquals(tc, COS_DIR_TRANSFERRED, result->action);
+        transferred++;
+    }
+    CuAssertIntEquals(tc, 3, transferred);
+
+    // a file of the same size but other content, a new file and a removed file
+    make_random_file(p, "test_sync_dir/1.dat", 1024);
+    make_random_file(p, "test_sync_dir/3.dat", 100);
+    apr_file_remove("test_sync_dir/a/2.dat", p);
+    cos_list_init(&results);
+    transferred = 0;
+    s = cos_sync_dir(options, &bucket, &local_dir, &prefix, NULL, clt_params, COS_TRUE, &results);
+    CuAssertIntEquals(tc, 0, s->code);
+    cos_list_for_each_entry(cos_dir_transfer_result_t, result, &results, node) {
+        CuAssertTrue(tc, result->s->code == 0 || result->s->code == 200);
+        if (result->action == COS_DIR_TRANSFERRED) {
+            CuAssertTrue(tc, 0 == strcmp(result->object.data, "test_sync_dir/1.dat") || 
+                         0 == strcmp(result->object.data, "test_sync_dir/3.dat"));
+            transferred++;
+        } else if (result->action == COS_DIR_SKIPPED) {
+            CuAssertStrEquals(tc, "test_sync_dir/a/large.dat", result->object.data);
+            skipped++;
+        } else {
+            CuAssertStrEquals(tc, "test_sync_dir/a/2.dat", result->object.data);
+            deleted++;
+        }
+    }
+    CuAssertIntEquals(tc, 2, transferred);
+    CuAssertIntEquals(tc, 1, skipped);
+    CuAssertIntEquals(tc, 1, deleted);
+
+    // nothing changes
+    cos_list_init(&results);
+    skipped = 0;
+    s = cos_sync_dir(options, &bucket, &local_dir, &prefix, NULL, clt_params, COS_TRUE, &results);
+    CuAssertIntEquals(tc, 0, s->code);
+    cos_list_for_each_entry(cos_dir_transfer_result_t, result, &results, node) {
+        CuAssertIntEquals(tc, COS_DIR_SKIPPED, result->action);
+        skipped++;
+    }
+    CuAssertIntEquals(tc, 3, skipped);
+
+#if !defined(WIN32)
+    // a link to a file is synced as the file, the object of a broken link is never deleted
+    CuAssertIntEquals(tc, 0, symlink("1.dat", "test_sync_dir/link.dat"));
+    CuAssertIntEquals(tc, 0, symlink("missing.dat", "test_sync_dir/broken.dat"));
+    s = create_test_object(options, TEST_BUCKET_NAME, "test_sync_dir/broken.dat", "a", cos_table_make(p, 0));
+    CuAssertIntEquals(tc, 200, s->code);
+    cos_list_init(&results);
+    transferred = 0;
+    deleted = 0;
+    s = cos_sync_dir(options, &bucket, &local_dir, &prefix, NULL, clt_params, COS_TRUE, &results);
+    CuAssertIntEquals(tc, 0, s->code);
+    cos_list_for_each_entry(cos_dir_transfer_result_t, result, &results, node) {
+        if (result->action == COS_DIR_TRANSFERRED) {
+            CuAssertStrEquals(tc, "test_sync_dir/link.dat", result->object.data);
+            transferred++;
+        } else if (result->action == COS_DIR_DELETED) {
+            deleted++;
+        }
+    }
+    CuAssertIntEquals(tc, 1, transferred);
+    CuAssertIntEquals(tc, 0, deleted);
+    cos_str_set(&object, "test_sync_dir/broken.dat");
+    s = cos_head_object(options, &bucket, &object, NULL, &resp_headers);
+    CuAssertIntEquals(tc, 200, s->code);
+    apr_file_remove("test_sync_dir/link.dat", p);
+    apr_file_remove("test_sync_dir/broken.dat", p);
+#endif
+
+    cos_pool_destroy(p);
+
+    printf("test_resumable_sync_dir ok\n");
+}
+
 CuSuite *test_cos_resumable()
 {
     CuSuite* suite = CuSuiteNew();
@@ -1202,8 +2088,17 @@ CuSuite *test_cos_resumable()
     SUITE_ADD_TEST(suite, test_resumable_cos_does_file_exist);
     SUITE_ADD_TEST(suite, test_resumable_cos_dump_checkpoint);
     SUITE_ADD_TEST(suite, test_resumable_cos_load_checkpoint);
+    SUITE_ADD_TEST(suite, test_resumable_checkpoint_journal);
     SUITE_ADD_TEST(suite, test_resumable_cos_is_upload_checkpoint_valid);
     SUITE_ADD_TEST(suite, test_resumable_checkpoint_xml);
+    SUITE_ADD_TEST(suite, test_resumable_checkpoint_crc64);
+    SUITE_ADD_TEST(suite, test_resumable_download_checkpoint);
+    SUITE_ADD_TEST(suite, test_resumable_copy_checkpoint);
+    SUITE_ADD_TEST(suite, test_resumable_run_part_tasks);
+    SUITE_ADD_TEST(suite, test_resumable_transfer_pool);
+    SUITE_ADD_TEST(suite, test_resumable_retry_part_task);
+    SUITE_ADD_TEST(suite, test_resumable_part_tuner);
+    SUITE_ADD_TEST(suite, test_resumable_part_prefetcher);
     SUITE_ADD_TEST(suite, test_resumable_upload_without_checkpoint);
     SUITE_ADD_TEST(suite, test_resumable_upload_with_checkpoint);
     SUITE_ADD_TEST(suite, test_resumable_upload_partsize);
@@ -1217,6 +2112,10 @@ CuSuite *test_cos_resumable()
     SUITE_ADD_TEST(suite, test_resumable_upload_progress_without_checkpoint);
     SUITE_ADD_TEST(suite, test_resumable_upload_progress_with_checkpoint);
     SUITE_ADD_TEST(suite, test_resumable_download);
+    SUITE_ADD_TEST(suite, test_resumable_download_to_buffer);
+    SUITE_ADD_TEST(suite, test_resumable_download_to_sink);
+    SUITE_ADD_TEST(suite, test_resumable_upload_download_dir);
+    SUITE_ADD_TEST(suite, test_resumable_sync_dir);
     SUITE_ADD_TEST(suite, test_resumable_cleanup);
      
     return suite;
@@ -7,8 +7,14 @@
 #include "cos_status.h"
 #include "cos_auth.h"
 #include "cos_xml.h"
+#include "cos_xml_stream.h"
+#include "cos_list_compact.h"
 #include "cos_utility.h"
 #include "cos_transport.h"
+#include "cos_crc64.h"
+#include "cos_digest_cache.h"
+#include "cos_progress.h"
+#include "cos_test_util.h"
 
 extern int starts_with(const cos_string_t *str, const char *prefix);
 extern int cos_curl_code_to_status(CURLcode code);
@@ -30,6 +36,191 @@ void test_get_xml_doc_with_empty_cos_list(CuTest *tc)
     printf("test_get_xml_doc_with_empty_cos_list ok\n");
 }
 
+void test_delete_objects_error_parse_from_body(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_list_t bc;
+    cos_list_t error_list;
+    cos_buf_t *buf;
+    cos_object_delete_error_t *error;
+    int ret;
+    int errors = 0;
+    const char *body = "<DeleteResult>"
+        "<Deleted><Key>a</Key></Deleted>"
+        "<Error><Key>b%2Fc</Key><Code>AccessDenied</Code><Message>Access Denied</Message></Error>"
+        "</DeleteResult>";
+
+    cos_pool_create(&p, NULL);
+    cos_list_init(&bc);
+    cos_list_init(&error_list);
+    buf = cos_buf_pack(p, body, strlen(body));
+    cos_list_add_tail(&buf->node, &bc);
+
+    ret = cos_delete_objects_error_parse_from_body(p, &bc, &error_list);
+    CuAssertIntEquals(tc, COSE_OK, ret);
+    cos_list_for_each_entry(cos_object_delete_error_t, error, &error_list, node) {
+        CuAssertStrEquals(tc, "b/c", error->key.data);
+        CuAssertStrEquals(tc, "AccessDenied", error->code.data);
+        CuAssertStrEquals(tc, "Access Denied", error->message.data);
+        errors++;
+    }
+    CuAssertIntEquals(tc, 1, errors);
+    cos_pool_destroy(p);
+
+    printf("test_delete_objects_error_parse_from_body ok\n");
+}
+
+/*
+ * cos_xml_stream.c
+ */
+void test_list_parser_parse_by_byte(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_list_parser_t *parser;
+    cos_list_object_params_t *params;
+    cos_list_multipart_upload_params_t *upload_params;
+    cos_list_object_content_t *content;
+    cos_list_object_common_prefix_t *common_prefix;
+    cos_list_multipart_upload_content_t *upload;
+    int ret = COSE_OK;
+    int i;
+    const char *body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<ListBucketResult xmlns=\"http://www.qcloud.com/\">\n"
+        "<Name>test-1253666666</Name><Prefix>a/</Prefix>"
+        "<NextMarker>a/b&amp;c</NextMarker><IsTruncated>true</IsTruncated>\n"
+        "<Contents><Key>a/&lt;&#x4E2D;&#65;</Key><LastModified>2023-01-01T00:00:00.000Z</LastModified>"
+        "<ETag>&quot;e&quot;</ETag><Size>10</Size><Owner><ID>1</ID><DisplayName>d</DisplayName></Owner>"
+        "<StorageClass>STANDARD</StorageClass></Contents>\n"
+        "<Contents><Key>a/b</Key><Size>0</Size><StorageClass/></Contents>\n"
+        "<CommonPrefixes><Prefix>a/d/</Prefix></CommonPrefixes>\n"
+        "</ListBucketResult>\n";
+    const char *uploads = "<ListMultipartUploadsResult><IsTruncated>false</IsTruncated>"
+        "<NextKeyMarker>k</NextKeyMarker><NextUploadIdMarker>u</NextUploadIdMarker>"
+        "<Upload><Key>o</Key><UploadId>1</UploadId><Initiated>t</Initiated></Upload>"
+        "</ListMultipartUploadsResult>";
+    const char *broken[] = {"", "<a><b></a></b>", "<a>x", "<a>&b;</a>", "x<a/>", "<a/><b/>",
+                            "<ListBucketResult><IsTruncated>false</IsTruncated>"};
+
+    cos_pool_create(&p, NULL);
+
+    // the body arrives byte by byte
+    params = cos_create_list_object_params(p);
+    parser = cos_list_objects_parser_create(p, params, NULL, NULL);
+    for (i = 0; body[i] != '\0' && ret == COSE_OK; i++) {
+        ret = cos_list_parser_feed(parser, body + i, 1);
+    }
+    CuAssertIntEquals(tc, COSE_OK, ret);
+    CuAssertIntEquals(tc, COSE_OK, cos_list_parser_finish(parser));
+    CuAssertIntEquals(tc, 1, params->truncated);
+    CuAssertStrEquals(tc, "a/b&c", params->next_marker.data);
+    content = cos_list_entry(params->object_list.next, cos_list_object_content_t, node);
+    CuAssertStrEquals(tc, "a/<\xE4\xB8\xAD" "A", content->key.data);
+    CuAssertStrEquals(tc, "\"e\"", content->etag.data);
+    CuAssertStrEquals(tc, "10", content->size.data);
+    CuAssertStrEquals(tc, "1", content->owner_id.data);
+    CuAssertStrEquals(tc, "d", content->owner_display_name.data);
+    CuAssertStrEquals(tc, "STANDARD", content->storage_class.data);
+    content = cos_list_entry(content->node.next, cos_list_object_content_t, node);
+    CuAssertStrEquals(tc, "a/b", content->key.data);
+    CuAssertPtrEquals(tc, NULL, content->storage_class.data);
+    CuAssertTrue(tc, content->node.next == &params->object_list);
+    common_prefix = cos_list_entry(params->common_prefix_list.next, cos_list_object_common_prefix_t, node);
+    CuAssertStrEquals(tc, "a/d/", common_prefix->prefix.data);
+
+    upload_params = cos_create_list_multipart_upload_params(p);
+    parser = cos_list_multipart_uploads_parser_create(p, upload_params);
+    CuAssertIntEquals(tc, COSE_OK, cos_list_parser_feed(parser, uploads, strlen(uploads)));
+    CuAssertIntEquals(tc, COSE_OK, cos_list_parser_finish(parser));
+    CuAssertIntEquals(tc, 0, upload_params->truncated);
+    CuAssertStrEquals(tc, "k", upload_params->next_key_marker.data);
+    CuAssertStrEquals(tc, "u", upload_params->next_upload_id_marker.data);
+    upload = cos_list_entry(upload_params->upload_list.next, cos_list_multipart_upload_content_t, node);
+    CuAssertStrEquals(tc, "o", upload->key.data);
+    CuAssertStrEquals(tc, "1", upload->upload_id.data);
+
+    for (i = 0; i < (int)(sizeof(broken) / sizeof(broken[0])); i++) {
+        params = cos_create_list_object_params(p);
+        parser = cos_list_objects_parser_create(p, params, NULL, NULL);
+        cos_list_parser_feed(parser, broken[i], strlen(broken[i]));
+        CuAssertIntEquals(tc, COSE_XML_PARSE_ERROR, cos_list_parser_finish(parser));
+        // a broken page never looks like the last one
+        CuAssertIntEquals(tc, 1, params->truncated);
+    }
+
+    cos_pool_destroy(p);
+
+    printf("test_list_parser_parse_by_byte ok\n");
+}
+
+/*
+ * cos_list_compact.c
+ */
+void test_list_object_compact(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_list_object_compact_t *compact;
+    cos_list_object_content_t content;
+    cos_list_object_content_t *dup;
+    cos_list_t object_list;
+    cos_string_t key;
+    const char *etags[] = {"\"0123456789abcdef0123456789abcdef\"",
+                           "\"0123456789abcdef0123456789abcdef-12\"", "\"sha1-etag\""};
+    int object_num = 3 * COS_LIST_COMPACT_INIT_NUM;
+    int i;
+
+    cos_pool_create(&p, NULL);
+    compact = cos_list_object_compact_create(p);
+
+    // the columns grow past the initial capacity
+    for (i = 0; i < object_num; i++) {
+        memset(&content, 0, sizeof(content));
+        cos_str_set(&content.key, apr_psprintf(p, "a/%05d", i));
+        cos_str_set(&content.size, apr_psprintf(p, "%d", i));
+        cos_str_set(&content.last_modified, "2023-01-02T03:04:05.000Z");
+        cos_str_set(&content.etag, etags[i % 3]);
+        cos_str_set(&content.owner_id, "1253666666");
+        cos_str_set(&content.storage_class, (i % 2 ? "STANDARD" : "ARCHIVE"));
+        CuAssertIntEquals(tc, COSE_OK, cos_list_object_compact_add(compact, &content));
+    }
+    CuAssertIntEquals(tc, object_num, (int)compact->count);
+    // the empty string, the owner and the two storage classes
+    CuAssertIntEquals(tc, 4, compact->strings->nelts);
+
+    cos_list_object_compact_key(compact, 1, &key);
+    CuAssertStrEquals(tc, "a/00001", key.data);
+    CuAssertTrue(tc, 1 == cos_list_object_compact_size(compact, 1));
+    CuAssertTrue(tc, INT64_C(1672628645) == cos_list_object_compact_mtime(compact, 1));
+    CuAssertIntEquals(tc, 0x01, cos_list_object_compact_md5(compact, 1)[0]);
+    CuAssertPtrEquals(tc, NULL, (void *)cos_list_object_compact_md5(compact, 2));
+    CuAssertStrEquals(tc, etags[0], cos_list_object_compact_etag(compact, 0, p));
+    CuAssertStrEquals(tc, etags[1], cos_list_object_compact_etag(compact, 1, p));
+    CuAssertStrEquals(tc, etags[2], cos_list_object_compact_etag(compact, 2, p));
+    CuAssertStrEquals(tc, "1253666666", cos_list_object_compact_owner_id(compact, 1));
+    CuAssertStrEquals(tc, "", cos_list_object_compact_owner_name(compact, 1));
+    CuAssertStrEquals(tc, "STANDARD", cos_list_object_compact_storage_class(compact, 1));
+
+    // back to the list of contents
+    cos_list_init(&object_list);
+    cos_list_object_compact_to_list(compact, p, &object_list);
+    i = 0;
+    cos_list_for_each_entry(cos_list_object_content_t, dup, &object_list, node) {
+        if (i == 1) {
+            CuAssertStrEquals(tc, "a/00001", dup->key.data);
+            CuAssertStrEquals(tc, "1", dup->size.data);
+            CuAssertStrEquals(tc, "2023-01-02T03:04:05.000Z", dup->last_modified.data);
+            CuAssertStrEquals(tc, etags[1], dup->etag.data);
+            CuAssertStrEquals(tc, "STANDARD", dup->storage_class.data);
+            CuAssertPtrEquals(tc, NULL, dup->owner_display_name.data);
+        }
+        i++;
+    }
+    CuAssertIntEquals(tc, object_num, i);
+
+    cos_pool_destroy(p);
+
+    printf("test_list_object_compact ok\n");
+}
+
 /*
  * cos_list.h
  */
@@ -448,11 +639,301 @@ void test_cos_strtoull(CuTest *tc)
     CuAssertTrue(tc, val == UINT64_MAX);
 }
 
+void test_cos_read_ahead_upload_file(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_request_options_t *options = NULL;
+    cos_upload_file_t *upload_file = NULL;
+    cos_table_t *read_ahead_headers = NULL;
+    cos_table_t *headers = NULL;
+    cos_list_t buffer;
+    cos_buf_t *content = NULL;
+    uint64_t crc64 = 0;
+    char *filename = "test_read_ahead.dat";
+    int res;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    options->ctl = cos_http_controller_create(p, 0);
+    make_random_file(p, filename, 300 * 1024);
+
+    upload_file = cos_create_upload_file(p);
+    cos_str_set(&upload_file->filename, filename);
+    upload_file->file_pos = 100 * 1024;
+    upload_file->file_last = 250 * 1024;
+
+    // disabled by default
+    CuAssertIntEquals(tc, COS_FALSE, cos_is_read_ahead_upload_file(options, upload_file));
+    cos_set_read_ahead_size(options->ctl, 100 * 1024);
+    CuAssertIntEquals(tc, COS_FALSE, cos_is_read_ahead_upload_file(options, upload_file));
+    cos_set_read_ahead_size(options->ctl, 1024 * 1024);
+    CuAssertIntEquals(tc, COS_TRUE, cos_is_read_ahead_upload_file(options, upload_file));
+
+    // md5 and crc64 equal to the ones calculated by reading the file range again
+    read_ahead_headers = cos_table_make(p, 1);
+    cos_list_init(&buffer);
+    res = cos_read_ahead_upload_file(options, upload_file, read_ahead_headers, &buffer, &crc64);
+    CuAssertIntEquals(tc, COSE_OK, res);
+    CuAssertTrue(tc, 150 * 1024 == cos_buf_list_len(&buffer));
+
+    headers = cos_table_make(p, 1);
+    cos_add_content_md5_from_file_range(options, upload_file, headers);
+    CuAssertStrEquals(tc, apr_table_get(headers, COS_CONTENT_MD5), apr_table_get(read_ahead_headers, COS_CONTENT_MD5));
+
+    content = cos_list_entry(buffer.next, cos_buf_t, node);
+    CuAssertTrue(tc, cos_crc64(0, content->pos, cos_buf_size(content)) == crc64);
+    cos_set_read_ahead_size(options->ctl, 0);
+
+    apr_file_remove(filename, p);
+    cos_pool_destroy(p);
+}
+
+void test_cos_digest_cache(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_request_options_t *options = NULL;
+    cos_upload_file_t *upload_file = NULL;
+    cos_table_t *headers = NULL;
+    cos_digest_cache_t *cache = NULL;
+    cos_digest_cache_key_t key;
+    cos_digest_t digest;
+    cos_digest_t cached;
+    char *filename = "test_digest_cache.dat";
+    char *cache_path = "test_digest_cache.dat.digest";
+    int res;
+    int i;
+
+    cos_pool_create(&p, NULL);
+    options = cos_request_options_create(p);
+    options->ctl = cos_http_controller_create(p, 0);
+    make_random_file(p, filename, 200 * 1024);
+    apr_file_remove(cache_path, p);
+
+    upload_file = cos_create_upload_file(p);
+    cos_str_set(&upload_file->filename, filename);
+    upload_file->file_pos = 10 * 1024;
+    upload_file->file_last = 110 * 1024;
+    headers = cos_table_make(p, 1);
+    cos_add_content_md5_from_file_range(options, upload_file, headers);
+
+    // miss, calculated from file and put into cache
+    cache = cos_digest_cache_create(p, cache_path);
+    res = cos_get_file_range_digest(p, cache, filename, upload_file->file_pos, upload_file->file_last, &digest);
+    CuAssertIntEquals(tc, COSE_OK, res);
+    CuAssertStrEquals(tc, apr_table_get(headers, COS_CONTENT_MD5), digest.content_md5);
+
+    res = cos_digest_cache_build_key(p, filename, upload_file->file_pos, upload_file->file_last, &key);
+    CuAssertIntEquals(tc, COSE_OK, res);
+    CuAssertIntEquals(tc, COS_TRUE, cos_digest_cache_get(cache, &key, &cached));
+    CuAssertTrue(tc, digest.crc64 == cached.crc64);
+
+    // persisted and loaded again
+    CuAssertIntEquals(tc, COSE_OK, cos_digest_cache_save(cache));
+    cos_digest_cache_destroy(cache);
+    cache = cos_digest_cache_create(p, cache_path);
+    memset(&cached, 0, sizeof(cached));
+    CuAssertIntEquals(tc, COS_TRUE, cos_digest_cache_get(cache, &key, &cached));
+    CuAssertStrEquals(tc, digest.content_md5, cached.content_md5);
+    CuAssertTrue(tc, digest.crc64 == cached.crc64);
+
+    // another range misses
+    res = cos_digest_cache_build_key(p, filename, 0, upload_file->file_last, &key);
+    CuAssertIntEquals(tc, COSE_OK, res);
+    CuAssertIntEquals(tc, COS_FALSE, cos_digest_cache_get(cache, &key, &cached));
+
+    // Content-MD5 taken from cache
+    cos_set_digest_cache(options->ctl, cache);
+    headers = cos_table_make(p, 1);
+    cos_add_content_md5_from_file_range(options, upload_file, headers);
+    CuAssertStrEquals(tc, digest.content_md5, apr_table_get(headers, COS_CONTENT_MD5));
+    cos_set_digest_cache(options->ctl, NULL);
+    cos_digest_cache_destroy(cache);
+
+    // the oldest range is evicted once the cache is full
+    cache = cos_digest_cache_create(p, NULL);
+    memset(&key, 0, sizeof(key));
+    for (i = 0; i <= COS_DIGEST_CACHE_MAX_ENTRIES; i++) {
+        key.range_pos = i;
+        cos_digest_cache_put(cache, &key, &digest);
+    }
+    CuAssertIntEquals(tc, COS_DIGEST_CACHE_MAX_ENTRIES, (int)apr_hash_count(cache->entries));
+    CuAssertIntEquals(tc, COS_TRUE, cos_digest_cache_get(cache, &key, &cached));
+    key.range_pos = 0;
+    CuAssertIntEquals(tc, COS_FALSE, cos_digest_cache_get(cache, &key, &cached));
+    key.range_pos = 1;
+    CuAssertIntEquals(tc, COS_TRUE, cos_digest_cache_get(cache, &key, &cached));
+
+    cos_digest_cache_destroy(cache);
+    apr_file_remove(cache_path, p);
+    apr_file_remove(filename, p);
+    cos_pool_destroy(p);
+}
+
+void test_cos_shared_file_write(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_http_response_t *resp = NULL;
+    cos_upload_file_t *download_file = NULL;
+    apr_file_t *file = NULL;
+    apr_finfo_t finfo;
+    cos_file_buf_t *fb = NULL;
+    char *filename = "test_shared_file_write.dat";
+    char content[16];
+    apr_size_t len;
+    int res;
+
+    cos_pool_create(&p, NULL);
+
+    // preallocated to the object size
+    res = cos_open_file_for_shared_write(p, filename, 12, &file);
+    CuAssertIntEquals(tc, COSE_OK, res);
+    CuAssertIntEquals(tc, APR_SUCCESS, apr_stat(&finfo, filename, APR_FINFO_SIZE, p));
+    CuAssertTrue(tc, 12 == finfo.size);
+
+    // parts are written out of order at their offsets
+    CuAssertIntEquals(tc, COSE_OK, cos_file_pwrite(file, "efgh", 4, 4));
+    download_file = cos_create_upload_file(p);
+    cos_str_set(&download_file->filename, filename);
+    download_file->file_pos = 8;
+    download_file->file_last = 12;
+    resp = cos_http_response_create(p);
+    cos_init_read_response_body_to_shared_file(p, download_file, file, resp);
+    CuAssertIntEquals(tc, 2, resp->write_body(resp, "ij", 2));
+    CuAssertIntEquals(tc, 2, resp->write_body(resp, "kl", 2));
+    // never beyond the part range
+    CuAssertTrue(tc, resp->write_body(resp, "m", 1) < 0);
+    CuAssertIntEquals(tc, COSE_OK, cos_file_pwrite(file, "abcd", 4, 0));
+    apr_file_close(file);
+
+    fb = cos_create_file_buf(p);
+    CuAssertIntEquals(tc, COSE_OK, cos_open_file_for_read(p, filename, fb));
+    len = sizeof(content);
+    apr_file_read(fb->file, content, &len);
+    apr_file_close(fb->file);
+    CuAssertIntEquals(tc, 12, (int)len);
+    CuAssertTrue(tc, 0 == memcmp(content, "abcdefghijkl", 12));
+
+    // an existing longer file is truncated
+    res = cos_open_file_for_shared_write(p, filename, 4, &file);
+    CuAssertIntEquals(tc, COSE_OK, res);
+    apr_file_close(file);
+    CuAssertIntEquals(tc, APR_SUCCESS, apr_stat(&finfo, filename, APR_FINFO_SIZE, p));
+    CuAssertTrue(tc, 4 == finfo.size);
+
+    apr_file_remove(filename, p);
+    cos_pool_destroy(p);
+}
+
+void test_cos_part_index(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_part_index_t *index = NULL;
+    cos_list_t complete_part_list;
+    cos_complete_part_content_t *content = NULL;
+    int missing[8];
+    int expected[] = {1, 3, 5};
+    int i = 0;
+
+    cos_pool_create(&p, NULL);
+    index = cos_create_part_index(p, 10);
+
+    // parts come in any order, a part listed again replaces the old one
+    CuAssertIntEquals(tc, COSE_OK, cos_part_index_set(index, 6, "\"e6\"", 100));
+    CuAssertIntEquals(tc, COSE_OK, cos_part_index_set(index, 2, "\"e2\"", 100));
+    CuAssertIntEquals(tc, COSE_OK, cos_part_index_set(index, 4, "\"x4\"", 100));
+    CuAssertIntEquals(tc, COSE_OK, cos_part_index_set(index, 4, "\"e4\"", 100));
+    CuAssertIntEquals(tc, COSE_INVALID_ARGUMENT, cos_part_index_set(index, 0, "\"e0\"", 100));
+    CuAssertIntEquals(tc, COSE_INVALID_ARGUMENT, cos_part_index_set(index, 11, "\"e11\"", 100));
+    CuAssertIntEquals(tc, 3, index->count);
+    CuAssertIntEquals(tc, COS_TRUE, cos_part_index_has(index, 2));
+    CuAssertIntEquals(tc, COS_FALSE, cos_part_index_has(index, 3));
+    CuAssertIntEquals(tc, COS_FALSE, cos_part_index_has(index, 11));
+
+    // holes anywhere are missing, not only after a prefix
+    CuAssertIntEquals(tc, 3, cos_part_index_get_missing(index, 5, missing));
+    for (i = 0; i < 3; i++) {
+        CuAssertIntEquals(tc, expected[i], missing[i]);
+    }
+
+    // completed parts in order, bounded by the part number
+    cos_list_init(&complete_part_list);
+    CuAssertIntEquals(tc, 2, cos_part_index_get_completed(index, p, 5, &complete_part_list));
+    i = 0;
+    cos_list_for_each_entry(cos_complete_part_content_t, content, &complete_part_list, node) {
+        CuAssertStrEquals(tc, i == 0 ? "2" : "4", content->part_number.data);
+        CuAssertStrEquals(tc, i == 0 ? "\"e2\"" : "\"e4\"", content->etag.data);
+        i++;
+    }
+    CuAssertIntEquals(tc, 2, i);
+
+    cos_pool_destroy(p);
+}
+
+typedef struct {
+    int reports;
+    cos_progress_info_t info;
+} progress_record_t;
+
+static void record_progress(const cos_progress_info_t *info, void *data)
+{
+    progress_record_t *last = (progress_record_t *)data;
+
+    last->reports++;
+    last->info = *info;
+}
+
+void test_cos_progress(CuTest *tc)
+{
+    cos_pool_t *p = NULL;
+    cos_progress_t *progress = NULL;
+    progress_record_t last;
+
+    cos_pool_create(&p, NULL);
+    memset(&last, 0, sizeof(last));
+
+    // no report before the interval is passed
+    progress = cos_progress_create(p, apr_time_from_sec(3600), record_progress, &last);
+    cos_progress_start(progress, 1000, 200);
+    cos_progress_update(progress, 300);
+    CuAssertIntEquals(tc, 0, last.reports);
+
+    // the bytes of a failed request are taken back
+    cos_progress_update(progress, -300);
+    cos_progress_report(progress);
+    CuAssertIntEquals(tc, 1, last.reports);
+    CuAssertIntEquals(tc, 200, (int)last.info.consumed_bytes);
+    CuAssertTrue(tc, last.info.eta == -1);
+
+    // the completion is reported once regardless of the interval, and never beyond the total
+    cos_progress_update(progress, 900);
+    CuAssertIntEquals(tc, 2, last.reports);
+    CuAssertIntEquals(tc, 1000, (int)last.info.consumed_bytes);
+    CuAssertTrue(tc, last.info.eta == 0);
+    cos_progress_update(progress, 100);
+    CuAssertIntEquals(tc, 2, last.reports);
+
+    // the rate is an estimate of byte/s, the eta follows the average rate
+    cos_progress_start(progress, 1000000, 0);
+    apr_sleep(apr_time_from_msec(100));
+    cos_progress_update(progress, 1000);
+    cos_progress_report(progress);
+    CuAssertIntEquals(tc, 1000, (int)last.info.consumed_bytes);
+    CuAssertTrue(tc, last.info.average_rate > 0 && last.info.average_rate <= 10000);
+    CuAssertTrue(tc, last.info.instant_rate > 0 && last.info.instant_rate <= 10000);
+    CuAssertTrue(tc, last.info.eta >= 99);
+
+    cos_progress_destroy(progress);
+    cos_pool_destroy(p);
+}
+
 CuSuite *test_cos_sys()
 {
     CuSuite* suite = CuSuiteNew();   
 
     SUITE_ADD_TEST(suite, test_get_xml_doc_with_empty_cos_list);
+    SUITE_ADD_TEST(suite, test_delete_objects_error_parse_from_body);
+    SUITE_ADD_TEST(suite, test_list_parser_parse_by_byte);
+    SUITE_ADD_TEST(suite, test_list_object_compact);
     SUITE_ADD_TEST(suite, test_cos_list_movelist_with_empty_list);
     SUITE_ADD_TEST(suite, test_starts_with_failed);
     SUITE_ADD_TEST(suite, test_is_valid_ip);
@@ -475,6 +956,11 @@ CuSuite *test_cos_sys()
     SUITE_ADD_TEST(suite, test_cos_should_retry);
     SUITE_ADD_TEST(suite, test_cos_strtoll);
     SUITE_ADD_TEST(suite, test_cos_strtoull);
+    SUITE_ADD_TEST(suite, test_cos_read_ahead_upload_file);
+    SUITE_ADD_TEST(suite, test_cos_digest_cache);
+    SUITE_ADD_TEST(suite, test_cos_shared_file_write);
+    SUITE_ADD_TEST(suite, test_cos_part_index);
+    SUITE_ADD_TEST(suite, test_cos_progress);
 
     return suite;
 }